@@ -0,0 +1,118 @@
+/*
+ * Copyright (c) 2025 TU Dresden
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Authors: Mingyu Ma <mingyu.ma@tu-dresden.de>
+ */
+
+/**
+ * Microbenchmark of the ns-3 <-> bmv2 packet conversion done at every P4 hop.
+ *
+ * Each round trip converts an ns-3 packet into a bm::Packet (ingress) and the
+ * bm::Packet back into an ns-3 packet (egress), without running the pipeline.
+ * The benchmark reports the conversion rate and the number of bytes copied per
+ * packet, for the switch core conversion and for the former implementation
+ * (scratch array + PacketBuffer copy + ns-3 copy) as a reference.
+ */
+
+#include "ns3/core-module.h"
+#include "ns3/network-module.h"
+#include "ns3/p4-core-pipeline.h"
+
+#include <chrono>
+#include <iomanip>
+
+using namespace ns3;
+
+NS_LOG_COMPONENT_DEFINE("P4PacketConversionBench");
+
+namespace
+{
+
+/**
+ * @brief Former conversion path, kept here as the reference: three copies
+ */
+Ptr<Packet>
+LegacyRoundTrip(P4SwitchCore* core, Ptr<Packet> nsPacket, uint64_t packetId, uint64_t* copied)
+{
+    int len = nsPacket->GetSize();
+    uint8_t* pkt_buffer = new uint8_t[len];
+    nsPacket->CopyData(pkt_buffer, len);
+    bm::PacketBuffer buffer(len + 512, (char*)pkt_buffer, len);
+    std::unique_ptr<bm::Packet> bm_packet(
+        core->new_packet_ptr(0, packetId, len, std::move(buffer)));
+    delete[] pkt_buffer;
+
+    Ptr<Packet> out = Create<Packet>((uint8_t*)(bm_packet->data()), bm_packet->get_data_size());
+    *copied += 3 * static_cast<uint64_t>(len);
+    return out;
+}
+
+} // namespace
+
+int
+main(int argc, char* argv[])
+{
+    std::string p4JsonPath =
+        "/home/p4/workdir/ns-3-dev-git/contrib/p4sim/examples/p4src/p4_basic/p4_basic.json";
+    uint32_t pktSize = 1000;
+    uint32_t nPackets = 1000000;
+
+    CommandLine cmd;
+    cmd.AddValue("jsonPath", "Path to a compiled P4 program (bmv2 JSON)", p4JsonPath);
+    cmd.AddValue("pktSize", "Packet size in bytes (default 1000)", pktSize);
+    cmd.AddValue("packets", "Number of packets to convert (default 1000000)", nPackets);
+    cmd.Parse(argc, argv);
+
+    P4CorePipeline core(nullptr, false, false);
+    core.InitializeSwitchFromP4Json(p4JsonPath);
+
+    Ptr<Packet> packet = Create<Packet>(pktSize);
+
+    // === Switch core conversion ===
+    auto start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < nPackets; i++)
+    {
+        std::unique_ptr<bm::Packet> bmPacket = core.ConvertToBmPacket(packet, 0);
+        Ptr<Packet> out = core.ConvertToNs3Packet(std::move(bmPacket));
+    }
+    std::chrono::duration<double> coreTime = std::chrono::steady_clock::now() - start;
+
+    const P4SwitchCore::PacketConversionStats& stats = core.GetPacketConversionStats();
+    double coreBytesPerPacket =
+        static_cast<double>(stats.ns3ToBmBytes + stats.bmToNs3Bytes) / nPackets;
+
+    // === Reference: former conversion ===
+    uint64_t legacyCopied = 0;
+    start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < nPackets; i++)
+    {
+        Ptr<Packet> out = LegacyRoundTrip(&core, packet, i, &legacyCopied);
+    }
+    std::chrono::duration<double> legacyTime = std::chrono::steady_clock::now() - start;
+    double legacyBytesPerPacket = static_cast<double>(legacyCopied) / nPackets;
+
+    std::cout << std::fixed << std::setprecision(1);
+    std::cout << "Packet conversion round trips: " << nPackets << " x " << pktSize << " bytes"
+              << std::endl;
+    std::cout << "  switch core : " << coreBytesPerPacket << " bytes copied/packet, "
+              << nPackets / coreTime.count() / 1e6 << " Mpps" << std::endl;
+    std::cout << "  packet pool : " << core.GetPacketPool().GetHitRate() * 100
+              << " % of the bm packets reused" << std::endl;
+    std::cout << "  former path : " << legacyBytesPerPacket << " bytes copied/packet, "
+              << nPackets / legacyTime.count() / 1e6 << " Mpps" << std::endl;
+
+    return 0;
+}
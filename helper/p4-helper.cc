@@ -83,4 +83,11 @@ P4Helper::Install(const std::string& nodeName, const NetDeviceContainer& netDevi
     return Install(node, netDevices);
 }
 
+void
+P4Helper::BringUpSwitches()
+{
+    NS_LOG_FUNCTION_NOARGS();
+    P4SwitchNetDevice::BringUpPendingSwitches();
+}
+
 } // namespace ns3
@@ -88,6 +88,16 @@ class P4Helper
      */
     NetDeviceContainer Install(const std::string& nodeName, const NetDeviceContainer& c) const;
 
+    /**
+     * \brief Bring up all the installed P4 switches.
+     *
+     * Loads the P4 programs and flow tables of all the installed switches on a
+     * thread pool (see the "P4SwitchBringUpThreads" global value). This is done
+     * automatically when the simulation starts; calling it after the last
+     * Install makes the start-up cost visible before Simulator::Run.
+     */
+    static void BringUpSwitches();
+
   private:
     ObjectFactory m_deviceFactory; //!< Factory for creating P4 bridge devices.
 };
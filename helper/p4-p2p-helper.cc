@@ -30,6 +30,12 @@
 #include "ns3/simulator.h"
 #include "ns3/trace-helper.h"
 
+#ifdef NS3_MPI
+#include "ns3/mpi-interface.h"
+#include "ns3/mpi-receiver.h"
+#include "ns3/p4-p2p-remote-channel.h"
+#endif
+
 namespace ns3
 {
 
@@ -267,7 +273,30 @@ P4PointToPointHelper::Install(Ptr<Node> a, Ptr<Node> b)
     devB->AggregateObject(ndqiB);
 
     Ptr<P4P2PChannel> channel = nullptr;
+#ifdef NS3_MPI
+    // A link between nodes of two ranks is carried over MPI. The devices of
+    // both ends are created on every rank, only the local ones are used.
+    bool remote = MpiInterface::IsEnabled() && a->GetSystemId() != b->GetSystemId();
+    if (remote)
+    {
+        m_channelFactory.SetTypeId("ns3::P4P2PRemoteChannel");
+        channel = m_channelFactory.Create<P4P2PRemoteChannel>();
+        m_channelFactory.SetTypeId("ns3::P4P2PChannel");
+
+        Ptr<MpiReceiver> mpiRecA = CreateObject<MpiReceiver>();
+        Ptr<MpiReceiver> mpiRecB = CreateObject<MpiReceiver>();
+        mpiRecA->SetReceiveCallback(MakeCallback(&CustomP2PNetDevice::Receive, devA));
+        mpiRecB->SetReceiveCallback(MakeCallback(&CustomP2PNetDevice::Receive, devB));
+        devA->AggregateObject(mpiRecA);
+        devB->AggregateObject(mpiRecB);
+    }
+    else
+    {
+        channel = m_channelFactory.Create<P4P2PChannel>();
+    }
+#else
     channel = m_channelFactory.Create<P4P2PChannel>();
+#endif
 
     devA->Attach(channel);
     devB->Attach(channel);
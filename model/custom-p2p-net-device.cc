@@ -17,7 +17,9 @@
  * Authors: Mingyu Ma <mingyu.ma@tu-dresden.de>
  */
 
+#include "ns3/boolean.h"
 #include "ns3/custom-p2p-net-device.h"
+#include "ns3/drop-tail-queue.h"
 #include "ns3/error-model.h"
 #include "ns3/llc-snap-header.h"
 #include "ns3/log.h"
@@ -95,6 +97,22 @@ CustomP2PNetDevice::GetTypeId(void)
                           MakeUintegerAccessor(&CustomP2PNetDevice::m_customDstPortMax),
                           MakeUintegerChecker<uint16_t>())
             //
+            // Priority flow control (IEEE 802.1Qbb)
+            //
+            .AddAttribute("PfcEnabled",
+                          "Send the packets through one transmit queue per priority (IPv4 "
+                          "precedence, three high bits of the TOS, 0 for other packets), honor "
+                          "the PFC frames received and allow sending them. The P4 switches "
+                          "with PfcEnabled classify and queue the packets the same way.",
+                          BooleanValue(false),
+                          MakeBooleanAccessor(&CustomP2PNetDevice::m_pfcEnabled),
+                          MakeBooleanChecker())
+            .AddAttribute("PfcPauseQuanta",
+                          "Pause time of the PFC frames sent, in quanta of 512 bit times",
+                          UintegerValue(0xffff),
+                          MakeUintegerAccessor(&CustomP2PNetDevice::m_pfcPauseQuanta),
+                          MakeUintegerChecker<uint16_t>(1))
+            //
             // Trace sources at the "top" of the net device, where packets transition
             // to/from higher layers.
             //
@@ -126,6 +144,16 @@ CustomP2PNetDevice::GetTypeId(void)
             // Trace sources at the "bottom" of the net device, where packets transition
             // to/from the channel.
             //
+            .AddTraceSource("PfcTx",
+                            "A PFC frame pausing or resuming a priority of the peer "
+                            "has been queued for transmission",
+                            MakeTraceSourceAccessor(&CustomP2PNetDevice::m_pfcTxTrace),
+                            "ns3::CustomP2PNetDevice::PfcTracedCallback")
+            .AddTraceSource("PfcRx",
+                            "A PFC frame pausing or resuming a priority has been "
+                            "received from the peer",
+                            MakeTraceSourceAccessor(&CustomP2PNetDevice::m_pfcRxTrace),
+                            "ns3::CustomP2PNetDevice::PfcTracedCallback")
             .AddTraceSource("PhyTxBegin",
                             "Trace source indicating a packet has begun "
                             "transmitting over the channel",
@@ -174,7 +202,10 @@ CustomP2PNetDevice::CustomP2PNetDevice()
       m_channel(0),
       m_NeedProcessHeader(false),
       m_linkUp(false),
-      m_currentPkt(0)
+      m_currentPkt(0),
+      m_pfcEnabled(false),
+      m_pfcPauseQuanta(0xffff),
+      m_pfcPausingPeer(0)
 {
     NS_LOG_FUNCTION(this);
 }
@@ -642,6 +673,14 @@ CustomP2PNetDevice::DoDispose()
     m_channel = 0;
     m_receiveErrorModel = 0;
     m_currentPkt = 0;
+    for (auto& event : m_pfcResume)
+    {
+        Simulator::Cancel(event);
+    }
+    Simulator::Cancel(m_pfcRefreshEvent);
+    m_pfcQueues.clear();
+    m_pfcFrames.clear();
+    m_pfcPauseCallback = MakeNullCallback<void, Ptr<NetDevice>, uint8_t, bool>();
     NetDevice::DoDispose();
 }
 
@@ -709,7 +748,7 @@ CustomP2PNetDevice::TransmitComplete(void)
     m_phyTxEndTrace(m_currentPkt);
     m_currentPkt = nullptr;
 
-    Ptr<Packet> p = m_queue->Dequeue();
+    Ptr<Packet> p = Dequeue();
     if (p == nullptr)
     {
         NS_LOG_LOGIC("No pending packets in device queue after tx complete");
@@ -786,6 +825,12 @@ CustomP2PNetDevice::Receive(Ptr<Packet> packet)
         m_promiscSnifferTrace(packet);
         m_phyRxEndTrace(packet);
 
+        if (m_pfcEnabled && ReceivePfcFrame(packet))
+        {
+            // MAC control frames end in the MAC layer
+            return;
+        }
+
         //
         // Trace sinks will expect complete packets, not packets without some of the
         // headers.
@@ -1016,6 +1061,17 @@ CustomP2PNetDevice::SendFrom(Ptr<Packet> packet,
     Mac48Address mac_source = Mac48Address::ConvertFrom(source);
     NS_LOG_LOGIC("source=" << mac_source << ", dest=" << mac_destination);
 
+    // the priority is read before the link layer headers are added
+    Ptr<Queue<Packet>> queue = m_queue;
+    if (m_pfcEnabled)
+    {
+        if (m_pfcQueues.empty())
+        {
+            CreatePfcQueues();
+        }
+        queue = m_pfcQueues[GetPfcPriority(packet, protocolNumber)];
+    }
+
     if (m_NeedProcessHeader)
     {
         AddHeader(packet, mac_source, mac_destination, protocolNumber);
@@ -1035,7 +1091,7 @@ CustomP2PNetDevice::SendFrom(Ptr<Packet> packet,
     // Place the packet to be sent on the send queue.  Note that the
     // queue may fire a drop trace, but we will too.
     //
-    if (m_queue->Enqueue(packet) == false)
+    if (queue->Enqueue(packet) == false)
     {
         m_macTxDropTrace(packet);
         return false;
@@ -1046,22 +1102,231 @@ CustomP2PNetDevice::SendFrom(Ptr<Packet> packet,
     // the transmission will be started when the current packet finished
     // transmission (see TransmitCompleteEvent)
     //
-    if (m_txMachineState == READY)
+    StartTransmission();
+    return true;
+}
+
+Ptr<Packet>
+CustomP2PNetDevice::Dequeue(void)
+{
+    if (!m_pfcEnabled)
+    {
+        return m_queue->Dequeue();
+    }
+
+    if (!m_pfcFrames.empty())
+    {
+        Ptr<Packet> frame = m_pfcFrames.front();
+        m_pfcFrames.pop_front();
+        return frame;
+    }
+    // strict priority among the priorities not paused by the peer
+    for (size_t priority = m_pfcQueues.size(); priority-- > 0;)
+    {
+        if (!m_pfcResume[priority].IsExpired())
+        {
+            continue;
+        }
+        Ptr<Packet> p = m_pfcQueues[priority]->Dequeue();
+        if (p)
+        {
+            return p;
+        }
+    }
+    return nullptr;
+}
+
+void
+CustomP2PNetDevice::StartTransmission(void)
+{
+    if (m_txMachineState != READY)
+    {
+        return;
+    }
+    Ptr<Packet> packet = Dequeue();
+    if (packet == nullptr)
+    {
+        return;
+    }
+    m_currentPkt = packet;
+    m_promiscSnifferTrace(m_currentPkt);
+    m_snifferTrace(m_currentPkt);
+    TransmitStart(m_currentPkt);
+}
+
+void
+CustomP2PNetDevice::CreatePfcQueues(void)
+{
+    NS_LOG_FUNCTION(this);
+    for (uint8_t priority = 0; priority < PfcHeader::NB_PRIORITIES; priority++)
+    {
+        Ptr<Queue<Packet>> queue = CreateObject<DropTailQueue<Packet>>();
+        if (m_queue)
+        {
+            queue->SetMaxSize(m_queue->GetMaxSize());
+        }
+        m_pfcQueues.push_back(queue);
+    }
+}
+
+uint8_t
+CustomP2PNetDevice::GetPfcPriority(Ptr<const Packet> p, uint16_t protocolNumber) const
+{
+    Ipv4Header ipv4;
+    if (protocolNumber != Ipv4L3Protocol::PROT_NUMBER || p->PeekHeader(ipv4) == 0)
+    {
+        return 0;
+    }
+    return ipv4.GetTos() >> 5;
+}
+
+Ptr<Queue<Packet>>
+CustomP2PNetDevice::GetPfcQueue(uint8_t priority) const
+{
+    return priority < m_pfcQueues.size() ? m_pfcQueues[priority] : nullptr;
+}
+
+bool
+CustomP2PNetDevice::IsPfcPaused(uint8_t priority) const
+{
+    return priority < PfcHeader::NB_PRIORITIES && !m_pfcResume[priority].IsExpired();
+}
+
+void
+CustomP2PNetDevice::SetPfcPauseCallback(PfcPauseCallback cb)
+{
+    m_pfcPauseCallback = cb;
+}
+
+bool
+CustomP2PNetDevice::ReceivePfcFrame(Ptr<Packet> p)
+{
+    EthernetHeader eeh_hd;
+    if (p->PeekHeader(eeh_hd) == 0 || eeh_hd.GetLengthType() != PfcHeader::PROTOCOL_NUMBER)
+    {
+        return false;
+    }
+
+    Ptr<Packet> frame = p->Copy();
+    frame->RemoveHeader(eeh_hd);
+    PfcHeader pfc;
+    frame->RemoveHeader(pfc);
+    if (!pfc.IsPfc())
     {
-        if (m_queue->IsEmpty() == false)
+        NS_LOG_DEBUG("Ignoring a MAC control frame which is not PFC");
+        return true;
+    }
+
+    for (uint8_t priority = 0; priority < PfcHeader::NB_PRIORITIES; priority++)
+    {
+        if (!pfc.IsEnabled(priority))
+        {
+            continue;
+        }
+        uint16_t quanta = pfc.GetQuanta(priority);
+        m_pfcRxTrace(priority, quanta != 0);
+        bool paused = IsPfcPaused(priority);
+        Simulator::Cancel(m_pfcResume[priority]);
+        if (quanta == 0)
+        {
+            if (paused)
+            {
+                PfcResume(priority);
+            }
+            continue;
+        }
+        // a quantum is 512 bit times at the rate of the link
+        Time pause = m_bps.CalculateBytesTxTime(64 * static_cast<uint32_t>(quanta));
+        NS_LOG_DEBUG("Priority " << +priority << " paused for " << pause.As(Time::US));
+        m_pfcResume[priority] =
+            Simulator::Schedule(pause, &CustomP2PNetDevice::PfcResume, this, priority);
+        if (!paused && !m_pfcPauseCallback.IsNull())
         {
-            Ptr<Packet> packet = m_queue->Dequeue();
-            NS_ASSERT_MSG(packet != nullptr,
-                          "CustomP2PNetDevice::SendFrom(): IsEmpty false but no packet on queue?");
-            m_currentPkt = packet;
-            m_promiscSnifferTrace(m_currentPkt);
-            m_snifferTrace(m_currentPkt);
-            TransmitStart(m_currentPkt);
+            m_pfcPauseCallback(this, priority, true);
         }
     }
     return true;
 }
 
+void
+CustomP2PNetDevice::PfcResume(uint8_t priority)
+{
+    NS_LOG_FUNCTION(this << +priority);
+    Simulator::Cancel(m_pfcResume[priority]);
+    if (!m_pfcPauseCallback.IsNull())
+    {
+        m_pfcPauseCallback(this, priority, false);
+    }
+    StartTransmission();
+}
+
+void
+CustomP2PNetDevice::SendPfcPause(uint8_t priority, bool pause)
+{
+    NS_LOG_FUNCTION(this << +priority << pause);
+    if (!m_pfcEnabled || priority >= PfcHeader::NB_PRIORITIES)
+    {
+        NS_LOG_WARN("PFC disabled or priority " << +priority << " out of range, no frame sent");
+        return;
+    }
+
+    uint8_t bit = 1 << priority;
+    if (pause)
+    {
+        m_pfcPausingPeer |= bit;
+    }
+    else
+    {
+        m_pfcPausingPeer &= ~bit;
+    }
+    m_pfcTxTrace(priority, pause);
+    SendPfcFrame(bit, pause ? m_pfcPauseQuanta : 0);
+
+    if (m_pfcPausingPeer != 0 && m_pfcRefreshEvent.IsExpired())
+    {
+        // refreshed at half the pause time, before it expires on the peer
+        Time refresh = m_bps.CalculateBytesTxTime(32 * static_cast<uint32_t>(m_pfcPauseQuanta));
+        m_pfcRefreshEvent =
+            Simulator::Schedule(refresh, &CustomP2PNetDevice::RefreshPfcPause, this);
+    }
+}
+
+void
+CustomP2PNetDevice::RefreshPfcPause(void)
+{
+    if (m_pfcPausingPeer == 0)
+    {
+        return;
+    }
+    SendPfcFrame(m_pfcPausingPeer, m_pfcPauseQuanta);
+    Time refresh = m_bps.CalculateBytesTxTime(32 * static_cast<uint32_t>(m_pfcPauseQuanta));
+    m_pfcRefreshEvent = Simulator::Schedule(refresh, &CustomP2PNetDevice::RefreshPfcPause, this);
+}
+
+void
+CustomP2PNetDevice::SendPfcFrame(uint8_t classEnable, uint16_t quanta)
+{
+    PfcHeader pfc;
+    for (uint8_t priority = 0; priority < PfcHeader::NB_PRIORITIES; priority++)
+    {
+        if (classEnable & (1 << priority))
+        {
+            pfc.SetPause(priority, quanta);
+        }
+    }
+    Ptr<Packet> frame = Create<Packet>();
+    frame->AddHeader(pfc);
+    EthernetHeader eeh_hd;
+    eeh_hd.SetSource(m_address);
+    eeh_hd.SetDestination(Mac48Address("01:80:c2:00:00:01"));
+    eeh_hd.SetLengthType(PfcHeader::PROTOCOL_NUMBER);
+    frame->AddHeader(eeh_hd);
+
+    // the PFC frames overtake the data packets
+    m_pfcFrames.push_back(frame);
+    StartTransmission();
+}
+
 Ptr<Node>
 CustomP2PNetDevice::GetNode(void) const
 {
@@ -25,11 +25,13 @@
 #include "ns3/custom-header.h"
 #include "ns3/data-rate.h"
 #include "ns3/ethernet-header.h"
+#include "ns3/event-id.h"
 #include "ns3/net-device.h"
 #include "ns3/node.h"
 #include "ns3/nstime.h"
 #include "ns3/p4-p2p-channel.h"
 #include "ns3/packet.h"
+#include "ns3/pfc-header.h"
 #include "ns3/ptr.h"
 #include "ns3/queue.h"
 #include "ns3/traced-callback.h"
@@ -39,7 +41,10 @@
 #include <ns3/tcp-header.h>
 #include <ns3/udp-header.h>
 
+#include <array>
 #include <cstring>
+#include <deque>
+#include <vector>
 
 namespace ns3
 {
@@ -136,6 +141,56 @@ class CustomP2PNetDevice : public NetDevice
 
     void SetCustomHeader(CustomHeader customHeader);
 
+    /**
+     * Callback reporting the priorities paused and resumed by the PFC frames
+     * received from the peer: device, priority, true if paused.
+     */
+    typedef Callback<void, Ptr<NetDevice>, uint8_t, bool> PfcPauseCallback;
+
+    /**
+     * TracedCallback signature for the PFC pause and resume events.
+     *
+     * \param [in] priority The priority.
+     * \param [in] pause True for a pause, false for a resume.
+     */
+    typedef void (*PfcTracedCallback)(uint8_t priority, bool pause);
+
+    /**
+     * Pause or resume a priority of the peer device with a PFC frame.
+     *
+     * While at least one priority is paused, the pause is refreshed before it
+     * expires on the peer. Needs PfcEnabled.
+     *
+     * \param priority the priority
+     * \param pause true to pause the priority, false to resume it
+     */
+    void SendPfcPause(uint8_t priority, bool pause);
+
+    /**
+     * Check if the transmission of a priority is paused by the peer.
+     *
+     * \param priority the priority
+     * \return true if a PFC frame of the peer paused the priority
+     */
+    bool IsPfcPaused(uint8_t priority) const;
+
+    /**
+     * Set the callback reporting the priorities paused and resumed by the
+     * peer, e.g. to pause the queues feeding this device.
+     *
+     * \param cb the callback
+     */
+    void SetPfcPauseCallback(PfcPauseCallback cb);
+
+    /**
+     * Get the transmit queue of a priority, used instead of the TxQueue with
+     * PfcEnabled.
+     *
+     * \param priority the priority
+     * \return the queue, nullptr before the first packet sent
+     */
+    Ptr<Queue<Packet>> GetPfcQueue(uint8_t priority) const;
+
     // The remaining methods are documented in ns3::NetDevice*
 
     virtual void SetIfIndex(const uint32_t index);
@@ -296,6 +351,63 @@ class CustomP2PNetDevice : public NetDevice
      */
     void TransmitComplete(void);
 
+    /**
+     * Get the next packet to transmit: with PfcEnabled, the pending PFC
+     * frames, then the packets of the highest priority not paused.
+     *
+     * \return the packet, nullptr if none can be sent
+     */
+    Ptr<Packet> Dequeue(void);
+
+    /**
+     * Start transmitting the next packet if the transmitter is ready.
+     */
+    void StartTransmission(void);
+
+    /**
+     * Create the per-priority transmit queues, with the size of the TxQueue.
+     */
+    void CreatePfcQueues(void);
+
+    /**
+     * Get the PFC priority of a packet sent: the IPv4 precedence (three high
+     * bits of the TOS), 0 for other packets.
+     *
+     * \param p the packet, without link layer header
+     * \param protocolNumber protocol number
+     * \return the priority
+     */
+    uint8_t GetPfcPriority(Ptr<const Packet> p, uint16_t protocolNumber) const;
+
+    /**
+     * Handle a received MAC control frame.
+     *
+     * \param p the received packet
+     * \return true if the packet was a MAC control frame, consumed here
+     */
+    bool ReceivePfcFrame(Ptr<Packet> p);
+
+    /**
+     * Resume a priority paused by the peer, at the expiry of its pause time
+     * or on a PFC frame resuming it.
+     *
+     * \param priority the priority
+     */
+    void PfcResume(uint8_t priority);
+
+    /**
+     * Queue a PFC frame ahead of the data packets.
+     *
+     * \param classEnable the priorities of the frame, one bit each
+     * \param quanta the pause time of these priorities, 0 to resume them
+     */
+    void SendPfcFrame(uint8_t classEnable, uint16_t quanta);
+
+    /**
+     * Send the pause of the priorities still paused on the peer again.
+     */
+    void RefreshPfcPause(void);
+
     /**
      * \brief Make the link up and running
      *
@@ -494,6 +606,18 @@ class CustomP2PNetDevice : public NetDevice
 
     Ptr<Packet> m_currentPkt; //!< Current packet processed
 
+    bool m_pfcEnabled;                           //!< Per-priority queues, PFC frames handled
+    uint16_t m_pfcPauseQuanta;                   //!< Pause time of the PFC frames sent
+    std::vector<Ptr<Queue<Packet>>> m_pfcQueues; //!< Transmit queues per priority
+    std::deque<Ptr<Packet>> m_pfcFrames;         //!< PFC frames waiting for the transmitter
+    uint8_t m_pfcPausingPeer;                    //!< Priorities paused on the peer, one bit each
+    EventId m_pfcRefreshEvent;                   //!< Next refresh of the peer pauses
+    PfcPauseCallback m_pfcPauseCallback;         //!< Reports the pauses of the peer
+    TracedCallback<uint8_t, bool> m_pfcTxTrace;  //!< PFC pause or resume sent to the peer
+    TracedCallback<uint8_t, bool> m_pfcRxTrace;  //!< PFC pause or resume received from the peer
+    //! Expiry of the pauses received from the peer, per priority
+    std::array<EventId, PfcHeader::NB_PRIORITIES> m_pfcResume;
+
     // /**
     //  * \brief PPP to Ethernet protocol number mapping
     //  * \param protocol A PPP protocol number
@@ -58,6 +58,16 @@ struct bmv2_hash_v1model_pipeline
     }
 };
 
+// Programmable blocks of the simple pipeline (v1model program names)
+const P4SwitchCore::ArchDescriptor g_pipelineArch = {
+    "parser",   // ingress parser
+    "ingress",  // ingress pipeline
+    nullptr,    // ingress deparser
+    nullptr,    // egress parser
+    "egress",   // egress pipeline
+    "deparser", // egress deparser
+};
+
 } // namespace
 
 // if REGISTER_HASH calls placed in the anonymous namespace, some compiler can
@@ -82,6 +92,10 @@ P4CorePipeline::P4CorePipeline(P4SwitchNetDevice* netDevice, bool enableSwap, bo
     force_arith_header("standard_metadata");
     // force_arith_header("queueing_metadata"); // not supported queueing metadata
     force_arith_header("intrinsic_metadata");
+
+    m_pipelineStage.SetHandler([this](OutputItem&& item) {
+        m_switchNetDevice->SendNs3Packet(item.packet, item.port, item.protocol, item.destination);
+    });
 }
 
 P4CorePipeline::~P4CorePipeline()
@@ -112,8 +126,8 @@ P4CorePipeline::ReceivePacket(Ptr<Packet> packetIn,
     f_instance_type.set(PKT_INSTANCE_TYPE_NORMAL);
 
     // === Parser and MAU processing
-    bm::Parser* parser = this->get_parser("parser");
-    bm::Pipeline* ingress_mau = this->get_pipeline("ingress");
+    bm::Parser* parser = m_blocks.ingressParser;
+    bm::Pipeline* ingress_mau = m_blocks.ingressPipeline;
     parser->parse(bm_packet.get());
     ingress_mau->apply(bm_packet.get());
 
@@ -129,8 +143,8 @@ P4CorePipeline::ReceivePacket(Ptr<Packet> packetIn,
     }
 
     // === Egress
-    bm::Pipeline* egress_mau = this->get_pipeline("egress");
-    bm::Deparser* deparser = this->get_deparser("deparser");
+    bm::Pipeline* egress_mau = m_blocks.egressPipeline;
+    bm::Deparser* deparser = m_blocks.egressDeparser;
     phv->get_field("standard_metadata.egress_port").set(egress_spec);
     f_egress_spec = phv->get_field("standard_metadata.egress_spec");
     f_egress_spec.set(0);
@@ -145,7 +159,7 @@ P4CorePipeline::ReceivePacket(Ptr<Packet> packetIn,
 
     // === Send the packet to the destination
     Ptr<Packet> ns_packet = ConvertToNs3Packet(std::move(bm_packet));
-    m_switchNetDevice->SendNs3Packet(ns_packet, egress_spec, protocol, destination);
+    m_pipelineStage.Push(OutputItem{ns_packet, egress_spec, protocol, destination});
     return 0;
 }
 
@@ -160,12 +174,28 @@ void
 P4CorePipeline::start_and_return_()
 {
     NS_LOG_FUNCTION(this);
+    ResolveArchBlocks(g_pipelineArch);
+    ApplyPipelineLatency();
 }
 
 void
 P4CorePipeline::swap_notify_()
 {
     NS_LOG_FUNCTION("p4_switch has been notified of a config swap");
+    // the cached packets hold PHVs of the former program
+    m_packetPool.Clear();
+    ResolveArchBlocks(g_pipelineArch);
+    ApplyPipelineLatency();
+}
+
+void
+P4CorePipeline::ApplyPipelineLatency()
+{
+    const PipelineLatency& latency = m_pipelineLatency;
+    m_pipelineStage.SetLatency(
+        latency.parser + latency.ingressStage + latency.egressStage + latency.deparser +
+        latency.tableLookup * (GetNumTables("ingress") + GetNumTables("egress")));
+    NS_LOG_DEBUG("Pipeline latency " << m_pipelineStage.GetLatency());
 }
 
 void
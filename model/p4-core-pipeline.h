@@ -22,6 +22,7 @@
 #define P4_CORE_V1MODEL_PIPELINE_H
 
 #include "ns3/p4-queue.h"
+#include "ns3/p4-stage-fifo.h"
 #include "ns3/p4-switch-core.h"
 
 namespace ns3
@@ -109,7 +110,27 @@ class P4CorePipeline : public P4SwitchCore
     bool HandleEgressPipeline(size_t workerId) override;
 
   private:
-    uint64_t m_packetId; //!< Packet ID
+    /**
+     * @brief A packet on its way out of the pipeline
+     */
+    struct OutputItem
+    {
+        Ptr<Packet> packet;  //!< The deparsed packet
+        uint32_t port;       //!< Egress port
+        uint16_t protocol;   //!< ns-3 protocol number
+        Address destination; //!< Destination address
+    };
+
+    /**
+     * @brief Set the latency of the pipeline from the pipeline latency model
+     * and the tables of the loaded program
+     * @details Without a queue buffer, all the stages are timed as one: the
+     * packet leaves the pipeline once the latency of all of them has elapsed.
+     */
+    void ApplyPipelineLatency();
+
+    uint64_t m_packetId;                     //!< Packet ID
+    P4StageFifo<OutputItem> m_pipelineStage; //!< Parser, controls and deparser
 };
 
 } // namespace ns3
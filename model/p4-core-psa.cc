@@ -21,6 +21,8 @@
 #include "ns3/register-access-v1model.h"
 #include "ns3/simulator.h"
 
+#include <algorithm>
+
 NS_LOG_COMPONENT_DEFINE("P4CorePsa");
 
 namespace ns3
@@ -56,6 +58,16 @@ struct bmv2_hash_psa
     }
 };
 
+// Programmable blocks of the PSA architecture
+const P4SwitchCore::ArchDescriptor g_psaArch = {
+    "ingress_parser",   // ingress parser
+    "ingress",          // ingress pipeline
+    "ingress_deparser", // ingress deparser
+    "egress_parser",    // egress parser
+    "egress",           // egress pipeline
+    "egress_deparser",  // egress deparser
+};
+
 } // namespace
 
 // if REGISTER_HASH calls placed in the anonymous namespace, some compiler can
@@ -72,14 +84,14 @@ P4CorePsa::P4CorePsa(P4SwitchNetDevice* net_device,
                      size_t nb_queues_per_port)
     : P4SwitchCore(net_device, enable_swap, enable_tracing),
       m_packetId(0),
-      m_firstPacket(false),
       m_switchRate(packet_rate),
       m_nbQueuesPerPort(nb_queues_per_port),
       input_buffer(input_buffer_size),
       egress_buffer(nb_egress_threads,
                     queue_buffer_size,
                     EgressThreadMapper(nb_egress_threads),
-                    nb_queues_per_port),
+                    nb_queues_per_port,
+                    net_device ? net_device->GetNBridgePorts() : 0),
       output_buffer(SSWITCH_VIRTUAL_QUEUE_NUM_PSA)
 {
     // configure for the switch v1model
@@ -128,17 +140,40 @@ P4CorePsa::P4CorePsa(P4SwitchNetDevice* net_device,
     force_arith_header("psa_egress_output_metadata");
     force_arith_header("psa_egress_deparser_input_metadata");
 
+    // the packets are deparsed before the queues and parsed again at egress,
+    // the mark is written in the frame
+    egress_buffer.set_ecn_marker(
+        [](std::unique_ptr<bm::Packet>& packet) { return MarkEcnFrame(packet.get()); });
+
+    // the resubmitted and recirculated packets enter the ingress pipeline
+    // directly, only the packets from the ports go through the ingress stage
+    m_ingressStage.SetHandler([this](std::unique_ptr<bm::Packet>&& packet) {
+        input_buffer.push_front(std::move(packet));
+        HandleIngressPipeline();
+    });
+    m_egressStage.SetHandler([this](EgressItem&& item) {
+        TracePacket(TRACE_EGRESS_DONE,
+                    item.packetId,
+                    item.packet->GetSize(),
+                    item.port,
+                    item.priority,
+                    egress_buffer.size(item.port));
+        m_switchNetDevice->SendNs3Packet(item.packet,
+                                         item.port,
+                                         item.protocol,
+                                         m_destinationList[item.addrIndex]);
+    });
+
     CalculateScheduleTime();
 }
 
 P4CorePsa::~P4CorePsa()
 {
     NS_LOG_FUNCTION(this << " Switch ID: " << m_p4SwitchId);
+    Simulator::Cancel(m_egressTimeEvent);
+    P4MetricsSink::Remove(this);
     input_buffer.push_front(nullptr);
-    for (size_t i = 0; i < nb_egress_threads; i++)
-    {
-        egress_buffer.push_front(i, 0, nullptr);
-    }
+    // The egress queues are served by events, no thread waits for a sentinel
     output_buffer.push_front(nullptr);
 }
 
@@ -147,39 +182,134 @@ P4CorePsa::start_and_return_()
 {
     NS_LOG_FUNCTION("Switch ID: " << m_p4SwitchId << " start");
     CheckQueueingMetadata();
-
-    if (!m_egressTimeRef.IsZero())
+    ResolveArchBlocks(g_psaArch);
+    ResolvePhvFields();
+    ApplyPipelineLatency();
+    // the first egress event is scheduled by the first enqueued packet
+    if (m_enableTracing)
     {
-        NS_LOG_DEBUG("Switch ID: " << m_p4SwitchId
-                                   << " Scheduling initial timer event using m_egressTimeRef = "
-                                   << m_egressTimeRef.GetNanoSeconds() << " ns");
-        m_egressTimeEvent =
-            Simulator::Schedule(m_egressTimeRef, &P4CorePsa::SetEgressTimerEvent, this);
+        NS_LOG_INFO("Enabling tracing in P4 Switch ID: " << m_p4SwitchId);
+        P4MetricsSink::Get()->Add(this, [this](P4MetricsSink* sink, Time now) {
+            SampleMetrics(sink, now);
+        });
     }
 }
 
 void
-P4CorePsa::SetEgressTimerEvent()
+P4CorePsa::ScheduleEgressEvent()
 {
-    NS_LOG_FUNCTION("p4_switch has been triggered by the egress timer event");
-    bool checkflag = HandleEgressPipeline(0);
-    m_egressTimeEvent = Simulator::Schedule(m_egressTimeRef, &P4CorePsa::SetEgressTimerEvent, this);
-    if (!m_firstPacket && checkflag)
+    if (egress_buffer.empty())
     {
-        m_firstPacket = true;
+        return;
     }
-    if (m_firstPacket && !checkflag)
+
+    // The next packet leaves when its queue and its port allow it, the ports
+    // transmit independently of each other
+    Time next = egress_buffer.get_next_tp_all_ports();
+    if (next == Time::Max())
     {
-        NS_LOG_INFO("Egress timer event needs additional scheduling due to !checkflag.");
-        Simulator::Schedule(Time(NanoSeconds(10)), &P4CorePsa::HandleEgressPipeline, this, 0);
+        // all the queued packets are paused, resuming a queue schedules the
+        // next event (see SetEgressQueuePaused)
+        return;
     }
+    Time now = Simulator::Now();
+    next = std::max(next, now);
+
+    if (!m_egressTimeEvent.IsExpired())
+    {
+        if (m_egressTimeEvent.GetTs() <= static_cast<uint64_t>(next.GetTimeStep()))
+        {
+            return;
+        }
+        // a packet became eligible earlier than the pending event
+        Simulator::Cancel(m_egressTimeEvent);
+    }
+    m_egressTimeEvent = Simulator::Schedule(next - now, &P4CorePsa::EgressEvent, this);
+}
+
+void
+P4CorePsa::EgressEvent()
+{
+    NS_LOG_FUNCTION("Switch ID: " << m_p4SwitchId << " egress event");
+    // all the packets eligible now are processed in this event
+    egress_buffer.pop_back_batch(0, m_egressBatchSize, &m_egressBatch);
+    for (auto& popped : m_egressBatch)
+    {
+        ProcessEgressPacket(popped.queue_id, popped.priority, std::move(popped.item));
+    }
+    m_egressBatch.clear();
+    ScheduleEgressEvent();
 }
 
 void
 P4CorePsa::swap_notify_()
 {
     NS_LOG_FUNCTION("p4_switch has been notified of a config swap");
+    // the cached packets hold PHVs of the former program
+    m_packetPool.Clear();
     CheckQueueingMetadata();
+    ResolveArchBlocks(g_psaArch);
+    ResolvePhvFields();
+    ApplyPipelineLatency();
+}
+
+void
+P4CorePsa::ApplyPipelineLatency()
+{
+    // As in the v1model, the ingress deparser is not timed: the deparser
+    // latency is taken once, at egress
+    const PipelineLatency& latency = m_pipelineLatency;
+    m_ingressStage.SetLatency(latency.parser + latency.ingressStage +
+                              latency.tableLookup * GetNumTables("ingress"));
+    m_egressStage.SetLatency(latency.egressStage + latency.deparser +
+                             latency.tableLookup * GetNumTables("egress"));
+    NS_LOG_DEBUG("Switch ID: " << m_p4SwitchId << " ingress latency "
+                               << m_ingressStage.GetLatency() << ", egress latency "
+                               << m_egressStage.GetLatency());
+}
+
+void
+P4CorePsa::ResolvePhvFields()
+{
+    // Any packet carries a PHV with the layout of the loaded program
+    std::unique_ptr<bm::Packet> probe = m_packetPool.Acquire(0, 0, 0);
+    const bm::PHV& phv = *probe->get_phv();
+
+    m_fields.igParserPacketPath =
+        ResolveField(phv, "psa_ingress_parser_input_metadata.packet_path");
+    m_fields.igParserIngressPort =
+        ResolveField(phv, "psa_ingress_parser_input_metadata.ingress_port");
+    m_fields.igIngressTimestamp = ResolveField(phv, "psa_ingress_input_metadata.ingress_timestamp");
+    m_fields.igIngressPort = ResolveField(phv, "psa_ingress_input_metadata.ingress_port");
+    m_fields.igPacketPath = ResolveField(phv, "psa_ingress_input_metadata.packet_path");
+    m_fields.igParserError = ResolveField(phv, "psa_ingress_input_metadata.parser_error");
+    m_fields.igOutClassOfService =
+        ResolveField(phv, "psa_ingress_output_metadata.class_of_service");
+    m_fields.igOutClone = ResolveField(phv, "psa_ingress_output_metadata.clone");
+    m_fields.igOutCloneSessionId =
+        ResolveField(phv, "psa_ingress_output_metadata.clone_session_id");
+    m_fields.igOutDrop = ResolveField(phv, "psa_ingress_output_metadata.drop");
+    m_fields.igOutResubmit = ResolveField(phv, "psa_ingress_output_metadata.resubmit");
+    m_fields.igOutMulticastGroup = ResolveField(phv, "psa_ingress_output_metadata.multicast_group");
+    m_fields.igOutEgressPort = ResolveField(phv, "psa_ingress_output_metadata.egress_port");
+    m_fields.egParserPacketPath = ResolveField(phv, "psa_egress_parser_input_metadata.packet_path");
+    m_fields.egParserEgressPort = ResolveField(phv, "psa_egress_parser_input_metadata.egress_port");
+    m_fields.egClassOfService = ResolveField(phv, "psa_egress_input_metadata.class_of_service");
+    m_fields.egEgressTimestamp = ResolveField(phv, "psa_egress_input_metadata.egress_timestamp");
+    m_fields.egInstance = ResolveField(phv, "psa_egress_input_metadata.instance");
+    m_fields.egEgressPort = ResolveField(phv, "psa_egress_input_metadata.egress_port");
+    m_fields.egPacketPath = ResolveField(phv, "psa_egress_input_metadata.packet_path");
+    m_fields.egParserError = ResolveField(phv, "psa_egress_input_metadata.parser_error");
+    m_fields.egOutClone = ResolveField(phv, "psa_egress_output_metadata.clone");
+    m_fields.egOutCloneSessionId = ResolveField(phv, "psa_egress_output_metadata.clone_session_id");
+    m_fields.egOutDrop = ResolveField(phv, "psa_egress_output_metadata.drop");
+    m_fields.egDeparserEgressPort =
+        ResolveField(phv, "psa_egress_deparser_input_metadata.egress_port");
+    m_fields.priority = ResolveField(phv, "intrinsic_metadata.priority");
+
+    ResolvePfcField(phv);
+
+    m_packetPool.Release(std::move(probe));
 }
 
 void
@@ -202,6 +332,9 @@ P4CorePsa::ReceivePacket(Ptr<Packet> packetIn,
     int len = bm_packet.get()->get_data_size();
     bm_packet.get()->set_ingress_port(inPort);
 
+    m_traffic.inputPackets++;
+    m_traffic.inputBits += len * 8;
+
     // many current p4 programs assume this
     // from psa spec - PSA does not mandate initialization of user-defined
     // metadata to known values as given as input to the ingress parser
@@ -214,16 +347,15 @@ P4CorePsa::ReceivePacket(Ptr<Packet> packetIn,
     RegisterAccess::set_ns_address(bm_packet.get(), addr_index);
 
     // TODO use appropriate enum member from JSON
-    phv->get_field("psa_ingress_parser_input_metadata.packet_path").set(PACKET_PATH_NORMAL);
-    phv->get_field("psa_ingress_parser_input_metadata.ingress_port").set(inPort);
+    GetField(phv, m_fields.igParserPacketPath).set(PACKET_PATH_NORMAL);
+    GetField(phv, m_fields.igParserIngressPort).set(inPort);
 
     // using packet register 0 to store length, this register will be updated for
     // each add_header / remove_header primitive call
     bm_packet->set_register(RegisterAccess::PACKET_LENGTH_REG_IDX, len);
 
-    input_buffer.push_front(std::move(bm_packet));
     // input_buffer.push_front (InputBuffer::PacketType::NORMAL, std::move (bm_packet));
-    HandleIngressPipeline();
+    m_ingressStage.Push(std::move(bm_packet));
     NS_LOG_DEBUG("Packet received by P4CorePsa, Port: " << inPort << ", Packet ID: " << m_packetId
                                                         << ", Size: " << len << " bytes");
     return 0;
@@ -236,16 +368,55 @@ P4CorePsa::Enqueue(uint32_t egress_port, std::unique_ptr<bm::Packet>&& packet)
 
     bm::PHV* phv = packet->get_phv();
 
-    auto priority = phv->has_field("intrinsic_metadata.priority")
-                        ? phv->get_field("intrinsic_metadata.priority").get<size_t>()
-                        : 0u;
+    size_t priority =
+        m_fields.priority.exists ? GetField(phv, m_fields.priority).get<size_t>() : 0u;
+    if (m_pfc)
+    {
+        // queue by PFC priority, the classification of the pauses
+        priority = GetPfcPriority(packet.get());
+        if (m_fields.priority.exists)
+        {
+            GetField(phv, m_fields.priority).set(priority);
+        }
+    }
     if (priority >= m_nbQueuesPerPort)
     {
         NS_LOG_ERROR("Priority out of range, dropping packet");
+        DropPacket(std::move(packet),
+                   P4MetricsSink::DROP_PRIORITY,
+                   egress_port,
+                   priority,
+                   egress_buffer.size(egress_port));
         return;
     }
 
-    egress_buffer.push_front(egress_port, m_nbQueuesPerPort - 1 - priority, std::move(packet));
+    size_t queue = m_nbQueuesPerPort - 1 - priority;
+    uint64_t packet_id = m_packetPool.GetPacketId(packet.get());
+    size_t packet_size = packet->get_data_size();
+    uint32_t ingress_port = packet->get_ingress_port();
+    P4Aqm::Verdict verdict;
+    if (!egress_buffer.push_front(egress_port, queue, std::move(packet), packet_size, &verdict))
+    {
+        // queue full or AQM drop, the packet was not taken
+        DropPacket(std::move(packet),
+                   verdict == P4Aqm::DROP ? P4MetricsSink::DROP_AQM
+                                          : P4MetricsSink::DROP_QUEUE_FULL,
+                   egress_port,
+                   priority,
+                   egress_buffer.size(egress_port));
+        return;
+    }
+    if (m_pfc)
+    {
+        m_pfc->OnEnqueue(ingress_port, priority, packet_size);
+    }
+    TracePacket(TRACE_ENQUEUED,
+                packet_id,
+                packet_size,
+                egress_port,
+                priority,
+                egress_buffer.size(egress_port));
+    ScheduleEgressEvent();
     NS_LOG_DEBUG("Packet enqueued in P4QueueDisc, Port: " << egress_port
                                                           << ", Priority: " << priority);
 }
@@ -262,10 +433,10 @@ P4CorePsa::HandleIngressPipeline()
 
     bm::PHV* phv = bm_packet->get_phv();
 
-    auto ingress_port = phv->get_field("psa_ingress_parser_input_metadata.ingress_port").get_uint();
+    auto ingress_port = GetField(phv, m_fields.igParserIngressPort).get_uint();
 
     NS_LOG_INFO("Processing packet from port "
-                << ingress_port << ", Packet ID: " << bm_packet->get_packet_id()
+                << ingress_port << ", Packet ID: " << m_packetPool.GetPacketId(bm_packet.get())
                 << ", Size: " << bm_packet->get_data_size() << " bytes");
 
     /* Ingress cloning and resubmitting work on the packet before parsing.
@@ -282,42 +453,39 @@ P4CorePsa::HandleIngressPipeline()
     // ingress_timestamp should be the time near when the packet began
     // ingress processing.  This one place for assigning a value to
     // ingress_timestamp covers all cases.
-    phv->get_field("psa_ingress_input_metadata.ingress_timestamp").set(GetTimeStamp());
+    GetField(phv, m_fields.igIngressTimestamp).set(GetTimeStamp());
 
-    bm::Parser* parser = this->get_parser("ingress_parser");
+    bm::Parser* parser = m_blocks.ingressParser;
     parser->parse(bm_packet.get());
 
     // pass relevant values from ingress parser
     // ingress_timestamp is already set above
-    phv->get_field("psa_ingress_input_metadata.ingress_port")
-        .set(phv->get_field("psa_ingress_parser_input_metadata.ingress_port"));
-    phv->get_field("psa_ingress_input_metadata.packet_path")
-        .set(phv->get_field("psa_ingress_parser_input_metadata.packet_path"));
-    phv->get_field("psa_ingress_input_metadata.parser_error")
-        .set(bm_packet->get_error_code().get());
+    GetField(phv, m_fields.igIngressPort).set(GetField(phv, m_fields.igParserIngressPort));
+    GetField(phv, m_fields.igPacketPath).set(GetField(phv, m_fields.igParserPacketPath));
+    GetField(phv, m_fields.igParserError).set(bm_packet->get_error_code().get());
 
     // set default metadata values according to PSA specification
-    phv->get_field("psa_ingress_output_metadata.class_of_service").set(0);
-    phv->get_field("psa_ingress_output_metadata.clone").set(0);
-    phv->get_field("psa_ingress_output_metadata.drop").set(1);
-    phv->get_field("psa_ingress_output_metadata.resubmit").set(0);
-    phv->get_field("psa_ingress_output_metadata.multicast_group").set(0);
+    GetField(phv, m_fields.igOutClassOfService).set(0);
+    GetField(phv, m_fields.igOutClone).set(0);
+    GetField(phv, m_fields.igOutDrop).set(1);
+    GetField(phv, m_fields.igOutResubmit).set(0);
+    GetField(phv, m_fields.igOutMulticastGroup).set(0);
 
-    bm::Pipeline* ingress_mau = this->get_pipeline("ingress");
+    bm::Pipeline* ingress_mau = m_blocks.ingressPipeline;
     ingress_mau->apply(bm_packet.get());
     bm_packet->reset_exit();
+    TracePacket(TRACE_INGRESS_PARSED, bm_packet.get(), ingress_port, 0, input_buffer.size());
 
-    const auto& f_ig_cos = phv->get_field("psa_ingress_output_metadata.class_of_service");
+    const auto& f_ig_cos = GetField(phv, m_fields.igOutClassOfService);
     const auto ig_cos = f_ig_cos.get_uint();
 
     // ingress cloning - each cloned packet is a copy of the packet as it entered the ingress parser
     //                 - dropped packets should still be cloned - do not move below drop
-    auto clone = phv->get_field("psa_ingress_output_metadata.clone").get_uint();
+    auto clone = GetField(phv, m_fields.igOutClone).get_uint();
     if (clone)
     {
         MirroringSessionConfig config;
-        auto clone_session_id =
-            phv->get_field("psa_ingress_output_metadata.clone_session_id").get<int>();
+        auto clone_session_id = GetField(phv, m_fields.igOutCloneSessionId).get<int>();
         auto is_session_configured = GetMirroringSession(clone_session_id, &config);
 
         if (is_session_configured)
@@ -327,11 +495,11 @@ P4CorePsa::HandleIngressPipeline()
             bm_packet->restore_buffer_state(packet_in_state);
 
             std::unique_ptr<bm::Packet> packet_copy = bm_packet->clone_no_phv_ptr();
+            m_packetPool.AddClone(packet_copy.get(), bm_packet.get());
             packet_copy->set_register(RegisterAccess::PACKET_LENGTH_REG_IDX, ingress_packet_size);
             auto phv_copy = packet_copy->get_phv();
             phv_copy->reset_metadata();
-            phv_copy->get_field("psa_egress_parser_input_metadata.packet_path")
-                .set(PACKET_PATH_CLONE_I2E);
+            GetField(phv_copy, m_fields.egParserPacketPath).set(PACKET_PATH_CLONE_I2E);
 
             if (config.mgid_valid)
             {
@@ -344,6 +512,11 @@ P4CorePsa::HandleIngressPipeline()
             if (config.egress_port_valid)
             {
                 NS_LOG_DEBUG("Cloning packet to egress port " << config.egress_port);
+                TracePacket(TRACE_CLONED,
+                            packet_copy.get(),
+                            config.egress_port,
+                            0,
+                            egress_buffer.size(config.egress_port));
                 Enqueue(config.egress_port, std::move(packet_copy));
             }
 
@@ -359,24 +532,32 @@ P4CorePsa::HandleIngressPipeline()
         }
     }
 
+    auto egress_port = GetField(phv, m_fields.igOutEgressPort).get<uint32_t>();
+    TracePacket(TRACE_INGRESS_DONE, bm_packet.get(), egress_port, 0, input_buffer.size());
+
     // drop - packets marked via the ingress_drop action
-    auto drop = phv->get_field("psa_ingress_output_metadata.drop").get_uint();
+    auto drop = GetField(phv, m_fields.igOutDrop).get_uint();
     if (drop)
     {
         NS_LOG_DEBUG("Dropping packet at the end of ingress");
+        DropPacket(std::move(bm_packet),
+                   P4MetricsSink::DROP_INGRESS,
+                   egress_port,
+                   0,
+                   input_buffer.size());
         return;
     }
 
     // resubmit - these packets get immediately resub'd to ingress, and skip
     //            deparsing, do not move below multicast or deparse
-    auto resubmit = phv->get_field("psa_ingress_output_metadata.resubmit").get_uint();
+    auto resubmit = GetField(phv, m_fields.igOutResubmit).get_uint();
     if (resubmit)
     {
         NS_LOG_DEBUG("Resubmitting packet");
 
         bm_packet->restore_buffer_state(packet_in_state);
         phv->reset_metadata();
-        phv->get_field("psa_ingress_parser_input_metadata.packet_path").set(PACKET_PATH_RESUBMIT);
+        GetField(phv, m_fields.igParserPacketPath).set(PACKET_PATH_RESUBMIT);
 
         // input_buffer.push_front (InputBuffer::PacketType::RESUBMIT, std::move (bm_packet));
         input_buffer.push_front(std::move(bm_packet));
@@ -384,12 +565,12 @@ P4CorePsa::HandleIngressPipeline()
         return;
     }
 
-    bm::Deparser* deparser = this->get_deparser("ingress_deparser");
+    bm::Deparser* deparser = m_blocks.ingressDeparser;
     deparser->deparse(bm_packet.get());
 
-    auto& f_packet_path = phv->get_field("psa_egress_parser_input_metadata.packet_path");
+    auto& f_packet_path = GetField(phv, m_fields.egParserPacketPath);
 
-    auto mgid = phv->get_field("psa_ingress_output_metadata.multicast_group").get_uint();
+    auto mgid = GetField(phv, m_fields.igOutMulticastGroup).get_uint();
     if (mgid != 0)
     {
         //   BMLOG_DEBUG_PKT (*bm_packet, "Multicast requested for packet with multicast group {}",
@@ -397,99 +578,105 @@ P4CorePsa::HandleIngressPipeline()
         NS_LOG_DEBUG("Multicast requested for packet with multicast group " << mgid);
         // MulticastPacket (packet_copy.get (), config.mgid);
         MultiCastPacket(bm_packet.get(), mgid, PACKET_PATH_NORMAL_MULTICAST, ig_cos);
+        m_packetPool.Release(std::move(bm_packet));
         return;
     }
 
-    auto& f_instance = phv->get_field("psa_egress_input_metadata.instance");
-    auto& f_eg_cos = phv->get_field("psa_egress_input_metadata.class_of_service");
+    auto& f_instance = GetField(phv, m_fields.egInstance);
+    auto& f_eg_cos = GetField(phv, m_fields.egClassOfService);
     f_instance.set(0);
     // TODO use appropriate enum member from JSON
     f_eg_cos.set(ig_cos);
 
     f_packet_path.set(PACKET_PATH_NORMAL_UNICAST);
-    auto egress_port = phv->get_field("psa_ingress_output_metadata.egress_port").get<uint32_t>();
 
     NS_LOG_DEBUG("Egress port is " << egress_port);
     Enqueue(egress_port, std::move(bm_packet));
 }
 
 bool
-P4CorePsa::HandleEgressPipeline(size_t worker_id)
+P4CorePsa::HandleEgressPipeline(size_t workerId)
 {
     NS_LOG_FUNCTION("Dequeue packet from QueueBuffer");
     std::unique_ptr<bm::Packet> bm_packet;
     size_t port;
     size_t priority;
 
-    int queue_number = SSWITCH_VIRTUAL_QUEUE_NUM_PSA;
+    egress_buffer.pop_back(workerId, &port, &priority, &bm_packet);
+    if (bm_packet == nullptr)
+        return false;
+
+    ProcessEgressPacket(port, priority, std::move(bm_packet));
+    return true;
+}
+
+void
+P4CorePsa::ProcessEgressPacket(size_t port,
+                               size_t priority,
+                               std::unique_ptr<bm::Packet>&& bm_packet)
+{
+    NS_LOG_FUNCTION("Egress processing, port " << port << ", priority " << priority);
+
+    m_traffic.egressPackets++;
+    m_traffic.egressBits += bm_packet->get_data_size() * 8;
 
-    for (int i = 0; i < queue_number; i++)
+    // the packet events carry the packet priority, queue i holds the
+    // priority m_nbQueuesPerPort - 1 - i
+    size_t packet_priority = m_nbQueuesPerPort - 1 - priority;
+    TracePacket(TRACE_DEQUEUED, bm_packet.get(), port, packet_priority, egress_buffer.size(port));
+    if (m_pfc)
     {
-        if (egress_buffer.size(i) > 0)
-        {
-            break;
-        }
-        if (i == queue_number - 1)
-        {
-            return false;
-        }
+        m_pfc->OnDequeue(bm_packet->get_ingress_port(),
+                         packet_priority,
+                         bm_packet->get_data_size());
     }
 
-    egress_buffer.pop_back(worker_id, &port, &priority, &bm_packet);
-    if (bm_packet == nullptr)
-        return false;
-
-    NS_LOG_FUNCTION("Egress processing for the packet");
     bm::PHV* phv = bm_packet->get_phv();
 
     // this reset() marks all headers as invalid - this is important since PSA
     // deparses packets after ingress processing - so no guarantees can be made
     // about their existence or validity while entering egress processing
     phv->reset();
-    phv->get_field("psa_egress_parser_input_metadata.egress_port").set(port);
-    phv->get_field("psa_egress_input_metadata.egress_timestamp").set(GetTimeStamp());
+    GetField(phv, m_fields.egParserEgressPort).set(port);
+    GetField(phv, m_fields.egEgressTimestamp).set(GetTimeStamp());
 
-    bm::Parser* parser = this->get_parser("egress_parser");
+    bm::Parser* parser = m_blocks.egressParser;
     parser->parse(bm_packet.get());
 
-    phv->get_field("psa_egress_input_metadata.egress_port")
-        .set(phv->get_field("psa_egress_parser_input_metadata.egress_port"));
-    phv->get_field("psa_egress_input_metadata.packet_path")
-        .set(phv->get_field("psa_egress_parser_input_metadata.packet_path"));
-    phv->get_field("psa_egress_input_metadata.parser_error").set(bm_packet->get_error_code().get());
+    GetField(phv, m_fields.egEgressPort).set(GetField(phv, m_fields.egParserEgressPort));
+    GetField(phv, m_fields.egPacketPath).set(GetField(phv, m_fields.egParserPacketPath));
+    GetField(phv, m_fields.egParserError).set(bm_packet->get_error_code().get());
 
     // default egress output values according to PSA spec
     // clone_session_id is undefined by default
-    phv->get_field("psa_egress_output_metadata.clone").set(0);
-    phv->get_field("psa_egress_output_metadata.drop").set(0);
+    GetField(phv, m_fields.egOutClone).set(0);
+    GetField(phv, m_fields.egOutDrop).set(0);
 
-    bm::Pipeline* egress_mau = this->get_pipeline("egress");
+    bm::Pipeline* egress_mau = m_blocks.egressPipeline;
     egress_mau->apply(bm_packet.get());
     bm_packet->reset_exit();
     // TODO(peter): add stf test where exit is invoked but packet still gets recirc'd
-    phv->get_field("psa_egress_deparser_input_metadata.egress_port")
-        .set(phv->get_field("psa_egress_parser_input_metadata.egress_port"));
+    GetField(phv, m_fields.egDeparserEgressPort).set(GetField(phv, m_fields.egParserEgressPort));
 
-    bm::Deparser* deparser = this->get_deparser("egress_deparser");
+    bm::Deparser* deparser = m_blocks.egressDeparser;
     deparser->deparse(bm_packet.get());
 
     // egress cloning - each cloned packet is a copy of the packet as output by the egress deparser
-    auto clone = phv->get_field("psa_egress_output_metadata.clone").get_uint();
+    auto clone = GetField(phv, m_fields.egOutClone).get_uint();
     if (clone)
     {
         MirroringSessionConfig config;
-        auto clone_session_id =
-            phv->get_field("psa_egress_output_metadata.clone_session_id").get<int>();
+        auto clone_session_id = GetField(phv, m_fields.egOutCloneSessionId).get<int>();
         auto is_session_configured = GetMirroringSession(clone_session_id, &config);
 
         if (is_session_configured)
         {
             NS_LOG_DEBUG("Cloning packet after egress to session id " << clone_session_id);
             std::unique_ptr<bm::Packet> packet_copy = bm_packet->clone_no_phv_ptr();
+            m_packetPool.AddClone(packet_copy.get(), bm_packet.get());
             auto phv_copy = packet_copy->get_phv();
             phv_copy->reset_metadata();
-            phv_copy->get_field("psa_egress_parser_input_metadata.packet_path")
-                .set(PACKET_PATH_CLONE_E2E);
+            GetField(phv_copy, m_fields.egParserPacketPath).set(PACKET_PATH_CLONE_E2E);
 
             if (config.mgid_valid)
             {
@@ -502,6 +689,11 @@ P4CorePsa::HandleEgressPipeline(size_t worker_id)
             if (config.egress_port_valid)
             {
                 NS_LOG_DEBUG("Cloning packet to egress port " << config.egress_port);
+                TracePacket(TRACE_CLONED,
+                            packet_copy.get(),
+                            config.egress_port,
+                            0,
+                            egress_buffer.size(config.egress_port));
                 Enqueue(config.egress_port, std::move(packet_copy));
             }
         }
@@ -512,11 +704,16 @@ P4CorePsa::HandleEgressPipeline(size_t worker_id)
         }
     }
 
-    auto drop = phv->get_field("psa_egress_output_metadata.drop").get_uint();
+    auto drop = GetField(phv, m_fields.egOutDrop).get_uint();
     if (drop)
     {
         NS_LOG_DEBUG("Dropping packet at the end of egress");
-        return true;
+        DropPacket(std::move(bm_packet),
+                   P4MetricsSink::DROP_EGRESS,
+                   port,
+                   packet_priority,
+                   egress_buffer.size(port));
+        return;
     }
 
     if (port == PSA_PORT_RECIRCULATE)
@@ -527,21 +724,27 @@ P4CorePsa::HandleEgressPipeline(size_t worker_id)
         phv->reset_header_stacks();
         phv->reset_metadata();
 
-        phv->get_field("psa_ingress_parser_input_metadata.ingress_port").set(PSA_PORT_RECIRCULATE);
-        phv->get_field("psa_ingress_parser_input_metadata.packet_path")
-            .set(PACKET_PATH_RECIRCULATE);
+        GetField(phv, m_fields.igParserIngressPort).set(PSA_PORT_RECIRCULATE);
+        GetField(phv, m_fields.igParserPacketPath).set(PACKET_PATH_RECIRCULATE);
+        TracePacket(TRACE_RECIRCULATED,
+                    bm_packet.get(),
+                    port,
+                    packet_priority,
+                    egress_buffer.size(port));
         // input_buffer.push_front (InputBuffer::PacketType::RECIRCULATE, std::move (bm_packet));
         input_buffer.push_front(std::move(bm_packet));
         HandleIngressPipeline();
-        return true;
+        return;
     }
 
     uint16_t protocol = RegisterAccess::get_ns_protocol(bm_packet.get());
     int addr_index = RegisterAccess::get_ns_address(bm_packet.get());
 
+    uint64_t packet_id = m_packetPool.GetPacketId(bm_packet.get());
+
     Ptr<Packet> ns_packet = this->ConvertToNs3Packet(std::move(bm_packet));
-    m_switchNetDevice->SendNs3Packet(ns_packet, port, protocol, m_destinationList[addr_index]);
-    return true;
+    m_egressStage.Push(
+        EgressItem{ns_packet, port, protocol, addr_index, packet_id, packet_priority});
 }
 
 void
@@ -552,9 +755,9 @@ P4CorePsa::MultiCastPacket(bm::Packet* packet,
 {
     auto phv = packet->get_phv();
     const auto pre_out = m_pre->replicate({mgid});
-    auto& f_eg_cos = phv->get_field("psa_egress_input_metadata.class_of_service");
-    auto& f_instance = phv->get_field("psa_egress_input_metadata.instance");
-    auto& f_packet_path = phv->get_field("psa_egress_parser_input_metadata.packet_path");
+    auto& f_eg_cos = GetField(phv, m_fields.egClassOfService);
+    auto& f_instance = GetField(phv, m_fields.egInstance);
+    auto& f_packet_path = GetField(phv, m_fields.egParserPacketPath);
     auto packet_size = packet->get_register(RegisterAccess::PACKET_LENGTH_REG_IDX);
     for (const auto& out : pre_out)
     {
@@ -566,18 +769,58 @@ P4CorePsa::MultiCastPacket(bm::Packet* packet,
         // TODO use appropriate enum member from JSON
         f_packet_path.set(path);
         std::unique_ptr<bm::Packet> packet_copy = packet->clone_with_phv_ptr();
+        m_packetPool.AddClone(packet_copy.get(), packet);
         packet_copy->set_register(RegisterAccess::PACKET_LENGTH_REG_IDX, packet_size);
+        TracePacket(TRACE_MULTICAST,
+                    packet_copy.get(),
+                    egress_port,
+                    0,
+                    egress_buffer.size(egress_port));
         Enqueue(egress_port, std::move(packet_copy));
     }
 }
 
 void
-P4CorePsa::CalculateScheduleTime()
+P4CorePsa::DropPacket(std::unique_ptr<bm::Packet>&& packet,
+                      P4MetricsSink::DropReason reason,
+                      uint32_t port,
+                      uint32_t priority,
+                      size_t depth)
+{
+    m_traffic.drops[reason]++;
+    TracePacket(TRACE_DROPPED, packet.get(), port, priority, depth, reason);
+    m_packetPool.Release(std::move(packet));
+}
+
+void
+P4CorePsa::SampleMetrics(P4MetricsSink* sink, Time now)
 {
-    m_egressTimeEvent = EventId();
+    sink->AppendSwitchRow(now, m_p4SwitchId, m_traffic, &m_lastTraffic, input_buffer.size());
+
+    // the queue sizes are kept by the queueing logic, no packet is walked
+    uint32_t port_number = m_switchNetDevice->GetNBridgePorts();
+    for (size_t i = 0; i < static_cast<size_t>(port_number); i++)
+    {
+        for (size_t j = 0; j < m_nbQueuesPerPort; j++)
+        {
+            // queue j holds the priority m_nbQueuesPerPort - 1 - j
+            sink->AppendQueueRow(now,
+                                 m_p4SwitchId,
+                                 i,
+                                 m_nbQueuesPerPort - 1 - j,
+                                 egress_buffer.size(i, j),
+                                 egress_buffer.depth_histogram(i, j),
+                                 egress_buffer.sojourn_histogram(i, j));
+        }
+    }
+}
 
+void
+P4CorePsa::CalculateScheduleTime()
+{
     uint64_t bottleneck_ns = 1e9 / m_switchRate;
     egress_buffer.set_rate_for_all(m_switchRate);
+    egress_buffer.set_port_rate_for_all(m_switchRate);
     m_egressTimeRef = Time::FromDouble(bottleneck_ns, Time::NS);
 
     NS_LOG_DEBUG("Switch ID: " << m_p4SwitchId << " Egress time reference set to " << bottleneck_ns
@@ -585,9 +828,9 @@ P4CorePsa::CalculateScheduleTime()
 }
 
 int
-P4CorePsa::SetEgressPriorityQueueDepth(size_t port, size_t priority, const size_t depth_pkts)
+P4CorePsa::SetEgressPriorityQueueDepth(size_t port, size_t queue, const size_t depth_pkts)
 {
-    egress_buffer.set_capacity(port, priority, depth_pkts);
+    egress_buffer.set_capacity(port, queue, depth_pkts);
     return 0;
 }
 
@@ -606,9 +849,9 @@ P4CorePsa::SetAllEgressQueueDepths(const size_t depth_pkts)
 }
 
 int
-P4CorePsa::SetEgressPriorityQueueRate(size_t port, size_t priority, const uint64_t rate_pps)
+P4CorePsa::SetEgressPriorityQueueRate(size_t port, size_t queue, const uint64_t rate_pps)
 {
-    egress_buffer.set_rate(port, priority, rate_pps);
+    egress_buffer.set_rate(port, queue, rate_pps);
     return 0;
 }
 
@@ -619,6 +862,14 @@ P4CorePsa::SetEgressQueueRate(size_t port, const uint64_t rate_pps)
     return 0;
 }
 
+int
+P4CorePsa::SetEgressPortRate(size_t port, const uint64_t rate_pps)
+{
+    egress_buffer.set_port_rate(port, rate_pps);
+    ScheduleEgressEvent();
+    return 0;
+}
+
 int
 P4CorePsa::SetAllEgressQueueRates(const uint64_t rate_pps)
 {
@@ -626,4 +877,179 @@ P4CorePsa::SetAllEgressQueueRates(const uint64_t rate_pps)
     return 0;
 }
 
+int
+P4CorePsa::SetEgressPriorityQueueRateBps(size_t port, size_t priority, uint64_t rate_bps)
+{
+    if (priority >= m_nbQueuesPerPort)
+    {
+        return -1;
+    }
+    egress_buffer.set_rate_bps(port, m_nbQueuesPerPort - 1 - priority, rate_bps);
+    return 0;
+}
+
+int
+P4CorePsa::SetEgressQueueRateBps(size_t port, uint64_t rate_bps)
+{
+    egress_buffer.set_rate_bps(port, rate_bps);
+    return 0;
+}
+
+int
+P4CorePsa::SetAllEgressQueueRatesBps(uint64_t rate_bps)
+{
+    egress_buffer.set_rate_bps_for_all(rate_bps);
+    return 0;
+}
+
+int
+P4CorePsa::SetEgressPortRateBps(size_t port, uint64_t rate_bps)
+{
+    egress_buffer.set_port_rate_bps(port, rate_bps);
+    return 0;
+}
+
+int
+P4CorePsa::SetAllEgressPortRatesBps(uint64_t rate_bps)
+{
+    egress_buffer.set_port_rate_bps_for_all(rate_bps);
+    return 0;
+}
+
+int
+P4CorePsa::SetEgressPriorityQueueByteDepth(size_t port, size_t priority, size_t depth_bytes)
+{
+    if (priority >= m_nbQueuesPerPort)
+    {
+        return -1;
+    }
+    egress_buffer.set_byte_capacity(port, m_nbQueuesPerPort - 1 - priority, depth_bytes);
+    return 0;
+}
+
+int
+P4CorePsa::SetEgressQueueByteDepth(size_t port, size_t depth_bytes)
+{
+    egress_buffer.set_byte_capacity(port, depth_bytes);
+    return 0;
+}
+
+int
+P4CorePsa::SetAllEgressQueueByteDepths(size_t depth_bytes)
+{
+    egress_buffer.set_byte_capacity_for_all(depth_bytes);
+    return 0;
+}
+
+int
+P4CorePsa::SetEgressSharedBuffer(size_t total_bytes, size_t reserve_bytes, double alpha)
+{
+    egress_buffer.set_shared_buffer(total_bytes, reserve_bytes, alpha);
+    return 0;
+}
+
+int
+P4CorePsa::SetEgressPriorityQueueSharedBuffer(size_t port,
+                                              size_t priority,
+                                              size_t reserve_bytes,
+                                              double alpha)
+{
+    if (priority >= m_nbQueuesPerPort)
+    {
+        return -1;
+    }
+    size_t queue = m_nbQueuesPerPort - 1 - priority;
+    egress_buffer.set_shared_buffer_reserve(port, queue, reserve_bytes);
+    egress_buffer.set_shared_buffer_alpha(port, queue, alpha);
+    return 0;
+}
+
+size_t
+P4CorePsa::GetEgressSharedBufferUsage() const
+{
+    return egress_buffer.shared_buffer_used();
+}
+
+int
+P4CorePsa::EnableQueueHistograms(bool enable)
+{
+    egress_buffer.enable_histograms(enable);
+    return 0;
+}
+
+const P4Histogram*
+P4CorePsa::GetQueueDepthHistogram(size_t port, size_t priority) const
+{
+    if (priority >= m_nbQueuesPerPort)
+    {
+        return nullptr;
+    }
+    return egress_buffer.depth_histogram(port, m_nbQueuesPerPort - 1 - priority);
+}
+
+int
+P4CorePsa::SetEgressPriorityQueueAqm(size_t port, size_t priority, const P4Aqm::Config& config)
+{
+    if (priority >= m_nbQueuesPerPort)
+    {
+        return -1;
+    }
+    egress_buffer.set_aqm(port, m_nbQueuesPerPort - 1 - priority, config);
+    return 0;
+}
+
+int
+P4CorePsa::SetAllEgressQueueAqm(const P4Aqm::Config& config)
+{
+    egress_buffer.set_aqm_for_all(config);
+    return 0;
+}
+
+P4Aqm::Counters
+P4CorePsa::GetEgressQueueAqmCounters(size_t port, size_t priority) const
+{
+    if (priority >= m_nbQueuesPerPort)
+    {
+        return P4Aqm::Counters();
+    }
+    return egress_buffer.aqm_counters(port, m_nbQueuesPerPort - 1 - priority);
+}
+
+int
+P4CorePsa::EnablePfc(uint64_t xoff_bytes, uint64_t xon_bytes)
+{
+    if (m_nbQueuesPerPort < P4PfcAccounting::NB_PRIORITIES)
+    {
+        NS_LOG_WARN("EnablePfc: PFC needs one egress queue per PFC priority");
+        return -1;
+    }
+    CreatePfcAccounting(xoff_bytes, xon_bytes);
+    return 0;
+}
+
+int
+P4CorePsa::SetEgressQueuePaused(size_t port, size_t priority, bool paused)
+{
+    if (priority >= m_nbQueuesPerPort)
+    {
+        return -1;
+    }
+    egress_buffer.set_paused(port, m_nbQueuesPerPort - 1 - priority, paused);
+    if (!paused)
+    {
+        ScheduleEgressEvent();
+    }
+    return 0;
+}
+
+const P4Histogram*
+P4CorePsa::GetQueueSojournHistogram(size_t port, size_t priority) const
+{
+    if (priority >= m_nbQueuesPerPort)
+    {
+        return nullptr;
+    }
+    return egress_buffer.sojourn_histogram(port, m_nbQueuesPerPort - 1 - priority);
+}
+
 } // namespace ns3
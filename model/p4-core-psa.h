@@ -19,7 +19,9 @@
 #ifndef P4_CORE_PSA_H
 #define P4_CORE_PSA_H
 
+#include "ns3/p4-metrics-sink.h"
 #include "ns3/p4-queue.h"
+#include "ns3/p4-stage-fifo.h"
 #include "ns3/p4-switch-core.h"
 
 #define SSWITCH_VIRTUAL_QUEUE_NUM_PSA 8
@@ -58,9 +60,58 @@ class P4CorePsa : public P4SwitchCore
                       uint16_t protocol,
                       const Address& destination) override;
 
-    void SetEgressTimerEvent();
     void CalculateScheduleTime();
 
+    /**
+     * @brief Resolve the handles of the PHV fields used on the packet path
+     * @details Called when the switch starts and when the P4 program is swapped.
+     */
+    void ResolvePhvFields();
+
+    /**
+     * @brief Set the latency of the ingress and egress stages from the
+     * pipeline latency model and the tables of the loaded program
+     * @details Called when the switch starts and when the P4 program is swapped.
+     */
+    void ApplyPipelineLatency();
+
+    /**
+     * @brief Make sure a dequeue event is pending while packets are queued
+     * @details Called after every enqueue and dequeue. The event is scheduled
+     * when the next packet becomes eligible, and none is scheduled while the
+     * queue buffer is empty or only holds paused queues.
+     */
+    void ScheduleEgressEvent();
+
+    /**
+     * @brief Dequeue event: run the packets eligible now (up to the egress
+     * batch size) through the egress pipeline, then schedule the next dequeue
+     * event
+     */
+    void EgressEvent();
+
+    /**
+     * @brief Drop a packet: count it, report it to the Dropped trace source
+     * and return it to the packet pool
+     * @param packet the packet
+     * @param reason why the packet is dropped
+     * @param port the ingress or egress port of the packet
+     * @param priority the queue priority of the packet
+     * @param depth the input buffer or queue depth
+     */
+    void DropPacket(std::unique_ptr<bm::Packet>&& packet,
+                    P4MetricsSink::DropReason reason,
+                    uint32_t port,
+                    uint32_t priority,
+                    size_t depth);
+
+    /**
+     * @brief Append the metrics rows of the switch to the metrics sink
+     * @param sink the metrics sink
+     * @param now the sample time
+     */
+    void SampleMetrics(P4MetricsSink* sink, Time now);
+
     // === override ===
 
     void start_and_return_() override;
@@ -71,18 +122,53 @@ class P4CorePsa : public P4SwitchCore
     void Enqueue(uint32_t egress_port, std::unique_ptr<bm::Packet>&& packet) override;
     bool HandleEgressPipeline(size_t workerId) override;
 
+    /**
+     * @brief Run a dequeued packet through the egress pipeline and send it
+     * @param port The egress port the packet was queued for
+     * @param priority The priority queue the packet was dequeued from
+     * @param bm_packet The packet
+     */
+    void ProcessEgressPacket(size_t port,
+                             size_t priority,
+                             std::unique_ptr<bm::Packet>&& bm_packet);
+
     void MultiCastPacket(bm::Packet* packet,
                          unsigned int mgid,
                          PktInstanceTypePsa path,
                          unsigned int class_of_service);
 
     // Queue Configuration
-    int SetEgressPriorityQueueDepth(size_t port, size_t priority, size_t depthPkts);
-    int SetEgressQueueDepth(size_t port, size_t depthPkts);
-    int SetAllEgressQueueDepths(size_t depthPkts);
-    int SetEgressPriorityQueueRate(size_t port, size_t priority, uint64_t ratePps);
-    int SetEgressQueueRate(size_t port, uint64_t ratePps);
-    int SetAllEgressQueueRates(uint64_t ratePps);
+    int SetEgressPriorityQueueDepth(size_t port, size_t queue, size_t depthPkts) override;
+    int SetEgressQueueDepth(size_t port, size_t depthPkts) override;
+    int SetAllEgressQueueDepths(size_t depthPkts) override;
+    int SetEgressPriorityQueueRate(size_t port, size_t queue, uint64_t ratePps) override;
+    int SetEgressQueueRate(size_t port, uint64_t ratePps) override;
+    int SetEgressPortRate(size_t port, uint64_t ratePps) override;
+    int SetAllEgressQueueRates(uint64_t ratePps) override;
+    int SetEgressPriorityQueueRateBps(size_t port, size_t priority, uint64_t rateBps) override;
+    int SetEgressQueueRateBps(size_t port, uint64_t rateBps) override;
+    int SetAllEgressQueueRatesBps(uint64_t rateBps) override;
+    int SetEgressPortRateBps(size_t port, uint64_t rateBps) override;
+    int SetAllEgressPortRatesBps(uint64_t rateBps) override;
+    int SetEgressPriorityQueueByteDepth(size_t port, size_t priority, size_t depthBytes) override;
+    int SetEgressQueueByteDepth(size_t port, size_t depthBytes) override;
+    int SetAllEgressQueueByteDepths(size_t depthBytes) override;
+    int SetEgressSharedBuffer(size_t totalBytes, size_t reserveBytes, double alpha) override;
+    int SetEgressPriorityQueueSharedBuffer(size_t port,
+                                           size_t priority,
+                                           size_t reserveBytes,
+                                           double alpha) override;
+    size_t GetEgressSharedBufferUsage() const override;
+    int EnableQueueHistograms(bool enable) override;
+    const P4Histogram* GetQueueDepthHistogram(size_t port, size_t priority) const override;
+    int SetEgressPriorityQueueAqm(size_t port,
+                                  size_t priority,
+                                  const P4Aqm::Config& config) override;
+    int SetAllEgressQueueAqm(const P4Aqm::Config& config) override;
+    P4Aqm::Counters GetEgressQueueAqmCounters(size_t port, size_t priority) const override;
+    int EnablePfc(uint64_t xoffBytes, uint64_t xonBytes) override;
+    int SetEgressQueuePaused(size_t port, size_t priority, bool paused) override;
+    const P4Histogram* GetQueueSojournHistogram(size_t port, size_t priority) const override;
 
   protected:
     struct EgressThreadMapper
@@ -101,23 +187,78 @@ class P4CorePsa : public P4SwitchCore
     };
 
   private:
+    /**
+     * @brief Handles of the metadata fields accessed for every packet
+     */
+    struct PhvFields
+    {
+        FieldHandle igParserPacketPath;   //!< psa_ingress_parser_input_metadata.packet_path
+        FieldHandle igParserIngressPort;  //!< psa_ingress_parser_input_metadata.ingress_port
+        FieldHandle igIngressTimestamp;   //!< psa_ingress_input_metadata.ingress_timestamp
+        FieldHandle igIngressPort;        //!< psa_ingress_input_metadata.ingress_port
+        FieldHandle igPacketPath;         //!< psa_ingress_input_metadata.packet_path
+        FieldHandle igParserError;        //!< psa_ingress_input_metadata.parser_error
+        FieldHandle igOutClassOfService;  //!< psa_ingress_output_metadata.class_of_service
+        FieldHandle igOutClone;           //!< psa_ingress_output_metadata.clone
+        FieldHandle igOutCloneSessionId;  //!< psa_ingress_output_metadata.clone_session_id
+        FieldHandle igOutDrop;            //!< psa_ingress_output_metadata.drop
+        FieldHandle igOutResubmit;        //!< psa_ingress_output_metadata.resubmit
+        FieldHandle igOutMulticastGroup;  //!< psa_ingress_output_metadata.multicast_group
+        FieldHandle igOutEgressPort;      //!< psa_ingress_output_metadata.egress_port
+        FieldHandle egParserPacketPath;   //!< psa_egress_parser_input_metadata.packet_path
+        FieldHandle egParserEgressPort;   //!< psa_egress_parser_input_metadata.egress_port
+        FieldHandle egClassOfService;     //!< psa_egress_input_metadata.class_of_service
+        FieldHandle egEgressTimestamp;    //!< psa_egress_input_metadata.egress_timestamp
+        FieldHandle egInstance;           //!< psa_egress_input_metadata.instance
+        FieldHandle egEgressPort;         //!< psa_egress_input_metadata.egress_port
+        FieldHandle egPacketPath;         //!< psa_egress_input_metadata.packet_path
+        FieldHandle egParserError;        //!< psa_egress_input_metadata.parser_error
+        FieldHandle egOutClone;           //!< psa_egress_output_metadata.clone
+        FieldHandle egOutCloneSessionId;  //!< psa_egress_output_metadata.clone_session_id
+        FieldHandle egOutDrop;            //!< psa_egress_output_metadata.drop
+        FieldHandle egDeparserEgressPort; //!< psa_egress_deparser_input_metadata.egress_port
+        FieldHandle priority;             //!< intrinsic_metadata.priority
+    };
+
+    /**
+     * @brief A packet on its way out of the egress pipeline
+     */
+    struct EgressItem
+    {
+        Ptr<Packet> packet; //!< The deparsed packet
+        size_t port;        //!< Egress port
+        uint16_t protocol;  //!< ns-3 protocol number
+        int addrIndex;      //!< Index of the destination address
+        uint64_t packetId;  //!< ID of the bm packet, for the packet traces
+        size_t priority;    //!< Priority of the queue the packet left
+    };
+
     static constexpr uint32_t PSA_PORT_RECIRCULATE = 0xfffffffa;
     static constexpr size_t nb_egress_threads = 1u; // 4u default
     uint64_t m_packetId;                            // Packet ID
-    bool m_firstPacket;
-    bool m_enableTracing;
+    PhvFields m_fields;                             //!< Field handles of the loaded P4 program
+
+    P4MetricsSink::TrafficCounters m_traffic;     //!< Traffic and drop counters
+    P4MetricsSink::TrafficCounters m_lastTraffic; //!< Counters at the last metrics sample
+
     uint64_t m_switchRate; //!< Switch processing capability (unit: PPS (Packets
                            //!< Per Second))
     size_t m_nbQueuesPerPort;
 
-    EventId m_egressTimeEvent; //!< The timer event ID [Egress]
-    Time m_egressTimeRef;      //!< Desired time between timer event triggers
+    EventId m_egressTimeEvent; //!< The pending dequeue event, if any [Egress]
+    Time m_egressTimeRef;      //!< Minimum time between two packets of a port (1 / SwitchRate)
 
     // Buffers and Transmit Function
     // std::unique_ptr<InputBuffer> input_buffer;
     bm::Queue<std::unique_ptr<bm::Packet>> input_buffer;
-    NSQueueingLogicPriRL<std::unique_ptr<bm::Packet>, EgressThreadMapper> egress_buffer;
+    using EgressBuffer = NSQueueingLogicPriRL<std::unique_ptr<bm::Packet>, EgressThreadMapper>;
+    EgressBuffer egress_buffer;
+    std::vector<EgressBuffer::PoppedItem> m_egressBatch; //!< Packets of the current dequeue event
     bm::Queue<std::unique_ptr<bm::Packet>> output_buffer;
+
+    //! Parser, ingress control and its tables
+    P4StageFifo<std::unique_ptr<bm::Packet>> m_ingressStage;
+    P4StageFifo<EgressItem> m_egressStage; //!< Egress control, its tables and deparser
 };
 
 } // namespace ns3
@@ -23,8 +23,7 @@
 #include "ns3/register-access-v1model.h"
 #include "ns3/simulator.h"
 
-#include <fstream> // tracing info to file
-#include <sstream>
+#include <algorithm>
 
 NS_LOG_COMPONENT_DEFINE("P4CoreV1model");
 
@@ -61,6 +60,16 @@ struct bmv2_hash_v1model
     }
 };
 
+// Programmable blocks of the v1model architecture
+const P4SwitchCore::ArchDescriptor g_v1modelArch = {
+    "parser",   // ingress parser
+    "ingress",  // ingress pipeline
+    nullptr,    // ingress deparser
+    nullptr,    // egress parser
+    "egress",   // egress pipeline
+    "deparser", // egress deparser
+};
+
 } // namespace
 
 // if REGISTER_HASH calls placed in the anonymous namespace, some compiler can
@@ -86,27 +95,15 @@ P4CoreV1model::P4CoreV1model(P4SwitchNetDevice* net_device,
       egress_buffer(m_nbEgressThreads,
                     queue_buffer_size,
                     EgressThreadMapper(m_nbEgressThreads),
-                    nb_queues_per_port),
+                    nb_queues_per_port,
+                    net_device ? net_device->GetNBridgePorts() : 0),
       output_buffer(64),
-      m_firstPacket(false)
+      m_engine(P4PipelineEngine::Get())
 {
     // configure for the switch v1model
     m_thriftCommand = "simple_switch_CLI"; // default thrift command for v1model
     m_enableQueueingMetadata = true;       // enable queueing metadata for v1model
 
-    if (m_enableTracing)
-    {
-        m_inputBps = 0;                                 // bps
-        m_inputBp = 0;                                  // bp
-        m_inputPps = 0;                                 // pps
-        m_inputPp = 0;                                  // pp
-        m_egressBps = 0;                                // bps
-        m_egressBp = 0;                                 // bp
-        m_egressPps = 0;                                // pps
-        m_egressPp = 0;                                 // pp
-        m_timeInterval = Time::FromInteger(1, Time::S); // 1 second per interval
-    }
-
     m_pre = std::make_shared<bm::McSimplePreLAG>();
     add_component<bm::McSimplePreLAG>(m_pre);
 
@@ -120,25 +117,56 @@ P4CoreV1model::P4CoreV1model(P4SwitchNetDevice* net_device,
     force_arith_header("queueing_metadata");
     force_arith_header("intrinsic_metadata");
 
+    m_ingressStage.SetHandler([this](IngressItem&& item) {
+        if (!input_buffer->push_front(item.type, std::move(item.bm_packet)))
+        {
+            NS_LOG_DEBUG("Input buffer full, dropping packet");
+            uint32_t port = item.bm_packet->get_ingress_port();
+            DropPacket(std::move(item.bm_packet),
+                       P4MetricsSink::DROP_INPUT_BUFFER,
+                       port,
+                       0,
+                       input_buffer->size());
+            return;
+        }
+        if (m_engine)
+        {
+            SubmitIngressJob();
+            return;
+        }
+        HandleIngressPipeline();
+    });
+    m_egressStage.SetHandler([this](EgressItem&& item) {
+        TracePacket(TRACE_EGRESS_DONE,
+                    item.packetId,
+                    item.packet->GetSize(),
+                    item.port,
+                    item.priority,
+                    egress_buffer.size(item.port));
+        m_switchNetDevice->SendNs3Packet(item.packet,
+                                         item.port,
+                                         item.protocol,
+                                         m_destinationList[item.addrIndex]);
+    });
+
+    egress_buffer.set_ecn_marker(
+        [this](std::unique_ptr<bm::Packet>& packet) { return MarkEcn(packet.get()); });
+
     CalculateScheduleTime(); // calculate the time interval for processing one packet
 }
 
 P4CoreV1model::~P4CoreV1model()
 {
     NS_LOG_FUNCTION(this << " Destructing P4CoreV1model...");
+    Simulator::Cancel(m_egressTimeEvent);
+    P4MetricsSink::Remove(this);
 
     if (input_buffer)
     {
         input_buffer->push_front(InputBuffer::PacketType::SENTINEL, nullptr);
     }
 
-    for (size_t i = 0; i < m_nbEgressThreads; i++)
-    {
-        while (egress_buffer.push_front(i, 0, nullptr) == 0)
-        {
-            continue;
-        }
-    }
+    // The egress queues are served by events, no thread waits for a sentinel
 
     output_buffer.push_front(nullptr);
 
@@ -150,20 +178,18 @@ P4CoreV1model::start_and_return_()
 {
     NS_LOG_FUNCTION("Switch ID: " << m_p4SwitchId << " start");
     CheckQueueingMetadata();
+    ResolveArchBlocks(g_v1modelArch);
+    ResolvePhvFields();
+    ApplyPipelineLatency();
 
-    if (!m_egressTimeRef.IsZero())
-    {
-        NS_LOG_DEBUG("Switch ID: " << m_p4SwitchId
-                                   << " Scheduling initial timer event using m_egressTimeRef = "
-                                   << m_egressTimeRef.GetNanoSeconds() << " ns");
-        m_egressTimeEvent =
-            Simulator::Schedule(m_egressTimeRef, &P4CoreV1model::SetEgressTimerEvent, this);
-    }
-
+    // No egress event is scheduled here: the first one is scheduled by the
+    // first enqueued packet
     if (m_enableTracing)
     {
         NS_LOG_INFO("Enabling tracing in P4 Switch ID: " << m_p4SwitchId);
-        Simulator::Schedule(m_timeInterval, &P4CoreV1model::CalculatePacketsPerSecond, this);
+        P4MetricsSink::Get()->Add(this, [this](P4MetricsSink* sink, Time now) {
+            SampleMetrics(sink, now);
+        });
     }
 }
 
@@ -171,7 +197,66 @@ void
 P4CoreV1model::swap_notify_()
 {
     NS_LOG_FUNCTION("p4_switch has been notified of a config swap");
+    // the cached packets hold PHVs of the former program
+    m_packetPool.Clear();
     CheckQueueingMetadata();
+    ResolveArchBlocks(g_v1modelArch);
+    ResolvePhvFields();
+    ApplyPipelineLatency();
+}
+
+void
+P4CoreV1model::ApplyPipelineLatency()
+{
+    // The tables are not timed per lookup: each table of a control counts
+    // once for every packet going through it
+    const PipelineLatency& latency = m_pipelineLatency;
+    m_ingressStage.SetLatency(latency.parser + latency.ingressStage +
+                              latency.tableLookup * GetNumTables("ingress"));
+    m_egressStage.SetLatency(latency.egressStage + latency.deparser +
+                             latency.tableLookup * GetNumTables("egress"));
+    NS_LOG_DEBUG("Switch ID: " << m_p4SwitchId << " ingress latency "
+                               << m_ingressStage.GetLatency() << ", egress latency "
+                               << m_egressStage.GetLatency());
+}
+
+void
+P4CoreV1model::EnterIngress(InputBuffer::PacketType type, std::unique_ptr<bm::Packet>&& bm_packet)
+{
+    m_ingressStage.Push(IngressItem{type, std::move(bm_packet)});
+}
+
+void
+P4CoreV1model::ResolvePhvFields()
+{
+    // Any packet carries a PHV with the layout of the loaded program
+    std::unique_ptr<bm::Packet> probe = m_packetPool.Acquire(0, 0, 0);
+    const bm::PHV& phv = *probe->get_phv();
+
+    m_fields.ingressPort = ResolveField(phv, "standard_metadata.ingress_port");
+    m_fields.packetLength = ResolveField(phv, "standard_metadata.packet_length");
+    m_fields.instanceType = ResolveField(phv, "standard_metadata.instance_type");
+    m_fields.egressSpec = ResolveField(phv, "standard_metadata.egress_spec");
+    m_fields.egressPort = ResolveField(phv, "standard_metadata.egress_port");
+    m_fields.parserError = ResolveField(phv, "standard_metadata.parser_error");
+    m_fields.checksumError = ResolveField(phv, "standard_metadata.checksum_error");
+    m_fields.ingressGlobalTimestamp =
+        ResolveField(phv, "intrinsic_metadata.ingress_global_timestamp");
+    m_fields.egressGlobalTimestamp =
+        ResolveField(phv, "intrinsic_metadata.egress_global_timestamp");
+    m_fields.mcastGrp = ResolveField(phv, "intrinsic_metadata.mcast_grp");
+    m_fields.egressRid = ResolveField(phv, "intrinsic_metadata.egress_rid");
+    m_fields.priority = ResolveField(phv, "intrinsic_metadata.priority");
+    m_fields.enqTimestamp = ResolveField(phv, "queueing_metadata.enq_timestamp");
+    m_fields.enqQdepth = ResolveField(phv, "queueing_metadata.enq_qdepth");
+    m_fields.deqTimedelta = ResolveField(phv, "queueing_metadata.deq_timedelta");
+    m_fields.deqQdepth = ResolveField(phv, "queueing_metadata.deq_qdepth");
+    m_fields.qid = ResolveField(phv, "queueing_metadata.qid");
+
+    ResolveEcnField(phv);
+    ResolvePfcField(phv);
+
+    m_packetPool.Release(std::move(probe));
 }
 
 void
@@ -182,21 +267,49 @@ P4CoreV1model::reset_target_state_()
 }
 
 void
-P4CoreV1model::SetEgressTimerEvent()
+P4CoreV1model::ScheduleEgressEvent()
 {
-    NS_LOG_FUNCTION("p4_switch has been triggered by the egress timer event");
-    bool checkflag = HandleEgressPipeline(0);
-    m_egressTimeEvent =
-        Simulator::Schedule(m_egressTimeRef, &P4CoreV1model::SetEgressTimerEvent, this);
-    if (!m_firstPacket && checkflag)
+    if (egress_buffer.empty())
+    {
+        return;
+    }
+
+    // The next packet leaves when its queue and its port allow it, the ports
+    // transmit independently of each other
+    Time next = egress_buffer.get_next_tp_all_ports();
+    if (next == Time::Max())
     {
-        m_firstPacket = true;
+        // all the queued packets are paused, resuming a queue schedules the
+        // next event (see SetEgressQueuePaused)
+        return;
     }
-    if (m_firstPacket && !checkflag)
+    Time now = Simulator::Now();
+    next = std::max(next, now);
+
+    if (!m_egressTimeEvent.IsExpired())
     {
-        NS_LOG_INFO("Egress timer event needs additional scheduling due to !checkflag.");
-        Simulator::Schedule(Time(NanoSeconds(10)), &P4CoreV1model::HandleEgressPipeline, this, 0);
+        if (m_egressTimeEvent.GetTs() <= static_cast<uint64_t>(next.GetTimeStep()))
+        {
+            return;
+        }
+        // a packet became eligible earlier than the pending event
+        Simulator::Cancel(m_egressTimeEvent);
     }
+    m_egressTimeEvent = Simulator::Schedule(next - now, &P4CoreV1model::EgressEvent, this);
+}
+
+void
+P4CoreV1model::EgressEvent()
+{
+    NS_LOG_FUNCTION("Switch ID: " << m_p4SwitchId << " egress event");
+    // all the packets eligible now are processed in this event
+    egress_buffer.pop_back_batch(0, m_egressBatchSize, &m_egressBatch);
+    for (auto& popped : m_egressBatch)
+    {
+        ProcessEgressPacket(popped.queue_id, popped.priority, std::move(popped.item));
+    }
+    m_egressBatch.clear();
+    ScheduleEgressEvent();
 }
 
 int
@@ -212,11 +325,9 @@ P4CoreV1model::ReceivePacket(Ptr<Packet> packetIn,
     bm::PHV* phv = bm_packet->get_phv();
     int len = bm_packet.get()->get_data_size();
 
-    if (m_enableTracing)
-    {
-        m_inputPps++;          // input pps
-        m_inputBps += len * 8; // input bps, this may add the header in account.
-    }
+    // this may add the header in account
+    m_traffic.inputPackets++;
+    m_traffic.inputBits += len * 8;
 
     bm_packet.get()->set_ingress_port(inPort);
     phv->reset_metadata();
@@ -228,21 +339,19 @@ P4CoreV1model::ReceivePacket(Ptr<Packet> packetIn,
     RegisterAccess::set_ns_address(bm_packet.get(), addr_index);
 
     // setting standard metadata
-    phv->get_field("standard_metadata.ingress_port").set(inPort);
+    GetField(phv, m_fields.ingressPort).set(inPort);
 
     // using packet register 0 to store length, this register will be updated for
     // each add_header / remove_header primitive call
     bm_packet->set_register(RegisterAccess::PACKET_LENGTH_REG_IDX, len);
-    phv->get_field("standard_metadata.packet_length").set(len);
-    bm::Field& f_instance_type = phv->get_field("standard_metadata.instance_type");
-    f_instance_type.set(PKT_INSTANCE_TYPE_NORMAL);
-    if (phv->has_field("intrinsic_metadata.ingress_global_timestamp"))
+    GetField(phv, m_fields.packetLength).set(len);
+    GetField(phv, m_fields.instanceType).set(PKT_INSTANCE_TYPE_NORMAL);
+    if (m_fields.ingressGlobalTimestamp.exists)
     {
-        phv->get_field("intrinsic_metadata.ingress_global_timestamp").set(GetTimeStamp());
+        GetField(phv, m_fields.ingressGlobalTimestamp).set(GetTimeStamp());
     }
 
-    input_buffer->push_front(InputBuffer::PacketType::NORMAL, std::move(bm_packet));
-    HandleIngressPipeline();
+    EnterIngress(InputBuffer::PacketType::NORMAL, std::move(bm_packet));
     NS_LOG_DEBUG("Packet received by P4CoreV1model, Port: "
                  << inPort << ", Packet ID: " << m_packetId << ", Size: " << len << " bytes");
     return 0;
@@ -253,22 +362,48 @@ P4CoreV1model::HandleIngressPipeline()
 {
     NS_LOG_FUNCTION(this);
 
-    std::unique_ptr<bm::Packet> bm_packet;
-    input_buffer->pop_back(&bm_packet);
-    if (bm_packet == nullptr)
+    IngressJob job;
+    input_buffer->pop_back(&job.bm_packet);
+    if (job.bm_packet == nullptr)
         return;
 
-    bm::Parser* parser = this->get_parser("parser");
-    bm::Pipeline* ingress_mau = this->get_pipeline("ingress");
-    bm::PHV* phv = bm_packet->get_phv();
+    RunIngressBlocks(&job);
+    FinishIngress(std::move(job));
+}
 
-    uint32_t ingress_port = bm_packet->get_ingress_port();
+void
+P4CoreV1model::SubmitIngressJob()
+{
+    // the packet is taken from the input buffer by the compute part, so that
+    // the buffer keeps its priorities
+    m_engine->Submit(
+        this,
+        [this]() {
+            IngressJob job;
+            input_buffer->pop_back(&job.bm_packet);
+            if (job.bm_packet)
+            {
+                RunIngressBlocks(&job);
+            }
+            m_ingressDone.push_back(std::move(job));
+        },
+        [this]() {
+            IngressJob job = std::move(m_ingressDone.front());
+            m_ingressDone.pop_front();
+            if (job.bm_packet)
+            {
+                FinishIngress(std::move(job));
+            }
+        });
+}
 
-    NS_LOG_INFO("Processing packet from port "
-                << ingress_port << ", Packet ID: " << bm_packet->get_packet_id()
-                << ", Size: " << bm_packet->get_data_size() << " bytes");
+void
+P4CoreV1model::RunIngressBlocks(IngressJob* job)
+{
+    bm::Packet* bm_packet = job->bm_packet.get();
+    bm::PHV* phv = bm_packet->get_phv();
 
-    auto ingress_packet_size = bm_packet->get_register(RegisterAccess::PACKET_LENGTH_REG_IDX);
+    job->packetSize = bm_packet->get_register(RegisterAccess::PACKET_LENGTH_REG_IDX);
 
     /* This looks like it comes out of the blue. However this is needed for
          ingress cloning. The parser updates the buffer state (pops the parsed
@@ -277,26 +412,42 @@ P4CoreV1model::HandleIngressPipeline()
          kind of looks hacky though. Maybe a better solution would be to have the
          parser leave the buffer unchanged, and move the pop logic to the
          deparser. TODO? */
-    const bm::Packet::buffer_state_t packet_in_state = bm_packet->save_buffer_state();
+    job->inState = bm_packet->save_buffer_state();
 
-    parser->parse(bm_packet.get());
+    m_blocks.ingressParser->parse(bm_packet);
 
-    if (phv->has_field("standard_metadata.parser_error"))
+    if (m_fields.parserError.exists)
     {
-        phv->get_field("standard_metadata.parser_error").set(bm_packet->get_error_code().get());
+        GetField(phv, m_fields.parserError).set(bm_packet->get_error_code().get());
     }
-    if (phv->has_field("standard_metadata.checksum_error"))
+    if (m_fields.checksumError.exists)
     {
-        phv->get_field("standard_metadata.checksum_error")
-            .set(bm_packet->get_checksum_error() ? 1 : 0);
+        GetField(phv, m_fields.checksumError).set(bm_packet->get_checksum_error() ? 1 : 0);
     }
 
-    ingress_mau->apply(bm_packet.get());
+    m_blocks.ingressPipeline->apply(bm_packet);
 
     bm_packet->reset_exit();
+}
 
-    bm::Field& f_egress_spec = phv->get_field("standard_metadata.egress_spec");
-    uint32_t egress_spec = f_egress_spec.get_uint();
+void
+P4CoreV1model::FinishIngress(IngressJob&& job)
+{
+    std::unique_ptr<bm::Packet> bm_packet = std::move(job.bm_packet);
+    const bm::Packet::buffer_state_t& packet_in_state = job.inState;
+    auto ingress_packet_size = job.packetSize;
+    bm::Parser* parser = m_blocks.ingressParser;
+    bm::PHV* phv = bm_packet->get_phv();
+
+    uint32_t ingress_port = bm_packet->get_ingress_port();
+    TracePacket(TRACE_INGRESS_PARSED, bm_packet.get(), ingress_port, 0, input_buffer->size());
+
+    NS_LOG_INFO("Processing packet from port "
+                << ingress_port << ", Packet ID: " << m_packetPool.GetPacketId(bm_packet.get())
+                << ", Size: " << bm_packet->get_data_size() << " bytes");
+
+    uint32_t egress_spec = GetField(phv, m_fields.egressSpec).get_uint();
+    TracePacket(TRACE_INGRESS_DONE, bm_packet.get(), egress_spec, 0, input_buffer->size());
 
     auto clone_mirror_session_id = RegisterAccess::get_clone_mirror_session_id(bm_packet.get());
     auto clone_field_list = RegisterAccess::get_clone_field_list(bm_packet.get());
@@ -306,18 +457,17 @@ P4CoreV1model::HandleIngressPipeline()
 
     // detect mcast support, if this is true we assume that other fields needed
     // for mcast are also defined
-    if (phv->has_field("intrinsic_metadata.mcast_grp"))
+    if (m_fields.mcastGrp.exists)
     {
-        bm::Field& f_mgid = phv->get_field("intrinsic_metadata.mcast_grp");
-        mgid = f_mgid.get_uint();
+        mgid = GetField(phv, m_fields.mcastGrp).get_uint();
     }
 
     // INGRESS CLONING
     if (clone_mirror_session_id)
     {
         NS_LOG_INFO("Cloning packet at ingress, Packet ID: "
-                    << bm_packet->get_packet_id() << ", Size: " << bm_packet->get_data_size()
-                    << " bytes");
+                    << m_packetPool.GetPacketId(bm_packet.get())
+                    << ", Size: " << bm_packet->get_data_size() << " bytes");
 
         RegisterAccess::set_clone_mirror_session_id(bm_packet.get(), 0);
         RegisterAccess::set_clone_field_list(bm_packet.get(), 0);
@@ -333,6 +483,7 @@ P4CoreV1model::HandleIngressPipeline()
             bm_packet->restore_buffer_state(packet_in_state);
             int field_list_id = clone_field_list;
             std::unique_ptr<bm::Packet> bm_packet_copy = bm_packet->clone_no_phv_ptr();
+            m_packetPool.AddClone(bm_packet_copy.get(), bm_packet.get());
             RegisterAccess::clear_all(bm_packet_copy.get());
             bm_packet_copy->set_register(RegisterAccess::PACKET_LENGTH_REG_IDX,
                                          ingress_packet_size);
@@ -344,9 +495,7 @@ P4CoreV1model::HandleIngressPipeline()
             // to ensure re-parsing gives the same result as the original parse.
             // TODO(https://github.com/p4lang/behavioral-model/issues/795): other
             // standard metadata should be preserved as well.
-            bm_packet_copy->get_phv()
-                ->get_field("standard_metadata.ingress_port")
-                .set(ingress_port);
+            GetField(bm_packet_copy->get_phv(), m_fields.ingressPort).set(ingress_port);
             parser->parse(bm_packet_copy.get());
             CopyFieldList(bm_packet,
                           bm_packet_copy,
@@ -360,8 +509,14 @@ P4CoreV1model::HandleIngressPipeline()
             if (config.egress_port_valid)
             {
                 NS_LOG_DEBUG("Cloning packet to egress port "
-                             << config.egress_port << ", Packet ID: " << bm_packet->get_packet_id()
+                             << config.egress_port
+                             << ", Packet ID: " << m_packetPool.GetPacketId(bm_packet.get())
                              << ", Size: " << bm_packet->get_data_size() << " bytes");
+                TracePacket(TRACE_CLONED,
+                            bm_packet_copy.get(),
+                            config.egress_port,
+                            0,
+                            egress_buffer.size(config.egress_port));
                 Enqueue(config.egress_port, std::move(bm_packet_copy));
             }
             bm_packet->restore_buffer_state(packet_out_state);
@@ -388,14 +543,15 @@ P4CoreV1model::HandleIngressPipeline()
         // TODO(antonin): a copy is not needed here, but I don't yet have an
         // optimized way of doing this
         std::unique_ptr<bm::Packet> bm_packet_copy = bm_packet->clone_no_phv_ptr();
+        m_packetPool.AddClone(bm_packet_copy.get(), bm_packet.get());
         bm::PHV* phv_copy = bm_packet_copy->get_phv();
         CopyFieldList(bm_packet, bm_packet_copy, PKT_INSTANCE_TYPE_RESUBMIT, field_list_id);
         RegisterAccess::clear_all(bm_packet_copy.get());
         bm_packet_copy->set_register(RegisterAccess::PACKET_LENGTH_REG_IDX, ingress_packet_size);
-        phv_copy->get_field("standard_metadata.packet_length").set(ingress_packet_size);
+        GetField(phv_copy, m_fields.packetLength).set(ingress_packet_size);
 
-        input_buffer->push_front(InputBuffer::PacketType::RESUBMIT, std::move(bm_packet_copy));
-        HandleIngressPipeline();
+        m_packetPool.Release(std::move(bm_packet));
+        EnterIngress(InputBuffer::PacketType::RESUBMIT, std::move(bm_packet_copy));
         return;
     }
 
@@ -403,10 +559,10 @@ P4CoreV1model::HandleIngressPipeline()
     if (mgid != 0)
     {
         NS_LOG_DEBUG("Multicast requested for packet");
-        auto& f_instance_type = phv->get_field("standard_metadata.instance_type");
-        f_instance_type.set(PKT_INSTANCE_TYPE_REPLICATION);
+        GetField(phv, m_fields.instanceType).set(PKT_INSTANCE_TYPE_REPLICATION);
         MulticastPacket(bm_packet.get(), mgid);
         // when doing MulticastPacket, we discard the original packet
+        m_packetPool.Release(std::move(bm_packet));
         return;
     }
 
@@ -417,12 +573,16 @@ P4CoreV1model::HandleIngressPipeline()
     {
         // drop packet
         NS_LOG_DEBUG("Dropping packet at the end of ingress");
+        DropPacket(std::move(bm_packet),
+                   P4MetricsSink::DROP_INGRESS,
+                   egress_port,
+                   0,
+                   input_buffer->size());
         return;
     }
-    auto& f_instance_type = phv->get_field("standard_metadata.instance_type");
-    f_instance_type.set(PKT_INSTANCE_TYPE_NORMAL);
+    GetField(phv, m_fields.instanceType).set(PKT_INSTANCE_TYPE_NORMAL);
 
-    NS_LOG_DEBUG("Packet ID: " << bm_packet->get_packet_id()
+    NS_LOG_DEBUG("Packet ID: " << m_packetPool.GetPacketId(bm_packet.get())
                                << ", Size: " << bm_packet->get_data_size()
                                << " bytes, Egress Port: " << egress_port);
     Enqueue(egress_port, std::move(bm_packet));
@@ -437,20 +597,61 @@ P4CoreV1model::Enqueue(uint32_t egress_port, std::unique_ptr<bm::Packet>&& packe
 
     if (m_enableQueueingMetadata)
     {
-        phv->get_field("queueing_metadata.enq_timestamp").set(GetTimeStamp());
-        phv->get_field("queueing_metadata.enq_qdepth").set(egress_buffer.size(egress_port));
+        GetField(phv, m_fields.enqTimestamp).set(GetTimeStamp());
+        GetField(phv, m_fields.enqQdepth).set(egress_buffer.size(egress_port));
     }
 
-    size_t priority = phv->has_field("intrinsic_metadata.priority")
-                          ? phv->get_field("intrinsic_metadata.priority").get<size_t>()
-                          : 0u;
+    size_t priority =
+        m_fields.priority.exists ? GetField(phv, m_fields.priority).get<size_t>() : 0u;
+    if (m_pfc)
+    {
+        // queue by PFC priority, the classification of the pauses
+        priority = GetPfcPriority(packet.get());
+        if (m_fields.priority.exists)
+        {
+            GetField(phv, m_fields.priority).set(priority);
+        }
+    }
     if (priority >= m_nbQueuesPerPort)
     {
         NS_LOG_ERROR("Priority out of range, dropping packet");
+        DropPacket(std::move(packet),
+                   P4MetricsSink::DROP_PRIORITY,
+                   egress_port,
+                   priority,
+                   egress_buffer.size(egress_port));
         return;
     }
 
-    egress_buffer.push_front(egress_port, m_nbQueuesPerPort - 1 - priority, std::move(packet));
+    size_t queue = m_nbQueuesPerPort - 1 - priority;
+    uint64_t packet_id = m_packetPool.GetPacketId(packet.get());
+    // the parser popped the headers from the buffer, the frame length is kept
+    // in the packet length register
+    size_t packet_size = packet->get_register(RegisterAccess::PACKET_LENGTH_REG_IDX);
+    uint32_t ingress_port = packet->get_ingress_port();
+    P4Aqm::Verdict verdict;
+    if (!egress_buffer.push_front(egress_port, queue, std::move(packet), packet_size, &verdict))
+    {
+        // queue full or AQM drop, the packet was not taken
+        DropPacket(std::move(packet),
+                   verdict == P4Aqm::DROP ? P4MetricsSink::DROP_AQM
+                                          : P4MetricsSink::DROP_QUEUE_FULL,
+                   egress_port,
+                   priority,
+                   egress_buffer.size(egress_port));
+        return;
+    }
+    if (m_pfc)
+    {
+        m_pfc->OnEnqueue(ingress_port, priority, packet_size);
+    }
+    TracePacket(TRACE_ENQUEUED,
+                packet_id,
+                packet_size,
+                egress_port,
+                priority,
+                egress_buffer.size(egress_port));
+    ScheduleEgressEvent();
 
     NS_LOG_DEBUG("Packet enqueued in queue buffer with Port: " << egress_port
                                                                << ", Priority: " << priority);
@@ -459,78 +660,128 @@ P4CoreV1model::Enqueue(uint32_t egress_port, std::unique_ptr<bm::Packet>&& packe
 bool
 P4CoreV1model::HandleEgressPipeline(size_t workerId)
 {
-    NS_LOG_FUNCTION("HandleEgressPipeline");
+    NS_LOG_FUNCTION("Dequeue packet from QueueBuffer");
     std::unique_ptr<bm::Packet> bm_packet;
     size_t port;
     size_t priority;
 
-    int queue_number = SSWITCH_VIRTUAL_QUEUE_NUM_V1MODEL;
-
-    for (int i = 0; i < queue_number; i++)
-    {
-        if (egress_buffer.size(i) > 0)
-        {
-            break;
-        }
-        if (i == queue_number - 1)
-        {
-            return false;
-        }
-    }
-
     egress_buffer.pop_back(workerId, &port, &priority, &bm_packet);
     if (bm_packet == nullptr)
         return false;
 
-    if (m_enableTracing)
+    ProcessEgressPacket(port, priority, std::move(bm_packet));
+    return true;
+}
+
+void
+P4CoreV1model::ProcessEgressPacket(size_t port,
+                                   size_t priority,
+                                   std::unique_ptr<bm::Packet>&& bm_packet)
+{
+    NS_LOG_FUNCTION("Egress processing, port " << port << ", priority " << priority);
+
+    // this may add the header in account
+    m_traffic.egressPackets++;
+    m_traffic.egressBits += bm_packet->get_data_size() * 8;
+
+    // the packet events carry the packet priority, queue i holds the
+    // priority m_nbQueuesPerPort - 1 - i
+    size_t packet_priority = m_nbQueuesPerPort - 1 - priority;
+    TracePacket(TRACE_DEQUEUED, bm_packet.get(), port, packet_priority, egress_buffer.size(port));
+    if (m_pfc)
     {
-        m_egressPps++; // egress pps
-        int len = bm_packet->get_data_size();
-        m_egressBps += len * 8; // egress bps, this may add the header in account.
+        m_pfc->OnDequeue(bm_packet->get_ingress_port(),
+                         packet_priority,
+                         bm_packet->get_register(RegisterAccess::PACKET_LENGTH_REG_IDX));
     }
 
-    NS_LOG_FUNCTION("Egress processing for the packet");
     bm::PHV* phv = bm_packet->get_phv();
-    bm::Pipeline* egress_mau = this->get_pipeline("egress");
-    bm::Deparser* deparser = this->get_deparser("deparser");
 
-    if (phv->has_field("intrinsic_metadata.egress_global_timestamp"))
+    if (m_fields.egressGlobalTimestamp.exists)
     {
-        phv->get_field("intrinsic_metadata.egress_global_timestamp").set(GetTimeStamp());
+        GetField(phv, m_fields.egressGlobalTimestamp).set(GetTimeStamp());
     }
 
     if (m_enableQueueingMetadata)
     {
-        uint64_t enq_timestamp = phv->get_field("queueing_metadata.enq_timestamp").get<uint64_t>();
-        phv->get_field("queueing_metadata.deq_timedelta").set(GetTimeStamp() - enq_timestamp);
+        uint64_t enq_timestamp = GetField(phv, m_fields.enqTimestamp).get<uint64_t>();
+        GetField(phv, m_fields.deqTimedelta).set(GetTimeStamp() - enq_timestamp);
 
-        size_t priority = phv->has_field("intrinsic_metadata.priority")
-                              ? phv->get_field("intrinsic_metadata.priority").get<size_t>()
-                              : 0u;
-        if (priority >= m_nbQueuesPerPort)
+        size_t meta_priority =
+            m_fields.priority.exists ? GetField(phv, m_fields.priority).get<size_t>() : 0u;
+        if (meta_priority >= m_nbQueuesPerPort)
         {
             NS_LOG_ERROR("Priority out of range (m_nbQueuesPerPort = " << m_nbQueuesPerPort
                                                                        << "), dropping packet");
-            return true;
+            DropPacket(std::move(bm_packet),
+                       P4MetricsSink::DROP_PRIORITY,
+                       port,
+                       meta_priority,
+                       egress_buffer.size(port));
+            return;
         }
 
-        phv->get_field("queueing_metadata.deq_qdepth").set(egress_buffer.size(port));
-        if (phv->has_field("queueing_metadata.qid"))
+        GetField(phv, m_fields.deqQdepth).set(egress_buffer.size(port));
+        if (m_fields.qid.exists)
         {
-            auto& qid_f = phv->get_field("queueing_metadata.qid");
-            qid_f.set(m_nbQueuesPerPort - 1 - priority);
+            GetField(phv, m_fields.qid).set(m_nbQueuesPerPort - 1 - meta_priority);
         }
     }
 
-    phv->get_field("standard_metadata.egress_port").set(port);
+    GetField(phv, m_fields.egressPort).set(port);
 
-    bm::Field& f_egress_spec = phv->get_field("standard_metadata.egress_spec");
-    f_egress_spec.set(0);
+    GetField(phv, m_fields.egressSpec).set(0);
 
-    phv->get_field("standard_metadata.packet_length")
+    GetField(phv, m_fields.packetLength)
         .set(bm_packet->get_register(RegisterAccess::PACKET_LENGTH_REG_IDX));
 
-    egress_mau->apply(bm_packet.get());
+    EgressJob job{std::move(bm_packet), port, packet_priority, false};
+    if (!m_engine)
+    {
+        RunEgressBlocks(&job);
+        FinishEgress(std::move(job));
+        return;
+    }
+
+    m_egressPending.push_back(std::move(job));
+    m_engine->Submit(
+        this,
+        [this]() {
+            EgressJob next = std::move(m_egressPending.front());
+            m_egressPending.pop_front();
+            RunEgressBlocks(&next);
+            m_egressDone.push_back(std::move(next));
+        },
+        [this]() {
+            EgressJob next = std::move(m_egressDone.front());
+            m_egressDone.pop_front();
+            FinishEgress(std::move(next));
+        });
+}
+
+void
+P4CoreV1model::RunEgressBlocks(EgressJob* job)
+{
+    bm::Packet* bm_packet = job->bm_packet.get();
+    m_blocks.egressPipeline->apply(bm_packet);
+
+    // Cloning needs the packet before deparsing, and dropped packets are
+    // not deparsed: these are left to FinishEgress
+    if (RegisterAccess::get_clone_mirror_session_id(bm_packet) == 0 &&
+        GetField(bm_packet->get_phv(), m_fields.egressSpec).get_uint() != m_dropPort)
+    {
+        m_blocks.egressDeparser->deparse(bm_packet);
+        job->deparsed = true;
+    }
+}
+
+void
+P4CoreV1model::FinishEgress(EgressJob&& job)
+{
+    std::unique_ptr<bm::Packet> bm_packet = std::move(job.bm_packet);
+    size_t port = job.port;
+    bm::PHV* phv = bm_packet->get_phv();
+    bm::Field& f_egress_spec = GetField(phv, m_fields.egressSpec);
 
     auto clone_mirror_session_id = RegisterAccess::get_clone_mirror_session_id(bm_packet.get());
     auto clone_field_list = RegisterAccess::get_clone_field_list(bm_packet.get());
@@ -539,8 +790,8 @@ P4CoreV1model::HandleEgressPipeline(size_t workerId)
     if (clone_mirror_session_id)
     {
         NS_LOG_DEBUG("Cloning packet at egress, Packet ID: "
-                     << bm_packet->get_packet_id() << ", Size: " << bm_packet->get_data_size()
-                     << " bytes");
+                     << m_packetPool.GetPacketId(bm_packet.get())
+                     << ", Size: " << bm_packet->get_data_size() << " bytes");
         RegisterAccess::set_clone_mirror_session_id(bm_packet.get(), 0);
         RegisterAccess::set_clone_field_list(bm_packet.get(), 0);
         MirroringSessionConfig config;
@@ -554,11 +805,11 @@ P4CoreV1model::HandleEgressPipeline(size_t workerId)
             int field_list_id = clone_field_list;
             std::unique_ptr<bm::Packet> packet_copy =
                 bm_packet->clone_with_phv_reset_metadata_ptr();
+            m_packetPool.AddClone(packet_copy.get(), bm_packet.get());
             bm::PHV* phv_copy = packet_copy->get_phv();
             bm::FieldList* field_list = this->get_field_list(field_list_id);
             field_list->copy_fields_between_phvs(phv_copy, phv);
-            phv_copy->get_field("standard_metadata.instance_type")
-                .set(PKT_INSTANCE_TYPE_EGRESS_CLONE);
+            GetField(phv_copy, m_fields.instanceType).set(PKT_INSTANCE_TYPE_EGRESS_CLONE);
             auto packet_size = bm_packet->get_register(RegisterAccess::PACKET_LENGTH_REG_IDX);
             RegisterAccess::clear_all(packet_copy.get());
             packet_copy->set_register(RegisterAccess::PACKET_LENGTH_REG_IDX, packet_size);
@@ -570,6 +821,11 @@ P4CoreV1model::HandleEgressPipeline(size_t workerId)
             if (config.egress_port_valid)
             {
                 NS_LOG_DEBUG("Cloning packet to egress port " << config.egress_port);
+                TracePacket(TRACE_CLONED,
+                            packet_copy.get(),
+                            config.egress_port,
+                            0,
+                            egress_buffer.size(config.egress_port));
                 // TODO This create a copy packet(new bm packet), but the UID mapping
                 // may need to be updated in map.
                 Enqueue(config.egress_port, std::move(packet_copy));
@@ -583,10 +839,18 @@ P4CoreV1model::HandleEgressPipeline(size_t workerId)
     {
         // drop packet
         NS_LOG_DEBUG("Dropping packet at the end of egress");
-        return true;
+        DropPacket(std::move(bm_packet),
+                   P4MetricsSink::DROP_EGRESS,
+                   port,
+                   job.priority,
+                   egress_buffer.size(port));
+        return;
     }
 
-    deparser->deparse(bm_packet.get());
+    if (!job.deparsed)
+    {
+        m_blocks.egressDeparser->deparse(bm_packet.get());
+    }
 
     // RECIRCULATE
     auto recirculate_flag = RegisterAccess::get_recirculate_flag(bm_packet.get());
@@ -600,40 +864,47 @@ P4CoreV1model::HandleEgressPipeline(size_t workerId)
         // TODO(antonin): just like for resubmit, there is no need for a copy
         // here, but it is more convenient for this first prototype
         std::unique_ptr<bm::Packet> packet_copy = bm_packet->clone_no_phv_ptr();
+        m_packetPool.AddClone(packet_copy.get(), bm_packet.get());
         bm::PHV* phv_copy = packet_copy->get_phv();
         phv_copy->reset_metadata();
         field_list->copy_fields_between_phvs(phv_copy, phv);
-        phv_copy->get_field("standard_metadata.instance_type").set(PKT_INSTANCE_TYPE_RECIRC);
+        GetField(phv_copy, m_fields.instanceType).set(PKT_INSTANCE_TYPE_RECIRC);
         size_t packet_size = packet_copy->get_data_size();
         RegisterAccess::clear_all(packet_copy.get());
         packet_copy->set_register(RegisterAccess::PACKET_LENGTH_REG_IDX, packet_size);
-        phv_copy->get_field("standard_metadata.packet_length").set(packet_size);
+        GetField(phv_copy, m_fields.packetLength).set(packet_size);
         // TODO(antonin): really it may be better to create a new packet here or
         // to fold this functionality into the Packet class?
         packet_copy->set_ingress_length(packet_size);
-        input_buffer->push_front(InputBuffer::PacketType::RECIRCULATE, std::move(packet_copy));
-        return true;
+        TracePacket(TRACE_RECIRCULATED,
+                    packet_copy.get(),
+                    port,
+                    job.priority,
+                    egress_buffer.size(port));
+        m_packetPool.Release(std::move(bm_packet));
+        EnterIngress(InputBuffer::PacketType::RECIRCULATE, std::move(packet_copy));
+        return;
     }
 
     uint16_t protocol = RegisterAccess::get_ns_protocol(bm_packet.get());
     int addr_index = RegisterAccess::get_ns_address(bm_packet.get());
 
+    uint64_t packet_id = m_packetPool.GetPacketId(bm_packet.get());
     Ptr<Packet> ns_packet = this->ConvertToNs3Packet(std::move(bm_packet));
     NS_LOG_DEBUG("Sending packet to NS-3 stack, Packet ID: " << ns_packet->GetUid() << ", Size: "
                                                              << ns_packet->GetSize() << " bytes");
-    m_switchNetDevice->SendNs3Packet(ns_packet, port, protocol, m_destinationList[addr_index]);
-    return true;
+    m_egressStage.Push(
+        EgressItem{ns_packet, port, protocol, addr_index, packet_id, job.priority});
 }
 
 void
 P4CoreV1model::CalculateScheduleTime()
 {
-    m_egressTimeEvent = EventId();
-
     // Now we can not set the dequeue rate for each queue, later we will add this feature
     // by p4 runtime controller.
     uint64_t bottleneck_ns = 1e9 / m_switchRate;
     egress_buffer.set_rate_for_all(m_switchRate);
+    egress_buffer.set_port_rate_for_all(m_switchRate);
     m_egressTimeRef = Time::FromDouble(bottleneck_ns, Time::NS);
 
     NS_LOG_DEBUG("Switch ID: " << m_p4SwitchId << " Egress time reference set to " << bottleneck_ns
@@ -645,7 +916,7 @@ P4CoreV1model::MulticastPacket(bm::Packet* packet, unsigned int mgid)
 {
     NS_LOG_FUNCTION(this);
     auto* phv = packet->get_phv();
-    auto& f_rid = phv->get_field("intrinsic_metadata.egress_rid");
+    auto& f_rid = GetField(phv, m_fields.egressRid);
     const auto pre_out = m_pre->replicate({mgid});
     auto packet_size = packet->get_register(RegisterAccess::PACKET_LENGTH_REG_IDX);
     for (const auto& out : pre_out)
@@ -654,77 +925,51 @@ P4CoreV1model::MulticastPacket(bm::Packet* packet, unsigned int mgid)
         NS_LOG_DEBUG("Replicating packet on port " << egress_port);
         f_rid.set(out.rid);
         std::unique_ptr<bm::Packet> packet_copy = packet->clone_with_phv_ptr();
+        m_packetPool.AddClone(packet_copy.get(), packet);
         RegisterAccess::clear_all(packet_copy.get());
         packet_copy->set_register(RegisterAccess::PACKET_LENGTH_REG_IDX, packet_size);
+        TracePacket(TRACE_MULTICAST,
+                    packet_copy.get(),
+                    egress_port,
+                    0,
+                    egress_buffer.size(egress_port));
         Enqueue(egress_port, std::move(packet_copy));
     }
 }
 
 void
-P4CoreV1model::CalculatePacketsPerSecond()
+P4CoreV1model::DropPacket(std::unique_ptr<bm::Packet>&& packet,
+                          P4MetricsSink::DropReason reason,
+                          uint32_t port,
+                          uint32_t priority,
+                          size_t depth)
 {
-    // Calculating P4 switch statistics
-    m_inputBp += m_inputBps;
-    m_inputPp += m_inputPps;
-    m_egressBp += m_egressBp;
-    m_egressPp += m_egressPps;
-
-    // Construct log file path
-    std::string log_filename = "/tmp/bmv2-" + std::to_string(m_p4SwitchId) + "-queue_info.log";
-    static std::ofstream log_file(log_filename, std::ios::app);
-
-    if (!log_file.is_open())
-    {
-        NS_LOG_ERROR("Failed to open log file: " << log_filename);
-        return;
-    }
-
-    std::ostringstream log_stream;
-    log_stream << "P4 switch ID: " << m_p4SwitchId << "\n";
-    log_stream << "Time: " << Simulator::Now().GetSeconds() << " [s]\n";
-    log_stream << "Input packets per time interval: " << m_inputPps << " [pps]\n";
-    log_stream << "Input bits per time interval: " << m_inputBps << " [bps]\n";
-    log_stream << "Egress packets per time interval: " << m_egressPps << " [pps]\n";
-    log_stream << "Egress bits per time interval: " << m_egressBps << " [bps]\n";
-
-    log_stream << "Total input packets: " << m_inputPp << " [pp]\n";
-    log_stream << "Total input bits: " << m_inputBp << " [bp]\n";
-    log_stream << "Total egress packets: " << m_egressPp << " [pp]\n";
-    log_stream << "Total egress bits: " << m_egressBp << " [bp]\n";
-
-    m_inputPps = 0;
-    m_inputBps = 0;
-    m_egressPps = 0;
-    m_egressBps = 0;
+    m_traffic.drops[reason]++;
+    TracePacket(TRACE_DROPPED, packet.get(), port, priority, depth, reason);
+    m_packetPool.Release(std::move(packet));
+}
 
-    size_t input_buffer_size = input_buffer->get_size();
-    log_stream << "Input buffer size: " << input_buffer_size << "\n";
+void
+P4CoreV1model::SampleMetrics(P4MetricsSink* sink, Time now)
+{
+    sink->AppendSwitchRow(now, m_p4SwitchId, m_traffic, &m_lastTraffic, input_buffer->size());
 
+    // the queue sizes are kept by the queueing logic, no packet is walked
     uint32_t port_number = m_switchNetDevice->GetNBridgePorts();
-
-    for (size_t i = 0; i < static_cast<size_t>(port_number); i++)
-    {
-        size_t queue_size = egress_buffer.size(i);
-        log_stream << "[TEST] Queue buffer for ports " << i << " size: " << queue_size << "\n";
-    }
-
     for (size_t i = 0; i < static_cast<size_t>(port_number); i++)
     {
         for (size_t j = 0; j < m_nbQueuesPerPort; j++)
         {
-            size_t queue_size = egress_buffer.size(i, j);
-            log_stream << "Queue pipeline " << i << " priority " << j << " size: " << queue_size
-                       << "\n";
+            // queue j holds the priority m_nbQueuesPerPort - 1 - j
+            sink->AppendQueueRow(now,
+                                 m_p4SwitchId,
+                                 i,
+                                 m_nbQueuesPerPort - 1 - j,
+                                 egress_buffer.size(i, j),
+                                 egress_buffer.depth_histogram(i, j),
+                                 egress_buffer.sojourn_histogram(i, j));
         }
     }
-
-    size_t output_buffer_size = output_buffer.size();
-    log_stream << "Output buffer size: " << output_buffer_size << "\n";
-
-    log_file << log_stream.str();
-    log_file.flush();
-
-    Simulator::Schedule(m_timeInterval, &P4CoreV1model::CalculatePacketsPerSecond, this);
 }
 
 void
@@ -737,13 +982,13 @@ P4CoreV1model::CopyFieldList(const std::unique_ptr<bm::Packet>& packet,
     phv_copy->reset_metadata();
     bm::FieldList* field_list = this->get_field_list(fieldListId);
     field_list->copy_fields_between_phvs(phv_copy, packet->get_phv());
-    phv_copy->get_field("standard_metadata.instance_type").set(copyType);
+    GetField(phv_copy, m_fields.instanceType).set(copyType);
 }
 
 int
-P4CoreV1model::SetEgressPriorityQueueDepth(size_t port, size_t priority, const size_t depth_pkts)
+P4CoreV1model::SetEgressPriorityQueueDepth(size_t port, size_t queue, const size_t depth_pkts)
 {
-    egress_buffer.set_capacity(port, priority, depth_pkts);
+    egress_buffer.set_capacity(port, queue, depth_pkts);
     return 0;
 }
 
@@ -762,9 +1007,9 @@ P4CoreV1model::SetAllEgressQueueDepths(const size_t depth_pkts)
 }
 
 int
-P4CoreV1model::SetEgressPriorityQueueRate(size_t port, size_t priority, const uint64_t rate_pps)
+P4CoreV1model::SetEgressPriorityQueueRate(size_t port, size_t queue, const uint64_t rate_pps)
 {
-    egress_buffer.set_rate(port, priority, rate_pps);
+    egress_buffer.set_rate(port, queue, rate_pps);
     return 0;
 }
 
@@ -775,6 +1020,14 @@ P4CoreV1model::SetEgressQueueRate(size_t port, const uint64_t rate_pps)
     return 0;
 }
 
+int
+P4CoreV1model::SetEgressPortRate(size_t port, const uint64_t rate_pps)
+{
+    egress_buffer.set_port_rate(port, rate_pps);
+    ScheduleEgressEvent();
+    return 0;
+}
+
 int
 P4CoreV1model::SetAllEgressQueueRates(const uint64_t rate_pps)
 {
@@ -782,4 +1035,179 @@ P4CoreV1model::SetAllEgressQueueRates(const uint64_t rate_pps)
     return 0;
 }
 
+int
+P4CoreV1model::SetEgressPriorityQueueRateBps(size_t port, size_t priority, uint64_t rate_bps)
+{
+    if (priority >= m_nbQueuesPerPort)
+    {
+        return -1;
+    }
+    egress_buffer.set_rate_bps(port, m_nbQueuesPerPort - 1 - priority, rate_bps);
+    return 0;
+}
+
+int
+P4CoreV1model::SetEgressQueueRateBps(size_t port, uint64_t rate_bps)
+{
+    egress_buffer.set_rate_bps(port, rate_bps);
+    return 0;
+}
+
+int
+P4CoreV1model::SetAllEgressQueueRatesBps(uint64_t rate_bps)
+{
+    egress_buffer.set_rate_bps_for_all(rate_bps);
+    return 0;
+}
+
+int
+P4CoreV1model::SetEgressPortRateBps(size_t port, uint64_t rate_bps)
+{
+    egress_buffer.set_port_rate_bps(port, rate_bps);
+    return 0;
+}
+
+int
+P4CoreV1model::SetAllEgressPortRatesBps(uint64_t rate_bps)
+{
+    egress_buffer.set_port_rate_bps_for_all(rate_bps);
+    return 0;
+}
+
+int
+P4CoreV1model::SetEgressPriorityQueueByteDepth(size_t port, size_t priority, size_t depth_bytes)
+{
+    if (priority >= m_nbQueuesPerPort)
+    {
+        return -1;
+    }
+    egress_buffer.set_byte_capacity(port, m_nbQueuesPerPort - 1 - priority, depth_bytes);
+    return 0;
+}
+
+int
+P4CoreV1model::SetEgressQueueByteDepth(size_t port, size_t depth_bytes)
+{
+    egress_buffer.set_byte_capacity(port, depth_bytes);
+    return 0;
+}
+
+int
+P4CoreV1model::SetAllEgressQueueByteDepths(size_t depth_bytes)
+{
+    egress_buffer.set_byte_capacity_for_all(depth_bytes);
+    return 0;
+}
+
+int
+P4CoreV1model::SetEgressSharedBuffer(size_t total_bytes, size_t reserve_bytes, double alpha)
+{
+    egress_buffer.set_shared_buffer(total_bytes, reserve_bytes, alpha);
+    return 0;
+}
+
+int
+P4CoreV1model::SetEgressPriorityQueueSharedBuffer(size_t port,
+                                                  size_t priority,
+                                                  size_t reserve_bytes,
+                                                  double alpha)
+{
+    if (priority >= m_nbQueuesPerPort)
+    {
+        return -1;
+    }
+    size_t queue = m_nbQueuesPerPort - 1 - priority;
+    egress_buffer.set_shared_buffer_reserve(port, queue, reserve_bytes);
+    egress_buffer.set_shared_buffer_alpha(port, queue, alpha);
+    return 0;
+}
+
+size_t
+P4CoreV1model::GetEgressSharedBufferUsage() const
+{
+    return egress_buffer.shared_buffer_used();
+}
+
+int
+P4CoreV1model::EnableQueueHistograms(bool enable)
+{
+    egress_buffer.enable_histograms(enable);
+    return 0;
+}
+
+const P4Histogram*
+P4CoreV1model::GetQueueDepthHistogram(size_t port, size_t priority) const
+{
+    if (priority >= m_nbQueuesPerPort)
+    {
+        return nullptr;
+    }
+    return egress_buffer.depth_histogram(port, m_nbQueuesPerPort - 1 - priority);
+}
+
+int
+P4CoreV1model::SetEgressPriorityQueueAqm(size_t port, size_t priority, const P4Aqm::Config& config)
+{
+    if (priority >= m_nbQueuesPerPort)
+    {
+        return -1;
+    }
+    egress_buffer.set_aqm(port, m_nbQueuesPerPort - 1 - priority, config);
+    return 0;
+}
+
+int
+P4CoreV1model::SetAllEgressQueueAqm(const P4Aqm::Config& config)
+{
+    egress_buffer.set_aqm_for_all(config);
+    return 0;
+}
+
+P4Aqm::Counters
+P4CoreV1model::GetEgressQueueAqmCounters(size_t port, size_t priority) const
+{
+    if (priority >= m_nbQueuesPerPort)
+    {
+        return P4Aqm::Counters();
+    }
+    return egress_buffer.aqm_counters(port, m_nbQueuesPerPort - 1 - priority);
+}
+
+int
+P4CoreV1model::EnablePfc(uint64_t xoff_bytes, uint64_t xon_bytes)
+{
+    if (m_nbQueuesPerPort < P4PfcAccounting::NB_PRIORITIES)
+    {
+        NS_LOG_WARN("EnablePfc: PFC needs one egress queue per PFC priority");
+        return -1;
+    }
+    CreatePfcAccounting(xoff_bytes, xon_bytes);
+    return 0;
+}
+
+int
+P4CoreV1model::SetEgressQueuePaused(size_t port, size_t priority, bool paused)
+{
+    if (priority >= m_nbQueuesPerPort)
+    {
+        return -1;
+    }
+    egress_buffer.set_paused(port, m_nbQueuesPerPort - 1 - priority, paused);
+    if (!paused)
+    {
+        ScheduleEgressEvent();
+    }
+    return 0;
+}
+
+const P4Histogram*
+P4CoreV1model::GetQueueSojournHistogram(size_t port, size_t priority) const
+{
+    if (priority >= m_nbQueuesPerPort)
+    {
+        return nullptr;
+    }
+    return egress_buffer.sojourn_histogram(port, m_nbQueuesPerPort - 1 - priority);
+}
+
 } // namespace ns3
\ No newline at end of file
@@ -20,9 +20,14 @@
 #ifndef P4_CORE_V1MODEL_H
 #define P4_CORE_V1MODEL_H
 
+#include "ns3/p4-metrics-sink.h"
+#include "ns3/p4-pipeline-engine.h"
 #include "ns3/p4-queue.h"
+#include "ns3/p4-stage-fifo.h"
 #include "ns3/p4-switch-core.h"
 
+#include <deque>
+
 #define SSWITCH_VIRTUAL_QUEUE_NUM_V1MODEL 8
 
 namespace ns3
@@ -108,28 +113,81 @@ class P4CoreV1model : public P4SwitchCore
      * @brief Handle the egress pipeline
      * @param workerId The worker ID of the egress pipeline
      * @return bool True if the egress pipeline is handled successfully
-     * @return bool False if the egress pipeline needs additional scheduling
+     * @return bool False if no packet was eligible for dequeue
      */
     bool HandleEgressPipeline(size_t workerId) override;
 
+    /**
+     * @brief Run a dequeued packet through the egress pipeline and send it
+     * @param port The egress port the packet was queued for
+     * @param priority The priority queue the packet was dequeued from
+     * @param bm_packet The packet
+     */
+    void ProcessEgressPacket(size_t port,
+                             size_t priority,
+                             std::unique_ptr<bm::Packet>&& bm_packet);
+
     /**
      * @brief Calculate the schedule time for the egress pipeline
      */
     void CalculateScheduleTime();
 
     /**
-     * @brief Set the egress timer event
-     * @details This function is called by the egress timer event to trigger the
-     * egress pipeline
+     * @brief Hand a packet to the ingress pipeline, after the ingress latency
+     * @param type The packet type (normal, resubmitted or recirculated)
+     * @param bm_packet The packet
+     */
+    void EnterIngress(InputBuffer::PacketType type, std::unique_ptr<bm::Packet>&& bm_packet);
+
+    /**
+     * @brief Set the latency of the ingress and egress stages from the
+     * pipeline latency model and the tables of the loaded program
+     */
+    void ApplyPipelineLatency();
+
+    /**
+     * @brief Drop a packet: count it, report it to the Dropped trace source
+     * and return it to the packet pool
+     * @param packet the packet
+     * @param reason why the packet is dropped
+     * @param port the ingress or egress port of the packet
+     * @param priority the queue priority of the packet
+     * @param depth the input buffer or queue depth
      */
-    void CalculatePacketsPerSecond();
+    void DropPacket(std::unique_ptr<bm::Packet>&& packet,
+                    P4MetricsSink::DropReason reason,
+                    uint32_t port,
+                    uint32_t priority,
+                    size_t depth);
 
     /**
-     * @brief Set the egress timer event
-     * @details This function is called by the egress timer event to trigger the
-     * dequeue, then run the egress pipeline
+     * @brief Append the metrics rows of the switch to the metrics sink
+     * @param sink the metrics sink
+     * @param now the sample time
      */
-    void SetEgressTimerEvent();
+    void SampleMetrics(P4MetricsSink* sink, Time now);
+
+    /**
+     * @brief Resolve the handles of the PHV fields used on the packet path
+     * @details Called when the switch starts and when the P4 program is swapped.
+     */
+    void ResolvePhvFields();
+
+    /**
+     * @brief Make sure a dequeue event is pending while packets are queued
+     * @details Called after every enqueue and dequeue. The event is scheduled
+     * when the next packet becomes eligible (see
+     * NSQueueingLogicPriRL::get_next_tp_all_ports), and none is scheduled
+     * while the queue buffer is empty or only holds paused queues.
+     */
+    void ScheduleEgressEvent();
+
+    /**
+     * @brief Dequeue event: run the packets eligible now (up to the egress
+     * batch size) through the egress pipeline, then schedule the next dequeue
+     * event
+     */
+    void EgressEvent();
 
     /**
      * @brief Multicast a packet to a multicast group ID
@@ -149,11 +207,11 @@ class P4CoreV1model : public P4SwitchCore
     /**
      * @brief Set the depth of a priority queue
      * @param port The egress port
-     * @param priority The priority of the queue
+     * @param queue The index of the queue in the port
      * @param depthPkts The depth of the queue in packets
      * @return int 0 if successful
      */
-    int SetEgressPriorityQueueDepth(size_t port, size_t priority, size_t depthPkts);
+    int SetEgressPriorityQueueDepth(size_t port, size_t queue, size_t depthPkts) override;
 
     /**
      * @brief Set the depth of a queue
@@ -161,23 +219,23 @@ class P4CoreV1model : public P4SwitchCore
      * @param depthPkts The depth of the queue in packets
      * @return int 0 if successful
      */
-    int SetEgressQueueDepth(size_t port, size_t depthPkts);
+    int SetEgressQueueDepth(size_t port, size_t depthPkts) override;
 
     /**
      * @brief Set the depth of all queues
      * @param depthPkts The depth of the queue in packets
      * @return int 0 if successful
      */
-    int SetAllEgressQueueDepths(size_t depthPkts);
+    int SetAllEgressQueueDepths(size_t depthPkts) override;
 
     /**
      * @brief Set the rate of a priority queue
      * @param port The egress port
-     * @param priority The priority of the queue
+     * @param queue The index of the queue in the port
      * @param ratePps The rate of the queue in packets per second
      * @return int 0 if successful
      */
-    int SetEgressPriorityQueueRate(size_t port, size_t priority, uint64_t ratePps);
+    int SetEgressPriorityQueueRate(size_t port, size_t queue, uint64_t ratePps) override;
 
     /**
      * @brief Set the rate of a virtual queue
@@ -185,14 +243,179 @@ class P4CoreV1model : public P4SwitchCore
      * @param ratePps The rate of the queue in packets per second
      * @return int 0 if successful
      */
-    int SetEgressQueueRate(size_t port, uint64_t ratePps);
+    int SetEgressQueueRate(size_t port, uint64_t ratePps) override;
+
+    /**
+     * @brief Set the line rate of an egress port
+     * @param port The egress port
+     * @param ratePps The rate of the port in packets per second, 0 for no limit
+     * @return int 0 if successful
+     */
+    int SetEgressPortRate(size_t port, uint64_t ratePps) override;
 
     /**
      * @brief Set the rate of all virtual queues
      * @param ratePps The rate of the queue in packets per second
      * @return int 0 if successful
      */
-    int SetAllEgressQueueRates(uint64_t ratePps);
+    int SetAllEgressQueueRates(uint64_t ratePps) override;
+
+    /**
+     * @brief Set the rate of a priority queue in bits per second, replacing its packet rate
+     * @param port The egress port
+     * @param priority The priority of the queue
+     * @param rateBps The rate of the queue in bits per second, 0 for no limit
+     * @return int 0 if successful
+     */
+    int SetEgressPriorityQueueRateBps(size_t port, size_t priority, uint64_t rateBps) override;
+
+    /**
+     * @brief Set the rate of the queues of a port in bits per second
+     * @param port The egress port
+     * @param rateBps The rate of the queues in bits per second
+     * @return int 0 if successful
+     */
+    int SetEgressQueueRateBps(size_t port, uint64_t rateBps) override;
+
+    /**
+     * @brief Set the rate of all the queues in bits per second
+     * @param rateBps The rate of the queues in bits per second
+     * @return int 0 if successful
+     */
+    int SetAllEgressQueueRatesBps(uint64_t rateBps) override;
+
+    /**
+     * @brief Set the line rate of an egress port in bits per second, replacing its packet rate
+     * @param port The egress port
+     * @param rateBps The rate of the port in bits per second, 0 for no limit
+     * @return int 0 if successful
+     */
+    int SetEgressPortRateBps(size_t port, uint64_t rateBps) override;
+
+    /**
+     * @brief Set the line rate of all the egress ports in bits per second
+     * @param rateBps The rate of the ports in bits per second, 0 for no limit
+     * @return int 0 if successful
+     */
+    int SetAllEgressPortRatesBps(uint64_t rateBps) override;
+
+    /**
+     * @brief Set the depth of a priority queue in bytes, on top of its depth in packets
+     * @param port The egress port
+     * @param priority The priority of the queue
+     * @param depthBytes The depth of the queue in bytes, 0 for no limit
+     * @return int 0 if successful
+     */
+    int SetEgressPriorityQueueByteDepth(size_t port, size_t priority, size_t depthBytes) override;
+
+    /**
+     * @brief Set the depth in bytes of the queues of a port
+     * @param port The egress port
+     * @param depthBytes The depth of the queues in bytes, 0 for no limit
+     * @return int 0 if successful
+     */
+    int SetEgressQueueByteDepth(size_t port, size_t depthBytes) override;
+
+    /**
+     * @brief Set the depth in bytes of all the queues
+     * @param depthBytes The depth of the queues in bytes, 0 for no limit
+     * @return int 0 if successful
+     */
+    int SetAllEgressQueueByteDepths(size_t depthBytes) override;
+
+    /**
+     * @brief Make the egress queues share one buffer with dynamic thresholds
+     * @param totalBytes The size of the buffer, reserves included, 0 to disable it
+     * @param reserveBytes The bytes guaranteed to each queue
+     * @param alpha The dynamic threshold factor of the queues
+     * @return int 0 if successful
+     */
+    int SetEgressSharedBuffer(size_t totalBytes, size_t reserveBytes, double alpha) override;
+
+    /**
+     * @brief Set the shared buffer reserve and dynamic threshold factor of a priority queue
+     * @param port The egress port
+     * @param priority The priority of the queue
+     * @param reserveBytes The bytes guaranteed to the queue
+     * @param alpha The dynamic threshold factor of the queue
+     * @return int 0 if successful
+     */
+    int SetEgressPriorityQueueSharedBuffer(size_t port,
+                                           size_t priority,
+                                           size_t reserveBytes,
+                                           double alpha) override;
+
+    /**
+     * @brief Get the bytes of the shared buffer used beyond the reserves
+     * @return size_t the bytes
+     */
+    size_t GetEgressSharedBufferUsage() const override;
+
+    /**
+     * @brief Keep occupancy and sojourn time histograms of the egress queues
+     * @param enable true to keep them, false to discard them
+     * @return int 0 if successful
+     */
+    int EnableQueueHistograms(bool enable) override;
+
+    /**
+     * @brief Get the enqueue depth histogram of a priority queue
+     * @param port The egress port
+     * @param priority The priority of the queue
+     * @return the histogram (packets), nullptr if the histograms are disabled
+     */
+    const P4Histogram* GetQueueDepthHistogram(size_t port, size_t priority) const override;
+
+    /**
+     * @brief Set the AQM of a priority queue
+     * @param port The egress port
+     * @param priority The priority of the queue
+     * @param config The AQM configuration
+     * @return int 0 if successful
+     */
+    int SetEgressPriorityQueueAqm(size_t port,
+                                  size_t priority,
+                                  const P4Aqm::Config& config) override;
+
+    /**
+     * @brief Set the AQM of all the queues
+     * @param config The AQM configuration
+     * @return int 0 if successful
+     */
+    int SetAllEgressQueueAqm(const P4Aqm::Config& config) override;
+
+    /**
+     * @brief Get the packets marked and dropped by the AQM of a priority queue
+     * @param port The egress port
+     * @param priority The priority of the queue
+     * @return the counters
+     */
+    P4Aqm::Counters GetEgressQueueAqmCounters(size_t port, size_t priority) const override;
+
+    /**
+     * @brief Pause the upstream devices with PFC when their packets fill the egress buffer
+     * @param xoffBytes The bytes of a port and priority pausing its upstream device
+     * @param xonBytes The bytes of a port and priority resuming its upstream device
+     * @return int 0 if successful
+     */
+    int EnablePfc(uint64_t xoffBytes, uint64_t xonBytes) override;
+
+    /**
+     * @brief Pause or resume the egress queue of a port and packet priority
+     * @param port The egress port
+     * @param priority The packet priority
+     * @param paused true to pause the queue, false to resume it
+     * @return int 0 if successful, -1 if the priority is out of range
+     */
+    int SetEgressQueuePaused(size_t port, size_t priority, bool paused) override;
+
+    /**
+     * @brief Get the sojourn time histogram of a priority queue
+     * @param port The egress port
+     * @param priority The priority of the queue
+     * @return the histogram (nanoseconds), nullptr if the histograms are disabled
+     */
+    const P4Histogram* GetQueueSojournHistogram(size_t port, size_t priority) const override;
 
   protected:
     /**
@@ -215,34 +438,133 @@ class P4CoreV1model : public P4SwitchCore
     };
 
   private:
+    /**
+     * @brief Handles of the metadata fields accessed for every packet
+     */
+    struct PhvFields
+    {
+        FieldHandle ingressPort;            //!< standard_metadata.ingress_port
+        FieldHandle packetLength;           //!< standard_metadata.packet_length
+        FieldHandle instanceType;           //!< standard_metadata.instance_type
+        FieldHandle egressSpec;             //!< standard_metadata.egress_spec
+        FieldHandle egressPort;             //!< standard_metadata.egress_port
+        FieldHandle parserError;            //!< standard_metadata.parser_error
+        FieldHandle checksumError;          //!< standard_metadata.checksum_error
+        FieldHandle ingressGlobalTimestamp; //!< intrinsic_metadata.ingress_global_timestamp
+        FieldHandle egressGlobalTimestamp;  //!< intrinsic_metadata.egress_global_timestamp
+        FieldHandle mcastGrp;               //!< intrinsic_metadata.mcast_grp
+        FieldHandle egressRid;              //!< intrinsic_metadata.egress_rid
+        FieldHandle priority;               //!< intrinsic_metadata.priority
+        FieldHandle enqTimestamp;           //!< queueing_metadata.enq_timestamp
+        FieldHandle enqQdepth;              //!< queueing_metadata.enq_qdepth
+        FieldHandle deqTimedelta;           //!< queueing_metadata.deq_timedelta
+        FieldHandle deqQdepth;              //!< queueing_metadata.deq_qdepth
+        FieldHandle qid;                    //!< queueing_metadata.qid
+    };
+
+    /**
+     * @brief A packet on its way to the ingress pipeline
+     */
+    struct IngressItem
+    {
+        InputBuffer::PacketType type;          //!< Packet type
+        std::unique_ptr<bm::Packet> bm_packet; //!< The packet
+    };
+
+    /**
+     * @brief A packet on its way out of the egress pipeline
+     */
+    struct EgressItem
+    {
+        Ptr<Packet> packet; //!< The deparsed packet
+        size_t port;        //!< Egress port
+        uint16_t protocol;  //!< ns-3 protocol number
+        int addrIndex;      //!< Index of the destination address
+        uint64_t packetId;  //!< ID of the bm packet, for the packet traces
+        size_t priority;    //!< Priority of the queue the packet left
+    };
+
+    /**
+     * @brief A packet going through the ingress pipeline
+     */
+    struct IngressJob
+    {
+        std::unique_ptr<bm::Packet> bm_packet; //!< The packet
+        bm::Packet::buffer_state_t inState;    //!< Buffer state before parsing
+        uint64_t packetSize{0};                //!< Packet length before parsing
+    };
+
+    /**
+     * @brief A packet going through the egress pipeline
+     */
+    struct EgressJob
+    {
+        std::unique_ptr<bm::Packet> bm_packet; //!< The packet
+        size_t port;                           //!< Egress port
+        size_t priority;                       //!< Priority of the queue the packet left
+        bool deparsed;                         //!< Deparsed with the egress pipeline
+    };
+
+    /**
+     * @brief Submit the ingress processing of the next packet of the input
+     * buffer to the parallel pipeline engine
+     */
+    void SubmitIngressJob();
+
+    /**
+     * @brief Run the ingress parser and pipeline on a packet
+     * @details Only touches the bmv2 state of the switch, may run on any thread.
+     * @param job the packet
+     */
+    void RunIngressBlocks(IngressJob* job);
+
+    /**
+     * @brief Carry out the decisions of the ingress pipeline (cloning,
+     * resubmit, multicast, enqueue)
+     * @param job the packet, run through RunIngressBlocks
+     */
+    void FinishIngress(IngressJob&& job);
+
+    /**
+     * @brief Run the egress pipeline, and the deparser when the packet is
+     * neither cloned nor dropped
+     * @details Only touches the bmv2 state of the switch, may run on any thread.
+     * @param job the packet
+     */
+    void RunEgressBlocks(EgressJob* job);
+
+    /**
+     * @brief Carry out the decisions of the egress pipeline (cloning, drop,
+     * recirculation) and send the packet
+     * @param job the packet, run through RunEgressBlocks
+     */
+    void FinishEgress(EgressJob&& job);
+
     uint64_t m_packetId;
     uint64_t m_switchRate;
+    PhvFields m_fields; //!< Field handles of the loaded P4 program
 
-    // enable tracing
-    uint64_t m_inputBps;  // bps
-    uint64_t m_inputBp;   // bp
-    uint64_t m_inputPps;  // pps
-    uint64_t m_inputPp;   // pp
-    uint64_t m_egressBps; // bps
-    uint64_t m_egressBp;  // bp
-    uint64_t m_egressPps; // pps
-    uint64_t m_egressPp;  // pp
-
-    Time m_timeInterval;       // s
-    double m_virtualQueueRate; // pps
+    P4MetricsSink::TrafficCounters m_traffic;     //!< Traffic and drop counters
+    P4MetricsSink::TrafficCounters m_lastTraffic; //!< Counters at the last metrics sample
 
     size_t m_nbQueuesPerPort;
-    EventId m_egressTimeEvent; //!< The timer event ID for dequeue
-    Time m_egressTimeRef;      //!< Desired time between timer event triggers
+    EventId m_egressTimeEvent; //!< The pending dequeue event, if any
+    Time m_egressTimeRef;      //!< Minimum time between two packets of a port (1 / SwitchRate)
     uint64_t m_startTimestamp; //!< Start time of the switch
 
     static constexpr size_t m_nbEgressThreads = 1u; // 4u default in bmv2
 
     std::unique_ptr<InputBuffer> input_buffer;
-    NSQueueingLogicPriRL<std::unique_ptr<bm::Packet>, EgressThreadMapper> egress_buffer;
+    using EgressBuffer = NSQueueingLogicPriRL<std::unique_ptr<bm::Packet>, EgressThreadMapper>;
+    EgressBuffer egress_buffer;
+    std::vector<EgressBuffer::PoppedItem> m_egressBatch; //!< Packets of the current dequeue event
     bm::Queue<std::unique_ptr<bm::Packet>> output_buffer;
-
-    bool m_firstPacket;
+    P4PipelineEngine* m_engine;              //!< Parallel pipeline engine, nullptr if disabled
+    std::deque<IngressJob> m_ingressDone;    //!< Ingress jobs computed, not committed yet
+    std::deque<EgressJob> m_egressPending;   //!< Egress jobs submitted, not computed yet
+    std::deque<EgressJob> m_egressDone;      //!< Egress jobs computed, not committed yet
+    P4StageFifo<IngressItem> m_ingressStage; //!< Parser, ingress control and its tables
+    P4StageFifo<EgressItem> m_egressStage;   //!< Egress control, its tables and deparser
 };
 
 } // namespace ns3
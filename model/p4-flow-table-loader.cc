@@ -0,0 +1,1964 @@
+/*
+ * Copyright (c) 2025 TU Dresden
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Authors: Mingyu Ma <mingyu.ma@tu-dresden.de>
+ */
+
+#include "ns3/log.h"
+#include "ns3/p4-flow-table-loader.h"
+#include "ns3/p4-switch-core.h"
+#include "ns3/switch-api.h"
+
+#include <algorithm>
+#include <arpa/inet.h>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <unordered_map>
+
+NS_LOG_COMPONENT_DEFINE("P4FlowTableLoader");
+
+namespace ns3
+{
+
+namespace
+{
+
+/**
+ * @brief Look up a command of the runtime CLI (simple_switch_CLI /
+ * psa_switch_CLI) accepted in flow table files
+ * @param verb the command name, e.g. "table_add"
+ * @param type set to the runtime API the command is implemented with
+ * @return true if the command is known
+ */
+bool
+GetCliCommandType(const std::string& verb, unsigned int* type)
+{
+    // Only the CLI verbs: the runtime API names (mt_add_entry...) are not
+    // commands of the CLI and are rejected
+    static const std::unordered_map<std::string, unsigned int> cliCommands = {
+        {"table_clear", SwitchApi::MT_CLEAR_ENTRIES},
+        {"table_add", SwitchApi::MT_ADD_ENTRY},
+        {"table_set_default", SwitchApi::MT_SET_DEFAULT_ACTION},
+        {"table_reset_default", SwitchApi::MT_RESET_DEFAULT_ENTRY},
+        {"table_delete", SwitchApi::MT_DELETE_ENTRY},
+        {"table_modify", SwitchApi::MT_MODIFY_ENTRY},
+        {"table_set_timeout", SwitchApi::MT_SET_ENTRY_TTL},
+        {"act_prof_create_member", SwitchApi::MT_ACT_PROF_ADD_MEMBER},
+        {"act_prof_delete_member", SwitchApi::MT_ACT_PROF_DELETE_MEMBER},
+        {"act_prof_modify_member", SwitchApi::MT_ACT_PROF_MODIFY_MEMBER},
+        {"act_prof_create_group", SwitchApi::MT_ACT_PROF_CREATE_GROUP},
+        {"act_prof_delete_group", SwitchApi::MT_ACT_PROF_DELETE_GROUP},
+        {"act_prof_add_member_to_group", SwitchApi::MT_ACT_PROF_ADD_MEMBER_TO_GROUP},
+        {"act_prof_remove_member_from_group", SwitchApi::MT_ACT_PROF_REMOVE_MEMBER_FROM_GROUP},
+        {"table_indirect_add", SwitchApi::MT_INDIRECT_ADD_ENTRY},
+        {"table_indirect_modify", SwitchApi::MT_INDIRECT_MODIFY_ENTRY},
+        {"table_indirect_delete", SwitchApi::MT_INDIRECT_DELETE_ENTRY},
+        {"table_indirect_set_default", SwitchApi::MT_INDIRECT_SET_DEFAULT_MEMBER},
+        {"table_indirect_reset_default", SwitchApi::MT_INDIRECT_RESET_DEFAULT_ENTRY},
+        {"table_indirect_add_with_group", SwitchApi::MT_INDIRECT_WS_ADD_ENTRY},
+        {"table_indirect_modify_with_group", SwitchApi::MT_INDIRECT_WS_MODIFY_ENTRY},
+        {"table_indirect_set_default_with_group", SwitchApi::MT_INDIRECT_WS_SET_DEFAULT_GROUP},
+        {"counter_reset", SwitchApi::RESET_COUNTERS},
+        {"counter_write", SwitchApi::WRITE_COUNTERS},
+        {"meter_array_set_rates", SwitchApi::METER_ARRAY_SET_RATES},
+        {"meter_set_rates", SwitchApi::METER_SET_RATES},
+        {"register_write", SwitchApi::REGISTER_WRITE},
+        {"register_reset", SwitchApi::REGISTER_RESET},
+        {"mirroring_add", SwitchApi::MIRRORING_ADD},
+        {"mirroring_add_mc", SwitchApi::MIRRORING_ADD_MC},
+        {"mirroring_delete", SwitchApi::MIRRORING_DELETE},
+        {"mc_mgrp_create", SwitchApi::MC_MGRP_CREATE},
+        {"mc_mgrp_destroy", SwitchApi::MC_MGRP_DESTROY},
+        {"mc_node_create", SwitchApi::MC_NODE_CREATE},
+        {"mc_node_update", SwitchApi::MC_NODE_UPDATE},
+        {"mc_node_associate", SwitchApi::MC_NODE_ASSOCIATE},
+        {"mc_node_dissociate", SwitchApi::MC_NODE_DISSOCIATE},
+        {"mc_node_destroy", SwitchApi::MC_NODE_DESTROY},
+        {"mc_set_lag_membership", SwitchApi::MC_SET_LAG_MEMBERSHIP},
+        {"set_queue_depth", SwitchApi::SET_QUEUE_DEPTH},
+        {"set_queue_rate", SwitchApi::SET_QUEUE_RATE},
+        {"reset_state", SwitchApi::RESET_STATE},
+    };
+    auto it = cliCommands.find(verb);
+    if (it == cliCommands.end())
+    {
+        return false;
+    }
+    *type = it->second;
+    return true;
+}
+
+/**
+ * @brief Parse a MAC address "aa:bb:cc:dd:ee:ff"
+ */
+bool
+ParseMac(const std::string& text, std::string* bytes)
+{
+    unsigned int b[6];
+    char tail;
+    if (std::sscanf(text.c_str(),
+                    "%2x:%2x:%2x:%2x:%2x:%2x%c",
+                    &b[0],
+                    &b[1],
+                    &b[2],
+                    &b[3],
+                    &b[4],
+                    &b[5],
+                    &tail) != 6)
+    {
+        return false;
+    }
+    bytes->clear();
+    for (unsigned int i = 0; i < 6; i++)
+    {
+        bytes->push_back(static_cast<char>(b[i]));
+    }
+    return true;
+}
+
+/**
+ * @brief Parse an unsigned integer argument (handles, indices, ports...)
+ */
+bool
+ParseUint(const std::string& text, uint64_t* value)
+{
+    if (text.empty() || text[0] == '-')
+    {
+        return false;
+    }
+    try
+    {
+        size_t pos = 0;
+        *value = std::stoull(text, &pos, 0);
+        return pos == text.size();
+    }
+    catch (const std::exception&)
+    {
+        return false;
+    }
+}
+
+/**
+ * @brief Parse a meter rate "<rate>:<burst>", rate in units per microsecond
+ */
+bool
+ParseMeterRate(const std::string& text, bm::Meter::rate_config_t* rate)
+{
+    size_t colon = text.find(':');
+    if (colon == std::string::npos)
+    {
+        return false;
+    }
+    uint64_t burst;
+    try
+    {
+        size_t pos = 0;
+        std::string rateText = text.substr(0, colon);
+        rate->info_rate = std::stod(rateText, &pos);
+        if (pos != rateText.size() || !ParseUint(text.substr(colon + 1), &burst))
+        {
+            return false;
+        }
+    }
+    catch (const std::exception&)
+    {
+        return false;
+    }
+    rate->burst_size = burst;
+    return true;
+}
+
+/**
+ * @brief Check the number of arguments of a command
+ */
+bool
+CheckArgs(const std::vector<std::string>& args,
+          size_t min,
+          size_t max,
+          const char* usage,
+          std::string* error)
+{
+    if (args.size() < min || args.size() > max)
+    {
+        *error = std::string("wrong number of arguments, usage: ") + usage;
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Parse a list of port (or LAG) indices into a bitmap
+ */
+template <typename Map>
+bool
+ParsePortList(std::vector<std::string>::const_iterator begin,
+              std::vector<std::string>::const_iterator end,
+              Map* map,
+              std::string* error)
+{
+    for (auto it = begin; it != end; ++it)
+    {
+        uint64_t index;
+        if (!ParseUint(*it, &index) || index >= map->size())
+        {
+            *error = "invalid port or LAG index '" + *it + "'";
+            return false;
+        }
+        map->set(index);
+    }
+    return true;
+}
+
+std::string
+MatchError(const char* api, bm::MatchErrorCode rc)
+{
+    return std::string(api) + " failed with error code " + std::to_string(static_cast<int>(rc));
+}
+
+} // namespace
+
+bool
+P4FlowTableLoader::ParseInteger(const std::string& text, unsigned int bitwidth, std::string* bytes)
+{
+    unsigned int base = 10;
+    size_t pos = 0;
+    if (text.size() > 2 && text[0] == '0')
+    {
+        char prefix = std::tolower(text[1]);
+        if (prefix == 'x')
+        {
+            base = 16;
+        }
+        else if (prefix == 'o')
+        {
+            base = 8;
+        }
+        else if (prefix == 'b')
+        {
+            base = 2;
+        }
+        pos = (base == 10) ? 0 : 2;
+    }
+    if (pos >= text.size())
+    {
+        return false;
+    }
+
+    size_t nbytes = (bitwidth + 7) / 8;
+    // One spare byte to detect values that do not fit in the field
+    std::vector<uint8_t> value(nbytes + 1, 0);
+    for (; pos < text.size(); pos++)
+    {
+        char c = std::tolower(text[pos]);
+        if (c == '_')
+        {
+            continue;
+        }
+        unsigned int digit;
+        if (c >= '0' && c <= '9')
+        {
+            digit = c - '0';
+        }
+        else if (c >= 'a' && c <= 'f')
+        {
+            digit = c - 'a' + 10;
+        }
+        else
+        {
+            return false;
+        }
+        if (digit >= base)
+        {
+            return false;
+        }
+
+        unsigned int carry = digit;
+        for (auto it = value.rbegin(); it != value.rend(); ++it)
+        {
+            unsigned int v = (*it) * base + carry;
+            *it = v & 0xff;
+            carry = v >> 8;
+        }
+        if (carry != 0 || value[0] != 0)
+        {
+            return false;
+        }
+    }
+
+    // Check the bits above the field width in the most significant byte
+    unsigned int extraBits = nbytes * 8 - bitwidth;
+    if (extraBits > 0 && (value[1] >> (8 - extraBits)) != 0)
+    {
+        return false;
+    }
+    bytes->assign(value.begin() + 1, value.end());
+    return true;
+}
+
+bool
+P4FlowTableLoader::EncodeValue(const std::string& text,
+                               unsigned int bitwidth,
+                               std::string* bytes,
+                               std::string* error)
+{
+    if (bitwidth == 32 && text.find('.') != std::string::npos)
+    {
+        uint8_t addr[4];
+        if (inet_pton(AF_INET, text.c_str(), addr) == 1)
+        {
+            bytes->assign(reinterpret_cast<char*>(addr), sizeof(addr));
+            return true;
+        }
+    }
+    else if (bitwidth == 48 && text.find(':') != std::string::npos)
+    {
+        if (ParseMac(text, bytes))
+        {
+            return true;
+        }
+    }
+    else if (bitwidth == 128 && text.find(':') != std::string::npos)
+    {
+        uint8_t addr[16];
+        if (inet_pton(AF_INET6, text.c_str(), addr) == 1)
+        {
+            bytes->assign(reinterpret_cast<char*>(addr), sizeof(addr));
+            return true;
+        }
+    }
+
+    if (!ParseInteger(text, bitwidth, bytes))
+    {
+        *error = "invalid value '" + text + "' for a " + std::to_string(bitwidth) + "-bit field";
+        return false;
+    }
+    return true;
+}
+
+P4FlowTableLoader::P4FlowTableLoader(P4SwitchCore* core, const P4ProgramInfo& programInfo)
+    : m_core(core),
+      m_programInfo(programInfo),
+      m_numCommands(0),
+      m_numErrors(0)
+{
+}
+
+uint32_t
+P4FlowTableLoader::GetNumCommands() const
+{
+    return m_numCommands;
+}
+
+uint32_t
+P4FlowTableLoader::GetNumErrors() const
+{
+    return m_numErrors;
+}
+
+const std::vector<std::string>&
+P4FlowTableLoader::GetErrors() const
+{
+    return m_errors;
+}
+
+int
+P4FlowTableLoader::LoadFromFile(const std::string& flowTablePath, const std::string& verbPrefix)
+{
+    NS_LOG_FUNCTION(this << flowTablePath << verbPrefix);
+
+    std::ifstream infile(flowTablePath);
+    if (!infile.good())
+    {
+        m_errors.push_back(flowTablePath + ": flow table file not found");
+        NS_LOG_ERROR(m_errors.back());
+        m_numErrors++;
+        return 1;
+    }
+
+    uint32_t errorsBefore = m_numErrors;
+    std::string line;
+    unsigned int lineNumber = 0;
+    while (std::getline(infile, line))
+    {
+        lineNumber++;
+        size_t start = line.find_first_not_of(" \t");
+        if (!verbPrefix.empty() &&
+            (start == std::string::npos || line.compare(start, verbPrefix.size(), verbPrefix) != 0))
+        {
+            continue;
+        }
+        std::string error;
+        if (!ExecuteCommand(line, &error))
+        {
+            m_errors.push_back(flowTablePath + ":" + std::to_string(lineNumber) + ": " + error);
+            NS_LOG_ERROR(m_errors.back());
+        }
+    }
+
+    NS_LOG_INFO("Applied " << m_numCommands << " commands from " << flowTablePath << ", "
+                           << (m_numErrors - errorsBefore) << " failed");
+    return (m_numErrors == errorsBefore) ? 0 : 1;
+}
+
+bool
+P4FlowTableLoader::ExecuteCommand(const std::string& line, std::string* error)
+{
+    std::istringstream iss(line);
+    std::string verb;
+    if (!(iss >> verb) || verb[0] == '#')
+    {
+        return true; // empty line or comment
+    }
+
+    Args args;
+    std::string token;
+    while (iss >> token)
+    {
+        args.push_back(token);
+    }
+
+    unsigned int type;
+    if (!GetCliCommandType(verb, &type))
+    {
+        *error = "unknown command '" + verb + "'";
+        m_numErrors++;
+        return false;
+    }
+
+    bool ok;
+    switch (type)
+    {
+    case SwitchApi::MT_ADD_ENTRY:
+        ok = TableAdd(args, error);
+        break;
+    case SwitchApi::MT_SET_DEFAULT_ACTION:
+        ok = TableSetDefault(args, error);
+        break;
+    case SwitchApi::MT_RESET_DEFAULT_ENTRY:
+        ok = TableResetDefault(args, error);
+        break;
+    case SwitchApi::MT_DELETE_ENTRY:
+        ok = TableDelete(args, error);
+        break;
+    case SwitchApi::MT_MODIFY_ENTRY:
+        ok = TableModify(args, error);
+        break;
+    case SwitchApi::MT_CLEAR_ENTRIES:
+        ok = TableClear(args, error);
+        break;
+    case SwitchApi::MT_SET_ENTRY_TTL:
+        ok = TableSetTimeout(args, error);
+        break;
+    case SwitchApi::MT_ACT_PROF_ADD_MEMBER:
+        ok = ActProfCreateMember(args, error);
+        break;
+    case SwitchApi::MT_ACT_PROF_DELETE_MEMBER:
+        ok = ActProfDeleteMember(args, error);
+        break;
+    case SwitchApi::MT_ACT_PROF_MODIFY_MEMBER:
+        ok = ActProfModifyMember(args, error);
+        break;
+    case SwitchApi::MT_ACT_PROF_CREATE_GROUP:
+        ok = ActProfCreateGroup(args, error);
+        break;
+    case SwitchApi::MT_ACT_PROF_DELETE_GROUP:
+        ok = ActProfDeleteGroup(args, error);
+        break;
+    case SwitchApi::MT_ACT_PROF_ADD_MEMBER_TO_GROUP:
+        ok = ActProfAddMemberToGroup(args, error);
+        break;
+    case SwitchApi::MT_ACT_PROF_REMOVE_MEMBER_FROM_GROUP:
+        ok = ActProfRemoveMemberFromGroup(args, error);
+        break;
+    case SwitchApi::MT_INDIRECT_ADD_ENTRY:
+        ok = TableIndirectAdd(args, false, error);
+        break;
+    case SwitchApi::MT_INDIRECT_WS_ADD_ENTRY:
+        ok = TableIndirectAdd(args, true, error);
+        break;
+    case SwitchApi::MT_INDIRECT_MODIFY_ENTRY:
+        ok = TableIndirectModify(args, false, error);
+        break;
+    case SwitchApi::MT_INDIRECT_WS_MODIFY_ENTRY:
+        ok = TableIndirectModify(args, true, error);
+        break;
+    case SwitchApi::MT_INDIRECT_DELETE_ENTRY:
+        ok = TableIndirectDelete(args, error);
+        break;
+    case SwitchApi::MT_INDIRECT_SET_DEFAULT_MEMBER:
+        ok = TableIndirectSetDefault(args, false, error);
+        break;
+    case SwitchApi::MT_INDIRECT_WS_SET_DEFAULT_GROUP:
+        ok = TableIndirectSetDefault(args, true, error);
+        break;
+    case SwitchApi::MT_INDIRECT_RESET_DEFAULT_ENTRY:
+        ok = TableIndirectResetDefault(args, error);
+        break;
+    case SwitchApi::RESET_COUNTERS:
+        ok = CounterReset(args, error);
+        break;
+    case SwitchApi::WRITE_COUNTERS:
+        ok = CounterWrite(args, error);
+        break;
+    case SwitchApi::METER_ARRAY_SET_RATES:
+        ok = MeterArraySetRates(args, error);
+        break;
+    case SwitchApi::METER_SET_RATES:
+        ok = MeterSetRates(args, error);
+        break;
+    case SwitchApi::REGISTER_WRITE:
+        ok = RegisterWrite(args, error);
+        break;
+    case SwitchApi::REGISTER_RESET:
+        ok = RegisterReset(args, error);
+        break;
+    case SwitchApi::MIRRORING_ADD:
+        ok = MirroringAdd(args, false, error);
+        break;
+    case SwitchApi::MIRRORING_ADD_MC:
+        ok = MirroringAdd(args, true, error);
+        break;
+    case SwitchApi::MIRRORING_DELETE:
+        ok = MirroringDelete(args, error);
+        break;
+    case SwitchApi::MC_MGRP_CREATE:
+        ok = McMgrpCreate(args, error);
+        break;
+    case SwitchApi::MC_MGRP_DESTROY:
+        ok = McMgrpDestroy(args, error);
+        break;
+    case SwitchApi::MC_NODE_CREATE:
+        ok = McNodeCreate(args, error);
+        break;
+    case SwitchApi::MC_NODE_UPDATE:
+        ok = McNodeUpdate(args, error);
+        break;
+    case SwitchApi::MC_NODE_ASSOCIATE:
+        ok = McNodeAssociate(args, true, error);
+        break;
+    case SwitchApi::MC_NODE_DISSOCIATE:
+        ok = McNodeAssociate(args, false, error);
+        break;
+    case SwitchApi::MC_NODE_DESTROY:
+        ok = McNodeDestroy(args, error);
+        break;
+    case SwitchApi::MC_SET_LAG_MEMBERSHIP:
+        ok = McSetLagMembership(args, error);
+        break;
+    case SwitchApi::SET_QUEUE_DEPTH:
+        ok = SetQueueDepth(args, error);
+        break;
+    case SwitchApi::SET_QUEUE_RATE:
+        ok = SetQueueRate(args, error);
+        break;
+    case SwitchApi::RESET_STATE:
+        ok = ResetState(args, error);
+        break;
+    default:
+        *error = "command '" + verb + "' is not supported in flow table files";
+        ok = false;
+        break;
+    }
+
+    if (ok)
+    {
+        m_numCommands++;
+    }
+    else
+    {
+        *error = verb + ": " + *error;
+        m_numErrors++;
+    }
+    return ok;
+}
+
+const P4ProgramInfo::TableInfo*
+P4FlowTableLoader::GetTable(const std::string& name, std::string* error) const
+{
+    const P4ProgramInfo::TableInfo* table = m_programInfo.FindTable(name);
+    if (!table)
+    {
+        *error = "unknown or ambiguous table '" + name + "'";
+    }
+    return table;
+}
+
+std::string
+P4FlowTableLoader::GetActionProfile(const std::string& name, std::string* error) const
+{
+    // The runtime CLI also accepts the name of an indirect table
+    const P4ProgramInfo::ActionProfileInfo* actProf = m_programInfo.FindActionProfile(name);
+    if (actProf)
+    {
+        return actProf->name;
+    }
+    const P4ProgramInfo::TableInfo* table = m_programInfo.FindTable(name);
+    if (table && !table->actionProfile.empty())
+    {
+        return table->actionProfile;
+    }
+    *error = "unknown or ambiguous action profile '" + name + "'";
+    return "";
+}
+
+bool
+P4FlowTableLoader::ParseMatchKey(const P4ProgramInfo::TableInfo& table,
+                                 const std::vector<std::string>& fields,
+                                 std::vector<bm::MatchKeyParam>* matchKey,
+                                 std::string* error)
+{
+    if (fields.size() != table.key.size())
+    {
+        *error = "table " + table.name + " expects " + std::to_string(table.key.size()) +
+                 " match fields, got " + std::to_string(fields.size());
+        return false;
+    }
+
+    for (size_t i = 0; i < fields.size(); i++)
+    {
+        const P4ProgramInfo::KeyField& keyField = table.key[i];
+        const std::string& field = fields[i];
+        std::string key;
+        std::string mask;
+
+        switch (keyField.matchType)
+        {
+        case P4ProgramInfo::MatchType::EXACT: {
+            if (!EncodeValue(field, keyField.bitwidth, &key, error))
+            {
+                return false;
+            }
+            matchKey->emplace_back(bm::MatchKeyParam::Type::EXACT, key);
+            break;
+        }
+        case P4ProgramInfo::MatchType::LPM: {
+            size_t slash = field.find('/');
+            uint64_t prefixLen;
+            if (slash == std::string::npos || !ParseUint(field.substr(slash + 1), &prefixLen) ||
+                prefixLen > keyField.bitwidth)
+            {
+                *error = "invalid LPM match '" + field + "' for " + keyField.name;
+                return false;
+            }
+            if (!EncodeValue(field.substr(0, slash), keyField.bitwidth, &key, error))
+            {
+                return false;
+            }
+            matchKey->emplace_back(bm::MatchKeyParam::Type::LPM,
+                                   key,
+                                   static_cast<int>(prefixLen));
+            break;
+        }
+        case P4ProgramInfo::MatchType::TERNARY: {
+            size_t sep = field.find("&&&");
+            if (sep == std::string::npos)
+            {
+                *error = "invalid ternary match '" + field + "' for " + keyField.name;
+                return false;
+            }
+            if (!EncodeValue(field.substr(0, sep), keyField.bitwidth, &key, error) ||
+                !EncodeValue(field.substr(sep + 3), keyField.bitwidth, &mask, error))
+            {
+                return false;
+            }
+            matchKey->emplace_back(bm::MatchKeyParam::Type::TERNARY, key, mask);
+            break;
+        }
+        case P4ProgramInfo::MatchType::RANGE: {
+            size_t sep = field.find("->");
+            if (sep == std::string::npos)
+            {
+                *error = "invalid range match '" + field + "' for " + keyField.name;
+                return false;
+            }
+            // For range matches, the "mask" carries the end of the range
+            if (!EncodeValue(field.substr(0, sep), keyField.bitwidth, &key, error) ||
+                !EncodeValue(field.substr(sep + 2), keyField.bitwidth, &mask, error))
+            {
+                return false;
+            }
+            matchKey->emplace_back(bm::MatchKeyParam::Type::RANGE, key, mask);
+            break;
+        }
+        case P4ProgramInfo::MatchType::VALID: {
+            if (field != "0" && field != "1" && field != "true" && field != "false")
+            {
+                *error = "invalid valid match '" + field + "' for " + keyField.name;
+                return false;
+            }
+            bool valid = (field == "1" || field == "true");
+            matchKey->emplace_back(bm::MatchKeyParam::Type::VALID, std::string(1, valid ? 1 : 0));
+            break;
+        }
+        case P4ProgramInfo::MatchType::OPTIONAL: {
+            // bmv2 implements optional matches as ternary matches with an
+            // all-zeros (wildcard) or all-ones mask
+            size_t nbytes = (keyField.bitwidth + 7) / 8;
+            if (field == "*")
+            {
+                key.assign(nbytes, '\0');
+                mask.assign(nbytes, '\0');
+            }
+            else
+            {
+                if (!EncodeValue(field, keyField.bitwidth, &key, error))
+                {
+                    return false;
+                }
+                mask.assign(nbytes, static_cast<char>(0xff));
+                if (keyField.bitwidth % 8 != 0)
+                {
+                    mask[0] = static_cast<char>(0xff >> (8 - keyField.bitwidth % 8));
+                }
+            }
+            matchKey->emplace_back(bm::MatchKeyParam::Type::TERNARY, key, mask);
+            break;
+        }
+        }
+    }
+    return true;
+}
+
+bool
+P4FlowTableLoader::ParseActionData(const P4ProgramInfo::ActionInfo& action,
+                                   const std::vector<std::string>& params,
+                                   bm::ActionData* actionData,
+                                   std::string* error) const
+{
+    if (params.size() != action.paramWidths.size())
+    {
+        *error = "action " + action.name + " expects " +
+                 std::to_string(action.paramWidths.size()) + " parameters, got " +
+                 std::to_string(params.size());
+        return false;
+    }
+    for (size_t i = 0; i < params.size(); i++)
+    {
+        std::string bytes;
+        if (!EncodeValue(params[i], action.paramWidths[i], &bytes, error))
+        {
+            *error = "parameter " + action.paramNames[i] + ": " + *error;
+            return false;
+        }
+        actionData->push_back_action_data(bytes.data(), bytes.size());
+    }
+    return true;
+}
+
+bool
+P4FlowTableLoader::TableAdd(const Args& args, std::string* error)
+{
+    // table_add <table> <action> <match fields> => <action parameters> [priority]
+    auto sep = std::find(args.begin(), args.end(), "=>");
+    if (args.size() < 2 || sep == args.end() || sep < args.begin() + 2)
+    {
+        *error = "usage: table_add <table> <action> <match fields> => <parameters> [priority]";
+        return false;
+    }
+    const P4ProgramInfo::TableInfo* table = GetTable(args[0], error);
+    if (!table)
+    {
+        return false;
+    }
+    const P4ProgramInfo::ActionInfo* action = m_programInfo.FindTableAction(*table, args[1]);
+    if (!action)
+    {
+        *error = "unknown action '" + args[1] + "' for table " + table->name;
+        return false;
+    }
+
+    std::vector<std::string> fields(args.begin() + 2, sep);
+    std::vector<std::string> params(sep + 1, args.end());
+    int priority = -1;
+    if (table->NeedsPriority())
+    {
+        uint64_t value;
+        if (params.empty() || !ParseUint(params.back(), &value))
+        {
+            *error = "table " + table->name + " requires a priority after the action parameters";
+            return false;
+        }
+        priority = static_cast<int>(value);
+        params.pop_back();
+    }
+
+    std::vector<bm::MatchKeyParam> matchKey;
+    bm::ActionData actionData;
+    if (!ParseMatchKey(*table, fields, &matchKey, error) ||
+        !ParseActionData(*action, params, &actionData, error))
+    {
+        return false;
+    }
+
+    bm::entry_handle_t handle;
+    bm::MatchErrorCode rc = m_core->mt_add_entry(0,
+                                                 table->name,
+                                                 matchKey,
+                                                 action->name,
+                                                 std::move(actionData),
+                                                 &handle,
+                                                 priority);
+    if (rc != bm::MatchErrorCode::SUCCESS)
+    {
+        *error = MatchError("mt_add_entry", rc);
+        return false;
+    }
+    NS_LOG_DEBUG("Entry added to " << table->name << " with handle " << handle);
+    return true;
+}
+
+bool
+P4FlowTableLoader::TableSetDefault(const Args& args, std::string* error)
+{
+    // table_set_default <table> <action> <action parameters>
+    if (!CheckArgs(args, 2, SIZE_MAX, "table_set_default <table> <action> <parameters>", error))
+    {
+        return false;
+    }
+    const P4ProgramInfo::TableInfo* table = GetTable(args[0], error);
+    if (!table)
+    {
+        return false;
+    }
+    const P4ProgramInfo::ActionInfo* action = m_programInfo.FindTableAction(*table, args[1]);
+    if (!action)
+    {
+        *error = "unknown action '" + args[1] + "' for table " + table->name;
+        return false;
+    }
+    bm::ActionData actionData;
+    if (!ParseActionData(*action,
+                         std::vector<std::string>(args.begin() + 2, args.end()),
+                         &actionData,
+                         error))
+    {
+        return false;
+    }
+
+    bm::MatchErrorCode rc =
+        m_core->mt_set_default_action(0, table->name, action->name, std::move(actionData));
+    if (rc != bm::MatchErrorCode::SUCCESS)
+    {
+        *error = MatchError("mt_set_default_action", rc);
+        return false;
+    }
+    return true;
+}
+
+bool
+P4FlowTableLoader::TableResetDefault(const Args& args, std::string* error)
+{
+    // table_reset_default <table>
+    if (!CheckArgs(args, 1, 1, "table_reset_default <table>", error))
+    {
+        return false;
+    }
+    const P4ProgramInfo::TableInfo* table = GetTable(args[0], error);
+    if (!table)
+    {
+        return false;
+    }
+    bm::MatchErrorCode rc = m_core->mt_reset_default_entry(0, table->name);
+    if (rc != bm::MatchErrorCode::SUCCESS)
+    {
+        *error = MatchError("mt_reset_default_entry", rc);
+        return false;
+    }
+    return true;
+}
+
+bool
+P4FlowTableLoader::TableDelete(const Args& args, std::string* error)
+{
+    // table_delete <table> <entry handle>
+    uint64_t handle;
+    if (!CheckArgs(args, 2, 2, "table_delete <table> <entry handle>", error))
+    {
+        return false;
+    }
+    const P4ProgramInfo::TableInfo* table = GetTable(args[0], error);
+    if (!table)
+    {
+        return false;
+    }
+    if (!ParseUint(args[1], &handle))
+    {
+        *error = "invalid entry handle '" + args[1] + "'";
+        return false;
+    }
+    bm::MatchErrorCode rc = m_core->mt_delete_entry(0, table->name, handle);
+    if (rc != bm::MatchErrorCode::SUCCESS)
+    {
+        *error = MatchError("mt_delete_entry", rc);
+        return false;
+    }
+    return true;
+}
+
+bool
+P4FlowTableLoader::TableModify(const Args& args, std::string* error)
+{
+    // table_modify <table> <action> <entry handle> <action parameters>
+    uint64_t handle;
+    if (!CheckArgs(args,
+                   3,
+                   SIZE_MAX,
+                   "table_modify <table> <action> <entry handle> <parameters>",
+                   error))
+    {
+        return false;
+    }
+    const P4ProgramInfo::TableInfo* table = GetTable(args[0], error);
+    if (!table)
+    {
+        return false;
+    }
+    const P4ProgramInfo::ActionInfo* action = m_programInfo.FindTableAction(*table, args[1]);
+    if (!action)
+    {
+        *error = "unknown action '" + args[1] + "' for table " + table->name;
+        return false;
+    }
+    if (!ParseUint(args[2], &handle))
+    {
+        *error = "invalid entry handle '" + args[2] + "'";
+        return false;
+    }
+    bm::ActionData actionData;
+    if (!ParseActionData(*action,
+                         std::vector<std::string>(args.begin() + 3, args.end()),
+                         &actionData,
+                         error))
+    {
+        return false;
+    }
+    bm::MatchErrorCode rc =
+        m_core->mt_modify_entry(0, table->name, handle, action->name, std::move(actionData));
+    if (rc != bm::MatchErrorCode::SUCCESS)
+    {
+        *error = MatchError("mt_modify_entry", rc);
+        return false;
+    }
+    return true;
+}
+
+bool
+P4FlowTableLoader::TableClear(const Args& args, std::string* error)
+{
+    // table_clear <table>
+    if (!CheckArgs(args, 1, 1, "table_clear <table>", error))
+    {
+        return false;
+    }
+    const P4ProgramInfo::TableInfo* table = GetTable(args[0], error);
+    if (!table)
+    {
+        return false;
+    }
+    bm::MatchErrorCode rc = m_core->mt_clear_entries(0, table->name, false);
+    if (rc != bm::MatchErrorCode::SUCCESS)
+    {
+        *error = MatchError("mt_clear_entries", rc);
+        return false;
+    }
+    return true;
+}
+
+bool
+P4FlowTableLoader::TableSetTimeout(const Args& args, std::string* error)
+{
+    // table_set_timeout <table> <entry handle> <timeout ms>
+    uint64_t handle;
+    uint64_t timeoutMs;
+    if (!CheckArgs(args, 3, 3, "table_set_timeout <table> <entry handle> <timeout ms>", error))
+    {
+        return false;
+    }
+    const P4ProgramInfo::TableInfo* table = GetTable(args[0], error);
+    if (!table)
+    {
+        return false;
+    }
+    if (!ParseUint(args[1], &handle) || !ParseUint(args[2], &timeoutMs))
+    {
+        *error = "invalid entry handle or timeout";
+        return false;
+    }
+    bm::MatchErrorCode rc = m_core->mt_set_entry_ttl(0, table->name, handle, timeoutMs);
+    if (rc != bm::MatchErrorCode::SUCCESS)
+    {
+        *error = MatchError("mt_set_entry_ttl", rc);
+        return false;
+    }
+    return true;
+}
+
+bool
+P4FlowTableLoader::ActProfCreateMember(const Args& args, std::string* error)
+{
+    // act_prof_create_member <action profile> <action> <action parameters>
+    if (!CheckArgs(args,
+                   2,
+                   SIZE_MAX,
+                   "act_prof_create_member <action profile> <action> <parameters>",
+                   error))
+    {
+        return false;
+    }
+    std::string actProf = GetActionProfile(args[0], error);
+    if (actProf.empty())
+    {
+        return false;
+    }
+    const P4ProgramInfo::ActionInfo* action = m_programInfo.FindAction(args[1]);
+    if (!action)
+    {
+        *error = "unknown or ambiguous action '" + args[1] + "'";
+        return false;
+    }
+    bm::ActionData actionData;
+    if (!ParseActionData(*action,
+                         std::vector<std::string>(args.begin() + 2, args.end()),
+                         &actionData,
+                         error))
+    {
+        return false;
+    }
+    bm::RuntimeInterface::mbr_hdl_t member;
+    bm::MatchErrorCode rc =
+        m_core->mt_act_prof_add_member(0, actProf, action->name, std::move(actionData), &member);
+    if (rc != bm::MatchErrorCode::SUCCESS)
+    {
+        *error = MatchError("mt_act_prof_add_member", rc);
+        return false;
+    }
+    NS_LOG_DEBUG("Member added to " << actProf << " with handle " << member);
+    return true;
+}
+
+bool
+P4FlowTableLoader::ActProfDeleteMember(const Args& args, std::string* error)
+{
+    // act_prof_delete_member <action profile> <member handle>
+    uint64_t member;
+    if (!CheckArgs(args, 2, 2, "act_prof_delete_member <action profile> <member handle>", error))
+    {
+        return false;
+    }
+    std::string actProf = GetActionProfile(args[0], error);
+    if (actProf.empty())
+    {
+        return false;
+    }
+    if (!ParseUint(args[1], &member))
+    {
+        *error = "invalid member handle '" + args[1] + "'";
+        return false;
+    }
+    bm::MatchErrorCode rc = m_core->mt_act_prof_delete_member(0, actProf, member);
+    if (rc != bm::MatchErrorCode::SUCCESS)
+    {
+        *error = MatchError("mt_act_prof_delete_member", rc);
+        return false;
+    }
+    return true;
+}
+
+bool
+P4FlowTableLoader::ActProfModifyMember(const Args& args, std::string* error)
+{
+    // act_prof_modify_member <action profile> <action> <member handle> <action parameters>
+    uint64_t member;
+    if (!CheckArgs(args,
+                   3,
+                   SIZE_MAX,
+                   "act_prof_modify_member <action profile> <action> <member handle> <parameters>",
+                   error))
+    {
+        return false;
+    }
+    std::string actProf = GetActionProfile(args[0], error);
+    if (actProf.empty())
+    {
+        return false;
+    }
+    const P4ProgramInfo::ActionInfo* action = m_programInfo.FindAction(args[1]);
+    if (!action)
+    {
+        *error = "unknown or ambiguous action '" + args[1] + "'";
+        return false;
+    }
+    if (!ParseUint(args[2], &member))
+    {
+        *error = "invalid member handle '" + args[2] + "'";
+        return false;
+    }
+    bm::ActionData actionData;
+    if (!ParseActionData(*action,
+                         std::vector<std::string>(args.begin() + 3, args.end()),
+                         &actionData,
+                         error))
+    {
+        return false;
+    }
+    bm::MatchErrorCode rc = m_core->mt_act_prof_modify_member(0,
+                                                              actProf,
+                                                              member,
+                                                              action->name,
+                                                              std::move(actionData));
+    if (rc != bm::MatchErrorCode::SUCCESS)
+    {
+        *error = MatchError("mt_act_prof_modify_member", rc);
+        return false;
+    }
+    return true;
+}
+
+bool
+P4FlowTableLoader::ActProfCreateGroup(const Args& args, std::string* error)
+{
+    // act_prof_create_group <action profile>
+    if (!CheckArgs(args, 1, 1, "act_prof_create_group <action profile>", error))
+    {
+        return false;
+    }
+    std::string actProf = GetActionProfile(args[0], error);
+    if (actProf.empty())
+    {
+        return false;
+    }
+    bm::RuntimeInterface::grp_hdl_t group;
+    bm::MatchErrorCode rc = m_core->mt_act_prof_create_group(0, actProf, &group);
+    if (rc != bm::MatchErrorCode::SUCCESS)
+    {
+        *error = MatchError("mt_act_prof_create_group", rc);
+        return false;
+    }
+    NS_LOG_DEBUG("Group created in " << actProf << " with handle " << group);
+    return true;
+}
+
+bool
+P4FlowTableLoader::ActProfDeleteGroup(const Args& args, std::string* error)
+{
+    // act_prof_delete_group <action profile> <group handle>
+    uint64_t group;
+    if (!CheckArgs(args, 2, 2, "act_prof_delete_group <action profile> <group handle>", error))
+    {
+        return false;
+    }
+    std::string actProf = GetActionProfile(args[0], error);
+    if (actProf.empty())
+    {
+        return false;
+    }
+    if (!ParseUint(args[1], &group))
+    {
+        *error = "invalid group handle '" + args[1] + "'";
+        return false;
+    }
+    bm::MatchErrorCode rc = m_core->mt_act_prof_delete_group(0, actProf, group);
+    if (rc != bm::MatchErrorCode::SUCCESS)
+    {
+        *error = MatchError("mt_act_prof_delete_group", rc);
+        return false;
+    }
+    return true;
+}
+
+bool
+P4FlowTableLoader::ActProfAddMemberToGroup(const Args& args, std::string* error)
+{
+    // act_prof_add_member_to_group <action profile> <member handle> <group handle>
+    uint64_t member;
+    uint64_t group;
+    if (!CheckArgs(args,
+                   3,
+                   3,
+                   "act_prof_add_member_to_group <action profile> <member handle> <group handle>",
+                   error))
+    {
+        return false;
+    }
+    std::string actProf = GetActionProfile(args[0], error);
+    if (actProf.empty())
+    {
+        return false;
+    }
+    if (!ParseUint(args[1], &member) || !ParseUint(args[2], &group))
+    {
+        *error = "invalid member or group handle";
+        return false;
+    }
+    bm::MatchErrorCode rc = m_core->mt_act_prof_add_member_to_group(0, actProf, member, group);
+    if (rc != bm::MatchErrorCode::SUCCESS)
+    {
+        *error = MatchError("mt_act_prof_add_member_to_group", rc);
+        return false;
+    }
+    return true;
+}
+
+bool
+P4FlowTableLoader::ActProfRemoveMemberFromGroup(const Args& args, std::string* error)
+{
+    // act_prof_remove_member_from_group <action profile> <member handle> <group handle>
+    uint64_t member;
+    uint64_t group;
+    if (!CheckArgs(
+            args,
+            3,
+            3,
+            "act_prof_remove_member_from_group <action profile> <member handle> <group handle>",
+            error))
+    {
+        return false;
+    }
+    std::string actProf = GetActionProfile(args[0], error);
+    if (actProf.empty())
+    {
+        return false;
+    }
+    if (!ParseUint(args[1], &member) || !ParseUint(args[2], &group))
+    {
+        *error = "invalid member or group handle";
+        return false;
+    }
+    bm::MatchErrorCode rc =
+        m_core->mt_act_prof_remove_member_from_group(0, actProf, member, group);
+    if (rc != bm::MatchErrorCode::SUCCESS)
+    {
+        *error = MatchError("mt_act_prof_remove_member_from_group", rc);
+        return false;
+    }
+    return true;
+}
+
+bool
+P4FlowTableLoader::TableIndirectAdd(const Args& args, bool withGroup, std::string* error)
+{
+    // table_indirect_add <table> <match fields> => <member handle> [priority]
+    // table_indirect_add_with_group <table> <match fields> => <group handle> [priority]
+    auto sep = std::find(args.begin(), args.end(), "=>");
+    if (args.empty() || sep == args.end() || sep < args.begin() + 1)
+    {
+        *error = "usage: <table> <match fields> => <handle> [priority]";
+        return false;
+    }
+    const P4ProgramInfo::TableInfo* table = GetTable(args[0], error);
+    if (!table)
+    {
+        return false;
+    }
+
+    std::vector<std::string> fields(args.begin() + 1, sep);
+    std::vector<std::string> params(sep + 1, args.end());
+    size_t expected = table->NeedsPriority() ? 2 : 1;
+    uint64_t handle;
+    uint64_t priority = 1;
+    if (params.size() != expected || !ParseUint(params[0], &handle) ||
+        (expected == 2 && !ParseUint(params[1], &priority)))
+    {
+        *error = "expected a handle" + std::string(expected == 2 ? " and a priority" : "") +
+                 " after '=>'";
+        return false;
+    }
+
+    std::vector<bm::MatchKeyParam> matchKey;
+    if (!ParseMatchKey(*table, fields, &matchKey, error))
+    {
+        return false;
+    }
+
+    bm::entry_handle_t entry;
+    bm::MatchErrorCode rc;
+    if (withGroup)
+    {
+        rc = m_core->mt_indirect_ws_add_entry(0,
+                                              table->name,
+                                              matchKey,
+                                              handle,
+                                              &entry,
+                                              static_cast<int>(priority));
+    }
+    else
+    {
+        rc = m_core->mt_indirect_add_entry(0,
+                                           table->name,
+                                           matchKey,
+                                           handle,
+                                           &entry,
+                                           static_cast<int>(priority));
+    }
+    if (rc != bm::MatchErrorCode::SUCCESS)
+    {
+        *error = MatchError(withGroup ? "mt_indirect_ws_add_entry" : "mt_indirect_add_entry", rc);
+        return false;
+    }
+    NS_LOG_DEBUG("Entry added to " << table->name << " with handle " << entry);
+    return true;
+}
+
+bool
+P4FlowTableLoader::TableIndirectModify(const Args& args, bool withGroup, std::string* error)
+{
+    // table_indirect_modify <table> <entry handle> <member handle>
+    // table_indirect_modify_with_group <table> <entry handle> <group handle>
+    uint64_t entry;
+    uint64_t handle;
+    if (!CheckArgs(args, 3, 3, "<table> <entry handle> <member or group handle>", error))
+    {
+        return false;
+    }
+    const P4ProgramInfo::TableInfo* table = GetTable(args[0], error);
+    if (!table)
+    {
+        return false;
+    }
+    if (!ParseUint(args[1], &entry) || !ParseUint(args[2], &handle))
+    {
+        *error = "invalid entry, member or group handle";
+        return false;
+    }
+    bm::MatchErrorCode rc =
+        withGroup ? m_core->mt_indirect_ws_modify_entry(0, table->name, entry, handle)
+                  : m_core->mt_indirect_modify_entry(0, table->name, entry, handle);
+    if (rc != bm::MatchErrorCode::SUCCESS)
+    {
+        *error =
+            MatchError(withGroup ? "mt_indirect_ws_modify_entry" : "mt_indirect_modify_entry", rc);
+        return false;
+    }
+    return true;
+}
+
+bool
+P4FlowTableLoader::TableIndirectDelete(const Args& args, std::string* error)
+{
+    // table_indirect_delete <table> <entry handle>
+    uint64_t entry;
+    if (!CheckArgs(args, 2, 2, "table_indirect_delete <table> <entry handle>", error))
+    {
+        return false;
+    }
+    const P4ProgramInfo::TableInfo* table = GetTable(args[0], error);
+    if (!table)
+    {
+        return false;
+    }
+    if (!ParseUint(args[1], &entry))
+    {
+        *error = "invalid entry handle '" + args[1] + "'";
+        return false;
+    }
+    bm::MatchErrorCode rc = m_core->mt_indirect_delete_entry(0, table->name, entry);
+    if (rc != bm::MatchErrorCode::SUCCESS)
+    {
+        *error = MatchError("mt_indirect_delete_entry", rc);
+        return false;
+    }
+    return true;
+}
+
+bool
+P4FlowTableLoader::TableIndirectSetDefault(const Args& args, bool withGroup, std::string* error)
+{
+    // table_indirect_set_default <table> <member handle>
+    // table_indirect_set_default_with_group <table> <group handle>
+    uint64_t handle;
+    if (!CheckArgs(args, 2, 2, "<table> <member or group handle>", error))
+    {
+        return false;
+    }
+    const P4ProgramInfo::TableInfo* table = GetTable(args[0], error);
+    if (!table)
+    {
+        return false;
+    }
+    if (!ParseUint(args[1], &handle))
+    {
+        *error = "invalid member or group handle '" + args[1] + "'";
+        return false;
+    }
+    bm::MatchErrorCode rc =
+        withGroup ? m_core->mt_indirect_ws_set_default_group(0, table->name, handle)
+                  : m_core->mt_indirect_set_default_member(0, table->name, handle);
+    if (rc != bm::MatchErrorCode::SUCCESS)
+    {
+        *error = MatchError(withGroup ? "mt_indirect_ws_set_default_group"
+                                      : "mt_indirect_set_default_member",
+                            rc);
+        return false;
+    }
+    return true;
+}
+
+bool
+P4FlowTableLoader::TableIndirectResetDefault(const Args& args, std::string* error)
+{
+    // table_indirect_reset_default <table>
+    if (!CheckArgs(args, 1, 1, "table_indirect_reset_default <table>", error))
+    {
+        return false;
+    }
+    const P4ProgramInfo::TableInfo* table = GetTable(args[0], error);
+    if (!table)
+    {
+        return false;
+    }
+    bm::MatchErrorCode rc = m_core->mt_indirect_reset_default_entry(0, table->name);
+    if (rc != bm::MatchErrorCode::SUCCESS)
+    {
+        *error = MatchError("mt_indirect_reset_default_entry", rc);
+        return false;
+    }
+    return true;
+}
+
+bool
+P4FlowTableLoader::CounterReset(const Args& args, std::string* error)
+{
+    // counter_reset <counter>
+    if (!CheckArgs(args, 1, 1, "counter_reset <counter>", error))
+    {
+        return false;
+    }
+    const P4ProgramInfo::ExternInfo* counter = m_programInfo.FindCounter(args[0]);
+    if (!counter)
+    {
+        *error = "unknown or ambiguous counter '" + args[0] + "'";
+        return false;
+    }
+    if (counter->isDirect)
+    {
+        bm::MatchErrorCode rc = m_core->mt_reset_counters(0, counter->binding);
+        if (rc != bm::MatchErrorCode::SUCCESS)
+        {
+            *error = MatchError("mt_reset_counters", rc);
+            return false;
+        }
+        return true;
+    }
+    if (m_core->reset_counters(0, counter->name) != bm::Counter::CounterErrorCode::SUCCESS)
+    {
+        *error = "reset_counters failed for " + counter->name;
+        return false;
+    }
+    return true;
+}
+
+bool
+P4FlowTableLoader::CounterWrite(const Args& args, std::string* error)
+{
+    // counter_write <counter> <index> <packets> <bytes>
+    uint64_t index;
+    uint64_t packets;
+    uint64_t bytes;
+    if (!CheckArgs(args, 4, 4, "counter_write <counter> <index> <packets> <bytes>", error))
+    {
+        return false;
+    }
+    const P4ProgramInfo::ExternInfo* counter = m_programInfo.FindCounter(args[0]);
+    if (!counter)
+    {
+        *error = "unknown or ambiguous counter '" + args[0] + "'";
+        return false;
+    }
+    if (!ParseUint(args[1], &index) || !ParseUint(args[2], &packets) ||
+        !ParseUint(args[3], &bytes))
+    {
+        *error = "invalid index or counter value";
+        return false;
+    }
+    if (counter->isDirect)
+    {
+        // For direct counters, the index is the handle of the table entry
+        bm::MatchErrorCode rc =
+            m_core->mt_write_counters(0, counter->binding, index, bytes, packets);
+        if (rc != bm::MatchErrorCode::SUCCESS)
+        {
+            *error = MatchError("mt_write_counters", rc);
+            return false;
+        }
+        return true;
+    }
+    if (m_core->write_counters(0, counter->name, index, bytes, packets) !=
+        bm::Counter::CounterErrorCode::SUCCESS)
+    {
+        *error = "write_counters failed for " + counter->name + "[" + args[1] + "]";
+        return false;
+    }
+    return true;
+}
+
+bool
+P4FlowTableLoader::MeterArraySetRates(const Args& args, std::string* error)
+{
+    // meter_array_set_rates <meter> <rate>:<burst> [<rate>:<burst>]
+    if (!CheckArgs(args, 2, 3, "meter_array_set_rates <meter> <rate>:<burst> ...", error))
+    {
+        return false;
+    }
+    const P4ProgramInfo::ExternInfo* meter = m_programInfo.FindMeter(args[0]);
+    if (!meter || meter->isDirect)
+    {
+        *error = "unknown or ambiguous meter array '" + args[0] + "'";
+        return false;
+    }
+    std::vector<bm::Meter::rate_config_t> rates(args.size() - 1);
+    for (size_t i = 1; i < args.size(); i++)
+    {
+        if (!ParseMeterRate(args[i], &rates[i - 1]))
+        {
+            *error = "invalid meter rate '" + args[i] + "', expected <rate>:<burst>";
+            return false;
+        }
+    }
+    if (m_core->meter_array_set_rates(0, meter->name, rates) != bm::Meter::MeterErrorCode::SUCCESS)
+    {
+        *error = "meter_array_set_rates failed for " + meter->name;
+        return false;
+    }
+    return true;
+}
+
+bool
+P4FlowTableLoader::MeterSetRates(const Args& args, std::string* error)
+{
+    // meter_set_rates <meter> <index> <rate>:<burst> [<rate>:<burst>]
+    uint64_t index;
+    if (!CheckArgs(args, 3, 4, "meter_set_rates <meter> <index> <rate>:<burst> ...", error))
+    {
+        return false;
+    }
+    const P4ProgramInfo::ExternInfo* meter = m_programInfo.FindMeter(args[0]);
+    if (!meter)
+    {
+        *error = "unknown or ambiguous meter '" + args[0] + "'";
+        return false;
+    }
+    if (!ParseUint(args[1], &index))
+    {
+        *error = "invalid meter index '" + args[1] + "'";
+        return false;
+    }
+    std::vector<bm::Meter::rate_config_t> rates(args.size() - 2);
+    for (size_t i = 2; i < args.size(); i++)
+    {
+        if (!ParseMeterRate(args[i], &rates[i - 2]))
+        {
+            *error = "invalid meter rate '" + args[i] + "', expected <rate>:<burst>";
+            return false;
+        }
+    }
+    if (meter->isDirect)
+    {
+        // For direct meters, the index is the handle of the table entry
+        bm::MatchErrorCode rc = m_core->mt_set_meter_rates(0, meter->binding, index, rates);
+        if (rc != bm::MatchErrorCode::SUCCESS)
+        {
+            *error = MatchError("mt_set_meter_rates", rc);
+            return false;
+        }
+        return true;
+    }
+    if (m_core->meter_set_rates(0, meter->name, index, rates) !=
+        bm::Meter::MeterErrorCode::SUCCESS)
+    {
+        *error = "meter_set_rates failed for " + meter->name + "[" + args[1] + "]";
+        return false;
+    }
+    return true;
+}
+
+bool
+P4FlowTableLoader::RegisterWrite(const Args& args, std::string* error)
+{
+    // register_write <register> <index> <value>
+    uint64_t index;
+    if (!CheckArgs(args, 3, 3, "register_write <register> <index> <value>", error))
+    {
+        return false;
+    }
+    const P4ProgramInfo::ExternInfo* reg = m_programInfo.FindRegister(args[0]);
+    if (!reg)
+    {
+        *error = "unknown or ambiguous register '" + args[0] + "'";
+        return false;
+    }
+    std::string bytes;
+    if (!ParseUint(args[1], &index) || !EncodeValue(args[2], reg->bitwidth, &bytes, error))
+    {
+        *error = "invalid register index or value: " + *error;
+        return false;
+    }
+    bm::Data value(bytes.data(), bytes.size());
+    if (m_core->register_write(0, reg->name, index, std::move(value)) !=
+        bm::Register::RegisterErrorCode::SUCCESS)
+    {
+        *error = "register_write failed for " + reg->name + "[" + args[1] + "]";
+        return false;
+    }
+    return true;
+}
+
+bool
+P4FlowTableLoader::RegisterReset(const Args& args, std::string* error)
+{
+    // register_reset <register>
+    if (!CheckArgs(args, 1, 1, "register_reset <register>", error))
+    {
+        return false;
+    }
+    const P4ProgramInfo::ExternInfo* reg = m_programInfo.FindRegister(args[0]);
+    if (!reg)
+    {
+        *error = "unknown or ambiguous register '" + args[0] + "'";
+        return false;
+    }
+    if (m_core->register_reset(0, reg->name) != bm::Register::RegisterErrorCode::SUCCESS)
+    {
+        *error = "register_reset failed for " + reg->name;
+        return false;
+    }
+    return true;
+}
+
+bool
+P4FlowTableLoader::MirroringAdd(const Args& args, bool multicast, std::string* error)
+{
+    // mirroring_add <mirror id> <egress port>
+    // mirroring_add_mc <mirror id> <multicast group>
+    uint64_t mirrorId;
+    uint64_t target;
+    if (!CheckArgs(args, 2, 2, "<mirror id> <egress port or multicast group>", error))
+    {
+        return false;
+    }
+    if (!ParseUint(args[0], &mirrorId) || !ParseUint(args[1], &target))
+    {
+        *error = "invalid mirror id or target";
+        return false;
+    }
+
+    P4SwitchCore::MirroringSessionConfig config = {};
+    if (multicast)
+    {
+        config.mgid = static_cast<unsigned int>(target);
+        config.mgid_valid = true;
+    }
+    else
+    {
+        config.egress_port = static_cast<uint32_t>(target);
+        config.egress_port_valid = true;
+    }
+    if (!m_core->AddMirroringSession(static_cast<int>(mirrorId), config))
+    {
+        *error = "mirror id " + args[0] + " out of range";
+        return false;
+    }
+    return true;
+}
+
+bool
+P4FlowTableLoader::MirroringDelete(const Args& args, std::string* error)
+{
+    // mirroring_delete <mirror id>
+    uint64_t mirrorId;
+    if (!CheckArgs(args, 1, 1, "mirroring_delete <mirror id>", error))
+    {
+        return false;
+    }
+    if (!ParseUint(args[0], &mirrorId))
+    {
+        *error = "invalid mirror id '" + args[0] + "'";
+        return false;
+    }
+    if (!m_core->DeleteMirroringSession(static_cast<int>(mirrorId)))
+    {
+        *error = "no mirroring session with id " + args[0];
+        return false;
+    }
+    return true;
+}
+
+bool
+P4FlowTableLoader::McMgrpCreate(const Args& args, std::string* error)
+{
+    // mc_mgrp_create <multicast group id>
+    uint64_t mgid;
+    if (!CheckArgs(args, 1, 1, "mc_mgrp_create <multicast group id>", error))
+    {
+        return false;
+    }
+    if (!ParseUint(args[0], &mgid))
+    {
+        *error = "invalid multicast group id '" + args[0] + "'";
+        return false;
+    }
+    bm::McSimplePre::mgrp_hdl_t mgrpHandle;
+    if (m_core->m_pre->mc_mgrp_create(mgid, &mgrpHandle) != bm::McSimplePre::SUCCESS)
+    {
+        *error = "failed to create multicast group " + args[0];
+        return false;
+    }
+    return true;
+}
+
+bool
+P4FlowTableLoader::McMgrpDestroy(const Args& args, std::string* error)
+{
+    // mc_mgrp_destroy <multicast group id>
+    uint64_t mgrpHandle;
+    if (!CheckArgs(args, 1, 1, "mc_mgrp_destroy <multicast group id>", error))
+    {
+        return false;
+    }
+    if (!ParseUint(args[0], &mgrpHandle))
+    {
+        *error = "invalid multicast group id '" + args[0] + "'";
+        return false;
+    }
+    if (m_core->m_pre->mc_mgrp_destroy(mgrpHandle) != bm::McSimplePre::SUCCESS)
+    {
+        *error = "failed to destroy multicast group " + args[0];
+        return false;
+    }
+    return true;
+}
+
+bool
+P4FlowTableLoader::McNodeCreate(const Args& args, std::string* error)
+{
+    // mc_node_create <rid> <port list> [| <lag list>]
+    uint64_t rid;
+    if (args.empty() || !ParseUint(args[0], &rid))
+    {
+        *error = "usage: mc_node_create <rid> <port list> [| <lag list>]";
+        return false;
+    }
+    auto bar = std::find(args.begin() + 1, args.end(), "|");
+    bm::McSimplePre::PortMap portMap;
+    bm::McSimplePreLAG::LagMap lagMap;
+    if (!ParsePortList(args.begin() + 1, bar, &portMap, error) ||
+        (bar != args.end() && !ParsePortList(bar + 1, args.end(), &lagMap, error)))
+    {
+        return false;
+    }
+    bm::McSimplePre::l1_hdl_t l1Handle;
+    if (m_core->m_pre->mc_node_create(rid, portMap, lagMap, &l1Handle) != bm::McSimplePre::SUCCESS)
+    {
+        *error = "failed to create multicast node";
+        return false;
+    }
+    NS_LOG_DEBUG("Multicast node created with handle " << l1Handle);
+    return true;
+}
+
+bool
+P4FlowTableLoader::McNodeUpdate(const Args& args, std::string* error)
+{
+    // mc_node_update <node handle> <port list> [| <lag list>]
+    uint64_t l1Handle;
+    if (args.empty() || !ParseUint(args[0], &l1Handle))
+    {
+        *error = "usage: mc_node_update <node handle> <port list> [| <lag list>]";
+        return false;
+    }
+    auto bar = std::find(args.begin() + 1, args.end(), "|");
+    bm::McSimplePre::PortMap portMap;
+    bm::McSimplePreLAG::LagMap lagMap;
+    if (!ParsePortList(args.begin() + 1, bar, &portMap, error) ||
+        (bar != args.end() && !ParsePortList(bar + 1, args.end(), &lagMap, error)))
+    {
+        return false;
+    }
+    if (m_core->m_pre->mc_node_update(l1Handle, portMap, lagMap) != bm::McSimplePre::SUCCESS)
+    {
+        *error = "failed to update multicast node " + args[0];
+        return false;
+    }
+    return true;
+}
+
+bool
+P4FlowTableLoader::McNodeAssociate(const Args& args, bool associate, std::string* error)
+{
+    // mc_node_associate <multicast group id> <node handle>
+    // mc_node_dissociate <multicast group id> <node handle>
+    uint64_t mgrpHandle;
+    uint64_t l1Handle;
+    if (!CheckArgs(args, 2, 2, "<multicast group id> <node handle>", error))
+    {
+        return false;
+    }
+    if (!ParseUint(args[0], &mgrpHandle) || !ParseUint(args[1], &l1Handle))
+    {
+        *error = "invalid multicast group id or node handle";
+        return false;
+    }
+    bm::McSimplePre::McReturnCode rc =
+        associate ? m_core->m_pre->mc_node_associate(mgrpHandle, l1Handle)
+                  : m_core->m_pre->mc_node_dissociate(mgrpHandle, l1Handle);
+    if (rc != bm::McSimplePre::SUCCESS)
+    {
+        *error = std::string("failed to ") + (associate ? "associate" : "dissociate") +
+                 " node " + args[1] + " and multicast group " + args[0];
+        return false;
+    }
+    return true;
+}
+
+bool
+P4FlowTableLoader::McNodeDestroy(const Args& args, std::string* error)
+{
+    // mc_node_destroy <node handle>
+    uint64_t l1Handle;
+    if (!CheckArgs(args, 1, 1, "mc_node_destroy <node handle>", error))
+    {
+        return false;
+    }
+    if (!ParseUint(args[0], &l1Handle))
+    {
+        *error = "invalid node handle '" + args[0] + "'";
+        return false;
+    }
+    if (m_core->m_pre->mc_node_destroy(l1Handle) != bm::McSimplePre::SUCCESS)
+    {
+        *error = "failed to destroy multicast node " + args[0];
+        return false;
+    }
+    return true;
+}
+
+bool
+P4FlowTableLoader::McSetLagMembership(const Args& args, std::string* error)
+{
+    // mc_set_lag_membership <lag index> <port list>
+    uint64_t lagIndex;
+    if (args.empty() || !ParseUint(args[0], &lagIndex))
+    {
+        *error = "usage: mc_set_lag_membership <lag index> <port list>";
+        return false;
+    }
+    bm::McSimplePre::PortMap portMap;
+    if (!ParsePortList(args.begin() + 1, args.end(), &portMap, error))
+    {
+        return false;
+    }
+    if (m_core->m_pre->mc_set_lag_membership(lagIndex, portMap) != bm::McSimplePre::SUCCESS)
+    {
+        *error = "failed to set membership of LAG " + args[0];
+        return false;
+    }
+    return true;
+}
+
+bool
+P4FlowTableLoader::SetQueueDepth(const Args& args, std::string* error)
+{
+    // set_queue_depth <depth in packets> [<egress port> [<priority>]]
+    uint64_t values[3];
+    if (!CheckArgs(args, 1, 3, "set_queue_depth <depth> [<egress port> [<priority>]]", error))
+    {
+        return false;
+    }
+    for (size_t i = 0; i < args.size(); i++)
+    {
+        if (!ParseUint(args[i], &values[i]))
+        {
+            *error = "invalid argument '" + args[i] + "'";
+            return false;
+        }
+    }
+    int rc;
+    if (args.size() == 1)
+    {
+        rc = m_core->SetAllEgressQueueDepths(values[0]);
+    }
+    else if (args.size() == 2)
+    {
+        rc = m_core->SetEgressQueueDepth(values[1], values[0]);
+    }
+    else
+    {
+        rc = m_core->SetEgressPriorityQueueDepth(values[1], values[2], values[0]);
+    }
+    if (rc != 0)
+    {
+        *error = "the switch architecture does not support queue configuration";
+        return false;
+    }
+    return true;
+}
+
+bool
+P4FlowTableLoader::SetQueueRate(const Args& args, std::string* error)
+{
+    // set_queue_rate <rate in pps> [<egress port> [<priority>]]
+    uint64_t values[3];
+    if (!CheckArgs(args, 1, 3, "set_queue_rate <rate pps> [<egress port> [<priority>]]", error))
+    {
+        return false;
+    }
+    for (size_t i = 0; i < args.size(); i++)
+    {
+        if (!ParseUint(args[i], &values[i]))
+        {
+            *error = "invalid argument '" + args[i] + "'";
+            return false;
+        }
+    }
+    int rc;
+    if (args.size() == 1)
+    {
+        rc = m_core->SetAllEgressQueueRates(values[0]);
+    }
+    else if (args.size() == 2)
+    {
+        rc = m_core->SetEgressQueueRate(values[1], values[0]);
+    }
+    else
+    {
+        rc = m_core->SetEgressPriorityQueueRate(values[1], values[2], values[0]);
+    }
+    if (rc != 0)
+    {
+        *error = "the switch architecture does not support queue configuration";
+        return false;
+    }
+    return true;
+}
+
+bool
+P4FlowTableLoader::ResetState(const Args& args, std::string* error)
+{
+    // reset_state
+    if (!CheckArgs(args, 0, 0, "reset_state", error))
+    {
+        return false;
+    }
+    if (m_core->reset_state() != bm::RuntimeInterface::ErrorCode::SUCCESS)
+    {
+        *error = "reset_state failed";
+        return false;
+    }
+    return true;
+}
+
+} // namespace ns3
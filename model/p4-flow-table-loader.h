@@ -0,0 +1,218 @@
+/*
+ * Copyright (c) 2025 TU Dresden
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Authors: Mingyu Ma <mingyu.ma@tu-dresden.de>
+ */
+
+#ifndef P4_FLOW_TABLE_LOADER_H
+#define P4_FLOW_TABLE_LOADER_H
+
+#include "ns3/p4-program-info.h"
+
+#include <bm/bm_sim/match_units.h>
+#include <string>
+#include <vector>
+
+namespace ns3
+{
+
+class P4SwitchCore;
+
+/**
+ * @brief In-process replacement for `simple_switch_CLI < flowtable.txt`.
+ *
+ * The loader understands the command grammar of the bmv2 runtime CLI that is
+ * used in the flow table files (table_add, table_set_default, mirroring_add,
+ * mc_* and the other CLI commands; the runtime API names such as mt_add_entry
+ * are not CLI commands and are rejected), encodes the arguments
+ * with the help of P4ProgramInfo and applies them directly through the
+ * bm::RuntimeInterface of the switch core. No thrift server, Python process or
+ * start-up delay is involved.
+ *
+ * Each line is applied independently: a failing line is reported with its
+ * file name and line number, and loading continues with the next line.
+ */
+class P4FlowTableLoader
+{
+  public:
+    /**
+     * @brief Construct a new flow table loader
+     * @param core the switch core the commands are applied to
+     * @param programInfo the description of the P4 program loaded in the core
+     */
+    P4FlowTableLoader(P4SwitchCore* core, const P4ProgramInfo& programInfo);
+
+    /**
+     * @brief Apply all the commands of a flow table file
+     * @param flowTablePath the path to the flow table file
+     * @param verbPrefix apply only the commands starting with this prefix,
+     * e.g. "mc_" for the multicast groups, all the commands if empty
+     * @return int 0 if all the commands were applied, 1 otherwise
+     */
+    int LoadFromFile(const std::string& flowTablePath, const std::string& verbPrefix = "");
+
+    /**
+     * @brief Apply a single command line
+     * @param line the command, e.g. "table_add ipv4_lpm forward 10.0.0.1/32 => 1"
+     * @param error set to a description of the problem on failure
+     * @return bool true if the command was applied (empty lines and comments included)
+     */
+    bool ExecuteCommand(const std::string& line, std::string* error);
+
+    /**
+     * @brief Get the number of commands applied successfully
+     * @return the number of commands
+     */
+    uint32_t GetNumCommands() const;
+
+    /**
+     * @brief Get the number of commands that failed
+     * @return the number of failed commands
+     */
+    uint32_t GetNumErrors() const;
+
+    /**
+     * @brief Get the errors reported by LoadFromFile
+     * @return one "file:line: command: problem" message per failed line
+     */
+    const std::vector<std::string>& GetErrors() const;
+
+    /**
+     * @brief Parse an unsigned integer with the base prefixes of the runtime
+     * CLI (0x, 0o, 0b or decimal, '_' separators allowed)
+     * @param text the integer
+     * @param bitwidth the width of the field
+     * @param bytes set to the big-endian value, (bitwidth + 7) / 8 bytes long
+     * @return false if the text is not an integer or does not fit in the field
+     */
+    static bool ParseInteger(const std::string& text, unsigned int bitwidth, std::string* bytes);
+
+    /**
+     * @brief Encode a value for a field of the given width, following
+     * runtime_CLI.py: IPv4 addresses for 32-bit fields, MAC addresses for
+     * 48-bit fields, IPv6 addresses for 128-bit fields, integers otherwise
+     * @param text the value
+     * @param bitwidth the width of the field
+     * @param bytes set to the encoded value
+     * @param error set on failure
+     * @return true on success
+     */
+    static bool EncodeValue(const std::string& text,
+                            unsigned int bitwidth,
+                            std::string* bytes,
+                            std::string* error);
+
+    /**
+     * @brief Encode the match key of an entry
+     * @param table the table
+     * @param fields the match fields, as written in the command
+     * @param matchKey the encoded match key
+     * @param error set on failure
+     * @return true on success
+     */
+    static bool ParseMatchKey(const P4ProgramInfo::TableInfo& table,
+                              const std::vector<std::string>& fields,
+                              std::vector<bm::MatchKeyParam>* matchKey,
+                              std::string* error);
+
+  private:
+    using Args = std::vector<std::string>;
+
+    // Flow table commands
+    bool TableAdd(const Args& args, std::string* error);
+    bool TableSetDefault(const Args& args, std::string* error);
+    bool TableResetDefault(const Args& args, std::string* error);
+    bool TableDelete(const Args& args, std::string* error);
+    bool TableModify(const Args& args, std::string* error);
+    bool TableClear(const Args& args, std::string* error);
+    bool TableSetTimeout(const Args& args, std::string* error);
+
+    // Action profile and indirect table commands
+    bool ActProfCreateMember(const Args& args, std::string* error);
+    bool ActProfDeleteMember(const Args& args, std::string* error);
+    bool ActProfModifyMember(const Args& args, std::string* error);
+    bool ActProfCreateGroup(const Args& args, std::string* error);
+    bool ActProfDeleteGroup(const Args& args, std::string* error);
+    bool ActProfAddMemberToGroup(const Args& args, std::string* error);
+    bool ActProfRemoveMemberFromGroup(const Args& args, std::string* error);
+    bool TableIndirectAdd(const Args& args, bool withGroup, std::string* error);
+    bool TableIndirectModify(const Args& args, bool withGroup, std::string* error);
+    bool TableIndirectSetDefault(const Args& args, bool withGroup, std::string* error);
+    bool TableIndirectDelete(const Args& args, std::string* error);
+    bool TableIndirectResetDefault(const Args& args, std::string* error);
+
+    // Counter, meter and register commands
+    bool CounterReset(const Args& args, std::string* error);
+    bool CounterWrite(const Args& args, std::string* error);
+    bool MeterArraySetRates(const Args& args, std::string* error);
+    bool MeterSetRates(const Args& args, std::string* error);
+    bool RegisterWrite(const Args& args, std::string* error);
+    bool RegisterReset(const Args& args, std::string* error);
+
+    // Mirroring and multicast commands
+    bool MirroringAdd(const Args& args, bool multicast, std::string* error);
+    bool MirroringDelete(const Args& args, std::string* error);
+    bool McMgrpCreate(const Args& args, std::string* error);
+    bool McMgrpDestroy(const Args& args, std::string* error);
+    bool McNodeCreate(const Args& args, std::string* error);
+    bool McNodeUpdate(const Args& args, std::string* error);
+    bool McNodeAssociate(const Args& args, bool associate, std::string* error);
+    bool McNodeDestroy(const Args& args, std::string* error);
+    bool McSetLagMembership(const Args& args, std::string* error);
+
+    // Target specific commands
+    bool SetQueueDepth(const Args& args, std::string* error);
+    bool SetQueueRate(const Args& args, std::string* error);
+    bool ResetState(const Args& args, std::string* error);
+
+    /**
+     * @brief Resolve a table name
+     * @param name the table name, full name or unambiguous suffix
+     * @param error set on failure
+     * @return the table, or nullptr if not found
+     */
+    const P4ProgramInfo::TableInfo* GetTable(const std::string& name, std::string* error) const;
+
+    /**
+     * @brief Resolve an action profile name, or the action profile of an indirect table
+     * @param name the action profile or table name
+     * @param error set on failure
+     * @return the fully qualified action profile name, or an empty string
+     */
+    std::string GetActionProfile(const std::string& name, std::string* error) const;
+
+    /**
+     * @brief Encode the runtime parameters of an action
+     * @param action the action
+     * @param params the action parameters, as written in the command
+     * @param actionData the encoded action data
+     * @param error set on failure
+     */
+    bool ParseActionData(const P4ProgramInfo::ActionInfo& action,
+                         const std::vector<std::string>& params,
+                         bm::ActionData* actionData,
+                         std::string* error) const;
+
+    P4SwitchCore* m_core;                //!< The switch core to configure
+    const P4ProgramInfo& m_programInfo;  //!< P4 program description
+    uint32_t m_numCommands;              //!< Number of commands applied
+    uint32_t m_numErrors;                //!< Number of commands failed
+    std::vector<std::string> m_errors;   //!< Errors of the failed lines
+};
+
+} // namespace ns3
+
+#endif /* P4_FLOW_TABLE_LOADER_H */
@@ -0,0 +1,309 @@
+/*
+ * Copyright (c) 2025 TU Dresden
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Authors: Mingyu Ma <mingyu.ma@tu-dresden.de>
+ */
+
+#include "ns3/global-value.h"
+#include "ns3/log.h"
+#include "ns3/p4-metrics-sink.h"
+#include "ns3/simulator.h"
+#include "ns3/string.h"
+
+#include <algorithm>
+#include <charconv>
+
+namespace ns3
+{
+
+NS_LOG_COMPONENT_DEFINE("P4MetricsSink");
+
+static GlobalValue g_p4MetricsInterval("P4MetricsInterval",
+                                       "Sampling interval of the metrics of the P4 switches "
+                                       "with tracing enabled",
+                                       TimeValue(Seconds(1)),
+                                       MakeTimeChecker(NanoSeconds(1)));
+
+static GlobalValue g_p4MetricsDirectory("P4MetricsDirectory",
+                                        "Directory of the metrics file of the P4 switches",
+                                        StringValue("."),
+                                        MakeStringChecker());
+
+static GlobalValue g_p4MetricsFormat("P4MetricsFormat",
+                                     "Format of the metrics file of the P4 switches: csv or "
+                                     "binary (fixed-width rows)",
+                                     StringValue("csv"),
+                                     MakeStringChecker());
+
+static_assert(sizeof(P4MetricsSink::Row) == 24 + 8 * (15 + P4MetricsSink::DROP_REASON_COUNT),
+              "P4MetricsSink::Row must not have padding");
+
+P4MetricsSink* P4MetricsSink::g_sink = nullptr;
+
+namespace
+{
+
+const char g_binaryMagic[8] = {'P', '4', 'M', 'E', 'T', 'R', 'I', 'C'};
+
+/**
+ * @brief Append an integer and a separator to a CSV line
+ */
+template <typename T>
+void
+AppendField(std::string& line, T value, char separator = ',')
+{
+    char digits[24];
+    std::to_chars_result result = std::to_chars(digits, digits + sizeof(digits), value);
+    line.append(digits, result.ptr);
+    line.push_back(separator);
+}
+
+} // namespace
+
+P4MetricsSink*
+P4MetricsSink::Get()
+{
+    if (g_sink)
+    {
+        return g_sink;
+    }
+
+    TimeValue intervalValue;
+    g_p4MetricsInterval.GetValue(intervalValue);
+    StringValue directoryValue;
+    g_p4MetricsDirectory.GetValue(directoryValue);
+    StringValue formatValue;
+    g_p4MetricsFormat.GetValue(formatValue);
+    if (formatValue.Get() != "csv" && formatValue.Get() != "binary")
+    {
+        NS_LOG_WARN("Unknown P4MetricsFormat " << formatValue.Get() << ", using csv");
+    }
+
+    g_sink = new P4MetricsSink(intervalValue.Get(),
+                               directoryValue.Get(),
+                               formatValue.Get() == "binary");
+    Simulator::ScheduleDestroy(&P4MetricsSink::Destroy);
+    return g_sink;
+}
+
+void
+P4MetricsSink::Destroy()
+{
+    delete g_sink;
+    g_sink = nullptr;
+}
+
+void
+P4MetricsSink::Remove(const void* owner)
+{
+    if (!g_sink)
+    {
+        return;
+    }
+    auto& sources = g_sink->m_sources;
+    sources.erase(std::remove_if(sources.begin(),
+                                 sources.end(),
+                                 [owner](const Source& source) { return source.owner == owner; }),
+                  sources.end());
+}
+
+P4MetricsSink::P4MetricsSink(Time interval, const std::string& directory, bool binary)
+    : m_interval(interval),
+      m_binary(binary)
+{
+    std::string path = directory + "/p4-metrics";
+    if (Simulator::GetSystemId() != 0)
+    {
+        path += "-" + std::to_string(Simulator::GetSystemId());
+    }
+    path += binary ? ".bin" : ".csv";
+
+    m_file.open(path, std::ios::out | std::ios::trunc | std::ios::binary);
+    if (!m_file.is_open())
+    {
+        NS_LOG_ERROR("Failed to open the metrics file " << path);
+        return;
+    }
+    NS_LOG_INFO("Writing the P4 switch metrics to " << path << " every " << interval);
+
+    m_buffer.reserve(FLUSH_SIZE + sizeof(Row) * 64);
+    if (binary)
+    {
+        m_buffer.append(g_binaryMagic, sizeof(g_binaryMagic));
+    }
+    else
+    {
+        m_buffer += "time_ns,switch,port,priority,input_pps,input_bps,egress_pps,egress_bps,"
+                    "input_packets,input_bits,egress_packets,egress_bits,drop_input_buffer,"
+                    "drop_ingress,drop_priority,drop_queue_full,drop_egress,drop_aqm,depth,"
+                    "depth_p50,depth_p99,depth_p999,sojourn_p50_ns,sojourn_p99_ns,"
+                    "sojourn_p999_ns\n";
+    }
+}
+
+P4MetricsSink::~P4MetricsSink()
+{
+    Simulator::Cancel(m_sampleEvent);
+    Flush();
+}
+
+void
+P4MetricsSink::Add(const void* owner, Sampler sampler)
+{
+    m_sources.push_back(Source{owner, std::move(sampler)});
+    if (m_sampleEvent.IsExpired())
+    {
+        m_sampleEvent = Simulator::Schedule(m_interval, &P4MetricsSink::Sample, this);
+    }
+}
+
+Time
+P4MetricsSink::GetInterval() const
+{
+    return m_interval;
+}
+
+void
+P4MetricsSink::Sample()
+{
+    Time now = Simulator::Now();
+    // by index: a sampler may remove a source
+    for (size_t i = 0; i < m_sources.size(); i++)
+    {
+        m_sources[i].sampler(this, now);
+    }
+    if (!m_sources.empty())
+    {
+        m_sampleEvent = Simulator::Schedule(m_interval, &P4MetricsSink::Sample, this);
+    }
+}
+
+void
+P4MetricsSink::AppendSwitchRow(Time now,
+                               uint32_t switchId,
+                               const TrafficCounters& counters,
+                               TrafficCounters* last,
+                               uint64_t depth)
+{
+    // Counters per interval, scaled to one second
+    double scale = 1.0 / m_interval.GetSeconds();
+
+    Row row;
+    row.timeNs = now.GetNanoSeconds();
+    row.switchId = switchId;
+    row.inputPps = (counters.inputPackets - last->inputPackets) * scale;
+    row.inputBps = (counters.inputBits - last->inputBits) * scale;
+    row.egressPps = (counters.egressPackets - last->egressPackets) * scale;
+    row.egressBps = (counters.egressBits - last->egressBits) * scale;
+    row.inputPackets = counters.inputPackets;
+    row.inputBits = counters.inputBits;
+    row.egressPackets = counters.egressPackets;
+    row.egressBits = counters.egressBits;
+    std::copy(std::begin(counters.drops), std::end(counters.drops), std::begin(row.drops));
+    row.depth = depth;
+    Append(row);
+
+    *last = counters;
+}
+
+void
+P4MetricsSink::AppendQueueRow(Time now,
+                              uint32_t switchId,
+                              int32_t port,
+                              int32_t priority,
+                              uint64_t depth,
+                              const P4Histogram* depthHistogram,
+                              const P4Histogram* sojournHistogram)
+{
+    Row row;
+    row.timeNs = now.GetNanoSeconds();
+    row.switchId = switchId;
+    row.port = port;
+    row.priority = priority;
+    row.depth = depth;
+    if (depthHistogram)
+    {
+        row.depthP50 = depthHistogram->GetPercentile(50);
+        row.depthP99 = depthHistogram->GetPercentile(99);
+        row.depthP999 = depthHistogram->GetPercentile(99.9);
+    }
+    if (sojournHistogram)
+    {
+        row.sojournP50Ns = sojournHistogram->GetPercentile(50);
+        row.sojournP99Ns = sojournHistogram->GetPercentile(99);
+        row.sojournP999Ns = sojournHistogram->GetPercentile(99.9);
+    }
+    Append(row);
+}
+
+void
+P4MetricsSink::Append(const Row& row)
+{
+    if (!m_file.is_open())
+    {
+        return;
+    }
+
+    if (m_binary)
+    {
+        m_buffer.append(reinterpret_cast<const char*>(&row), sizeof(row));
+    }
+    else
+    {
+        AppendField(m_buffer, row.timeNs);
+        AppendField(m_buffer, row.switchId);
+        AppendField(m_buffer, row.port);
+        AppendField(m_buffer, row.priority);
+        AppendField(m_buffer, row.inputPps);
+        AppendField(m_buffer, row.inputBps);
+        AppendField(m_buffer, row.egressPps);
+        AppendField(m_buffer, row.egressBps);
+        AppendField(m_buffer, row.inputPackets);
+        AppendField(m_buffer, row.inputBits);
+        AppendField(m_buffer, row.egressPackets);
+        AppendField(m_buffer, row.egressBits);
+        for (uint64_t drops : row.drops)
+        {
+            AppendField(m_buffer, drops);
+        }
+        AppendField(m_buffer, row.depth);
+        AppendField(m_buffer, row.depthP50);
+        AppendField(m_buffer, row.depthP99);
+        AppendField(m_buffer, row.depthP999);
+        AppendField(m_buffer, row.sojournP50Ns);
+        AppendField(m_buffer, row.sojournP99Ns);
+        AppendField(m_buffer, row.sojournP999Ns, '\n');
+    }
+
+    if (m_buffer.size() >= FLUSH_SIZE)
+    {
+        Flush();
+    }
+}
+
+void
+P4MetricsSink::Flush()
+{
+    if (!m_file.is_open() || m_buffer.empty())
+    {
+        return;
+    }
+    m_file.write(m_buffer.data(), m_buffer.size());
+    m_file.flush();
+    m_buffer.clear();
+}
+
+} // namespace ns3
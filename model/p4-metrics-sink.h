@@ -0,0 +1,238 @@
+/*
+ * Copyright (c) 2025 TU Dresden
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Authors: Mingyu Ma <mingyu.ma@tu-dresden.de>
+ */
+
+#ifndef P4_METRICS_SINK_H
+#define P4_METRICS_SINK_H
+
+#include "ns3/event-id.h"
+#include "ns3/nstime.h"
+#include "ns3/p4-histogram.h"
+
+#include <cstdint>
+#include <fstream>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace ns3
+{
+
+/**
+ * @brief Collects the periodic metrics of the P4 switches into one file.
+ *
+ * The switches with tracing enabled register a sampler with the sink. Every
+ * interval (P4MetricsInterval global value), one event calls all the samplers
+ * in registration order; each sampler appends its rows. The rows are buffered
+ * in memory and written to the file in chunks of FLUSH_SIZE bytes, and when
+ * the simulator is destroyed.
+ *
+ * All the rows share one fixed schema (see Row). A switch writes one switch
+ * row (port and priority -1) carrying its traffic rates, totals and drops,
+ * with the depth of its input buffer, then one queue row per egress port and
+ * priority carrying the depth of the queue and, if the queue keeps histograms,
+ * the 50th, 99th and 99.9th percentiles of its enqueue depth and sojourn time
+ * since the start (0 without histograms).
+ *
+ * The file is P4MetricsDirectory/p4-metrics.csv, or p4-metrics.bin with the
+ * binary format (P4MetricsFormat). With MPI, the ranks other than 0 add their
+ * rank to the file name. The binary file starts with the 8 bytes "P4METRIC",
+ * followed by the rows as laid out in Row, in the byte order of the host.
+ */
+class P4MetricsSink
+{
+  public:
+    /**
+     * @brief Why a switch dropped a packet
+     */
+    enum DropReason
+    {
+        DROP_INPUT_BUFFER = 0, //!< The input buffer was full
+        DROP_INGRESS,          //!< Dropped by the ingress pipeline
+        DROP_PRIORITY,         //!< The priority of the packet was out of range
+        DROP_QUEUE_FULL,       //!< The egress queue was full
+        DROP_EGRESS,           //!< Dropped by the egress pipeline
+        DROP_AQM,              //!< Dropped by the AQM of the egress queue
+        DROP_REASON_COUNT
+    };
+
+    /**
+     * @brief One row of the metrics file, fixed width
+     */
+    struct Row
+    {
+        uint64_t timeNs{0};                     //!< Simulation time of the sample
+        uint32_t switchId{0};                   //!< ID of the switch
+        int32_t port{-1};                       //!< Egress port, -1 for the switch row
+        int32_t priority{-1};                   //!< Queue priority, -1 for the switch row
+        uint32_t reserved{0};                   //!< Padding, always 0
+        uint64_t inputPps{0};                   //!< Received packets per second
+        uint64_t inputBps{0};                   //!< Received bits per second
+        uint64_t egressPps{0};                  //!< Sent packets per second
+        uint64_t egressBps{0};                  //!< Sent bits per second
+        uint64_t inputPackets{0};               //!< Received packets since the start
+        uint64_t inputBits{0};                  //!< Received bits since the start
+        uint64_t egressPackets{0};              //!< Sent packets since the start
+        uint64_t egressBits{0};                 //!< Sent bits since the start
+        uint64_t drops[DROP_REASON_COUNT] = {}; //!< Dropped packets since the start, by reason
+        uint64_t depth{0};                      //!< Packets in the input buffer or the queue
+        uint64_t depthP50{0};                   //!< Median depth seen at enqueue
+        uint64_t depthP99{0};                   //!< 99th percentile of the enqueue depth
+        uint64_t depthP999{0};                  //!< 99.9th percentile of the enqueue depth
+        uint64_t sojournP50Ns{0};               //!< Median sojourn time (ns)
+        uint64_t sojournP99Ns{0};               //!< 99th percentile of the sojourn time (ns)
+        uint64_t sojournP999Ns{0};              //!< 99.9th percentile of the sojourn time (ns)
+    };
+
+    /**
+     * @brief Traffic counters of a switch, sampled into its switch rows
+     */
+    struct TrafficCounters
+    {
+        uint64_t inputPackets{0};               //!< Received packets
+        uint64_t inputBits{0};                  //!< Received bits
+        uint64_t egressPackets{0};              //!< Sent packets
+        uint64_t egressBits{0};                 //!< Sent bits
+        uint64_t drops[DROP_REASON_COUNT] = {}; //!< Dropped packets, by reason
+    };
+
+    /**
+     * @brief Appends the rows of one switch at a sample time
+     */
+    using Sampler = std::function<void(P4MetricsSink* sink, Time now)>;
+
+    static constexpr size_t FLUSH_SIZE = 1 << 20; //!< Buffered bytes written at once
+
+    /**
+     * @brief Get the sink of the simulation
+     * @details Created on first use from the global values, flushed and
+     * destroyed with the simulator.
+     * @return the sink
+     */
+    static P4MetricsSink* Get();
+
+    /**
+     * @brief Remove the sampler of a switch, if the sink exists
+     * @param owner the switch
+     */
+    static void Remove(const void* owner);
+
+    ~P4MetricsSink();
+
+    /**
+     * @brief Register the sampler of a switch
+     * @param owner the switch
+     * @param sampler the sampler, called every interval
+     */
+    void Add(const void* owner, Sampler sampler);
+
+    /**
+     * @brief Get the sampling interval
+     * @return the interval
+     */
+    Time GetInterval() const;
+
+    /**
+     * @brief Fill the switch row of a switch from its counters
+     * @details The rates are computed from the counters of the previous
+     * sample, which are updated.
+     * @param now the sample time
+     * @param switchId the switch
+     * @param counters the counters now
+     * @param last the counters at the previous sample
+     * @param depth packets in the input buffer of the switch
+     */
+    void AppendSwitchRow(Time now,
+                         uint32_t switchId,
+                         const TrafficCounters& counters,
+                         TrafficCounters* last,
+                         uint64_t depth);
+
+    /**
+     * @brief Append a queue row
+     * @param now the sample time
+     * @param switchId the switch
+     * @param port the egress port
+     * @param priority the priority of the queue
+     * @param depth packets in the queue
+     * @param depthHistogram enqueue depths of the queue, or nullptr
+     * @param sojournHistogram sojourn times of the queue (ns), or nullptr
+     */
+    void AppendQueueRow(Time now,
+                        uint32_t switchId,
+                        int32_t port,
+                        int32_t priority,
+                        uint64_t depth,
+                        const P4Histogram* depthHistogram = nullptr,
+                        const P4Histogram* sojournHistogram = nullptr);
+
+    /**
+     * @brief Append a row
+     * @param row the row
+     */
+    void Append(const Row& row);
+
+    /**
+     * @brief Write the buffered rows to the file
+     */
+    void Flush();
+
+    P4MetricsSink(const P4MetricsSink&) = delete;
+    P4MetricsSink& operator=(const P4MetricsSink&) = delete;
+
+  private:
+    /**
+     * @brief Construct the sink and open its file
+     * @param interval sampling interval
+     * @param directory directory of the file
+     * @param binary write binary rows instead of CSV
+     */
+    P4MetricsSink(Time interval, const std::string& directory, bool binary);
+
+    /**
+     * @brief Destroy the sink of the simulation
+     */
+    static void Destroy();
+
+    /**
+     * @brief Call all the samplers and schedule the next sample
+     */
+    void Sample();
+
+    /**
+     * @brief A registered sampler
+     */
+    struct Source
+    {
+        const void* owner; //!< The switch
+        Sampler sampler;   //!< Its sampler
+    };
+
+    static P4MetricsSink* g_sink; //!< Sink of the simulation
+
+    Time m_interval;               //!< Sampling interval
+    bool m_binary;                 //!< Binary rows instead of CSV
+    std::ofstream m_file;          //!< The metrics file
+    std::string m_buffer;          //!< Rows not written yet
+    std::vector<Source> m_sources; //!< Registered samplers
+    EventId m_sampleEvent;         //!< Pending sample
+};
+
+} // namespace ns3
+
+#endif /* P4_METRICS_SINK_H */
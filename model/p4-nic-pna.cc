@@ -18,18 +18,41 @@
 
 #include "ns3/p4-nic-pna.h"
 #include "ns3/p4-switch-net-device.h"
+#include "ns3/primitives-pna.h"
 #include "ns3/register-access-v1model.h"
 #include "ns3/simulator.h"
 
+#include <algorithm>
+
 NS_LOG_COMPONENT_DEFINE("P4CorePna");
 
 namespace ns3
 {
 
-P4PnaNic::P4PnaNic(P4SwitchNetDevice* net_device, bool enable_swap)
+namespace
+{
+
+// Programmable blocks of the PNA architecture, the main blocks are the ingress ones
+const P4SwitchCore::ArchDescriptor g_pnaArch = {
+    "main_parser",   // ingress parser
+    "main_control",  // ingress pipeline
+    "main_deparser", // ingress deparser
+    nullptr,         // egress parser
+    nullptr,         // egress pipeline
+    nullptr,         // egress deparser
+};
+
+} // namespace
+
+P4PnaNic::P4PnaNic(P4SwitchNetDevice* net_device,
+                   bool enable_swap,
+                   uint64_t packet_rate,
+                   size_t input_buffer_size)
     : P4SwitchCore(net_device, enable_swap, false),
       m_packetId(0),
-      input_buffer(1024)
+      m_serviceTime(packet_rate ? Time::FromDouble(1e9 / packet_rate, Time::NS) : Seconds(0)),
+      m_nextFree(Seconds(0)),
+      input_buffer(input_buffer_size)
 {
     // configure for the switch pna
     m_thriftCommand = "";             // default thrift command for pna
@@ -49,11 +72,78 @@ P4PnaNic::P4PnaNic(P4SwitchNetDevice* net_device, bool enable_swap)
     force_arith_header("pna_main_parser_input_metadata");
     force_arith_header("pna_main_input_metadata");
     force_arith_header("pna_main_output_metadata");
+
+    m_pipelineStage.SetHandler([this](OutputItem&& item) {
+        m_switchNetDevice->SendNs3Packet(item.packet,
+                                         item.port,
+                                         item.protocol,
+                                         m_destinationList[item.addrIndex]);
+    });
 }
 
 P4PnaNic::~P4PnaNic()
 {
-    input_buffer.push_front(nullptr);
+    Simulator::Cancel(m_processingEvent);
+    NS_LOG_DEBUG("PNA NIC " << m_p4SwitchId << ": " << input_buffer.get_drops()
+                            << " packets dropped at the input ring");
+}
+
+uint64_t
+P4PnaNic::GetInputDrops() const
+{
+    return input_buffer.get_drops();
+}
+
+void
+P4PnaNic::ScheduleProcessing()
+{
+    if (input_buffer.empty() || !m_processingEvent.IsExpired())
+    {
+        return;
+    }
+    Time now = Simulator::Now();
+    Time next = std::max(m_nextFree, now);
+    m_processingEvent = Simulator::Schedule(next - now, &P4PnaNic::ProcessingEvent, this);
+}
+
+void
+P4PnaNic::ProcessingEvent()
+{
+    NS_LOG_FUNCTION(this);
+    // Without a rate limit the pipeline takes all the waiting packets at once
+    Time now = Simulator::Now();
+    while (m_nextFree <= now && main_processing_pipeline())
+    {
+        m_nextFree = now + m_serviceTime;
+    }
+    ScheduleProcessing();
+}
+
+void
+P4PnaNic::ApplyPipelineLatency()
+{
+    // The main control is the only match-action stage of the NIC
+    const PipelineLatency& latency = m_pipelineLatency;
+    m_pipelineStage.SetLatency(latency.parser + latency.ingressStage + latency.deparser +
+                               latency.tableLookup * GetNumTables("main_control"));
+}
+
+void
+P4PnaNic::ResolvePhvFields()
+{
+    // Any packet carries a PHV with the layout of the loaded program
+    std::unique_ptr<bm::Packet> probe = m_packetPool.Acquire(0, 0, 0);
+    const bm::PHV& phv = *probe->get_phv();
+
+    m_fields.parserRecirculated = ResolveField(phv, "pna_main_parser_input_metadata.recirculated");
+    m_fields.parserInputPort = ResolveField(phv, "pna_main_parser_input_metadata.input_port");
+    m_fields.recirculated = ResolveField(phv, "pna_main_input_metadata.recirculated");
+    m_fields.timestamp = ResolveField(phv, "pna_main_input_metadata.timestamp");
+    m_fields.parserError = ResolveField(phv, "pna_main_input_metadata.parser_error");
+    m_fields.classOfService = ResolveField(phv, "pna_main_input_metadata.class_of_service");
+    m_fields.inputPort = ResolveField(phv, "pna_main_input_metadata.input_port");
+
+    m_packetPool.Release(std::move(probe));
 }
 
 bool
@@ -62,41 +152,55 @@ P4PnaNic::main_processing_pipeline()
     NS_LOG_FUNCTION(this);
 
     std::unique_ptr<bm::Packet> bm_packet;
-    input_buffer.pop_back(&bm_packet);
-    if (bm_packet == nullptr)
+    if (!input_buffer.pop_front(&bm_packet))
         return false;
 
     bm::PHV* phv = bm_packet->get_phv();
-    auto input_port = phv->get_field("pna_main_parser_input_metadata.input_port").get_uint();
+    auto input_port = GetField(phv, m_fields.parserInputPort).get_uint();
 
     NS_LOG_DEBUG("Processing packet received on port " << input_port);
 
-    phv->get_field("pna_main_input_metadata.timestamp").set(GetTimeStamp());
+    GetField(phv, m_fields.timestamp).set(GetTimeStamp());
 
-    bm::Parser* parser = this->get_parser("main_parser");
+    bm::Parser* parser = m_blocks.ingressParser;
     parser->parse(bm_packet.get());
 
     // pass relevant values from main parser
-    phv->get_field("pna_main_input_metadata.recirculated")
-        .set(phv->get_field("pna_main_parser_input_metadata.recirculated"));
-    phv->get_field("pna_main_input_metadata.parser_error").set(bm_packet->get_error_code().get());
-    phv->get_field("pna_main_input_metadata.class_of_service").set(0);
-    phv->get_field("pna_main_input_metadata.input_port")
-        .set(phv->get_field("pna_main_parser_input_metadata.input_port"));
-
-    bm::Pipeline* main_mau = this->get_pipeline("main_control");
+    GetField(phv, m_fields.recirculated).set(GetField(phv, m_fields.parserRecirculated));
+    GetField(phv, m_fields.parserError).set(bm_packet->get_error_code().get());
+    GetField(phv, m_fields.classOfService).set(0);
+    GetField(phv, m_fields.inputPort).set(GetField(phv, m_fields.parserInputPort));
+
+    // the forwarding decision of the main control, drop unless send_to_port()
+    // is called (see primitives-pna.h)
+    bm_packet->set_egress_port(DROP_PORT);
+
+    bm::Pipeline* main_mau = m_blocks.ingressPipeline;
     main_mau->apply(bm_packet.get());
     bm_packet->reset_exit();
 
-    bm::Deparser* deparser = this->get_deparser("main_deparser");
+    uint32_t port = bm_packet->get_egress_port();
+    if (port == DROP_PORT)
+    {
+        NS_LOG_DEBUG("Dropping packet at the end of the main control");
+        TracePacket(TRACE_DROPPED,
+                    bm_packet.get(),
+                    input_port,
+                    0,
+                    input_buffer.size(),
+                    P4MetricsSink::DROP_INGRESS);
+        m_packetPool.Release(std::move(bm_packet));
+        return true;
+    }
+
+    bm::Deparser* deparser = m_blocks.ingressDeparser;
     deparser->deparse(bm_packet.get());
 
-    int port = bm_packet->get_egress_port();
     uint16_t protocol = RegisterAccess::get_ns_protocol(bm_packet.get());
     int addr_index = RegisterAccess::get_ns_address(bm_packet.get());
 
     Ptr<Packet> ns_packet = this->ConvertToNs3Packet(std::move(bm_packet));
-    m_switchNetDevice->SendNs3Packet(ns_packet, port, protocol, m_destinationList[addr_index]);
+    m_pipelineStage.Push(OutputItem{ns_packet, static_cast<int>(port), protocol, addr_index});
     return true;
 }
 
@@ -121,14 +225,26 @@ P4PnaNic::ReceivePacket(Ptr<Packet> packetIn,
     int addr_index = GetAddressIndex(destination);
     RegisterAccess::set_ns_address(bm_packet.get(), addr_index);
 
-    phv->get_field("pna_main_parser_input_metadata.recirculated").set(0);
-    phv->get_field("pna_main_parser_input_metadata.input_port").set(inPort);
+    GetField(phv, m_fields.parserRecirculated).set(0);
+    GetField(phv, m_fields.parserInputPort).set(inPort);
 
     // using packet register 0 to store length, this register will be updated for
     // each add_header / remove_header primitive call
     bm_packet->set_register(0, len);
 
-    input_buffer.push_front(std::move(bm_packet));
+    if (!input_buffer.push_back(std::move(bm_packet)))
+    {
+        NS_LOG_DEBUG("Input ring full, dropping packet received on port " << inPort);
+        TracePacket(TRACE_DROPPED,
+                    bm_packet.get(),
+                    inPort,
+                    0,
+                    input_buffer.size(),
+                    P4MetricsSink::DROP_INPUT_BUFFER);
+        m_packetPool.Release(std::move(bm_packet));
+        return 0;
+    }
+    ScheduleProcessing();
     return 0;
 }
 
@@ -143,6 +259,20 @@ void
 P4PnaNic::start_and_return_()
 {
     NS_LOG_FUNCTION(this);
+    ResolveArchBlocks(g_pnaArch);
+    ResolvePhvFields();
+    ApplyPipelineLatency();
+}
+
+void
+P4PnaNic::swap_notify_()
+{
+    NS_LOG_FUNCTION("PNA NIC has been notified of a config swap");
+    // the cached packets hold PHVs of the former program
+    m_packetPool.Clear();
+    ResolveArchBlocks(g_pnaArch);
+    ResolvePhvFields();
+    ApplyPipelineLatency();
 }
 
 void
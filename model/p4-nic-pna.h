@@ -20,6 +20,7 @@
 #define P4_NIC_PNA_H
 
 #include "ns3/p4-queue.h"
+#include "ns3/p4-stage-fifo.h"
 #include "ns3/p4-switch-core.h"
 
 namespace ns3
@@ -28,8 +29,20 @@ namespace ns3
 class P4PnaNic : public P4SwitchCore
 {
   public:
-    // by default, swapping is off
-    explicit P4PnaNic(P4SwitchNetDevice* net_device, bool enable_swap = false);
+    static constexpr size_t DEFAULT_INPUT_BUFFER_SIZE = 1024; //!< Default input ring size
+    static constexpr uint32_t DROP_PORT = 0xffffffff;         //!< Egress port of a dropped packet
+
+    /**
+     * @brief Construct a new PNA NIC
+     * @param net_device the device wrapping the NIC
+     * @param enable_swap enable swapping the P4 program at run time, off by default
+     * @param packet_rate packets processed per second by the main pipeline, 0 for no limit
+     * @param input_buffer_size packets the input ring holds before dropping
+     */
+    explicit P4PnaNic(P4SwitchNetDevice* net_device,
+                      bool enable_swap = false,
+                      uint64_t packet_rate = 0,
+                      size_t input_buffer_size = DEFAULT_INPUT_BUFFER_SIZE);
 
     ~P4PnaNic();
 
@@ -47,29 +60,97 @@ class P4PnaNic : public P4SwitchCore
 
     void start_and_return_() override;
 
+    void swap_notify_() override;
+
     void reset_target_state_() override;
 
     void HandleIngressPipeline() override;
     void Enqueue(uint32_t egress_port, std::unique_ptr<bm::Packet>&& packet) override;
     bool HandleEgressPipeline(size_t workerId) override;
 
+    /**
+     * @brief Run the next packet of the input ring through the main pipeline
+     * @details The packet leaves on the port given to send_to_port() by the
+     * main control. Like the PSA ingress, it is dropped when the main control
+     * calls drop_packet() last or calls neither extern (see primitives-pna.h).
+     * @return bool False if the input ring was empty
+     */
     bool main_processing_pipeline();
 
+    /**
+     * @brief Get the number of packets dropped because the input ring was full
+     * @return the number of packets
+     */
+    uint64_t GetInputDrops() const;
+
     int ReceivePacket(Ptr<Packet> packetIn,
                       int inPort,
                       uint16_t protocol,
                       const Address& destination) override;
 
   private:
+    /**
+     * @brief Handles of the metadata fields accessed for every packet
+     */
+    struct PhvFields
+    {
+        FieldHandle parserRecirculated; //!< pna_main_parser_input_metadata.recirculated
+        FieldHandle parserInputPort;    //!< pna_main_parser_input_metadata.input_port
+        FieldHandle recirculated;       //!< pna_main_input_metadata.recirculated
+        FieldHandle timestamp;          //!< pna_main_input_metadata.timestamp
+        FieldHandle parserError;        //!< pna_main_input_metadata.parser_error
+        FieldHandle classOfService;     //!< pna_main_input_metadata.class_of_service
+        FieldHandle inputPort;          //!< pna_main_input_metadata.input_port
+    };
+
     enum PktDirection
     {
         NET_TO_HOST,
         HOST_TO_NET,
     };
 
+    /**
+     * @brief A packet on its way out of the main pipeline
+     */
+    struct OutputItem
+    {
+        Ptr<Packet> packet; //!< The deparsed packet
+        int port;           //!< Egress port
+        uint16_t protocol;  //!< ns-3 protocol number
+        int addrIndex;      //!< Index of the destination address
+    };
+
+    /**
+     * @brief Schedule the processing of the next packet, if any, once the
+     * pipeline is free
+     */
+    void ScheduleProcessing();
+
+    /**
+     * @brief Process the packets the pipeline can take now
+     */
+    void ProcessingEvent();
+
+    /**
+     * @brief Set the latency of the main pipeline from the pipeline latency
+     * model and the tables of the loaded program
+     */
+    void ApplyPipelineLatency();
+
+    /**
+     * @brief Resolve the handles of the PHV fields used on the packet path
+     * @details Called when the NIC starts and when the P4 program is swapped.
+     */
+    void ResolvePhvFields();
+
     uint64_t m_packetId; // Packet ID
+    PhvFields m_fields;  //!< Field handles of the loaded P4 program
 
-    bm::Queue<std::unique_ptr<bm::Packet>> input_buffer;
+    Time m_serviceTime;          //!< Time the pipeline takes per packet (1 / packet rate)
+    Time m_nextFree;             //!< Time the pipeline can take the next packet
+    EventId m_processingEvent;   //!< The pending processing event, if any
+    BoundedRing<std::unique_ptr<bm::Packet>> input_buffer; //!< Packets waiting for the pipeline
+    P4StageFifo<OutputItem> m_pipelineStage; //!< Parser, main control and deparser
 };
 
 } // namespace ns3
@@ -0,0 +1,73 @@
+/*
+ * Copyright (c) 2025 TU Dresden
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Authors: Mingyu Ma <mingyu.ma@tu-dresden.de>
+ */
+
+#include "ns3/log.h"
+#include "ns3/mpi-interface.h"
+#include "ns3/node.h"
+#include "ns3/p4-p2p-remote-channel.h"
+#include "ns3/packet.h"
+#include "ns3/simulator.h"
+
+namespace ns3
+{
+
+NS_LOG_COMPONENT_DEFINE("P4P2PRemoteChannel");
+
+NS_OBJECT_ENSURE_REGISTERED(P4P2PRemoteChannel);
+
+TypeId
+P4P2PRemoteChannel::GetTypeId()
+{
+    static TypeId tid = TypeId("ns3::P4P2PRemoteChannel")
+                            .SetParent<P4P2PChannel>()
+                            .SetGroupName("PointToPoint")
+                            .AddConstructor<P4P2PRemoteChannel>();
+    return tid;
+}
+
+P4P2PRemoteChannel::P4P2PRemoteChannel()
+    : P4P2PChannel()
+{
+    NS_LOG_FUNCTION(this);
+}
+
+P4P2PRemoteChannel::~P4P2PRemoteChannel()
+{
+    NS_LOG_FUNCTION(this);
+}
+
+bool
+P4P2PRemoteChannel::TransmitStart(Ptr<const Packet> p, Ptr<CustomP2PNetDevice> src, Time txTime)
+{
+    NS_LOG_FUNCTION(this << p << src);
+    NS_LOG_LOGIC("UID is " << p->GetUid() << ")");
+
+    IsInitialized();
+
+    uint32_t wire = src == GetSource(0) ? 0 : 1;
+    Ptr<CustomP2PNetDevice> dst = GetDestination(wire);
+
+    // The reception time is absolute: the peer rank schedules it on its own
+    // simulator
+    Time rxTime = Simulator::Now() + txTime + GetDelay();
+    MpiInterface::SendPacket(p->Copy(), rxTime, dst->GetNode()->GetId(), dst->GetIfIndex());
+    return true;
+}
+
+} // namespace ns3
@@ -0,0 +1,63 @@
+/*
+ * Copyright (c) 2025 TU Dresden
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Authors: Mingyu Ma <mingyu.ma@tu-dresden.de>
+ */
+
+#ifndef P4_P2P_REMOTE_CHANNEL_H
+#define P4_P2P_REMOTE_CHANNEL_H
+
+#include "ns3/p4-p2p-channel.h"
+
+namespace ns3
+{
+
+/**
+ * @brief P4P2PChannel whose two devices live on different MPI ranks.
+ *
+ * Used by the distributed simulator: instead of scheduling the reception on
+ * the peer device, the packet is handed to the MPI interface with its absolute
+ * reception time, and delivered on the rank of the peer node to the MpiReceiver
+ * aggregated to the peer device (see P4PointToPointHelper).
+ *
+ * The propagation delay of the channel bounds the lookahead of the
+ * distributed simulator, it must not be zero.
+ */
+class P4P2PRemoteChannel : public P4P2PChannel
+{
+  public:
+    /**
+     * @brief Get the TypeId
+     * @return The TypeId for this class
+     */
+    static TypeId GetTypeId();
+
+    P4P2PRemoteChannel();
+    ~P4P2PRemoteChannel() override;
+
+    /**
+     * @brief Transmit a packet to the remote device over MPI
+     * @param p Packet to transmit
+     * @param src Source CustomP2PNetDevice
+     * @param txTime Transmit time to apply
+     * @returns true if successful (currently always true)
+     */
+    bool TransmitStart(Ptr<const Packet> p, Ptr<CustomP2PNetDevice> src, Time txTime) override;
+};
+
+} // namespace ns3
+
+#endif // P4_P2P_REMOTE_CHANNEL_H
@@ -0,0 +1,233 @@
+/*
+ * Copyright (c) 2025 TU Dresden
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Authors: Mingyu Ma <mingyu.ma@tu-dresden.de>
+ */
+
+#include "ns3/global-value.h"
+#include "ns3/log.h"
+#include "ns3/p4-pipeline-engine.h"
+#include "ns3/simulator.h"
+#include "ns3/uinteger.h"
+
+#include <algorithm>
+#include <unordered_map>
+
+namespace ns3
+{
+
+NS_LOG_COMPONENT_DEFINE("P4PipelineEngine");
+
+static GlobalValue g_p4PipelineThreads(
+    "P4PipelineThreads",
+    "Number of threads running the bmv2 pipelines of the P4 switches (0: run them inline, "
+    "without the parallel engine). The results do not depend on the number of threads, but "
+    "can differ from the inline mode: the engine runs the pipelines after the other events "
+    "of the same time.",
+    UintegerValue(0),
+    MakeUintegerChecker<uint32_t>());
+
+P4PipelineEngine* P4PipelineEngine::g_engine = nullptr;
+
+P4PipelineEngine*
+P4PipelineEngine::Get()
+{
+    if (g_engine)
+    {
+        return g_engine;
+    }
+
+    UintegerValue threadsValue;
+    g_p4PipelineThreads.GetValue(threadsValue);
+    if (threadsValue.Get() == 0)
+    {
+        return nullptr;
+    }
+
+    g_engine = new P4PipelineEngine(threadsValue.Get());
+    Simulator::ScheduleDestroy(&P4PipelineEngine::Destroy);
+    return g_engine;
+}
+
+void
+P4PipelineEngine::Destroy()
+{
+    delete g_engine;
+    g_engine = nullptr;
+}
+
+P4PipelineEngine::P4PipelineEngine(size_t nbThreads)
+    : m_generation(0),
+      m_running(0),
+      m_nextGroup(0),
+      m_stop(false)
+{
+    NS_LOG_INFO("Running the P4 pipelines on " << nbThreads << " threads");
+    // the simulator thread takes its share of every flush
+    for (size_t i = 1; i < nbThreads; i++)
+    {
+        m_workers.emplace_back(&P4PipelineEngine::WorkerLoop, this);
+    }
+}
+
+P4PipelineEngine::~P4PipelineEngine()
+{
+    Simulator::Cancel(m_flushEvent);
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = true;
+    }
+    m_start.notify_all();
+    for (auto& worker : m_workers)
+    {
+        worker.join();
+    }
+}
+
+size_t
+P4PipelineEngine::GetNThreads() const
+{
+    return m_workers.size() + 1;
+}
+
+void
+P4PipelineEngine::Submit(const void* owner, Task compute, Task commit)
+{
+    m_jobs.push_back(Job{owner, std::move(compute), std::move(commit)});
+    if (m_flushEvent.IsExpired())
+    {
+        // runs after the events already scheduled now, which may submit jobs too
+        m_flushEvent = Simulator::ScheduleNow(&P4PipelineEngine::Flush, this);
+    }
+}
+
+void
+P4PipelineEngine::Flush()
+{
+    Simulator::Cancel(m_flushEvent);
+    if (m_jobs.empty())
+    {
+        return;
+    }
+
+    // The commit parts may submit new jobs, they go to the next flush
+    m_batch.swap(m_jobs);
+
+    m_groups.clear();
+    std::unordered_map<const void*, size_t> groupOf;
+    for (size_t i = 0; i < m_batch.size(); i++)
+    {
+        auto it = groupOf.emplace(m_batch[i].owner, m_groups.size()).first;
+        if (it->second == m_groups.size())
+        {
+            m_groups.push_back(Group{m_batch[i].owner, {}});
+        }
+        m_groups[it->second].jobs.push_back(i);
+    }
+    NS_LOG_DEBUG("Flushing " << m_batch.size() << " pipeline jobs of " << m_groups.size()
+                             << " switches");
+
+    if (m_workers.empty() || m_groups.size() == 1)
+    {
+        m_nextGroup = 0;
+        RunGroups();
+    }
+    else
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_nextGroup = 0;
+            m_running = m_workers.size();
+            m_generation++;
+        }
+        m_start.notify_all();
+        RunGroups();
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_done.wait(lock, [this]() { return m_running == 0; });
+    }
+
+    if (m_error)
+    {
+        std::exception_ptr error = m_error;
+        m_error = nullptr;
+        m_batch.clear();
+        std::rethrow_exception(error);
+    }
+
+    for (auto& job : m_batch)
+    {
+        job.commit();
+    }
+    m_batch.clear();
+}
+
+void
+P4PipelineEngine::RunGroups()
+{
+    for (;;)
+    {
+        size_t group;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (m_nextGroup >= m_groups.size() || m_error)
+            {
+                return;
+            }
+            group = m_nextGroup++;
+        }
+        try
+        {
+            for (size_t job : m_groups[group].jobs)
+            {
+                m_batch[job].compute();
+            }
+        }
+        catch (...)
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (!m_error)
+            {
+                m_error = std::current_exception();
+            }
+        }
+    }
+}
+
+void
+P4PipelineEngine::WorkerLoop()
+{
+    uint64_t generation = 0;
+    for (;;)
+    {
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_start.wait(lock, [&]() { return m_stop || m_generation != generation; });
+            if (m_stop)
+            {
+                return;
+            }
+            generation = m_generation;
+        }
+        RunGroups();
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_running--;
+        }
+        m_done.notify_one();
+    }
+}
+
+} // namespace ns3
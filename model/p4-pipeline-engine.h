@@ -0,0 +1,158 @@
+/*
+ * Copyright (c) 2025 TU Dresden
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Authors: Mingyu Ma <mingyu.ma@tu-dresden.de>
+ */
+
+#ifndef P4_PIPELINE_ENGINE_H
+#define P4_PIPELINE_ENGINE_H
+
+#include "ns3/event-id.h"
+
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace ns3
+{
+
+/**
+ * @brief Runs the bmv2 pipelines of different switches in parallel.
+ *
+ * The switch cores split the processing of a packet in two parts: the compute
+ * part only runs bmv2 blocks (parser, match-action pipeline, deparser) on the
+ * state of its own switch, the commit part does everything touching ns-3
+ * (queues, events, sending). The cores submit both parts as a job instead of
+ * running them right away.
+ *
+ * The jobs submitted at the same simulation time are run together, by one
+ * event scheduled at that time: the compute parts run on a pool of threads,
+ * the jobs of one switch in order on the same thread, then the commit parts
+ * run on the simulator thread in submission order. No job is delayed and the
+ * result of a simulation does not depend on the number of threads.
+ *
+ * The flush is scheduled with Simulator::ScheduleNow, after the events already
+ * scheduled at that time: the jobs complete later within the timestamp than
+ * the inline pipelines do. The events of one timestamp can then happen in a
+ * different order than in inline mode (e.g. a frame sent by the pipeline of a
+ * switch against the other events of that time), so the two modes can give
+ * different, though each deterministic, results.
+ *
+ * The engine is disabled by default (P4PipelineThreads = 0): the cores then
+ * run their pipelines inline, as before.
+ */
+class P4PipelineEngine
+{
+  public:
+    using Task = std::function<void()>; //!< Compute or commit part of a job
+
+    /**
+     * @brief Get the engine of the simulation
+     * @details Created on first use from the global values, destroyed with
+     * the simulator.
+     * @return the engine, nullptr if parallel pipelines are disabled
+     */
+    static P4PipelineEngine* Get();
+
+    ~P4PipelineEngine();
+
+    /**
+     * @brief Submit a job
+     * @param owner the switch running the job, its jobs are computed in order
+     * @param compute the compute part, may run on any thread
+     * @param commit the commit part, runs on the simulator thread
+     */
+    void Submit(const void* owner, Task compute, Task commit);
+
+    /**
+     * @brief Run all the submitted jobs now
+     */
+    void Flush();
+
+    /**
+     * @brief Get the number of threads computing the jobs
+     * @return the number of threads, including the simulator thread
+     */
+    size_t GetNThreads() const;
+
+    P4PipelineEngine(const P4PipelineEngine&) = delete;
+    P4PipelineEngine& operator=(const P4PipelineEngine&) = delete;
+
+  private:
+    /**
+     * @brief Construct the engine and start its worker threads
+     * @param nbThreads number of threads, including the simulator thread
+     */
+    P4PipelineEngine(size_t nbThreads);
+
+    /**
+     * @brief Destroy the engine of the simulation
+     */
+    static void Destroy();
+
+    /**
+     * @brief Loop of the worker threads
+     */
+    void WorkerLoop();
+
+    /**
+     * @brief Compute the jobs of the switches left in the current flush
+     */
+    void RunGroups();
+
+    /**
+     * @brief A submitted job
+     */
+    struct Job
+    {
+        const void* owner; //!< The switch running the job
+        Task compute;      //!< Compute part
+        Task commit;       //!< Commit part
+    };
+
+    /**
+     * @brief The jobs of one switch in a flush
+     */
+    struct Group
+    {
+        const void* owner;        //!< The switch
+        std::vector<size_t> jobs; //!< Indexes of its jobs, in submission order
+    };
+
+    static P4PipelineEngine* g_engine; //!< Engine of the simulation
+
+    EventId m_flushEvent;        //!< Pending flush
+    std::vector<Job> m_jobs;     //!< Submitted jobs
+    std::vector<Job> m_batch;    //!< Jobs of the current flush
+    std::vector<Group> m_groups; //!< Jobs of the current flush, per switch
+
+    std::vector<std::thread> m_workers; //!< Worker threads
+    std::mutex m_mutex;                 //!< Protects the fields below
+    std::condition_variable m_start;    //!< Signals a new flush to the workers
+    std::condition_variable m_done;     //!< Signals the end of a flush
+    uint64_t m_generation;              //!< Number of flushes handed to the workers
+    size_t m_running;                   //!< Workers still busy with the current flush
+    size_t m_nextGroup;                 //!< Next group to compute
+    bool m_stop;                        //!< Workers must exit
+    std::exception_ptr m_error;         //!< First exception thrown by a compute part
+};
+
+} // namespace ns3
+
+#endif /* P4_PIPELINE_ENGINE_H */
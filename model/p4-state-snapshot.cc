@@ -0,0 +1,1248 @@
+/*
+ * Copyright (c) 2025 TU Dresden
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Authors: Mingyu Ma <mingyu.ma@tu-dresden.de>
+ */
+
+#include "ns3/log.h"
+#include "ns3/p4-state-snapshot.h"
+#include "ns3/p4-switch-core.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <sstream>
+
+NS_LOG_COMPONENT_DEFINE("P4StateSnapshot");
+
+namespace ns3
+{
+
+namespace
+{
+
+const char SNAPSHOT_MAGIC[4] = {'P', '4', 'S', 'S'}; //!< First bytes of a snapshot
+
+/**
+ * @brief Kind of match table, saved with its entries
+ */
+enum TableKind : uint8_t
+{
+    TABLE_SIMPLE = 0,
+    TABLE_INDIRECT,
+    TABLE_INDIRECT_WS
+};
+
+/**
+ * @brief What a table entry (or default entry) runs
+ */
+enum EntryKind : uint8_t
+{
+    ENTRY_NONE = 0,
+    ENTRY_ACTION,
+    ENTRY_MEMBER,
+    ENTRY_GROUP
+};
+
+constexpr uint8_t TABLE_DIRECT_COUNTERS = 0x01; //!< The entries carry direct counters
+constexpr uint8_t TABLE_DIRECT_METERS = 0x02;   //!< The entries carry direct meter rates
+constexpr uint8_t MIRROR_PORT_VALID = 0x01;     //!< The mirroring session has an egress port
+constexpr uint8_t MIRROR_MGID_VALID = 0x02;     //!< The mirroring session has a multicast group
+
+std::string
+MatchError(const char* api, bm::MatchErrorCode rc)
+{
+    return std::string(api) + " failed with error code " + std::to_string(static_cast<int>(rc));
+}
+
+/**
+ * @brief Get the kind of a table from its bmv2 type
+ */
+TableKind
+GetTableKind(const P4ProgramInfo::TableInfo& table)
+{
+    if (table.type == "indirect")
+    {
+        return TABLE_INDIRECT;
+    }
+    if (table.type == "indirect_ws")
+    {
+        return TABLE_INDIRECT_WS;
+    }
+    return TABLE_SIMPLE;
+}
+
+/**
+ * @brief Check whether a direct counter or meter is bound to a table
+ */
+bool
+HasDirect(const std::map<std::string, P4ProgramInfo::ExternInfo>& objects, const std::string& table)
+{
+    return std::any_of(objects.begin(), objects.end(), [&table](const auto& object) {
+        return object.second.isDirect && object.second.binding == table;
+    });
+}
+
+/**
+ * @brief Check whether a bmv2 value, exported as bytes, is zero
+ */
+bool
+IsZero(const std::string& bytes)
+{
+    return std::all_of(bytes.begin(), bytes.end(), [](char byte) { return byte == 0; });
+}
+
+} // namespace
+
+/**
+ * @brief Appends the encoded values to a snapshot
+ */
+class P4StateSnapshot::Writer
+{
+  public:
+    explicit Writer(std::string* data)
+        : m_data(data)
+    {
+    }
+
+    void PutU8(uint8_t value)
+    {
+        m_data->push_back(static_cast<char>(value));
+    }
+
+    void PutVarint(uint64_t value)
+    {
+        while (value >= 0x80)
+        {
+            PutU8(static_cast<uint8_t>(value | 0x80));
+            value >>= 7;
+        }
+        PutU8(static_cast<uint8_t>(value));
+    }
+
+    void PutSigned(int64_t value)
+    {
+        // zigzag: the small negative values stay short
+        PutVarint((static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63));
+    }
+
+    void PutDouble(double value)
+    {
+        uint64_t bits;
+        std::memcpy(&bits, &value, sizeof(bits));
+        for (int i = 0; i < 8; i++)
+        {
+            PutU8(static_cast<uint8_t>(bits >> (8 * i)));
+        }
+    }
+
+    void PutBytes(const std::string& bytes)
+    {
+        PutVarint(bytes.size());
+        m_data->append(bytes);
+    }
+
+    void PutData(const bm::Data& value)
+    {
+        PutBytes(value.get_string());
+    }
+
+    void PutActionData(const bm::ActionData& actionData)
+    {
+        PutVarint(actionData.action_data.size());
+        for (const bm::Data& value : actionData.action_data)
+        {
+            PutData(value);
+        }
+    }
+
+    void PutMatchKey(const std::vector<bm::MatchKeyParam>& matchKey)
+    {
+        PutVarint(matchKey.size());
+        for (const bm::MatchKeyParam& param : matchKey)
+        {
+            PutU8(static_cast<uint8_t>(param.type));
+            PutBytes(param.key);
+            PutBytes(param.mask);
+            PutSigned(param.prefix_length);
+        }
+    }
+
+    void PutMeterRates(const std::vector<bm::Meter::rate_config_t>& rates)
+    {
+        PutVarint(rates.size());
+        for (const bm::Meter::rate_config_t& rate : rates)
+        {
+            PutDouble(rate.info_rate);
+            PutVarint(rate.burst_size);
+        }
+    }
+
+  private:
+    std::string* m_data; //!< The snapshot
+};
+
+/**
+ * @brief Decodes the values of a snapshot
+ * @details A read past the end of the snapshot returns zero values and
+ * marks the reader as failed: the callers check Ok() once per object.
+ */
+class P4StateSnapshot::Reader
+{
+  public:
+    Reader(const std::string& data, size_t offset)
+        : m_data(data),
+          m_pos(offset),
+          m_ok(true)
+    {
+    }
+
+    bool Ok() const
+    {
+        return m_ok;
+    }
+
+    uint8_t GetU8()
+    {
+        if (m_pos >= m_data.size())
+        {
+            m_ok = false;
+            return 0;
+        }
+        return static_cast<uint8_t>(m_data[m_pos++]);
+    }
+
+    uint64_t GetVarint()
+    {
+        uint64_t value = 0;
+        for (unsigned int shift = 0; shift < 64; shift += 7)
+        {
+            uint8_t byte = GetU8();
+            value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+            if (!(byte & 0x80))
+            {
+                return value;
+            }
+        }
+        m_ok = false;
+        return 0;
+    }
+
+    /**
+     * @brief Read a number of items, each encoded on one byte at least
+     */
+    uint64_t GetCount()
+    {
+        uint64_t count = GetVarint();
+        if (count > m_data.size() - std::min(m_pos, m_data.size()))
+        {
+            m_ok = false;
+            return 0;
+        }
+        return count;
+    }
+
+    int64_t GetSigned()
+    {
+        uint64_t value = GetVarint();
+        return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+    }
+
+    double GetDouble()
+    {
+        uint64_t bits = 0;
+        for (int i = 0; i < 8; i++)
+        {
+            bits |= static_cast<uint64_t>(GetU8()) << (8 * i);
+        }
+        double value;
+        std::memcpy(&value, &bits, sizeof(value));
+        return value;
+    }
+
+    std::string GetBytes()
+    {
+        uint64_t size = GetCount();
+        std::string bytes = m_data.substr(std::min(m_pos, m_data.size()), size);
+        m_pos += size;
+        return bytes;
+    }
+
+    bm::Data GetData()
+    {
+        std::string bytes = GetBytes();
+        if (bytes.empty())
+        {
+            return bm::Data(0);
+        }
+        return bm::Data(bytes.data(), static_cast<int>(bytes.size()));
+    }
+
+    bm::ActionData GetActionData()
+    {
+        bm::ActionData actionData;
+        uint64_t count = GetCount();
+        for (uint64_t i = 0; i < count && m_ok; i++)
+        {
+            actionData.push_back_action_data(GetData());
+        }
+        return actionData;
+    }
+
+    std::vector<bm::MatchKeyParam> GetMatchKey()
+    {
+        std::vector<bm::MatchKeyParam> matchKey;
+        uint64_t count = GetCount();
+        for (uint64_t i = 0; i < count && m_ok; i++)
+        {
+            auto type = static_cast<bm::MatchKeyParam::Type>(GetU8());
+            std::string key = GetBytes();
+            std::string mask = GetBytes();
+            int prefixLength = static_cast<int>(GetSigned());
+            matchKey.emplace_back(type, std::move(key), std::move(mask));
+            matchKey.back().prefix_length = prefixLength;
+        }
+        return matchKey;
+    }
+
+    std::vector<bm::Meter::rate_config_t> GetMeterRates()
+    {
+        std::vector<bm::Meter::rate_config_t> rates;
+        uint64_t count = GetCount();
+        for (uint64_t i = 0; i < count && m_ok; i++)
+        {
+            bm::Meter::rate_config_t rate;
+            rate.info_rate = GetDouble();
+            rate.burst_size = GetVarint();
+            rates.push_back(rate);
+        }
+        return rates;
+    }
+
+  private:
+    const std::string& m_data; //!< The snapshot
+    size_t m_pos;              //!< Position of the next value
+    bool m_ok;                 //!< False after a read past the end
+};
+
+P4StateSnapshot::P4StateSnapshot(P4SwitchCore* core,
+                                 const P4ProgramInfo& programInfo,
+                                 uint64_t programHash)
+    : m_core(core),
+      m_programInfo(programInfo),
+      m_programHash(programHash),
+      m_numObjects(0),
+      m_numErrors(0)
+{
+}
+
+uint32_t
+P4StateSnapshot::GetNumObjects() const
+{
+    return m_numObjects;
+}
+
+uint32_t
+P4StateSnapshot::GetNumErrors() const
+{
+    return m_numErrors;
+}
+
+void
+P4StateSnapshot::ReportError(const std::string& error)
+{
+    NS_LOG_ERROR(error);
+    m_numErrors++;
+}
+
+int
+P4StateSnapshot::SaveToFile(const std::string& path)
+{
+    NS_LOG_FUNCTION(this << path);
+
+    std::string data;
+    Save(&data);
+    std::ofstream outfile(path, std::ios::binary | std::ios::trunc);
+    outfile.write(data.data(), data.size());
+    outfile.close();
+    if (!outfile)
+    {
+        NS_LOG_ERROR("Failed to write the switch state to " << path);
+        return 1;
+    }
+    NS_LOG_INFO("Saved " << m_numObjects << " objects in " << data.size() << " bytes to "
+                         << path);
+    return 0;
+}
+
+int
+P4StateSnapshot::LoadFromFile(const std::string& path)
+{
+    NS_LOG_FUNCTION(this << path);
+
+    std::ifstream infile(path, std::ios::binary);
+    if (!infile.good())
+    {
+        NS_LOG_ERROR("Switch state snapshot not found: " << path);
+        m_numErrors++;
+        return 1;
+    }
+    std::ostringstream content;
+    content << infile.rdbuf();
+
+    uint32_t errorsBefore = m_numErrors;
+    std::string error;
+    if (!Restore(content.str(), &error))
+    {
+        NS_LOG_ERROR(path << ": " << error);
+        m_numErrors++;
+        return 1;
+    }
+    NS_LOG_INFO("Restored " << m_numObjects << " objects from " << path << ", "
+                            << (m_numErrors - errorsBefore) << " failed");
+    return (m_numErrors == errorsBefore) ? 0 : 1;
+}
+
+void
+P4StateSnapshot::Save(std::string* data)
+{
+    NS_LOG_FUNCTION(this);
+
+    data->assign(SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC));
+    m_numObjects = 0;
+    Writer out(data);
+    out.PutU8(VERSION);
+    out.PutVarint(m_programHash);
+
+    // The action profiles come first: the indirect entries refer to them
+    SaveActionProfiles(out);
+    SaveTables(out);
+    SaveRegisters(out);
+    SaveCounters(out);
+    SaveMeters(out);
+    SaveMirroring(out);
+    out.PutU8(SECTION_END);
+}
+
+bool
+P4StateSnapshot::Restore(const std::string& data, std::string* error)
+{
+    NS_LOG_FUNCTION(this);
+
+    m_numObjects = 0;
+    m_members.clear();
+    m_groups.clear();
+    if (data.compare(0, sizeof(SNAPSHOT_MAGIC), SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC)) != 0)
+    {
+        *error = "not a switch state snapshot";
+        return false;
+    }
+    Reader in(data, sizeof(SNAPSHOT_MAGIC));
+    uint8_t version = in.GetU8();
+    uint64_t programHash = in.GetVarint();
+    if (!in.Ok() || version != VERSION)
+    {
+        *error = "unsupported snapshot version " + std::to_string(version);
+        return false;
+    }
+    if (programHash != m_programHash)
+    {
+        *error = "the snapshot was taken with another P4 program";
+        return false;
+    }
+
+    for (;;)
+    {
+        bool ok;
+        uint8_t section = in.GetU8();
+        switch (section)
+        {
+        case SECTION_END:
+            ok = in.Ok();
+            break;
+        case SECTION_ACTION_PROFILES:
+            ok = RestoreActionProfiles(in);
+            break;
+        case SECTION_TABLES:
+            ok = RestoreTables(in);
+            break;
+        case SECTION_REGISTERS:
+            ok = RestoreRegisters(in);
+            break;
+        case SECTION_COUNTERS:
+            ok = RestoreCounters(in);
+            break;
+        case SECTION_METERS:
+            ok = RestoreMeters(in);
+            break;
+        case SECTION_MIRRORING:
+            ok = RestoreMirroring(in);
+            break;
+        default:
+            *error = "unknown snapshot section " + std::to_string(section);
+            return false;
+        }
+        if (!ok)
+        {
+            *error = "truncated or malformed snapshot";
+            return false;
+        }
+        if (section == SECTION_END)
+        {
+            return true;
+        }
+    }
+}
+
+void
+P4StateSnapshot::SaveActionProfiles(Writer& out)
+{
+    const auto& profiles = m_programInfo.GetActionProfiles();
+    out.PutU8(SECTION_ACTION_PROFILES);
+    out.PutVarint(profiles.size());
+    for (const auto& it : profiles)
+    {
+        const std::string& name = it.first;
+        out.PutBytes(name);
+
+        std::vector<bm::ActionProfile::Member> members = m_core->mt_act_prof_get_members(0, name);
+        out.PutVarint(members.size());
+        for (const auto& member : members)
+        {
+            out.PutVarint(member.mbr);
+            out.PutBytes(member.action_fn->get_name());
+            out.PutActionData(member.action_data);
+        }
+
+        std::vector<bm::ActionProfile::Group> groups = m_core->mt_act_prof_get_groups(0, name);
+        out.PutVarint(groups.size());
+        for (const auto& group : groups)
+        {
+            out.PutVarint(group.grp);
+            out.PutVarint(group.mbr_handles.size());
+            for (auto member : group.mbr_handles)
+            {
+                out.PutVarint(member);
+            }
+        }
+        m_numObjects += members.size() + groups.size();
+    }
+}
+
+bool
+P4StateSnapshot::RestoreActionProfiles(Reader& in)
+{
+    uint64_t nbProfiles = in.GetCount();
+    for (uint64_t i = 0; i < nbProfiles && in.Ok(); i++)
+    {
+        std::string name = in.GetBytes();
+        bool known = m_programInfo.GetActionProfiles().count(name) != 0;
+        if (!known && in.Ok())
+        {
+            ReportError("unknown action profile " + name);
+        }
+
+        std::map<uint64_t, uint64_t>& members = m_members[name];
+        uint64_t nbMembers = in.GetCount();
+        for (uint64_t j = 0; j < nbMembers && in.Ok(); j++)
+        {
+            uint64_t oldMember = in.GetVarint();
+            std::string action = in.GetBytes();
+            bm::ActionData actionData = in.GetActionData();
+            if (!known || !in.Ok())
+            {
+                continue;
+            }
+            bm::RuntimeInterface::mbr_hdl_t member;
+            bm::MatchErrorCode rc =
+                m_core->mt_act_prof_add_member(0, name, action, std::move(actionData), &member);
+            if (rc != bm::MatchErrorCode::SUCCESS)
+            {
+                ReportError(name + ": " + MatchError("mt_act_prof_add_member", rc));
+                continue;
+            }
+            members[oldMember] = member;
+            m_numObjects++;
+        }
+
+        std::map<uint64_t, uint64_t>& groups = m_groups[name];
+        uint64_t nbGroups = in.GetCount();
+        for (uint64_t j = 0; j < nbGroups && in.Ok(); j++)
+        {
+            uint64_t oldGroup = in.GetVarint();
+            std::vector<uint64_t> groupMembers(in.GetCount());
+            for (auto& member : groupMembers)
+            {
+                member = in.GetVarint();
+            }
+            if (!known || !in.Ok())
+            {
+                continue;
+            }
+            bm::RuntimeInterface::grp_hdl_t group;
+            bm::MatchErrorCode rc = m_core->mt_act_prof_create_group(0, name, &group);
+            if (rc != bm::MatchErrorCode::SUCCESS)
+            {
+                ReportError(name + ": " + MatchError("mt_act_prof_create_group", rc));
+                continue;
+            }
+            groups[oldGroup] = group;
+            m_numObjects++;
+            for (uint64_t member : groupMembers)
+            {
+                auto it = members.find(member);
+                rc = (it != members.end())
+                         ? m_core->mt_act_prof_add_member_to_group(0, name, it->second, group)
+                         : bm::MatchErrorCode::INVALID_MBR_HANDLE;
+                if (rc != bm::MatchErrorCode::SUCCESS)
+                {
+                    ReportError(name + ": " + MatchError("mt_act_prof_add_member_to_group", rc));
+                }
+            }
+        }
+    }
+    return in.Ok();
+}
+
+void
+P4StateSnapshot::SaveTables(Writer& out)
+{
+    using mbr_hdl_t = bm::RuntimeInterface::mbr_hdl_t;
+
+    const auto& tables = m_programInfo.GetTables();
+    out.PutU8(SECTION_TABLES);
+    out.PutVarint(tables.size());
+    for (const auto& it : tables)
+    {
+        const P4ProgramInfo::TableInfo& table = it.second;
+        TableKind kind = GetTableKind(table);
+        uint8_t flags = 0;
+        if (HasDirect(m_programInfo.GetCounters(), table.name))
+        {
+            flags |= TABLE_DIRECT_COUNTERS;
+        }
+        if (HasDirect(m_programInfo.GetMeters(), table.name))
+        {
+            flags |= TABLE_DIRECT_METERS;
+        }
+        out.PutBytes(table.name);
+        out.PutU8(kind);
+        out.PutU8(flags);
+
+        // The direct counters and meter rates follow each entry
+        auto putDirect = [&](bm::entry_handle_t handle) {
+            if (flags & TABLE_DIRECT_COUNTERS)
+            {
+                bm::MatchTableAbstract::counter_value_t bytes = 0;
+                bm::MatchTableAbstract::counter_value_t packets = 0;
+                m_core->mt_read_counters(0, table.name, handle, &bytes, &packets);
+                out.PutVarint(bytes);
+                out.PutVarint(packets);
+            }
+            if (flags & TABLE_DIRECT_METERS)
+            {
+                std::vector<bm::Meter::rate_config_t> rates;
+                m_core->mt_get_meter_rates(0, table.name, handle, &rates);
+                out.PutMeterRates(rates);
+            }
+        };
+        // The entries of an action selector point to a member or to a group,
+        // bmv2 gives the entries pointing to a group the maximum member handle
+        auto putIndirect = [&](mbr_hdl_t member, bm::RuntimeInterface::grp_hdl_t group) {
+            if (kind == TABLE_INDIRECT_WS && member == std::numeric_limits<mbr_hdl_t>::max())
+            {
+                out.PutU8(ENTRY_GROUP);
+                out.PutVarint(group);
+            }
+            else
+            {
+                out.PutU8(ENTRY_MEMBER);
+                out.PutVarint(member);
+            }
+        };
+
+        if (kind == TABLE_SIMPLE)
+        {
+            bm::MatchTable::Entry defaultEntry;
+            if (m_core->mt_get_default_entry(0, table.name, &defaultEntry) ==
+                    bm::MatchErrorCode::SUCCESS &&
+                defaultEntry.action_fn)
+            {
+                out.PutU8(ENTRY_ACTION);
+                out.PutBytes(defaultEntry.action_fn->get_name());
+                out.PutActionData(defaultEntry.action_data);
+            }
+            else
+            {
+                out.PutU8(ENTRY_NONE);
+            }
+
+            std::vector<bm::MatchTable::Entry> entries = m_core->mt_get_entries(0, table.name);
+            out.PutVarint(entries.size());
+            for (const auto& entry : entries)
+            {
+                out.PutMatchKey(entry.match_key);
+                out.PutSigned(entry.priority);
+                out.PutVarint(entry.timeout_ms);
+                out.PutU8(ENTRY_ACTION);
+                out.PutBytes(entry.action_fn->get_name());
+                out.PutActionData(entry.action_data);
+                putDirect(entry.handle);
+            }
+            m_numObjects += entries.size();
+        }
+        else if (kind == TABLE_INDIRECT)
+        {
+            bm::MatchTableIndirect::Entry defaultEntry;
+            if (m_core->mt_indirect_get_default_entry(0, table.name, &defaultEntry) ==
+                bm::MatchErrorCode::SUCCESS)
+            {
+                putIndirect(defaultEntry.mbr, 0);
+            }
+            else
+            {
+                out.PutU8(ENTRY_NONE);
+            }
+
+            std::vector<bm::MatchTableIndirect::Entry> entries =
+                m_core->mt_indirect_get_entries(0, table.name);
+            out.PutVarint(entries.size());
+            for (const auto& entry : entries)
+            {
+                out.PutMatchKey(entry.match_key);
+                out.PutSigned(entry.priority);
+                out.PutVarint(entry.timeout_ms);
+                putIndirect(entry.mbr, 0);
+                putDirect(entry.handle);
+            }
+            m_numObjects += entries.size();
+        }
+        else
+        {
+            bm::MatchTableIndirectWS::Entry defaultEntry;
+            if (m_core->mt_indirect_ws_get_default_entry(0, table.name, &defaultEntry) ==
+                bm::MatchErrorCode::SUCCESS)
+            {
+                putIndirect(defaultEntry.mbr, defaultEntry.grp);
+            }
+            else
+            {
+                out.PutU8(ENTRY_NONE);
+            }
+
+            std::vector<bm::MatchTableIndirectWS::Entry> entries =
+                m_core->mt_indirect_ws_get_entries(0, table.name);
+            out.PutVarint(entries.size());
+            for (const auto& entry : entries)
+            {
+                out.PutMatchKey(entry.match_key);
+                out.PutSigned(entry.priority);
+                out.PutVarint(entry.timeout_ms);
+                putIndirect(entry.mbr, entry.grp);
+                putDirect(entry.handle);
+            }
+            m_numObjects += entries.size();
+        }
+    }
+}
+
+bool
+P4StateSnapshot::RestoreTables(Reader& in)
+{
+    uint64_t nbTables = in.GetCount();
+    for (uint64_t i = 0; i < nbTables && in.Ok(); i++)
+    {
+        std::string name = in.GetBytes();
+        uint8_t kind = in.GetU8();
+        uint8_t flags = in.GetU8();
+        auto tableIt = m_programInfo.GetTables().find(name);
+        bool known = tableIt != m_programInfo.GetTables().end() &&
+                     GetTableKind(tableIt->second) == kind;
+        if (!known && in.Ok())
+        {
+            ReportError("unknown table " + name);
+        }
+        const std::string actionProfile = known ? tableIt->second.actionProfile : "";
+
+        // Member or group handle of an indirect entry in the restored switch
+        auto readIndirect = [&](uint8_t entryKind, uint64_t* handle) {
+            uint64_t oldHandle = in.GetVarint();
+            auto& handles = (entryKind == ENTRY_GROUP) ? m_groups[actionProfile]
+                                                       : m_members[actionProfile];
+            auto it = handles.find(oldHandle);
+            if (it == handles.end())
+            {
+                return false;
+            }
+            *handle = it->second;
+            return true;
+        };
+
+        // Default entry
+        uint8_t defaultKind = in.GetU8();
+        if (defaultKind == ENTRY_ACTION)
+        {
+            std::string action = in.GetBytes();
+            bm::ActionData actionData = in.GetActionData();
+            // The default action of the program may be const, only set it if changed
+            bm::MatchTable::Entry current;
+            bool unchanged = known &&
+                             m_core->mt_get_default_entry(0, name, &current) ==
+                                 bm::MatchErrorCode::SUCCESS &&
+                             current.action_fn && current.action_fn->get_name() == action &&
+                             current.action_data.action_data == actionData.action_data;
+            if (known && in.Ok() && !unchanged)
+            {
+                bm::MatchErrorCode rc =
+                    m_core->mt_set_default_action(0, name, action, std::move(actionData));
+                if (rc != bm::MatchErrorCode::SUCCESS)
+                {
+                    ReportError(name + ": " + MatchError("mt_set_default_action", rc));
+                }
+            }
+        }
+        else if (defaultKind == ENTRY_MEMBER || defaultKind == ENTRY_GROUP)
+        {
+            uint64_t handle;
+            bool found = readIndirect(defaultKind, &handle);
+            if (known && in.Ok())
+            {
+                bm::MatchErrorCode rc;
+                if (defaultKind == ENTRY_GROUP)
+                {
+                    rc = found ? m_core->mt_indirect_ws_set_default_group(0, name, handle)
+                               : bm::MatchErrorCode::INVALID_GRP_HANDLE;
+                }
+                else
+                {
+                    rc = found ? m_core->mt_indirect_set_default_member(0, name, handle)
+                               : bm::MatchErrorCode::INVALID_MBR_HANDLE;
+                }
+                if (rc != bm::MatchErrorCode::SUCCESS)
+                {
+                    ReportError(name + ": " + MatchError("setting the default entry", rc));
+                }
+            }
+        }
+        else if (defaultKind != ENTRY_NONE)
+        {
+            return false;
+        }
+
+        // Entries
+        uint64_t nbEntries = in.GetCount();
+        for (uint64_t j = 0; j < nbEntries && in.Ok(); j++)
+        {
+            std::vector<bm::MatchKeyParam> matchKey = in.GetMatchKey();
+            int priority = static_cast<int>(in.GetSigned());
+            uint64_t timeoutMs = in.GetVarint();
+            uint8_t entryKind = in.GetU8();
+
+            bm::entry_handle_t handle = 0;
+            bm::MatchErrorCode rc = bm::MatchErrorCode::SUCCESS;
+            const char* api = "mt_add_entry";
+            if (entryKind == ENTRY_ACTION)
+            {
+                std::string action = in.GetBytes();
+                bm::ActionData actionData = in.GetActionData();
+                if (known && in.Ok())
+                {
+                    rc = m_core->mt_add_entry(0,
+                                              name,
+                                              matchKey,
+                                              action,
+                                              std::move(actionData),
+                                              &handle,
+                                              priority);
+                }
+            }
+            else if (entryKind == ENTRY_MEMBER || entryKind == ENTRY_GROUP)
+            {
+                uint64_t target;
+                bool found = readIndirect(entryKind, &target);
+                api = (entryKind == ENTRY_GROUP) ? "mt_indirect_ws_add_entry"
+                                                 : "mt_indirect_add_entry";
+                if (!found)
+                {
+                    rc = (entryKind == ENTRY_GROUP) ? bm::MatchErrorCode::INVALID_GRP_HANDLE
+                                                    : bm::MatchErrorCode::INVALID_MBR_HANDLE;
+                }
+                else if (known && in.Ok() && entryKind == ENTRY_GROUP)
+                {
+                    rc = m_core->mt_indirect_ws_add_entry(0,
+                                                          name,
+                                                          matchKey,
+                                                          target,
+                                                          &handle,
+                                                          priority);
+                }
+                else if (known && in.Ok())
+                {
+                    rc = m_core->mt_indirect_add_entry(0, name, matchKey, target, &handle, priority);
+                }
+            }
+            else
+            {
+                return false;
+            }
+
+            bm::MatchTableAbstract::counter_value_t bytes = 0;
+            bm::MatchTableAbstract::counter_value_t packets = 0;
+            std::vector<bm::Meter::rate_config_t> rates;
+            if (flags & TABLE_DIRECT_COUNTERS)
+            {
+                bytes = in.GetVarint();
+                packets = in.GetVarint();
+            }
+            if (flags & TABLE_DIRECT_METERS)
+            {
+                rates = in.GetMeterRates();
+            }
+            if (!known || !in.Ok())
+            {
+                continue;
+            }
+            if (rc == bm::MatchErrorCode::DUPLICATE_ENTRY ||
+                rc == bm::MatchErrorCode::IMMUTABLE_TABLE_ENTRIES)
+            {
+                // an entry of the program itself, already in the switch
+                NS_LOG_DEBUG("Entry of " << name << " already in the switch");
+                continue;
+            }
+            if (rc != bm::MatchErrorCode::SUCCESS)
+            {
+                ReportError(name + ": " + MatchError(api, rc));
+                continue;
+            }
+            m_numObjects++;
+
+            if (timeoutMs > 0)
+            {
+                auto ttlMs = static_cast<unsigned int>(timeoutMs);
+                rc = m_core->mt_set_entry_ttl(0, name, handle, ttlMs);
+                if (rc != bm::MatchErrorCode::SUCCESS)
+                {
+                    ReportError(name + ": " + MatchError("mt_set_entry_ttl", rc));
+                }
+            }
+            if ((flags & TABLE_DIRECT_COUNTERS) && (bytes || packets))
+            {
+                rc = m_core->mt_write_counters(0, name, handle, bytes, packets);
+                if (rc != bm::MatchErrorCode::SUCCESS)
+                {
+                    ReportError(name + ": " + MatchError("mt_write_counters", rc));
+                }
+            }
+            if (!rates.empty())
+            {
+                rc = m_core->mt_set_meter_rates(0, name, handle, rates);
+                if (rc != bm::MatchErrorCode::SUCCESS)
+                {
+                    ReportError(name + ": " + MatchError("mt_set_meter_rates", rc));
+                }
+            }
+        }
+    }
+    return in.Ok();
+}
+
+void
+P4StateSnapshot::SaveRegisters(Writer& out)
+{
+    const auto& registers = m_programInfo.GetRegisters();
+    out.PutU8(SECTION_REGISTERS);
+    out.PutVarint(registers.size());
+    for (const auto& it : registers)
+    {
+        const std::string& name = it.first;
+        out.PutBytes(name);
+
+        // Only the non-zero cells, each index as the gap from the previous one
+        std::vector<std::pair<size_t, std::string>> cells;
+        std::vector<bm::Data> values = m_core->register_read_all(0, name);
+        for (size_t index = 0; index < values.size(); index++)
+        {
+            std::string bytes = values[index].get_string();
+            if (!IsZero(bytes))
+            {
+                cells.emplace_back(index, std::move(bytes));
+            }
+        }
+        out.PutVarint(cells.size());
+        size_t next = 0;
+        for (const auto& cell : cells)
+        {
+            out.PutVarint(cell.first - next);
+            out.PutBytes(cell.second);
+            next = cell.first + 1;
+        }
+        m_numObjects += cells.size();
+    }
+}
+
+bool
+P4StateSnapshot::RestoreRegisters(Reader& in)
+{
+    uint64_t nbRegisters = in.GetCount();
+    for (uint64_t i = 0; i < nbRegisters && in.Ok(); i++)
+    {
+        std::string name = in.GetBytes();
+        bool known = m_programInfo.GetRegisters().count(name) != 0;
+        if (!known && in.Ok())
+        {
+            ReportError("unknown register " + name);
+        }
+
+        uint64_t nbCells = in.GetCount();
+        uint64_t index = 0;
+        for (uint64_t j = 0; j < nbCells && in.Ok(); j++, index++)
+        {
+            index += in.GetVarint();
+            bm::Data value = in.GetData();
+            if (!known || !in.Ok())
+            {
+                continue;
+            }
+            if (m_core->register_write(0, name, index, std::move(value)) !=
+                bm::Register::RegisterErrorCode::SUCCESS)
+            {
+                ReportError("register_write failed for " + name + "[" + std::to_string(index) +
+                            "]");
+                continue;
+            }
+            m_numObjects++;
+        }
+    }
+    return in.Ok();
+}
+
+void
+P4StateSnapshot::SaveCounters(Writer& out)
+{
+    // The direct counters are saved with the entries of their table
+    std::vector<const P4ProgramInfo::ExternInfo*> counters;
+    for (const auto& it : m_programInfo.GetCounters())
+    {
+        if (!it.second.isDirect)
+        {
+            counters.push_back(&it.second);
+        }
+    }
+
+    out.PutU8(SECTION_COUNTERS);
+    out.PutVarint(counters.size());
+    for (const P4ProgramInfo::ExternInfo* counter : counters)
+    {
+        out.PutBytes(counter->name);
+
+        struct Cell
+        {
+            size_t index;
+            bm::MatchTableAbstract::counter_value_t bytes;
+            bm::MatchTableAbstract::counter_value_t packets;
+        };
+
+        std::vector<Cell> cells;
+        for (size_t index = 0; index < counter->size; index++)
+        {
+            Cell cell{index, 0, 0};
+            if (m_core->read_counters(0, counter->name, index, &cell.bytes, &cell.packets) ==
+                    bm::Counter::CounterErrorCode::SUCCESS &&
+                (cell.bytes || cell.packets))
+            {
+                cells.push_back(cell);
+            }
+        }
+        out.PutVarint(cells.size());
+        size_t next = 0;
+        for (const Cell& cell : cells)
+        {
+            out.PutVarint(cell.index - next);
+            out.PutVarint(cell.bytes);
+            out.PutVarint(cell.packets);
+            next = cell.index + 1;
+        }
+        m_numObjects += cells.size();
+    }
+}
+
+bool
+P4StateSnapshot::RestoreCounters(Reader& in)
+{
+    uint64_t nbCounters = in.GetCount();
+    for (uint64_t i = 0; i < nbCounters && in.Ok(); i++)
+    {
+        std::string name = in.GetBytes();
+        auto counterIt = m_programInfo.GetCounters().find(name);
+        bool known =
+            counterIt != m_programInfo.GetCounters().end() && !counterIt->second.isDirect;
+        if (!known && in.Ok())
+        {
+            ReportError("unknown counter " + name);
+        }
+
+        uint64_t nbCells = in.GetCount();
+        uint64_t index = 0;
+        for (uint64_t j = 0; j < nbCells && in.Ok(); j++, index++)
+        {
+            index += in.GetVarint();
+            uint64_t bytes = in.GetVarint();
+            uint64_t packets = in.GetVarint();
+            if (!known || !in.Ok())
+            {
+                continue;
+            }
+            if (m_core->write_counters(0, name, index, bytes, packets) !=
+                bm::Counter::CounterErrorCode::SUCCESS)
+            {
+                ReportError("write_counters failed for " + name + "[" + std::to_string(index) +
+                            "]");
+                continue;
+            }
+            m_numObjects++;
+        }
+    }
+    return in.Ok();
+}
+
+void
+P4StateSnapshot::SaveMeters(Writer& out)
+{
+    // The direct meters are saved with the entries of their table
+    std::vector<const P4ProgramInfo::ExternInfo*> meters;
+    for (const auto& it : m_programInfo.GetMeters())
+    {
+        if (!it.second.isDirect)
+        {
+            meters.push_back(&it.second);
+        }
+    }
+
+    out.PutU8(SECTION_METERS);
+    out.PutVarint(meters.size());
+    for (const P4ProgramInfo::ExternInfo* meter : meters)
+    {
+        out.PutBytes(meter->name);
+
+        // Only the configured meters
+        std::vector<std::pair<size_t, std::vector<bm::Meter::rate_config_t>>> cells;
+        for (size_t index = 0; index < meter->size; index++)
+        {
+            std::vector<bm::Meter::rate_config_t> rates;
+            if (m_core->meter_get_rates(0, meter->name, index, &rates) ==
+                    bm::Meter::MeterErrorCode::SUCCESS &&
+                !rates.empty())
+            {
+                cells.emplace_back(index, std::move(rates));
+            }
+        }
+        out.PutVarint(cells.size());
+        size_t next = 0;
+        for (const auto& cell : cells)
+        {
+            out.PutVarint(cell.first - next);
+            out.PutMeterRates(cell.second);
+            next = cell.first + 1;
+        }
+        m_numObjects += cells.size();
+    }
+}
+
+bool
+P4StateSnapshot::RestoreMeters(Reader& in)
+{
+    uint64_t nbMeters = in.GetCount();
+    for (uint64_t i = 0; i < nbMeters && in.Ok(); i++)
+    {
+        std::string name = in.GetBytes();
+        auto meterIt = m_programInfo.GetMeters().find(name);
+        bool known = meterIt != m_programInfo.GetMeters().end() && !meterIt->second.isDirect;
+        if (!known && in.Ok())
+        {
+            ReportError("unknown meter " + name);
+        }
+
+        uint64_t nbCells = in.GetCount();
+        uint64_t index = 0;
+        for (uint64_t j = 0; j < nbCells && in.Ok(); j++, index++)
+        {
+            index += in.GetVarint();
+            std::vector<bm::Meter::rate_config_t> rates = in.GetMeterRates();
+            if (!known || !in.Ok())
+            {
+                continue;
+            }
+            if (m_core->meter_set_rates(0, name, index, rates) !=
+                bm::Meter::MeterErrorCode::SUCCESS)
+            {
+                ReportError("meter_set_rates failed for " + name + "[" + std::to_string(index) +
+                            "]");
+                continue;
+            }
+            m_numObjects++;
+        }
+    }
+    return in.Ok();
+}
+
+void
+P4StateSnapshot::SaveMirroring(Writer& out)
+{
+    std::map<int, P4SwitchCore::MirroringSessionConfig> sessions =
+        m_core->GetMirroringSessions();
+    out.PutU8(SECTION_MIRRORING);
+    out.PutVarint(sessions.size());
+    for (const auto& it : sessions)
+    {
+        const P4SwitchCore::MirroringSessionConfig& config = it.second;
+        out.PutVarint(it.first);
+        out.PutU8((config.egress_port_valid ? MIRROR_PORT_VALID : 0) |
+                  (config.mgid_valid ? MIRROR_MGID_VALID : 0));
+        out.PutVarint(config.egress_port_valid ? config.egress_port : 0);
+        out.PutVarint(config.mgid_valid ? config.mgid : 0);
+    }
+    m_numObjects += sessions.size();
+}
+
+bool
+P4StateSnapshot::RestoreMirroring(Reader& in)
+{
+    uint64_t nbSessions = in.GetCount();
+    for (uint64_t i = 0; i < nbSessions && in.Ok(); i++)
+    {
+        uint64_t mirrorId = in.GetVarint();
+        uint8_t flags = in.GetU8();
+        P4SwitchCore::MirroringSessionConfig config = {};
+        config.egress_port = static_cast<uint32_t>(in.GetVarint());
+        config.egress_port_valid = (flags & MIRROR_PORT_VALID) != 0;
+        config.mgid = static_cast<unsigned int>(in.GetVarint());
+        config.mgid_valid = (flags & MIRROR_MGID_VALID) != 0;
+        if (!in.Ok())
+        {
+            break;
+        }
+        if (!m_core->AddMirroringSession(static_cast<int>(mirrorId), config))
+        {
+            ReportError("mirror id " + std::to_string(mirrorId) + " out of range");
+            continue;
+        }
+        m_numObjects++;
+    }
+    return in.Ok();
+}
+
+} // namespace ns3
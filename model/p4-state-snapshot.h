@@ -0,0 +1,168 @@
+/*
+ * Copyright (c) 2025 TU Dresden
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Authors: Mingyu Ma <mingyu.ma@tu-dresden.de>
+ */
+
+#ifndef P4_STATE_SNAPSHOT_H
+#define P4_STATE_SNAPSHOT_H
+
+#include "ns3/p4-program-info.h"
+
+#include <cstdint>
+#include <map>
+#include <string>
+
+namespace ns3
+{
+
+class P4SwitchCore;
+
+/**
+ * @brief Checkpoint of the runtime state of a switch core.
+ *
+ * A snapshot holds the state a run builds up in the switch: the table
+ * entries and default actions, the members and groups of the action profiles,
+ * the register, counter and meter arrays, the direct counters and meters of
+ * the entries and the mirroring sessions. Restoring it into a switch running
+ * the same P4 program replaces loading the flow table file, and skips the
+ * warm-up of the registers and of the learned state.
+ *
+ * The snapshot is a compact binary file per switch: the magic "P4SS", a
+ * format version and the hash of the P4 program, then one section per kind of
+ * object. The integers are LEB128 varints, the byte strings and bmv2 values
+ * are prefixed by their length, and the register and counter arrays only keep
+ * their non-zero cells. The state is read and written through the runtime
+ * interface of the switch, like P4FlowTableLoader does.
+ *
+ * The entry, member and group handles are renumbered by the restore. The
+ * token buckets of the meters restart full (only their rates are saved), and
+ * the multicast groups of the PRE are not part of the snapshot: they only
+ * change through the runtime CLI, and P4SwitchNetDevice applies the mc_*
+ * commands of the flow table file again after a restore.
+ */
+class P4StateSnapshot
+{
+  public:
+    static constexpr uint8_t VERSION = 1; //!< Version of the snapshot format
+
+    /**
+     * @brief Construct a new state snapshot
+     * @param core the switch core the state is read from or restored into
+     * @param programInfo the description of the P4 program loaded in the core
+     * @param programHash the hash of the P4 program, see P4JsonCache::Hash
+     */
+    P4StateSnapshot(P4SwitchCore* core, const P4ProgramInfo& programInfo, uint64_t programHash);
+
+    /**
+     * @brief Save the state of the switch into a snapshot
+     * @param data set to the snapshot
+     */
+    void Save(std::string* data);
+
+    /**
+     * @brief Restore the state of the switch from a snapshot
+     * @details An object the switch rejects is reported and skipped, the
+     * restore goes on with the next one.
+     * @param data the snapshot
+     * @param error set to a description of the problem on failure
+     * @return false if the snapshot is malformed or was taken with another P4 program
+     */
+    bool Restore(const std::string& data, std::string* error);
+
+    /**
+     * @brief Save the state of the switch into a snapshot file
+     * @param path the path to the file
+     * @return int 0 if successful, 1 otherwise
+     */
+    int SaveToFile(const std::string& path);
+
+    /**
+     * @brief Restore the state of the switch from a snapshot file
+     * @param path the path to the file
+     * @return int 0 if all the state was restored, 1 otherwise
+     */
+    int LoadFromFile(const std::string& path);
+
+    /**
+     * @brief Get the number of objects saved or restored
+     * @details Table entries, members, groups, non-zero cells and mirroring
+     * sessions.
+     * @return the number of objects
+     */
+    uint32_t GetNumObjects() const;
+
+    /**
+     * @brief Get the number of objects the switch rejected in a restore
+     * @return the number of errors
+     */
+    uint32_t GetNumErrors() const;
+
+  private:
+    class Writer; //!< Encodes a snapshot
+    class Reader; //!< Decodes a snapshot
+
+    /**
+     * @brief Sections of a snapshot, in file order
+     */
+    enum Section : uint8_t
+    {
+        SECTION_END = 0,
+        SECTION_ACTION_PROFILES,
+        SECTION_TABLES,
+        SECTION_REGISTERS,
+        SECTION_COUNTERS,
+        SECTION_METERS,
+        SECTION_MIRRORING
+    };
+
+    // Save one section
+    void SaveActionProfiles(Writer& out);
+    void SaveTables(Writer& out);
+    void SaveRegisters(Writer& out);
+    void SaveCounters(Writer& out);
+    void SaveMeters(Writer& out);
+    void SaveMirroring(Writer& out);
+
+    // Restore one section, false if the section is malformed
+    bool RestoreActionProfiles(Reader& in);
+    bool RestoreTables(Reader& in);
+    bool RestoreRegisters(Reader& in);
+    bool RestoreCounters(Reader& in);
+    bool RestoreMeters(Reader& in);
+    bool RestoreMirroring(Reader& in);
+
+    /**
+     * @brief Report an object the switch rejected
+     * @param error the description of the problem
+     */
+    void ReportError(const std::string& error);
+
+    P4SwitchCore* m_core;               //!< The switch core
+    const P4ProgramInfo& m_programInfo; //!< P4 program description
+    uint64_t m_programHash;             //!< Hash of the P4 program
+    uint32_t m_numObjects;              //!< Number of objects saved or restored
+    uint32_t m_numErrors;               //!< Number of objects rejected
+
+    //! Old to new member handles of the action profiles, filled by the restore
+    std::map<std::string, std::map<uint64_t, uint64_t>> m_members;
+    //! Old to new group handles of the action profiles, filled by the restore
+    std::map<std::string, std::map<uint64_t, uint64_t>> m_groups;
+};
+
+} // namespace ns3
+
+#endif /* P4_STATE_SNAPSHOT_H */
@@ -34,13 +34,19 @@
 #undef LOG_DEBUG
 
 #include "ns3/log.h"
+#include "ns3/p4-flow-table-loader.h"
+#include "ns3/p4-program-info.h"
+#include "ns3/p4-state-snapshot.h"
 #include "ns3/p4-switch-core.h"
 #include "ns3/p4-switch-net-device.h"
 #include "ns3/simulator.h"
 
 #include <bm/bm_runtime/bm_runtime.h>
+#include <bm/bm_sim/logger.h>
+#include <algorithm>
 #include <bm/bm_sim/options_parse.h>
 #include <fstream>
+#include <mutex>
 
 NS_LOG_COMPONENT_DEFINE("P4SwitchCore");
 
@@ -49,6 +55,20 @@ namespace ns3
 
 static constexpr uint16_t MAX_MIRROR_SESSION_ID = (1u << 15) - 1;
 
+/**
+ * @brief Read-only stream buffer over a string, used to feed the cached JSON
+ * text to bmv2 without copying it for every switch
+ */
+class ConstStringBuf : public std::streambuf
+{
+  public:
+    explicit ConstStringBuf(const std::string& str)
+    {
+        char* begin = const_cast<char*>(str.data());
+        setg(begin, begin, begin + str.size());
+    }
+};
+
 class P4SwitchCore::MirroringSessions
 {
   public:
@@ -91,6 +111,12 @@ class P4SwitchCore::MirroringSessions
         }
     }
 
+    std::map<int, MirroringSessionConfig> get_sessions() const
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return std::map<int, MirroringSessionConfig>(sessions_map.begin(), sessions_map.end());
+    }
+
     bool get_session(int mirror_id, MirroringSessionConfig* config) const
     {
         std::lock_guard<std::mutex> lock(mutex);
@@ -120,16 +146,47 @@ P4SwitchCore::P4SwitchCore(P4SwitchNetDevice* netDevice,
       m_enableTracing(enableTracing),
       m_dropPort(dropPort),
       m_pre(new bm::McSimplePreLAG()),
+      m_packetPool(this, BM_PACKET_HEADROOM),
+      m_egressBatchSize(DEFAULT_EGRESS_BATCH_SIZE),
+      m_pfcShift(5),
+      m_packetId(0),
       m_startTimestamp(Simulator::Now().GetNanoSeconds()),
       m_mirroringSessions(new MirroringSessions())
 {
+    // Cores are constructed on the main thread, the IDs and thrift ports stay
+    // deterministic even when the P4 programs are loaded in parallel
     static int switch_id = 1;
+    static int p4_switch_ctrl_plane_thrift_port = 9090;
     m_p4SwitchId = switch_id++;
+    m_thriftPort = p4_switch_ctrl_plane_thrift_port++;
     NS_LOG_INFO("Initialized P4 Switch with ID: " << m_p4SwitchId);
+
+    std::cout << "P4 switch " << m_p4SwitchId << " thrift port: " << m_thriftPort << std::endl;
+
+    // without net device (benchmarks), the packet traces go to a source
+    // nothing can connect to
+    static const TracedCallback<const P4PacketEvent&> noTrace;
+    m_packetTraces.fill(&noTrace);
+    if (netDevice)
+    {
+        m_packetTraces[TRACE_INGRESS_PARSED] = &netDevice->m_ingressParsedTrace;
+        m_packetTraces[TRACE_INGRESS_DONE] = &netDevice->m_ingressDoneTrace;
+        m_packetTraces[TRACE_ENQUEUED] = &netDevice->m_enqueuedTrace;
+        m_packetTraces[TRACE_DEQUEUED] = &netDevice->m_dequeuedTrace;
+        m_packetTraces[TRACE_EGRESS_DONE] = &netDevice->m_egressDoneTrace;
+        m_packetTraces[TRACE_DROPPED] = &netDevice->m_droppedTrace;
+        m_packetTraces[TRACE_CLONED] = &netDevice->m_clonedTrace;
+        m_packetTraces[TRACE_RECIRCULATED] = &netDevice->m_recirculatedTrace;
+        m_packetTraces[TRACE_MULTICAST] = &netDevice->m_multicastTrace;
+    }
 }
 
 P4SwitchCore::~P4SwitchCore()
 {
+    if (m_tableStats)
+    {
+        P4TableStats::Remove(this);
+    }
 }
 
 void
@@ -139,26 +196,37 @@ P4SwitchCore::InitializeSwitchFromP4Json(const std::string& jsonPath)
     NS_LOG_INFO("Applying p4 json to switch.");
     int status = 0;
 
-    static int p4_switch_ctrl_plane_thrift_port = 9090;
-    m_thriftPort = p4_switch_ctrl_plane_thrift_port;
-
-    std::cout << "P4 switch " << m_p4SwitchId
-              << " thrift port: " << p4_switch_ctrl_plane_thrift_port << std::endl;
-
-    bm::OptionsParser opt_parser;
-    opt_parser.config_file_path = jsonPath;
-    opt_parser.debugger_addr =
-        "ipc:///tmp/bmv2-" + std::to_string(p4_switch_ctrl_plane_thrift_port) + "-debug.ipc";
-    opt_parser.notifications_addr = "ipc:///tmp/bmv2-" +
-                                    std::to_string(p4_switch_ctrl_plane_thrift_port) +
-                                    "-notifications.ipc";
-    opt_parser.file_logger =
-        "/tmp/bmv2-" + std::to_string(p4_switch_ctrl_plane_thrift_port) + "-pipeline.log";
-    opt_parser.thrift_port = p4_switch_ctrl_plane_thrift_port++;
-    opt_parser.console_logging = false;
-
-    // Initialize the switch
-    status = init_from_options_parser(opt_parser);
+    std::string error;
+    m_p4Program = P4JsonCache::Get(jsonPath, &error);
+    if (!m_p4Program)
+    {
+        NS_LOG_ERROR("Failed to read p4 json for switch core: " << error);
+        return;
+    }
+
+    // bmv2 keeps a single process-wide logger, send it to a file once
+    static std::once_flag loggerFlag;
+    std::call_once(loggerFlag, []() { bm::Logger::set_logger_file("/tmp/bmv2-pipeline.log"); });
+
+    // The instrumented program is shared by the switches running it too
+    std::shared_ptr<const P4TableStats::InstrumentedProgram> instrumented;
+    if (m_tableStats)
+    {
+        instrumented = P4TableStats::Instrument(*m_p4Program, &error);
+        if (!instrumented)
+        {
+            NS_LOG_ERROR("Failed to instrument the tables of " << jsonPath << ": " << error);
+            return;
+        }
+        m_countedActions = instrumented->counted;
+    }
+
+    // Build the P4 objects from the cached JSON text, no intermediate copy
+    ConstStringBuf jsonBuf(instrumented ? instrumented->json : m_p4Program->json);
+    std::istream jsonStream(&jsonBuf);
+    std::shared_ptr<bm::TransportIface> transport =
+        std::shared_ptr<bm::TransportIface>(bm::TransportIface::make_dummy());
+    status = init_objects(&jsonStream, 0, transport);
     if (status != 0)
     {
         NS_LOG_ERROR("Failed to apply p4 json for switch core.");
@@ -168,6 +236,71 @@ P4SwitchCore::InitializeSwitchFromP4Json(const std::string& jsonPath)
     NS_LOG_INFO("P4 json applied successfully.");
 }
 
+void
+P4SwitchCore::SetTableStatsEnabled(bool enable)
+{
+    NS_LOG_FUNCTION(this << enable);
+    m_tableStats = enable;
+    if (enable)
+    {
+        P4TableStats::Get()->Add(this);
+    }
+    else
+    {
+        P4TableStats::Remove(this);
+    }
+}
+
+P4TableStats::SwitchCounters
+P4SwitchCore::GetTableStats()
+{
+    P4TableStats::SwitchCounters counters;
+    counters.switchId = m_p4SwitchId;
+    if (!m_tableStats)
+    {
+        return counters;
+    }
+
+    // The counted actions are grouped by table, in program order
+    for (size_t slot = 0; slot < m_countedActions.size(); slot++)
+    {
+        const P4ProgramInfo::CountedAction& counted = m_countedActions[slot];
+        if (counters.tables.empty() || counters.tables.back().name != counted.table)
+        {
+            counters.tables.push_back(P4TableStats::TableCounters{counted.table, 0, 0, 0, {}});
+        }
+        P4TableStats::TableCounters& table = counters.tables.back();
+
+        bm::MatchTableAbstract::counter_value_t bytes = 0;
+        bm::MatchTableAbstract::counter_value_t packets = 0;
+        if (read_counters(0, P4ProgramInfo::TABLE_STATS_COUNTER, slot, &bytes, &packets) != 0)
+        {
+            NS_LOG_WARN("Failed to read the table statistics counter " << slot);
+            packets = 0;
+        }
+        table.actions.push_back(P4TableStats::ActionCounters{counted.action, packets});
+        table.lookups += packets;
+    }
+
+    for (auto& table : counters.tables)
+    {
+        for (const auto& entry : mt_get_entries(0, table.name))
+        {
+            bm::MatchTableAbstract::counter_value_t bytes = 0;
+            bm::MatchTableAbstract::counter_value_t packets = 0;
+            if (mt_read_counters(0, table.name, entry.handle, &bytes, &packets) ==
+                bm::MatchErrorCode::SUCCESS)
+            {
+                table.hits += packets;
+            }
+        }
+        // Hits of deleted entries are lost, never report more hits than lookups
+        table.hits = std::min(table.hits, table.lookups);
+        table.misses = table.lookups - table.hits;
+    }
+    return counters;
+}
+
 int
 P4SwitchCore::InitFromCommandLineOptions(int argc, char* argv[])
 {
@@ -185,11 +318,90 @@ P4SwitchCore::InitFromCommandLineOptions(int argc, char* argv[])
     return status;
 }
 
+const P4ProgramInfo*
+P4SwitchCore::GetProgramInfo(P4ProgramInfo* localProgramInfo)
+{
+    // The program description is shared with all the switches running the
+    // same program, only parse it here if the JSON was not loaded from a file
+    if (m_p4Program && m_p4Program->programInfoValid)
+    {
+        return &m_p4Program->programInfo;
+    }
+    std::string error;
+    if (!localProgramInfo->LoadFromString(get_config(), &error))
+    {
+        NS_LOG_ERROR("Switch ID: " << m_p4SwitchId
+                                   << " failed to read the loaded P4 program: " << error);
+        return nullptr;
+    }
+    return localProgramInfo;
+}
+
+uint64_t
+P4SwitchCore::GetProgramHash()
+{
+    return m_p4Program ? m_p4Program->hash : P4JsonCache::Hash(get_config());
+}
+
 int
-P4SwitchCore::LoadFlowTableToSwitch(const std::string& flowTablePath)
+P4SwitchCore::LoadFlowTableToSwitch(const std::string& flowTablePath,
+                                    const std::string& verbPrefix)
 {
     NS_LOG_INFO("Loading flow table from: " << flowTablePath);
-    return ExecuteCliCommands(flowTablePath);
+
+    P4ProgramInfo localProgramInfo;
+    const P4ProgramInfo* programInfo = GetProgramInfo(&localProgramInfo);
+    if (!programInfo)
+    {
+        return 1;
+    }
+
+    P4FlowTableLoader loader(this, *programInfo);
+    int status = loader.LoadFromFile(flowTablePath, verbPrefix);
+    if (status != 0)
+    {
+        NS_LOG_WARN("Switch ID: " << m_p4SwitchId << " " << loader.GetNumErrors()
+                                  << " flow table commands failed in " << flowTablePath);
+    }
+    return status;
+}
+
+int
+P4SwitchCore::SaveStateToFile(const std::string& path)
+{
+    NS_LOG_INFO("Saving the switch state to: " << path);
+
+    P4ProgramInfo localProgramInfo;
+    const P4ProgramInfo* programInfo = GetProgramInfo(&localProgramInfo);
+    if (!programInfo)
+    {
+        return 1;
+    }
+
+    P4StateSnapshot snapshot(this, *programInfo, GetProgramHash());
+    return snapshot.SaveToFile(path);
+}
+
+int
+P4SwitchCore::LoadStateFromFile(const std::string& path)
+{
+    NS_LOG_INFO("Restoring the switch state from: " << path);
+
+    P4ProgramInfo localProgramInfo;
+    const P4ProgramInfo* programInfo = GetProgramInfo(&localProgramInfo);
+    if (!programInfo)
+    {
+        return 1;
+    }
+
+    P4StateSnapshot snapshot(this, *programInfo, GetProgramHash());
+    int status = snapshot.LoadFromFile(path);
+    if (status != 0)
+    {
+        NS_LOG_WARN("Switch ID: " << m_p4SwitchId << " " << snapshot.GetNumErrors()
+                                  << " objects not restored from " << path);
+    }
+    return status;
 }
 
 int
@@ -212,8 +424,8 @@ P4SwitchCore::ExecuteCliCommands(const std::string& commandsFile)
         return 1;
     }
 
-    // Get runtime port and start the server
-    int port = get_runtime_port();
+    // Start the server on the thrift port of this switch
+    int port = m_thriftPort;
     bm_runtime::start_server(this, port);
     std::this_thread::sleep_for(std::chrono::seconds(1));
 
@@ -244,28 +456,76 @@ P4SwitchCore::GetTimeStamp()
 Ptr<Packet>
 P4SwitchCore::ConvertToNs3Packet(std::unique_ptr<bm::Packet>&& bm_packet)
 {
-    // Create a new ns3::Packet using the data buffer
-    char* bm_buf = bm_packet.get()->data();
-    size_t len = bm_packet.get()->get_data_size();
-    Ptr<Packet> ns_packet = Create<Packet>((uint8_t*)(bm_buf), len);
-
+    // Single copy: the deparsed bytes go straight into the ns-3 packet buffer
+    const char* bm_buf = bm_packet->data();
+    size_t len = bm_packet->get_data_size();
+    Ptr<Packet> ns_packet = Create<Packet>(reinterpret_cast<const uint8_t*>(bm_buf), len);
+    m_packetPool.Release(std::move(bm_packet));
+
+    m_conversionStats.bmToNs3Packets++;
+    m_conversionStats.bmToNs3Bytes += len;
     return ns_packet;
 }
 
 std::unique_ptr<bm::Packet>
 P4SwitchCore::ConvertToBmPacket(Ptr<Packet> nsPacket, int inPort)
 {
-    int len = nsPacket->GetSize();
-    uint8_t* pkt_buffer = new uint8_t[len];
-    nsPacket->CopyData(pkt_buffer, len);
-    bm::PacketBuffer buffer(len + 512, (char*)pkt_buffer, len);
-    std::unique_ptr<bm::Packet> bm_packet(
-        new_packet_ptr(inPort, m_packetId++, len, std::move(buffer)));
-    delete[] pkt_buffer;
-
+    // Single copy: the ns-3 packet is serialized at the end of the bm buffer,
+    // leaving BM_PACKET_HEADROOM bytes in front for headers added by the pipeline
+    uint32_t len = nsPacket->GetSize();
+    std::unique_ptr<bm::Packet> bm_packet = m_packetPool.Acquire(inPort, m_packetId++, len);
+    nsPacket->CopyData(reinterpret_cast<uint8_t*>(bm_packet->data()), len);
+
+    m_conversionStats.ns3ToBmPackets++;
+    m_conversionStats.ns3ToBmBytes += len;
     return bm_packet;
 }
 
+const P4SwitchCore::PacketConversionStats&
+P4SwitchCore::GetPacketConversionStats() const
+{
+    return m_conversionStats;
+}
+
+void
+P4SwitchCore::SetPacketPoolSize(size_t maxPackets)
+{
+    m_packetPool.SetMaxPackets(maxPackets);
+}
+
+const P4PacketPool&
+P4SwitchCore::GetPacketPool() const
+{
+    return m_packetPool;
+}
+
+void
+P4SwitchCore::SetEgressBatchSize(size_t batchSize)
+{
+    m_egressBatchSize = std::max<size_t>(batchSize, 1);
+}
+
+void
+P4SwitchCore::SetPipelineLatency(const PipelineLatency& latency)
+{
+    m_pipelineLatency = latency;
+}
+
+size_t
+P4SwitchCore::GetNumTables(const std::string& pipeline) const
+{
+    if (!m_p4Program || !m_p4Program->programInfoValid)
+    {
+        return 0;
+    }
+    size_t count = 0;
+    for (const auto& table : m_p4Program->programInfo.GetTables())
+    {
+        count += (table.second.pipeline == pipeline);
+    }
+    return count;
+}
+
 int
 P4SwitchCore::GetAddressIndex(const Address& destination)
 {
@@ -309,6 +569,187 @@ P4SwitchCore::reset_target_state_()
     get_component<bm::McSimplePreLAG>()->reset_state();
 }
 
+int
+P4SwitchCore::SetEgressPriorityQueueDepth(size_t port, size_t queue, size_t depthPkts)
+{
+    NS_LOG_WARN("SetEgressPriorityQueueDepth: the architecture has no egress queue buffer");
+    return -1;
+}
+
+int
+P4SwitchCore::SetEgressQueueDepth(size_t port, size_t depthPkts)
+{
+    NS_LOG_WARN("SetEgressQueueDepth: the architecture has no egress queue buffer");
+    return -1;
+}
+
+int
+P4SwitchCore::SetAllEgressQueueDepths(size_t depthPkts)
+{
+    NS_LOG_WARN("SetAllEgressQueueDepths: the architecture has no egress queue buffer");
+    return -1;
+}
+
+int
+P4SwitchCore::SetEgressPriorityQueueRate(size_t port, size_t queue, uint64_t ratePps)
+{
+    NS_LOG_WARN("SetEgressPriorityQueueRate: the architecture has no egress queue buffer");
+    return -1;
+}
+
+int
+P4SwitchCore::SetEgressQueueRate(size_t port, uint64_t ratePps)
+{
+    NS_LOG_WARN("SetEgressQueueRate: the architecture has no egress queue buffer");
+    return -1;
+}
+
+int
+P4SwitchCore::SetEgressPortRate(size_t port, uint64_t ratePps)
+{
+    NS_LOG_WARN("SetEgressPortRate: the architecture has no egress queue buffer");
+    return -1;
+}
+
+int
+P4SwitchCore::SetAllEgressQueueRates(uint64_t ratePps)
+{
+    NS_LOG_WARN("SetAllEgressQueueRates: the architecture has no egress queue buffer");
+    return -1;
+}
+
+int
+P4SwitchCore::SetEgressPriorityQueueRateBps(size_t port, size_t priority, uint64_t rateBps)
+{
+    NS_LOG_WARN("SetEgressPriorityQueueRateBps: the architecture has no egress queue buffer");
+    return -1;
+}
+
+int
+P4SwitchCore::SetEgressQueueRateBps(size_t port, uint64_t rateBps)
+{
+    NS_LOG_WARN("SetEgressQueueRateBps: the architecture has no egress queue buffer");
+    return -1;
+}
+
+int
+P4SwitchCore::SetAllEgressQueueRatesBps(uint64_t rateBps)
+{
+    NS_LOG_WARN("SetAllEgressQueueRatesBps: the architecture has no egress queue buffer");
+    return -1;
+}
+
+int
+P4SwitchCore::SetEgressPortRateBps(size_t port, uint64_t rateBps)
+{
+    NS_LOG_WARN("SetEgressPortRateBps: the architecture has no egress queue buffer");
+    return -1;
+}
+
+int
+P4SwitchCore::SetAllEgressPortRatesBps(uint64_t rateBps)
+{
+    NS_LOG_WARN("SetAllEgressPortRatesBps: the architecture has no egress queue buffer");
+    return -1;
+}
+
+int
+P4SwitchCore::SetEgressPriorityQueueByteDepth(size_t port, size_t priority, size_t depthBytes)
+{
+    NS_LOG_WARN("SetEgressPriorityQueueByteDepth: the architecture has no egress queue buffer");
+    return -1;
+}
+
+int
+P4SwitchCore::SetEgressQueueByteDepth(size_t port, size_t depthBytes)
+{
+    NS_LOG_WARN("SetEgressQueueByteDepth: the architecture has no egress queue buffer");
+    return -1;
+}
+
+int
+P4SwitchCore::SetAllEgressQueueByteDepths(size_t depthBytes)
+{
+    NS_LOG_WARN("SetAllEgressQueueByteDepths: the architecture has no egress queue buffer");
+    return -1;
+}
+
+int
+P4SwitchCore::SetEgressSharedBuffer(size_t totalBytes, size_t reserveBytes, double alpha)
+{
+    NS_LOG_WARN("SetEgressSharedBuffer: the architecture has no egress queue buffer");
+    return -1;
+}
+
+int
+P4SwitchCore::SetEgressPriorityQueueSharedBuffer(size_t port,
+                                                 size_t priority,
+                                                 size_t reserveBytes,
+                                                 double alpha)
+{
+    NS_LOG_WARN("SetEgressPriorityQueueSharedBuffer: the architecture has no egress queue buffer");
+    return -1;
+}
+
+size_t
+P4SwitchCore::GetEgressSharedBufferUsage() const
+{
+    return 0;
+}
+
+int
+P4SwitchCore::EnableQueueHistograms(bool enable)
+{
+    NS_LOG_WARN("EnableQueueHistograms: the architecture has no egress queue buffer");
+    return -1;
+}
+
+const P4Histogram*
+P4SwitchCore::GetQueueDepthHistogram(size_t port, size_t priority) const
+{
+    return nullptr;
+}
+
+int
+P4SwitchCore::SetEgressPriorityQueueAqm(size_t port, size_t priority, const P4Aqm::Config& config)
+{
+    NS_LOG_WARN("SetEgressPriorityQueueAqm: the architecture has no egress queue buffer");
+    return -1;
+}
+
+int
+P4SwitchCore::SetAllEgressQueueAqm(const P4Aqm::Config& config)
+{
+    NS_LOG_WARN("SetAllEgressQueueAqm: the architecture has no egress queue buffer");
+    return -1;
+}
+
+P4Aqm::Counters
+P4SwitchCore::GetEgressQueueAqmCounters(size_t port, size_t priority) const
+{
+    return P4Aqm::Counters();
+}
+
+int
+P4SwitchCore::EnablePfc(uint64_t xoffBytes, uint64_t xonBytes)
+{
+    NS_LOG_WARN("EnablePfc: the architecture has no egress queue buffer");
+    return -1;
+}
+
+int
+P4SwitchCore::SetEgressQueuePaused(size_t port, size_t priority, bool paused)
+{
+    NS_LOG_WARN("SetEgressQueuePaused: the architecture has no egress queue buffer");
+    return -1;
+}
+
+const P4Histogram*
+P4SwitchCore::GetQueueSojournHistogram(size_t port, size_t priority) const
+{
+    return nullptr;
+}
+
 bool
 P4SwitchCore::AddMirroringSession(int mirror_id, const MirroringSessionConfig& config)
 {
@@ -327,6 +768,176 @@ P4SwitchCore::GetMirroringSession(int mirror_id, MirroringSessionConfig* config)
     return m_mirroringSessions->get_session(mirror_id, config);
 }
 
+std::map<int, P4SwitchCore::MirroringSessionConfig>
+P4SwitchCore::GetMirroringSessions() const
+{
+    return m_mirroringSessions->get_sessions();
+}
+
+void
+P4SwitchCore::ResolveArchBlocks(const ArchDescriptor& arch)
+{
+    m_blocks.ingressParser = arch.ingressParser ? get_parser(arch.ingressParser) : nullptr;
+    m_blocks.ingressPipeline = arch.ingressPipeline ? get_pipeline(arch.ingressPipeline) : nullptr;
+    m_blocks.ingressDeparser = arch.ingressDeparser ? get_deparser(arch.ingressDeparser) : nullptr;
+    m_blocks.egressParser = arch.egressParser ? get_parser(arch.egressParser) : nullptr;
+    m_blocks.egressPipeline = arch.egressPipeline ? get_pipeline(arch.egressPipeline) : nullptr;
+    m_blocks.egressDeparser = arch.egressDeparser ? get_deparser(arch.egressDeparser) : nullptr;
+}
+
+P4SwitchCore::FieldHandle
+P4SwitchCore::ResolveField(const bm::PHV& phv, const std::string& name)
+{
+    FieldHandle handle;
+    if (!phv.has_field(name))
+    {
+        return handle;
+    }
+    size_t dot = name.find('.');
+    const bm::Header& header = phv.get_header(name.substr(0, dot));
+    handle.header = header.get_id();
+    handle.offset = header.get_header_type().get_field_offset(name.substr(dot + 1));
+    handle.exists = true;
+    return handle;
+}
+
+void
+P4SwitchCore::ResolveEcnField(const bm::PHV& phv)
+{
+    m_ecnField = FieldHandle();
+    for (const char* name : {"ipv4.ecn", "ipv4.diffserv", "ipv4.tos", "ipv4.typeOfService"})
+    {
+        m_ecnField = ResolveField(phv, name);
+        if (m_ecnField.exists)
+        {
+            NS_LOG_DEBUG("ECN marking through " << name);
+            return;
+        }
+    }
+}
+
+bool
+P4SwitchCore::MarkEcn(bm::Packet* packet) const
+{
+    if (!m_ecnField.exists)
+    {
+        return false;
+    }
+    bm::PHV* phv = packet->get_phv();
+    if (!phv->get_header(m_ecnField.header).is_valid())
+    {
+        return false;
+    }
+    bm::Field& field = GetField(phv, m_ecnField);
+    unsigned int value = field.get<unsigned int>();
+    if ((value & 0x3) == 0)
+    {
+        // Not-ECT
+        return false;
+    }
+    field.set(value | 0x3);
+    return true;
+}
+
+bool
+P4SwitchCore::MarkEcnFrame(bm::Packet* packet)
+{
+    auto* data = reinterpret_cast<uint8_t*>(packet->data());
+    size_t size = packet->get_data_size();
+
+    // Ethernet header, with at most one VLAN tag
+    size_t offset = 12;
+    if (size < offset + 2)
+    {
+        return false;
+    }
+    uint16_t etherType = (data[offset] << 8) | data[offset + 1];
+    if (etherType == 0x8100)
+    {
+        offset += 4;
+        if (size < offset + 2)
+        {
+            return false;
+        }
+        etherType = (data[offset] << 8) | data[offset + 1];
+    }
+    offset += 2;
+    if (etherType != 0x0800 || size < offset + 20 || (data[offset] >> 4) != 4)
+    {
+        return false;
+    }
+
+    uint8_t* ipv4 = data + offset;
+    if ((ipv4[1] & 0x3) == 0)
+    {
+        // Not-ECT
+        return false;
+    }
+    uint16_t oldWord = (ipv4[0] << 8) | ipv4[1];
+    ipv4[1] |= 0x3;
+    uint16_t newWord = (ipv4[0] << 8) | ipv4[1];
+
+    // incremental update of the header checksum (RFC 1624)
+    uint16_t checksum = (ipv4[10] << 8) | ipv4[11];
+    uint32_t sum = static_cast<uint16_t>(~checksum) + static_cast<uint16_t>(~oldWord) + newWord;
+    sum = (sum & 0xffff) + (sum >> 16);
+    sum = (sum & 0xffff) + (sum >> 16);
+    checksum = ~sum;
+    ipv4[10] = checksum >> 8;
+    ipv4[11] = checksum & 0xff;
+    return true;
+}
+
+void
+P4SwitchCore::ResolvePfcField(const bm::PHV& phv)
+{
+    m_pfcField = FieldHandle();
+    for (const char* name : {"ipv4.diffserv", "ipv4.tos", "ipv4.typeOfService", "ipv4.dscp"})
+    {
+        m_pfcField = ResolveField(phv, name);
+        if (m_pfcField.exists)
+        {
+            // the DSCP holds the six high bits of the TOS
+            m_pfcShift = std::string(name) == "ipv4.dscp" ? 3 : 5;
+            NS_LOG_DEBUG("PFC priority from " << name);
+            return;
+        }
+    }
+}
+
+uint8_t
+P4SwitchCore::GetPfcPriority(bm::Packet* packet) const
+{
+    if (!m_pfcField.exists)
+    {
+        return 0;
+    }
+    bm::PHV* phv = packet->get_phv();
+    if (!phv->get_header(m_pfcField.header).is_valid())
+    {
+        return 0;
+    }
+    unsigned int value = GetField(phv, m_pfcField).get<unsigned int>();
+    return (value >> m_pfcShift) & 0x7;
+}
+
+void
+P4SwitchCore::CreatePfcAccounting(uint64_t xoffBytes, uint64_t xonBytes)
+{
+    NS_ASSERT_MSG(xonBytes < xoffBytes, "PFC XON threshold must be below the XOFF threshold");
+    m_pfc = std::make_unique<P4PfcAccounting>(
+        xoffBytes,
+        xonBytes,
+        [this](uint32_t port, uint8_t priority, bool pause) {
+            NS_LOG_DEBUG("Switch " << m_p4SwitchId << (pause ? " pauses" : " resumes")
+                                   << " priority " << +priority << " on port " << port);
+            if (m_switchNetDevice)
+            {
+                m_switchNetDevice->SendPfcPause(port, priority, pause);
+            }
+        });
+}
+
 void
 P4SwitchCore::CheckQueueingMetadata()
 {
@@ -20,15 +20,23 @@
 #ifndef P4_SWITCH_CORE_H
 #define P4_SWITCH_CORE_H
 
+#include "ns3/p4-aqm.h"
+#include "ns3/p4-histogram.h"
+#include "ns3/p4-json-cache.h"
+#include "ns3/p4-packet-pool.h"
+#include "ns3/p4-pfc.h"
 #include "ns3/p4-switch-net-device.h"
+#include "ns3/p4-table-stats.h"
 
 #include <bm/bm_sim/packet.h>
 #include <bm/bm_sim/simple_pre_lag.h>
 #include <bm/bm_sim/switch.h>
+#include <array>
 #include <map>
 #include <vector>
 
 #define SSWITCH_DROP_PORT 511
+#define BM_PACKET_HEADROOM 512 //!< Free bytes in front of the packet data in bm buffers
 
 namespace ns3
 {
@@ -55,17 +63,63 @@ class P4SwitchCore : public bm::Switch
 
     /**
      * @brief Initialize the switch with the P4 program
+     *
+     * The JSON file is read through P4JsonCache, so switches running the same
+     * program share a single copy of it.
+     *
      * @param jsonPath the path to the JSON file
      * @return void
      */
     void InitializeSwitchFromP4Json(const std::string& jsonPath);
 
+    /**
+     * @brief Count the table lookups, hits, misses and action executions
+     * @details Must be called on the main thread, before the P4 program is
+     * loaded: the program is instrumented when it is loaded. The counters are
+     * reported by P4TableStats.
+     * @param enable true to count
+     */
+    void SetTableStatsEnabled(bool enable);
+
+    /**
+     * @brief Read the table counters of the switch
+     * @return the counters, without tables if the statistics are disabled
+     */
+    P4TableStats::SwitchCounters GetTableStats();
+
     /**
      * @brief Load the flow table to the switch
+     *
+     * The runtime CLI commands of the file are applied in-process through the
+     * runtime interface of the switch (see P4FlowTableLoader).
+     *
      * @param flowTablePath the path to the flow table file
-     * @return int the status code
+     * @param verbPrefix apply only the commands starting with this prefix, all
+     * the commands if empty
+     * @return int 0 if all the commands were applied, 1 otherwise
      */
-    int LoadFlowTableToSwitch(const std::string& flowTablePath);
+    int LoadFlowTableToSwitch(const std::string& flowTablePath,
+                              const std::string& verbPrefix = "");
+
+    /**
+     * @brief Save the runtime state of the switch to a checkpoint file
+     * @details The table entries, action profiles, registers, counters,
+     * meters and mirroring sessions, in the binary format of P4StateSnapshot.
+     * @param path the path to the checkpoint file
+     * @return int 0 if successful, 1 otherwise
+     */
+    int SaveStateToFile(const std::string& path);
+
+    /**
+     * @brief Restore the runtime state of the switch from a checkpoint file
+     * @details Replaces loading a flow table file, except for the multicast
+     * groups of the PRE, which the checkpoint does not hold (see
+     * P4StateSnapshot). The switch must run the P4 program the checkpoint was
+     * saved with.
+     * @param path the path to the checkpoint file
+     * @return int 0 if all the state was restored, 1 otherwise
+     */
+    int LoadStateFromFile(const std::string& path);
 
     /**
      * @brief Initialize the switch from command line options
@@ -76,7 +130,8 @@ class P4SwitchCore : public bm::Switch
     int InitFromCommandLineOptions(int argc, char* argv[]);
 
     /**
-     * @brief Execute the CLI commands from a file
+     * @brief Execute the CLI commands from a file with the external thrift CLI
+     * @details Legacy path, requires a thrift server and the simple_switch_CLI tool.
      * @param commandsFile the path to the CLI commands file
      * @return int the status code
      */
@@ -95,23 +150,110 @@ class P4SwitchCore : public bm::Switch
                               uint16_t protocol,
                               const Address& destination) = 0;
 
+    /**
+     * @brief Byte counters of the ns-3 / bmv2 packet conversions
+     * @details Each conversion copies the packet data exactly once, the
+     * counters give the number of bytes copied in each direction.
+     */
+    struct PacketConversionStats
+    {
+        uint64_t ns3ToBmPackets{0}; //!< Packets converted from ns-3 to bmv2
+        uint64_t ns3ToBmBytes{0};   //!< Bytes copied from ns-3 to bmv2
+        uint64_t bmToNs3Packets{0}; //!< Packets converted from bmv2 to ns-3
+        uint64_t bmToNs3Bytes{0};   //!< Bytes copied from bmv2 to ns-3
+    };
+
+    /**
+     * @brief Names of the programmable blocks of a P4 architecture
+     * @details A nullptr name means the architecture has no such block
+     * (e.g. v1model has no egress parser, the PNA main blocks are given as
+     * the ingress blocks).
+     */
+    struct ArchDescriptor
+    {
+        const char* ingressParser;   //!< Parser run at ingress
+        const char* ingressPipeline; //!< Ingress control
+        const char* ingressDeparser; //!< Deparser run after ingress
+        const char* egressParser;    //!< Parser run at egress
+        const char* egressPipeline;  //!< Egress control
+        const char* egressDeparser;  //!< Deparser run after egress
+    };
+
     /**
      * @brief Convert a bm packet to ns-3 packet
      *
+     * The deparsed data is copied once, directly into the new ns-3 packet, and
+     * the bm packet is given back to the packet pool of the switch.
+     *
      * @param bmPacket the bm packet
-     * @return Ptr<Packet> the ns-3 packetclear
+     * @return Ptr<Packet> the ns-3 packet
      */
     Ptr<Packet> ConvertToNs3Packet(std::unique_ptr<bm::Packet>&& bmPacket);
 
     /**
      * @brief Convert a ns-3 packet to bm packet
      *
+     * The ns-3 packet is serialized once, directly into the bm packet buffer.
+     * The bm packet is taken from the packet pool of the switch.
+     *
      * @param nsPacket the ns-3 packet
      * @param inPort the port where the packet is received
      * @return std::unique_ptr<bm::Packet> the bm packet
      */
     std::unique_ptr<bm::Packet> ConvertToBmPacket(Ptr<Packet> nsPacket, int inPort);
 
+    /**
+     * @brief Get the packet conversion counters of this switch
+     * @return the counters
+     */
+    const PacketConversionStats& GetPacketConversionStats() const;
+
+    /**
+     * @brief Set the maximum number of bm packets cached by this switch
+     * @param maxPackets the maximum number of packets, 0 disables the pool
+     */
+    void SetPacketPoolSize(size_t maxPackets);
+
+    /**
+     * @brief Get the bm packet pool of this switch (limits and hit-rate counters)
+     * @return the packet pool
+     */
+    const P4PacketPool& GetPacketPool() const;
+
+    static constexpr size_t DEFAULT_EGRESS_BATCH_SIZE = 32; //!< Default egress batch size
+
+    /**
+     * @brief Set the maximum number of packets run through the egress pipeline
+     * in one dequeue event
+     * @details All the packets eligible at the same time are dequeued together,
+     * up to this number, in the order they would be dequeued one by one.
+     * @param batchSize the batch size, at least 1
+     */
+    void SetEgressBatchSize(size_t batchSize);
+
+    /**
+     * @brief Processing latency of the pipeline stages
+     * @details All zero by default: the pipeline then runs in zero simulated
+     * time.
+     */
+    struct PipelineLatency
+    {
+        Time parser;       //!< Latency of the parser
+        Time ingressStage; //!< Fixed latency of the ingress control
+        Time egressStage;  //!< Fixed latency of the egress control
+        Time deparser;     //!< Latency of the deparser
+        Time tableLookup;  //!< Latency added per match table of a control
+    };
+
+    /**
+     * @brief Set the processing latency of the pipeline stages
+     * @details Applied by all the architectures when the switch starts and
+     * when the P4 program is swapped. The PNA NIC has a single main control:
+     * it times it with the ingress latency and leaves the egress latency out.
+     * @param latency the stage latencies
+     */
+    void SetPipelineLatency(const PipelineLatency& latency);
+
     /**
      * @brief Returns the elapsed time since the switch started.
      *
@@ -123,6 +265,242 @@ class P4SwitchCore : public bm::Switch
      */
     uint64_t GetTimeStamp();
 
+    /**
+     * @brief Set the depth of a priority queue
+     * @details Unlike the other per-priority APIs, takes the index of the queue
+     * in the port, as the bmv2 runtime command set_queue_depth: queue i holds
+     * the packet priority nbQueuesPerPort - 1 - i.
+     * @param port The egress port
+     * @param queue The index of the queue in the port
+     * @param depthPkts The depth of the queue in packets
+     * @return int 0 if successful, -1 if the architecture has no egress queue buffer
+     */
+    virtual int SetEgressPriorityQueueDepth(size_t port, size_t queue, size_t depthPkts);
+
+    /**
+     * @brief Set the depth of a queue
+     * @param port The egress port
+     * @param depthPkts The depth of the queue in packets
+     * @return int 0 if successful, -1 if the architecture has no egress queue buffer
+     */
+    virtual int SetEgressQueueDepth(size_t port, size_t depthPkts);
+
+    /**
+     * @brief Set the depth of all queues
+     * @param depthPkts The depth of the queue in packets
+     * @return int 0 if successful, -1 if the architecture has no egress queue buffer
+     */
+    virtual int SetAllEgressQueueDepths(size_t depthPkts);
+
+    /**
+     * @brief Set the rate of a priority queue
+     * @details Takes the index of the queue in the port, as the bmv2 runtime
+     * command set_queue_rate (see SetEgressPriorityQueueDepth).
+     * @param port The egress port
+     * @param queue The index of the queue in the port
+     * @param ratePps The rate of the queue in packets per second
+     * @return int 0 if successful, -1 if the architecture has no egress queue buffer
+     */
+    virtual int SetEgressPriorityQueueRate(size_t port, size_t queue, uint64_t ratePps);
+
+    /**
+     * @brief Set the rate of a virtual queue
+     * @param port The egress port
+     * @param ratePps The rate of the queue in packets per second
+     * @return int 0 if successful, -1 if the architecture has no egress queue buffer
+     */
+    virtual int SetEgressQueueRate(size_t port, uint64_t ratePps);
+
+    /**
+     * @brief Set the line rate of an egress port, shared by all its queues
+     * @param port The egress port
+     * @param ratePps The rate of the port in packets per second, 0 for no limit
+     * @return int 0 if successful, -1 if the architecture has no egress queue buffer
+     */
+    virtual int SetEgressPortRate(size_t port, uint64_t ratePps);
+
+    /**
+     * @brief Set the rate of all virtual queues
+     * @param ratePps The rate of the queue in packets per second
+     * @return int 0 if successful, -1 if the architecture has no egress queue buffer
+     */
+    virtual int SetAllEgressQueueRates(uint64_t ratePps);
+
+    /**
+     * @brief Set the rate of a priority queue in bits per second, replacing its packet rate
+     * @param port The egress port
+     * @param priority The packet priority of the queue
+     * @param rateBps The rate of the queue in bits per second, 0 for no limit
+     * @return int 0 if successful, -1 if the architecture has no egress queue
+     * buffer or the priority is out of range
+     */
+    virtual int SetEgressPriorityQueueRateBps(size_t port, size_t priority, uint64_t rateBps);
+
+    /**
+     * @brief Set the rate of the queues of a port in bits per second
+     * @param port The egress port
+     * @param rateBps The rate of the queues in bits per second
+     * @return int 0 if successful, -1 if the architecture has no egress queue buffer
+     */
+    virtual int SetEgressQueueRateBps(size_t port, uint64_t rateBps);
+
+    /**
+     * @brief Set the rate of all the queues in bits per second
+     * @param rateBps The rate of the queues in bits per second
+     * @return int 0 if successful, -1 if the architecture has no egress queue buffer
+     */
+    virtual int SetAllEgressQueueRatesBps(uint64_t rateBps);
+
+    /**
+     * @brief Set the line rate of an egress port in bits per second, replacing its packet rate
+     * @param port The egress port
+     * @param rateBps The rate of the port in bits per second, 0 for no limit
+     * @return int 0 if successful, -1 if the architecture has no egress queue buffer
+     */
+    virtual int SetEgressPortRateBps(size_t port, uint64_t rateBps);
+
+    /**
+     * @brief Set the line rate of all the egress ports in bits per second
+     * @param rateBps The rate of the ports in bits per second, 0 for no limit
+     * @return int 0 if successful, -1 if the architecture has no egress queue buffer
+     */
+    virtual int SetAllEgressPortRatesBps(uint64_t rateBps);
+
+    /**
+     * @brief Set the depth of a priority queue in bytes, on top of its depth in packets
+     * @param port The egress port
+     * @param priority The packet priority of the queue
+     * @param depthBytes The depth of the queue in bytes, 0 for no limit
+     * @return int 0 if successful, -1 if the architecture has no egress queue
+     * buffer or the priority is out of range
+     */
+    virtual int SetEgressPriorityQueueByteDepth(size_t port, size_t priority, size_t depthBytes);
+
+    /**
+     * @brief Set the depth in bytes of the queues of a port
+     * @param port The egress port
+     * @param depthBytes The depth of the queues in bytes, 0 for no limit
+     * @return int 0 if successful, -1 if the architecture has no egress queue buffer
+     */
+    virtual int SetEgressQueueByteDepth(size_t port, size_t depthBytes);
+
+    /**
+     * @brief Set the depth in bytes of all the queues
+     * @param depthBytes The depth of the queues in bytes, 0 for no limit
+     * @return int 0 if successful, -1 if the architecture has no egress queue buffer
+     */
+    virtual int SetAllEgressQueueByteDepths(size_t depthBytes);
+
+    /**
+     * @brief Make the egress queues share one buffer with dynamic thresholds
+     * @details Each queue is guaranteed reserveBytes bytes and takes at most
+     * alpha times the free shared bytes beyond them. The depths of the queues
+     * still apply.
+     * @param totalBytes The size of the buffer, reserves included, 0 to disable it
+     * @param reserveBytes The bytes guaranteed to each queue
+     * @param alpha The dynamic threshold factor of the queues
+     * @return int 0 if successful, -1 if the architecture has no egress queue buffer
+     */
+    virtual int SetEgressSharedBuffer(size_t totalBytes, size_t reserveBytes, double alpha);
+
+    /**
+     * @brief Set the shared buffer reserve and dynamic threshold factor of a priority queue
+     * @param port The egress port
+     * @param priority The packet priority of the queue
+     * @param reserveBytes The bytes guaranteed to the queue
+     * @param alpha The dynamic threshold factor of the queue
+     * @return int 0 if successful, -1 if the architecture has no egress queue
+     * buffer or the priority is out of range
+     */
+    virtual int SetEgressPriorityQueueSharedBuffer(size_t port,
+                                                   size_t priority,
+                                                   size_t reserveBytes,
+                                                   double alpha);
+
+    /**
+     * @brief Get the bytes of the shared buffer used beyond the reserves
+     * @return size_t the bytes, 0 without shared buffer
+     */
+    virtual size_t GetEgressSharedBufferUsage() const;
+
+    /**
+     * @brief Keep occupancy and sojourn time histograms of the egress queues
+     * @param enable true to keep them, false to discard them
+     * @return int 0 if successful, -1 if the architecture has no egress queue buffer
+     */
+    virtual int EnableQueueHistograms(bool enable);
+
+    /**
+     * @brief Set the AQM of a priority queue
+     * @param port The egress port
+     * @param priority The packet priority of the queue
+     * @param config The AQM configuration, mode P4Aqm::NONE to disable it
+     * @return int 0 if successful, -1 if the architecture has no egress queue
+     * buffer or the priority is out of range
+     */
+    virtual int SetEgressPriorityQueueAqm(size_t port,
+                                          size_t priority,
+                                          const P4Aqm::Config& config);
+
+    /**
+     * @brief Set the AQM of all the queues
+     * @param config The AQM configuration, mode P4Aqm::NONE to disable it
+     * @return int 0 if successful, -1 if the architecture has no egress queue buffer
+     */
+    virtual int SetAllEgressQueueAqm(const P4Aqm::Config& config);
+
+    /**
+     * @brief Get the packets marked and dropped by the AQM of a priority queue
+     * @param port The egress port
+     * @param priority The packet priority of the queue
+     * @return the counters, 0 if the architecture has no egress queue buffer
+     */
+    virtual P4Aqm::Counters GetEgressQueueAqmCounters(size_t port, size_t priority) const;
+
+    /**
+     * @brief Pause the upstream devices with PFC when their packets fill the egress buffer
+     * @details The PFC priority of a packet is its IPv4 precedence, as in
+     * CustomP2PNetDevice (GetPfcPriority()): with PFC, the packets are queued
+     * by PFC priority instead of standard_metadata.priority, so that the
+     * accounting, the pauses sent and the pauses received agree. The bytes in
+     * the egress buffer are counted per ingress port and PFC priority. At
+     * xoffBytes the switch asks its net device to pause the priority on the
+     * ingress port, at xonBytes to resume it.
+     * @param xoffBytes The bytes of a port and priority pausing its upstream device
+     * @param xonBytes The bytes of a port and priority resuming its upstream device
+     * @return int 0 if successful, -1 if the architecture has no egress queue
+     * buffer or less queues per port than PFC priorities
+     */
+    virtual int EnablePfc(uint64_t xoffBytes, uint64_t xonBytes);
+
+    /**
+     * @brief Pause or resume the egress queue of a port and PFC priority
+     * @details Called when the downstream device on the port sends PFC frames:
+     * a paused queue keeps its packets and is not served.
+     * @param port The egress port
+     * @param priority The PFC priority, the packet priority of the queue with PFC
+     * @param paused true to pause the queue, false to resume it
+     * @return int 0 if successful, -1 if the architecture has no egress queue buffer
+     */
+    virtual int SetEgressQueuePaused(size_t port, size_t priority, bool paused);
+
+    /**
+     * @brief Get the histogram of the depth of a priority queue seen by the
+     * packets enqueued into it
+     * @param port The egress port
+     * @param priority The packet priority of the queue
+     * @return the histogram (packets), nullptr if the histograms are disabled
+     */
+    virtual const P4Histogram* GetQueueDepthHistogram(size_t port, size_t priority) const;
+
+    /**
+     * @brief Get the histogram of the time the packets spent in a priority queue
+     * @param port The egress port
+     * @param priority The packet priority of the queue
+     * @return the histogram (nanoseconds), nullptr if the histograms are disabled
+     */
+    virtual const P4Histogram* GetQueueSojournHistogram(size_t port, size_t priority) const;
+
     // === override ===
     /**
      * @brief [Deprecated] Receive a packet from the network, using ReceivePacket instead.
@@ -154,6 +532,83 @@ class P4SwitchCore : public bm::Switch
     P4SwitchCore&& operator=(P4SwitchCore&&) = delete;
 
   protected:
+    friend class P4FlowTableLoader; //!< Applies mirroring and PRE commands
+    friend class P4StateSnapshot;   //!< Saves and restores the mirroring sessions
+
+    /**
+     * @brief Packet trace sources of the switch net device
+     */
+    enum PacketTrace
+    {
+        TRACE_INGRESS_PARSED = 0, //!< IngressParsed
+        TRACE_INGRESS_DONE,       //!< IngressDone
+        TRACE_ENQUEUED,           //!< Enqueued
+        TRACE_DEQUEUED,           //!< Dequeued
+        TRACE_EGRESS_DONE,        //!< EgressDone
+        TRACE_DROPPED,            //!< Dropped
+        TRACE_CLONED,             //!< Cloned
+        TRACE_RECIRCULATED,       //!< Recirculated
+        TRACE_MULTICAST,          //!< Multicast
+        TRACE_COUNT
+    };
+
+    /**
+     * @brief Fire a packet trace source of the switch net device
+     * @details Costs one branch when nothing is connected to the source: the
+     * event is only built for the connected sources.
+     * @param trace the trace source
+     * @param packetId the ID of the packet
+     * @param size the packet size (bytes)
+     * @param port the ingress or egress port
+     * @param priority the queue priority
+     * @param depth the input buffer or queue depth
+     * @param reason why the packet was dropped, for TRACE_DROPPED
+     */
+    void TracePacket(PacketTrace trace,
+                     uint64_t packetId,
+                     size_t size,
+                     uint32_t port,
+                     uint32_t priority,
+                     size_t depth,
+                     P4MetricsSink::DropReason reason = P4MetricsSink::DROP_REASON_COUNT) const
+    {
+        const TracedCallback<const P4PacketEvent&>& callback = *m_packetTraces[trace];
+        if (callback.IsEmpty())
+        {
+            return;
+        }
+        callback(P4PacketEvent{packetId,
+                               port,
+                               priority,
+                               static_cast<uint32_t>(size),
+                               static_cast<uint32_t>(depth),
+                               reason});
+    }
+
+    /**
+     * @brief Fire a packet trace source of the switch net device for a bm packet
+     * @see TracePacket
+     */
+    void TracePacket(PacketTrace trace,
+                     const bm::Packet* packet,
+                     uint32_t port,
+                     uint32_t priority,
+                     size_t depth,
+                     P4MetricsSink::DropReason reason = P4MetricsSink::DROP_REASON_COUNT) const
+    {
+        if (m_packetTraces[trace]->IsEmpty())
+        {
+            return;
+        }
+        TracePacket(trace,
+                    m_packetPool.GetPacketId(packet),
+                    packet->get_data_size(),
+                    port,
+                    priority,
+                    depth,
+                    reason);
+    }
+
     /**
      * @brief Configuration for a mirroring session
      * @details The configuration includes the egress port and the multicast group ID. The egress
@@ -191,11 +646,123 @@ class P4SwitchCore : public bm::Switch
      */
     bool GetMirroringSession(int mirrorId, MirroringSessionConfig* config) const;
 
+    /**
+     * @brief Get all the mirroring sessions of the switch
+     * @return the configurations of the sessions, by mirroring session ID
+     */
+    std::map<int, MirroringSessionConfig> GetMirroringSessions() const;
+
     /**
      * @brief Check the queueing metadata
      */
     void CheckQueueingMetadata();
 
+    /**
+     * @brief The programmable blocks of the loaded P4 program
+     * @details Resolved once per program by ResolveArchBlocks(), so the packet
+     * path does not look the blocks up by name.
+     */
+    struct ArchBlocks
+    {
+        bm::Parser* ingressParser{nullptr};     //!< Parser run at ingress
+        bm::Pipeline* ingressPipeline{nullptr}; //!< Ingress control
+        bm::Deparser* ingressDeparser{nullptr}; //!< Deparser run after ingress
+        bm::Parser* egressParser{nullptr};      //!< Parser run at egress
+        bm::Pipeline* egressPipeline{nullptr};  //!< Egress control
+        bm::Deparser* egressDeparser{nullptr};  //!< Deparser run after egress
+    };
+
+    /**
+     * @brief Resolve the programmable blocks of the loaded P4 program into m_blocks
+     * @details Called by the cores when the switch starts and when the P4
+     * program is swapped.
+     * @param arch the block names of the architecture
+     */
+    void ResolveArchBlocks(const ArchDescriptor& arch);
+
+    /**
+     * @brief Position of a field in the PHV, resolved once per P4 program
+     * @details Accessing a field through its handle is an indexed access,
+     * while bm::PHV::get_field(name) hashes the field name on every call.
+     */
+    struct FieldHandle
+    {
+        bm::header_id_t header{0}; //!< Index of the header in the PHV
+        int offset{0};             //!< Index of the field in the header
+        bool exists{false};        //!< False if the program does not define the field
+    };
+
+    /**
+     * @brief Resolve the handle of a field
+     * @param phv a PHV of the loaded P4 program
+     * @param name the field name, e.g. "standard_metadata.egress_spec"
+     * @return the handle, with exists set to false if the field is not defined
+     */
+    static FieldHandle ResolveField(const bm::PHV& phv, const std::string& name);
+
+    /**
+     * @brief Access a field of a packet through its handle
+     * @param phv the PHV of the packet
+     * @param handle the handle of the field, which must exist
+     * @return the field
+     */
+    static bm::Field& GetField(bm::PHV* phv, const FieldHandle& handle)
+    {
+        return phv->get_field(handle.header, handle.offset);
+    }
+
+    /**
+     * @brief Resolve the IPv4 field holding the ECN bits, for MarkEcn()
+     * @details The first field defined among ipv4.ecn, ipv4.diffserv,
+     * ipv4.tos and ipv4.typeOfService: the ECN bits are its two low bits.
+     * @param phv a PHV of the loaded P4 program
+     */
+    void ResolveEcnField(const bm::PHV& phv);
+
+    /**
+     * @brief Set ECN CE in the IPv4 header of a parsed packet
+     * @details Changes the PHV only: the deparser of the program must update
+     * the IPv4 checksum, as for any header rewrite.
+     * @param packet the packet
+     * @return false if the packet has no valid IPv4 header or is not ECN capable
+     */
+    bool MarkEcn(bm::Packet* packet) const;
+
+    /**
+     * @brief Set ECN CE in the IPv4 header of a deparsed packet
+     * @details Rewrites the bytes of the Ethernet frame in the packet buffer
+     * and updates the IPv4 checksum, for the architectures deparsing the
+     * packets before the egress queues (PSA), whose PHV is parsed again at
+     * egress.
+     * @param packet the packet
+     * @return false if the frame has no IPv4 header or is not ECN capable
+     */
+    static bool MarkEcnFrame(bm::Packet* packet);
+
+    /**
+     * @brief Resolve the IPv4 field holding the precedence, for GetPfcPriority()
+     * @details The first field defined among ipv4.diffserv, ipv4.tos,
+     * ipv4.typeOfService and ipv4.dscp.
+     * @param phv a PHV of the loaded P4 program
+     */
+    void ResolvePfcField(const bm::PHV& phv);
+
+    /**
+     * @brief Get the PFC priority of a parsed packet: its IPv4 precedence, the
+     * three high bits of the TOS, as in CustomP2PNetDevice
+     * @param packet the packet
+     * @return the precedence, 0 if the packet has no valid IPv4 header
+     */
+    uint8_t GetPfcPriority(bm::Packet* packet) const;
+
+    /**
+     * @brief Create the PFC ingress accounting, sending the pause and resume
+     * requests to the net device
+     * @param xoffBytes The bytes of a port and priority pausing its upstream device
+     * @param xonBytes The bytes of a port and priority resuming its upstream device
+     */
+    void CreatePfcAccounting(uint64_t xoffBytes, uint64_t xonBytes);
+
     /**
      * @brief Ingress processing pipeline
      */
@@ -241,7 +808,40 @@ class P4SwitchCore : public bm::Switch
 
     std::vector<Address> m_destinationList; //!< List of addresses (O(log n) search)
     std::map<Address, int> m_addressMap;    //!< Map for fast lookup
+    P4PacketPool m_packetPool;              //!< Recycled bm packets
+    ArchBlocks m_blocks;                    //!< Programmable blocks of the loaded program
+    size_t m_egressBatchSize;               //!< Maximum packets per dequeue event
+    PipelineLatency m_pipelineLatency;      //!< Latency of the pipeline stages
+
+    FieldHandle m_ecnField;                 //!< IPv4 field holding the ECN bits
+    FieldHandle m_pfcField;                 //!< IPv4 field holding the precedence
+    unsigned int m_pfcShift;                //!< Position of the precedence in m_pfcField
+    std::unique_ptr<P4PfcAccounting> m_pfc; //!< PFC ingress accounting, null without PFC
+
+    //! Trace sources of the net device, empty ones without net device
+    std::array<const TracedCallback<const P4PacketEvent&>*, TRACE_COUNT> m_packetTraces;
+
+    /**
+     * @brief Count the match tables of a control of the loaded P4 program
+     * @param pipeline the name of the control (bmv2 pipeline)
+     * @return the number of tables, 0 if the program description is unknown
+     */
+    size_t GetNumTables(const std::string& pipeline) const;
+
   private:
+    /**
+     * @brief Get the description of the loaded P4 program
+     * @param localProgramInfo filled if the program was not read through P4JsonCache
+     * @return the description, nullptr if the loaded program cannot be read
+     */
+    const P4ProgramInfo* GetProgramInfo(P4ProgramInfo* localProgramInfo);
+
+    /**
+     * @brief Get the hash of the loaded P4 program, see P4JsonCache::Hash
+     * @return the hash
+     */
+    uint64_t GetProgramHash();
+
     class MirroringSessions;            //!< Mirroring sessions for clone .etc
     int m_thriftPort;                   //!< Thrift port for the switch (default 9090)
     size_t m_nbQueuesPerPort;           //!< Number of queues per port (default 8)
@@ -249,6 +849,11 @@ class P4SwitchCore : public bm::Switch
     uint64_t m_startTimestamp;          //!< Start time of the switch
     bm::TargetParserBasic* m_argParser; //!< Structure of parsers
     std::unique_ptr<MirroringSessions> m_mirroringSessions; //!< Mirroring sessions
+    std::shared_ptr<const P4JsonCache::Program> m_p4Program; //!< Loaded P4 program (shared)
+    PacketConversionStats m_conversionStats;                  //!< Packet conversion counters
+    bool m_tableStats{false};                                 //!< Count the table statistics
+    //! Table and action of each slot of the table statistics counter
+    std::vector<P4ProgramInfo::CountedAction> m_countedActions;
 };
 
 } // namespace ns3
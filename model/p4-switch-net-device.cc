@@ -19,7 +19,10 @@
 
 #include "ns3/boolean.h"
 #include "ns3/channel.h"
+#include "ns3/custom-p2p-net-device.h"
+#include "ns3/double.h"
 #include "ns3/ethernet-header.h"
+#include "ns3/global-value.h"
 #include "ns3/log.h"
 #include "ns3/node.h"
 #include "ns3/p4-core-pipeline.h"
@@ -30,8 +33,19 @@
 #include "ns3/packet.h"
 #include "ns3/simulator.h"
 #include "ns3/string.h"
+#include "ns3/trace-source-accessor.h"
 #include "ns3/uinteger.h"
 
+#ifdef NS3_MPI
+#include "ns3/mpi-interface.h"
+#endif
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <fstream>
+#include <thread>
+
 namespace ns3
 {
 
@@ -39,6 +53,14 @@ NS_LOG_COMPONENT_DEFINE("P4SwitchNetDevice");
 
 NS_OBJECT_ENSURE_REGISTERED(P4SwitchNetDevice);
 
+static GlobalValue g_p4SwitchBringUpThreads(
+    "P4SwitchBringUpThreads",
+    "Number of threads loading P4 programs and flow tables at start-up (0: one per CPU core)",
+    UintegerValue(0),
+    MakeUintegerChecker<uint32_t>());
+
+std::vector<P4SwitchNetDevice*> P4SwitchNetDevice::g_pendingDevices;
+
 TypeId
 P4SwitchNetDevice::GetTypeId()
 {
@@ -53,6 +75,20 @@ P4SwitchNetDevice::GetTypeId()
                           MakeBooleanAccessor(&P4SwitchNetDevice::m_enableTracing),
                           MakeBooleanChecker())
 
+            .AddAttribute("EnableTableStats",
+                          "Count the lookups, hits and misses of every table and the "
+                          "executions of every action, reported by P4TableStats.",
+                          BooleanValue(false),
+                          MakeBooleanAccessor(&P4SwitchNetDevice::m_enableTableStats),
+                          MakeBooleanChecker())
+
+            .AddAttribute("EnableQueueHistograms",
+                          "Keep histograms of the depth at enqueue and of the sojourn time "
+                          "of every egress queue, reported by the metrics file.",
+                          BooleanValue(false),
+                          MakeBooleanAccessor(&P4SwitchNetDevice::m_queueHistograms),
+                          MakeBooleanChecker())
+
             .AddAttribute("EnableSwap",
                           "Enable swapping in the switch.",
                           BooleanValue(false),
@@ -79,6 +115,28 @@ P4SwitchNetDevice::GetTypeId()
                                              &P4SwitchNetDevice::SetFlowTablePath),
                           MakeStringChecker())
 
+            .AddAttribute("StateRestorePath",
+                          "Checkpoint file the runtime state of the switch is restored from, "
+                          "in place of loading FlowTablePath (empty: load FlowTablePath). "
+                          "The multicast groups are not checkpointed: the mc_* commands of "
+                          "FlowTablePath are still applied.",
+                          StringValue(""),
+                          MakeStringAccessor(&P4SwitchNetDevice::m_stateRestorePath),
+                          MakeStringChecker())
+
+            .AddAttribute("StateCheckpointPath",
+                          "File the runtime state of the switch is saved to at "
+                          "StateCheckpointTime (empty: no checkpoint).",
+                          StringValue(""),
+                          MakeStringAccessor(&P4SwitchNetDevice::m_stateCheckpointPath),
+                          MakeStringChecker())
+
+            .AddAttribute("StateCheckpointTime",
+                          "Simulation time the runtime state of the switch is saved at.",
+                          TimeValue(Seconds(0)),
+                          MakeTimeAccessor(&P4SwitchNetDevice::m_stateCheckpointTime),
+                          MakeTimeChecker(Seconds(0)))
+
             .AddAttribute("InputBufferSizeLow",
                           "Low input buffer size for the switch queue.",
                           UintegerValue(128),
@@ -98,11 +156,123 @@ P4SwitchNetDevice::GetTypeId()
                           MakeUintegerChecker<size_t>())
 
             .AddAttribute("SwitchRate",
-                          "Packet processing speed in switch (unit: pps)",
+                          "Line rate of each egress port of the switch (unit: pps)",
                           UintegerValue(1000),
                           MakeUintegerAccessor(&P4SwitchNetDevice::m_switchRate),
                           MakeUintegerChecker<uint64_t>())
 
+            .AddAttribute("SwitchRateBps",
+                          "Line rate of each egress port of the switch in bits per second, "
+                          "using the size of each packet. Replaces SwitchRate if not 0.",
+                          UintegerValue(0),
+                          MakeUintegerAccessor(&P4SwitchNetDevice::m_switchRateBps),
+                          MakeUintegerChecker<uint64_t>())
+
+            .AddAttribute("QueueBufferSizeBytes",
+                          "Capacity in bytes of each egress queue, on top of QueueBufferSize "
+                          "(0: no byte limit).",
+                          UintegerValue(0),
+                          MakeUintegerAccessor(&P4SwitchNetDevice::m_queueBufferSizeBytes),
+                          MakeUintegerChecker<size_t>())
+
+            .AddAttribute("QueueAqm",
+                          "Active queue management of each egress queue: none, red, ecn or pie, "
+                          "with optional parameters, e.g. \"red:min=5,max=15,maxp=0.1\" or "
+                          "\"ecn:k=20,bytes=1\" (see P4Aqm::Config::Parse).",
+                          StringValue("none"),
+                          MakeStringAccessor(&P4SwitchNetDevice::m_queueAqm),
+                          MakeStringChecker())
+
+            .AddAttribute("SharedBufferSizeBytes",
+                          "Size in bytes of a buffer shared by all the egress queues, with "
+                          "dynamic thresholds, on top of their own capacities (0: no shared "
+                          "buffer).",
+                          UintegerValue(0),
+                          MakeUintegerAccessor(&P4SwitchNetDevice::m_sharedBufferSizeBytes),
+                          MakeUintegerChecker<size_t>())
+
+            .AddAttribute("SharedBufferReserveBytes",
+                          "Bytes of the shared buffer guaranteed to each egress queue.",
+                          UintegerValue(0),
+                          MakeUintegerAccessor(&P4SwitchNetDevice::m_sharedBufferReserveBytes),
+                          MakeUintegerChecker<size_t>())
+
+            .AddAttribute("SharedBufferAlpha",
+                          "Dynamic threshold factor of the shared buffer: a queue takes at most "
+                          "alpha times the free shared bytes beyond its reserve.",
+                          DoubleValue(1.0),
+                          MakeDoubleAccessor(&P4SwitchNetDevice::m_sharedBufferAlpha),
+                          MakeDoubleChecker<double>(0.0))
+
+            .AddAttribute("PfcEnabled",
+                          "Pause the upstream device of a port with PFC frames when its packets "
+                          "of a priority fill the egress buffer. Enables PFC on the "
+                          "CustomP2PNetDevice ports of the switch. The PFC priority is the IPv4 "
+                          "precedence (three high bits of the TOS), as in CustomP2PNetDevice: "
+                          "the switch queues the packets by PFC priority instead of "
+                          "standard_metadata.priority.",
+                          BooleanValue(false),
+                          MakeBooleanAccessor(&P4SwitchNetDevice::m_pfcEnabled),
+                          MakeBooleanChecker())
+
+            .AddAttribute("PfcXoffBytes",
+                          "Bytes of an ingress port and priority in the egress buffer pausing "
+                          "the upstream device.",
+                          UintegerValue(96000),
+                          MakeUintegerAccessor(&P4SwitchNetDevice::m_pfcXoffBytes),
+                          MakeUintegerChecker<uint64_t>(1))
+
+            .AddAttribute("PfcXonBytes",
+                          "Bytes of an ingress port and priority in the egress buffer resuming "
+                          "the upstream device, below PfcXoffBytes.",
+                          UintegerValue(64000),
+                          MakeUintegerAccessor(&P4SwitchNetDevice::m_pfcXonBytes),
+                          MakeUintegerChecker<uint64_t>())
+
+            .AddAttribute("PacketPoolSize",
+                          "Number of bm packets the switch keeps for reuse (0 disables the pool).",
+                          UintegerValue(P4PacketPool::DEFAULT_MAX_PACKETS),
+                          MakeUintegerAccessor(&P4SwitchNetDevice::m_packetPoolSize),
+                          MakeUintegerChecker<size_t>())
+
+            .AddAttribute("EgressBatchSize",
+                          "Maximum number of packets eligible at the same time that are run "
+                          "through the egress pipeline in one dequeue event.",
+                          UintegerValue(P4SwitchCore::DEFAULT_EGRESS_BATCH_SIZE),
+                          MakeUintegerAccessor(&P4SwitchNetDevice::m_egressBatchSize),
+                          MakeUintegerChecker<size_t>(1))
+
+            .AddAttribute("ParserLatency",
+                          "Processing latency of the parser.",
+                          TimeValue(Seconds(0)),
+                          MakeTimeAccessor(&P4SwitchNetDevice::m_parserLatency),
+                          MakeTimeChecker(Seconds(0)))
+
+            .AddAttribute("IngressStageLatency",
+                          "Fixed processing latency of the ingress control.",
+                          TimeValue(Seconds(0)),
+                          MakeTimeAccessor(&P4SwitchNetDevice::m_ingressStageLatency),
+                          MakeTimeChecker(Seconds(0)))
+
+            .AddAttribute("EgressStageLatency",
+                          "Fixed processing latency of the egress control "
+                          "(not used by the PNA NIC, which only has a main control).",
+                          TimeValue(Seconds(0)),
+                          MakeTimeAccessor(&P4SwitchNetDevice::m_egressStageLatency),
+                          MakeTimeChecker(Seconds(0)))
+
+            .AddAttribute("DeparserLatency",
+                          "Processing latency of the deparser.",
+                          TimeValue(Seconds(0)),
+                          MakeTimeAccessor(&P4SwitchNetDevice::m_deparserLatency),
+                          MakeTimeChecker(Seconds(0)))
+
+            .AddAttribute("TableLookupLatency",
+                          "Latency added per match table of the ingress and egress controls.",
+                          TimeValue(Seconds(0)),
+                          MakeTimeAccessor(&P4SwitchNetDevice::m_tableLookupLatency),
+                          MakeTimeChecker(Seconds(0)))
+
             .AddAttribute("ChannelType",
                           "Channel type for the switch, csma with 0, p2p with 1.",
                           UintegerValue(0),
@@ -114,29 +284,183 @@ P4SwitchNetDevice::GetTypeId()
                 "The MAC-level Maximum Transmission Unit",
                 UintegerValue(1500),
                 MakeUintegerAccessor(&P4SwitchNetDevice::SetMtu, &P4SwitchNetDevice::GetMtu),
-                MakeUintegerChecker<uint16_t>());
+                MakeUintegerChecker<uint16_t>())
+
+            .AddTraceSource("IngressParsed",
+                            "A packet went through the parser and the ingress control.",
+                            MakeTraceSourceAccessor(&P4SwitchNetDevice::m_ingressParsedTrace),
+                            "ns3::P4SwitchNetDevice::PacketEventTracedCallback")
+
+            .AddTraceSource("IngressDone",
+                            "The ingress pipeline chose the egress port of a packet.",
+                            MakeTraceSourceAccessor(&P4SwitchNetDevice::m_ingressDoneTrace),
+                            "ns3::P4SwitchNetDevice::PacketEventTracedCallback")
+
+            .AddTraceSource("Enqueued",
+                            "A packet was queued for its egress port.",
+                            MakeTraceSourceAccessor(&P4SwitchNetDevice::m_enqueuedTrace),
+                            "ns3::P4SwitchNetDevice::PacketEventTracedCallback")
+
+            .AddTraceSource("Dequeued",
+                            "A packet left its egress queue for the egress pipeline.",
+                            MakeTraceSourceAccessor(&P4SwitchNetDevice::m_dequeuedTrace),
+                            "ns3::P4SwitchNetDevice::PacketEventTracedCallback")
+
+            .AddTraceSource("EgressDone",
+                            "A packet left the egress pipeline and is sent.",
+                            MakeTraceSourceAccessor(&P4SwitchNetDevice::m_egressDoneTrace),
+                            "ns3::P4SwitchNetDevice::PacketEventTracedCallback")
+
+            .AddTraceSource("Dropped",
+                            "A packet was dropped by the switch, the event carries the reason.",
+                            MakeTraceSourceAccessor(&P4SwitchNetDevice::m_droppedTrace),
+                            "ns3::P4SwitchNetDevice::PacketEventTracedCallback")
+
+            .AddTraceSource("Cloned",
+                            "A clone of a packet was queued (ingress or egress cloning).",
+                            MakeTraceSourceAccessor(&P4SwitchNetDevice::m_clonedTrace),
+                            "ns3::P4SwitchNetDevice::PacketEventTracedCallback")
+
+            .AddTraceSource("Recirculated",
+                            "A packet was sent back to the ingress pipeline.",
+                            MakeTraceSourceAccessor(&P4SwitchNetDevice::m_recirculatedTrace),
+                            "ns3::P4SwitchNetDevice::PacketEventTracedCallback")
+
+            .AddTraceSource("Multicast",
+                            "A multicast replica of a packet was queued.",
+                            MakeTraceSourceAccessor(&P4SwitchNetDevice::m_multicastTrace),
+                            "ns3::P4SwitchNetDevice::PacketEventTracedCallback");
 
     return tid;
 }
 
 P4SwitchNetDevice::P4SwitchNetDevice()
-    : m_node(nullptr),
+    : m_v1modelSwitch(nullptr),
+      m_p4Pipeline(nullptr),
+      m_psaSwitch(nullptr),
+      m_pnaNic(nullptr),
+      m_coreCreated(false),
+      m_node(nullptr),
       m_ifIndex(0)
 {
     NS_LOG_FUNCTION_NOARGS();
     m_channel = CreateObject<P4BridgeChannel>();
+    g_pendingDevices.push_back(this);
 }
 
 P4SwitchNetDevice::~P4SwitchNetDevice()
 {
     NS_LOG_FUNCTION_NOARGS();
+    g_pendingDevices.erase(std::remove(g_pendingDevices.begin(), g_pendingDevices.end(), this),
+                           g_pendingDevices.end());
 }
 
 void
-P4SwitchNetDevice::DoInitialize()
+P4SwitchNetDevice::BringUpPendingSwitches()
+{
+    NS_LOG_FUNCTION_NOARGS();
+
+    std::vector<P4SwitchNetDevice*> devices;
+    devices.swap(g_pendingDevices);
+#ifdef NS3_MPI
+    // In a distributed simulation, the switches of the other ranks are not
+    // brought up: their devices exist on every rank but are never used here
+    if (MpiInterface::IsEnabled())
+    {
+        uint32_t rank = MpiInterface::GetSystemId();
+        devices.erase(std::remove_if(devices.begin(),
+                                     devices.end(),
+                                     [rank](const P4SwitchNetDevice* device) {
+                                         return device->m_node &&
+                                                device->m_node->GetSystemId() != rank;
+                                     }),
+                      devices.end());
+    }
+#endif
+    if (devices.empty())
+    {
+        return;
+    }
+
+    // Same order as the nodes initialize their devices
+    std::stable_sort(devices.begin(),
+                     devices.end(),
+                     [](const P4SwitchNetDevice* a, const P4SwitchNetDevice* b) {
+                         uint32_t nodeA = a->m_node ? a->m_node->GetId() : UINT32_MAX;
+                         uint32_t nodeB = b->m_node ? b->m_node->GetId() : UINT32_MAX;
+                         return std::make_pair(nodeA, a->m_ifIndex) <
+                                std::make_pair(nodeB, b->m_ifIndex);
+                     });
+
+    // ns-3 objects, attributes and switch IDs are handled on the main thread
+    for (P4SwitchNetDevice* device : devices)
+    {
+        device->CreateCore();
+    }
+
+    UintegerValue threadsValue;
+    g_p4SwitchBringUpThreads.GetValue(threadsValue);
+    size_t nbThreads = threadsValue.Get();
+    if (nbThreads == 0)
+    {
+        nbThreads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    nbThreads = std::min(nbThreads, devices.size());
+    NS_LOG_INFO("Bringing up " << devices.size() << " P4 switches with " << nbThreads
+                               << " threads");
+
+    std::vector<int> status(devices.size(), 0);
+    std::vector<std::exception_ptr> errors(devices.size());
+    std::atomic<size_t> next{0};
+    auto worker = [&]() {
+        for (size_t i = next++; i < devices.size(); i = next++)
+        {
+            try
+            {
+                status[i] = devices[i]->LoadCore();
+            }
+            catch (...)
+            {
+                errors[i] = std::current_exception();
+            }
+        }
+    };
+
+    std::vector<std::thread> pool;
+    for (size_t i = 1; i < nbThreads; i++)
+    {
+        pool.emplace_back(worker);
+    }
+    worker(); // the main thread takes its share
+    for (auto& thread : pool)
+    {
+        thread.join();
+    }
+
+    // Hand the results back in the device order
+    for (size_t i = 0; i < devices.size(); i++)
+    {
+        if (errors[i])
+        {
+            std::rethrow_exception(errors[i]);
+        }
+        if (status[i] != 0)
+        {
+            const std::string& restorePath = devices[i]->m_stateRestorePath;
+            NS_LOG_WARN("P4 switch on node "
+                        << (devices[i]->m_node ? devices[i]->m_node->GetId() : UINT32_MAX)
+                        << " did not load its "
+                        << (restorePath.empty() ? "flow table " + devices[i]->m_flowTablePath
+                                                : "state checkpoint " + restorePath)
+                        << " completely");
+        }
+    }
+}
+
+void
+P4SwitchNetDevice::CreateCore()
 {
     NS_LOG_FUNCTION(this);
-    NS_LOG_DEBUG("P4 architecture: v1model");
 
     switch (m_switchArch)
     {
@@ -149,9 +473,6 @@ P4SwitchNetDevice::DoInitialize()
                                             m_InputBufferSizeLow,
                                             m_InputBufferSizeHigh,
                                             m_queueBufferSize);
-        m_v1modelSwitch->InitializeSwitchFromP4Json(m_jsonPath);
-        m_v1modelSwitch->LoadFlowTableToSwitch(m_flowTablePath);
-        m_v1modelSwitch->start_and_return_();
         break;
 
     case P4SWITCH_ARCH_PSA:
@@ -162,36 +483,184 @@ P4SwitchNetDevice::DoInitialize()
                                     m_switchRate,
                                     m_InputBufferSizeLow, // normal input queue size
                                     m_queueBufferSize);
-        m_psaSwitch->InitializeSwitchFromP4Json(m_jsonPath);
-        m_psaSwitch->LoadFlowTableToSwitch(m_flowTablePath);
-        m_psaSwitch->start_and_return_();
         break;
 
     case P4NIC_ARCH_PNA:
         NS_LOG_DEBUG("P4 architecture: PNA");
-        m_pnaNic = new P4PnaNic(this, m_enableSwap);
-        m_pnaNic->InitializeSwitchFromP4Json(m_jsonPath);
-        // m_pnaNic->LoadFlowTableToSwitch(m_flowTablePath); // Now not supported
-        m_pnaNic->start_and_return_();
+        m_pnaNic = new P4PnaNic(this, m_enableSwap, m_switchRate, m_InputBufferSizeLow);
         break;
 
     case P4SWITCH_ARCH_PIPELINE:
-
         NS_LOG_DEBUG("P4 architecture: Pipeline");
         m_p4Pipeline = new P4CorePipeline(this, m_enableSwap, m_enableTracing);
-        m_p4Pipeline->InitializeSwitchFromP4Json(m_jsonPath);
-        m_p4Pipeline->LoadFlowTableToSwitch(m_flowTablePath);
-        // m_p4Pipeline->InitSwitchWithP4(m_jsonPath, m_flowTablePath);
-        m_p4Pipeline->start_and_return_();
         break;
     }
+    if (GetCore())
+    {
+        GetCore()->SetPacketPoolSize(m_packetPoolSize);
+        GetCore()->SetEgressBatchSize(m_egressBatchSize);
+
+        P4SwitchCore::PipelineLatency latency;
+        latency.parser = m_parserLatency;
+        latency.ingressStage = m_ingressStageLatency;
+        latency.egressStage = m_egressStageLatency;
+        latency.deparser = m_deparserLatency;
+        latency.tableLookup = m_tableLookupLatency;
+        GetCore()->SetPipelineLatency(latency);
+
+        if (m_enableTableStats)
+        {
+            GetCore()->SetTableStatsEnabled(true);
+        }
+        if (m_queueHistograms)
+        {
+            GetCore()->EnableQueueHistograms(true);
+        }
+        if (m_switchRateBps > 0)
+        {
+            // the bit rate replaces the packet rate set by the core
+            GetCore()->SetAllEgressQueueRatesBps(m_switchRateBps);
+            GetCore()->SetAllEgressPortRatesBps(m_switchRateBps);
+        }
+        if (m_queueBufferSizeBytes > 0)
+        {
+            GetCore()->SetAllEgressQueueByteDepths(m_queueBufferSizeBytes);
+        }
+        if (m_queueAqm != "none")
+        {
+            P4Aqm::Config config;
+            std::string error;
+            if (!P4Aqm::Config::Parse(m_queueAqm, &config, &error))
+            {
+                NS_FATAL_ERROR("Invalid QueueAqm \"" << m_queueAqm << "\": " << error);
+            }
+            GetCore()->SetAllEgressQueueAqm(config);
+        }
+        if (m_sharedBufferSizeBytes > 0)
+        {
+            GetCore()->SetEgressSharedBuffer(m_sharedBufferSizeBytes,
+                                             m_sharedBufferReserveBytes,
+                                             m_sharedBufferAlpha);
+        }
+        if (m_pfcEnabled)
+        {
+            if (m_pfcXonBytes >= m_pfcXoffBytes)
+            {
+                NS_FATAL_ERROR("PfcXonBytes must be below PfcXoffBytes");
+            }
+            if (GetCore()->EnablePfc(m_pfcXoffBytes, m_pfcXonBytes) != 0)
+            {
+                NS_FATAL_ERROR("PfcEnabled needs a v1model or PSA switch with 8 queues per port");
+            }
+        }
+    }
+    m_coreCreated = true;
+}
+
+int
+P4SwitchNetDevice::LoadCore()
+{
+    P4SwitchCore* core = GetCore();
+    if (!core)
+    {
+        return 1;
+    }
+    core->InitializeSwitchFromP4Json(m_jsonPath);
+    if (!m_stateRestorePath.empty())
+    {
+        int status = core->LoadStateFromFile(m_stateRestorePath);
+        // the multicast groups of the PRE are not in the checkpoint, they are
+        // created again by the commands of the flow table
+        if (std::ifstream(m_flowTablePath).good())
+        {
+            status |= core->LoadFlowTableToSwitch(m_flowTablePath, "mc_");
+        }
+        else
+        {
+            NS_LOG_WARN("No flow table to create the multicast groups from: " << m_flowTablePath);
+        }
+        return status;
+    }
+    return core->LoadFlowTableToSwitch(m_flowTablePath);
+}
+
+P4SwitchCore*
+P4SwitchNetDevice::GetCore() const
+{
+    if (m_v1modelSwitch)
+    {
+        return m_v1modelSwitch;
+    }
+    if (m_psaSwitch)
+    {
+        return m_psaSwitch;
+    }
+    if (m_pnaNic)
+    {
+        return m_pnaNic;
+    }
+    return m_p4Pipeline;
+}
+
+const P4Histogram*
+P4SwitchNetDevice::GetQueueDepthHistogram(uint32_t port, uint32_t priority) const
+{
+    P4SwitchCore* core = GetCore();
+    return core ? core->GetQueueDepthHistogram(port, priority) : nullptr;
+}
+
+const P4Histogram*
+P4SwitchNetDevice::GetQueueSojournHistogram(uint32_t port, uint32_t priority) const
+{
+    P4SwitchCore* core = GetCore();
+    return core ? core->GetQueueSojournHistogram(port, priority) : nullptr;
+}
+
+void
+P4SwitchNetDevice::DoInitialize()
+{
+    NS_LOG_FUNCTION(this);
+
+    if (!m_coreCreated)
+    {
+        // First device to initialize: bring up all the switches at once
+        BringUpPendingSwitches();
+    }
+
+    P4SwitchCore* core = GetCore();
+    if (core)
+    {
+        core->start_and_return_();
+        if (!m_stateCheckpointPath.empty())
+        {
+            Time delay = Max(m_stateCheckpointTime - Simulator::Now(), Seconds(0));
+            m_stateCheckpointEvent =
+                Simulator::Schedule(delay, &P4SwitchNetDevice::SaveStateCheckpoint, this);
+        }
+    }
     NetDevice::DoInitialize();
 }
 
+void
+P4SwitchNetDevice::SaveStateCheckpoint()
+{
+    NS_LOG_FUNCTION(this);
+    P4SwitchCore* core = GetCore();
+    if (core && core->SaveStateToFile(m_stateCheckpointPath) != 0)
+    {
+        NS_LOG_WARN("P4 switch on node " << (m_node ? m_node->GetId() : UINT32_MAX)
+                                         << " could not save its state to "
+                                         << m_stateCheckpointPath);
+    }
+}
+
 void
 P4SwitchNetDevice::DoDispose()
 {
     NS_LOG_FUNCTION_NOARGS();
+    g_pendingDevices.erase(std::remove(g_pendingDevices.begin(), g_pendingDevices.end(), this),
+                           g_pendingDevices.end());
+    Simulator::Cancel(m_stateCheckpointEvent);
     for (auto iter = m_ports.begin(); iter != m_ports.end(); iter++)
     {
         *iter = nullptr;
@@ -334,6 +803,17 @@ P4SwitchNetDevice::AddBridgePort(Ptr<NetDevice> bridgePort)
                                     0,
                                     bridgePort,
                                     true);
+
+    // the PFC frames received by the port pause its egress queues
+    Ptr<CustomP2PNetDevice> p2pPort = DynamicCast<CustomP2PNetDevice>(bridgePort);
+    if (p2pPort)
+    {
+        if (m_pfcEnabled)
+        {
+            p2pPort->SetAttribute("PfcEnabled", BooleanValue(true));
+        }
+        p2pPort->SetPfcPauseCallback(MakeCallback(&P4SwitchNetDevice::ReceivePfcPause, this));
+    }
     m_ports.push_back(bridgePort);
     m_channel->AddChannel(bridgePort->GetChannel());
 }
@@ -345,8 +825,10 @@ P4SwitchNetDevice::GetPortNumber(Ptr<NetDevice> port) const
     for (int i = 0; i < portsNum; i++)
     {
         if (GetBridgePort(i) == port)
+        {
             NS_LOG_DEBUG("Port found: " << i);
-        return i;
+            return i;
+        }
     }
     NS_LOG_ERROR("Port not found");
     return -1;
@@ -523,6 +1005,30 @@ P4SwitchNetDevice::SendFrom(Ptr<Packet> packet,
     return true;
 }
 
+void
+P4SwitchNetDevice::SendPfcPause(uint32_t port, uint8_t priority, bool pause)
+{
+    NS_LOG_FUNCTION(this << port << +priority << pause);
+    Ptr<CustomP2PNetDevice> device = DynamicCast<CustomP2PNetDevice>(GetBridgePort(port));
+    if (!device)
+    {
+        NS_LOG_WARN("Port " << port << " is not a CustomP2PNetDevice, no PFC frame sent");
+        return;
+    }
+    device->SendPfcPause(priority, pause);
+}
+
+void
+P4SwitchNetDevice::ReceivePfcPause(Ptr<NetDevice> device, uint8_t priority, bool paused)
+{
+    NS_LOG_FUNCTION(this << device << +priority << paused);
+    P4SwitchCore* core = GetCore();
+    if (core)
+    {
+        core->SetEgressQueuePaused(GetPortNumber(device), priority, paused);
+    }
+}
+
 void
 P4SwitchNetDevice::SendPacket(Ptr<Packet> packetOut,
                               int outPort,
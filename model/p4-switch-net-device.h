@@ -20,12 +20,16 @@
 #ifndef P4_SWITCH_NET_DEVICE
 #define P4_SWITCH_NET_DEVICE
 
+#include "ns3/event-id.h"
 #include "ns3/net-device.h"
 #include "ns3/p4-bridge-channel.h"
+#include "ns3/p4-metrics-sink.h"
+#include "ns3/traced-callback.h"
 
 #include <map>
 #include <stdint.h>
 #include <string>
+#include <vector>
 
 /**
  * \file
@@ -49,6 +53,21 @@ class P4CoreV1model;
 class P4CorePsa;
 class P4PnaNic;
 class P4CorePipeline;
+class P4SwitchCore;
+
+/**
+ * \brief A step of the life of a packet inside a P4 switch, reported by the
+ * packet trace sources of P4SwitchNetDevice
+ */
+struct P4PacketEvent
+{
+    uint64_t packetId; //!< ID of the packet in the switch
+    uint32_t port;     //!< Ingress port for the ingress events, egress port otherwise
+    uint32_t priority; //!< Queue priority, 0 before the packet is queued
+    uint32_t size;     //!< Packet size (bytes)
+    uint32_t depth;    //!< Input buffer depth for the ingress events, port queue depth otherwise
+    P4MetricsSink::DropReason reason; //!< Why the packet was dropped, Dropped only
+};
 
 /**
  * \defgroup P4 Switch Network Device
@@ -67,6 +86,12 @@ class P4SwitchNetDevice : public NetDevice
      */
     static TypeId GetTypeId();
 
+    /**
+     * \brief TracedCallback signature of the packet trace sources
+     * \param event the packet event
+     */
+    typedef void (*PacketEventTracedCallback)(const P4PacketEvent& event);
+
     P4SwitchNetDevice();
     ~P4SwitchNetDevice() override;
 
@@ -149,6 +174,45 @@ class P4SwitchNetDevice : public NetDevice
                        uint16_t protocol,
                        const Address& destination);
 
+    /**
+     * \brief Bring up the P4 cores of all the switches not initialized yet.
+     *
+     * The cores are constructed on the main thread, then the P4 programs and
+     * flow tables are loaded on a pool of "P4SwitchBringUpThreads" threads.
+     * The cores are started (events scheduled) later by each device in its own
+     * DoInitialize, in the usual order. This is called by the first
+     * DoInitialize; calling it after the installation of all the switches
+     * moves the start-up cost before Simulator::Run.
+     */
+    static void BringUpPendingSwitches();
+
+    /**
+     * \brief Gets the depth histogram of an egress queue.
+     * \param port the egress port
+     * \param priority the packet priority of the queue
+     * \return the depths seen by the packets enqueued (packets), nullptr
+     * without EnableQueueHistograms or egress queues
+     */
+    const P4Histogram* GetQueueDepthHistogram(uint32_t port, uint32_t priority) const;
+
+    /**
+     * \brief Gets the sojourn time histogram of an egress queue.
+     * \param port the egress port
+     * \param priority the packet priority of the queue
+     * \return the times the packets spent in the queue (ns), nullptr
+     * without EnableQueueHistograms or egress queues
+     */
+    const P4Histogram* GetQueueSojournHistogram(uint32_t port, uint32_t priority) const;
+
+    /**
+     * \brief Sends a PFC frame pausing or resuming a priority of the upstream
+     * device of a port. Called by the switch core from its ingress accounting.
+     * \param port the ingress port
+     * \param priority the packet priority
+     * \param pause true to pause the priority, false to resume it
+     */
+    void SendPfcPause(uint32_t port, uint8_t priority, bool pause);
+
     // inherited from NetDevice base class.
     void SetIfIndex(const uint32_t index) override;
     uint32_t GetIfIndex() const override;
@@ -204,6 +268,19 @@ class P4SwitchNetDevice : public NetDevice
                            const Address& destination,
                            PacketType packetType);
 
+    /**
+     * \brief Pauses or resumes an egress queue on a PFC frame received by a port.
+     * \param device the port
+     * \param priority the packet priority
+     * \param paused true if paused, false if resumed
+     */
+    void ReceivePfcPause(Ptr<NetDevice> device, uint8_t priority, bool paused);
+
+    /**
+     * \brief Saves the runtime state of the switch core to StateCheckpointPath.
+     */
+    void SaveStateCheckpoint();
+
     // /**
     //  * \brief Gets the port associated to a source address
     //  * \param source the source address
@@ -212,10 +289,34 @@ class P4SwitchNetDevice : public NetDevice
     // Ptr<NetDevice> GetLearnedState(Mac48Address source);
 
   private:
+    /**
+     * \brief Construct the switch core of the configured architecture.
+     * Must run on the main thread.
+     */
+    void CreateCore();
+
+    /**
+     * \brief Load the P4 program and the flow table (or the state checkpoint)
+     * into the switch core.
+     * Only touches the core, so it can run on a worker thread.
+     * \return 0 on success
+     */
+    int LoadCore();
+
+    /**
+     * \brief Get the switch core, whatever its architecture
+     * \return the switch core, or nullptr if not created yet
+     */
+    P4SwitchCore* GetCore() const;
+
+    static std::vector<P4SwitchNetDevice*> g_pendingDevices; //!< Devices without core yet
+
     // === Basic configuration ===
-    bool m_enableTracing;  //!< Enable tracing
-    bool m_enableSwap;     //!< Enable swapping
-    uint32_t m_switchArch; //!< Switch architecture type
+    bool m_enableTracing;    //!< Enable tracing
+    bool m_enableSwap;       //!< Enable swapping
+    bool m_enableTableStats; //!< Count the table statistics
+    bool m_queueHistograms;  //!< Keep histograms of the egress queues
+    uint32_t m_switchArch;   //!< Switch architecture type
 
     // === P4 configuration and initialization ===
     std::string m_jsonPath;         //!< Path to the P4 JSON configuration file.
@@ -224,12 +325,39 @@ class P4SwitchNetDevice : public NetDevice
     P4CorePipeline* m_p4Pipeline;   //!< P4 pipeline core
     P4CorePsa* m_psaSwitch;         //!< PSA switch core
     P4PnaNic* m_pnaNic;             //!< PNA NIC core
+    bool m_coreCreated;             //!< Core created by BringUpPendingSwitches
 
     // === Buffer and queue configuration ===
-    size_t m_InputBufferSizeLow;  //!< Input buffer normal packets(low priority) size
-    size_t m_InputBufferSizeHigh; //!< Input buffer (high priority) size
-    size_t m_queueBufferSize;     //!< Queue buffer size
-    uint64_t m_switchRate;        //!< Switch rate, packet processing speed in switch (unit: pps)
+    size_t m_InputBufferSizeLow;       //!< Input buffer normal packets(low priority) size
+    size_t m_InputBufferSizeHigh;      //!< Input buffer (high priority) size
+    size_t m_queueBufferSize;          //!< Queue buffer size
+    uint64_t m_switchRate;             //!< Switch rate, packet processing speed (unit: pps)
+    uint64_t m_switchRateBps;          //!< Line rate of the egress ports (unit: bps), 0: SwitchRate
+    size_t m_queueBufferSizeBytes;     //!< Queue buffer size in bytes, 0: no byte limit
+    std::string m_queueAqm;            //!< AQM of the egress queues, see P4Aqm::Config::Parse
+    size_t m_sharedBufferSizeBytes;    //!< Shared buffer of the egress queues, 0: none
+    size_t m_sharedBufferReserveBytes; //!< Shared buffer bytes guaranteed to each queue
+    double m_sharedBufferAlpha;        //!< Dynamic threshold factor of the shared buffer
+    size_t m_packetPoolSize;           //!< Number of bm packets kept for reuse by the core
+    size_t m_egressBatchSize;          //!< Maximum packets per egress dequeue event
+
+    // === Priority flow control ===
+    bool m_pfcEnabled;       //!< Pause the upstream devices with PFC
+    uint64_t m_pfcXoffBytes; //!< Bytes of an ingress port and priority pausing its upstream
+    uint64_t m_pfcXonBytes;  //!< Bytes of an ingress port and priority resuming its upstream
+
+    // === Pipeline latency model ===
+    Time m_parserLatency;       //!< Latency of the parser
+    Time m_ingressStageLatency; //!< Fixed latency of the ingress control
+    Time m_egressStageLatency;  //!< Fixed latency of the egress control
+    Time m_deparserLatency;     //!< Latency of the deparser
+    Time m_tableLookupLatency;  //!< Latency per match table of a control
+
+    // === Runtime state checkpoint ===
+    std::string m_stateRestorePath;    //!< Checkpoint restored in place of the flow table
+    std::string m_stateCheckpointPath; //!< Checkpoint saved at m_stateCheckpointTime
+    Time m_stateCheckpointTime;        //!< Time the checkpoint is saved at
+    EventId m_stateCheckpointEvent;    //!< Pending checkpoint
 
     // === Network device information ===
     uint32_t m_channelType;              //!< Channel type
@@ -243,6 +371,17 @@ class P4SwitchNetDevice : public NetDevice
     // === Callback function ===
     NetDevice::ReceiveCallback m_rxCallback;               //!< Receive callback
     NetDevice::PromiscReceiveCallback m_promiscRxCallback; //!< Promiscuous mode receive callback
+
+    // === Packet trace sources, fired by the switch core ===
+    TracedCallback<const P4PacketEvent&> m_ingressParsedTrace; //!< Parser and ingress control ran
+    TracedCallback<const P4PacketEvent&> m_ingressDoneTrace;   //!< Egress port chosen by ingress
+    TracedCallback<const P4PacketEvent&> m_enqueuedTrace;      //!< Packet queued for egress
+    TracedCallback<const P4PacketEvent&> m_dequeuedTrace;      //!< Packet left its egress queue
+    TracedCallback<const P4PacketEvent&> m_egressDoneTrace;    //!< Packet left the egress stage
+    TracedCallback<const P4PacketEvent&> m_droppedTrace;       //!< Packet dropped by the switch
+    TracedCallback<const P4PacketEvent&> m_clonedTrace;        //!< Clone of a packet queued
+    TracedCallback<const P4PacketEvent&> m_recirculatedTrace;  //!< Packet sent back to ingress
+    TracedCallback<const P4PacketEvent&> m_multicastTrace;     //!< Multicast replica queued
 };
 
 } // namespace ns3
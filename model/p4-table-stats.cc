@@ -0,0 +1,179 @@
+/*
+ * Copyright (c) 2025 TU Dresden
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Authors: Mingyu Ma <mingyu.ma@tu-dresden.de>
+ */
+
+#include "ns3/global-value.h"
+#include "ns3/log.h"
+#include "ns3/p4-switch-core.h"
+#include "ns3/p4-table-stats.h"
+#include "ns3/simulator.h"
+#include "ns3/string.h"
+
+#include <algorithm>
+#include <fstream>
+
+namespace ns3
+{
+
+NS_LOG_COMPONENT_DEFINE("P4TableStats");
+
+static GlobalValue g_p4TableStatsFile("P4TableStatsFile",
+                                      "File the table statistics of the P4 switches are written "
+                                      "to when the simulator is destroyed (empty: not written)",
+                                      StringValue("p4-table-stats.csv"),
+                                      MakeStringChecker());
+
+P4TableStats* P4TableStats::g_stats = nullptr;
+std::mutex P4TableStats::g_programsMutex;
+std::map<std::pair<std::string, uint64_t>,
+         std::shared_ptr<const P4TableStats::InstrumentedProgram>>
+    P4TableStats::g_programs;
+
+std::shared_ptr<const P4TableStats::InstrumentedProgram>
+P4TableStats::Instrument(const P4JsonCache::Program& program, std::string* error)
+{
+    std::lock_guard<std::mutex> lock(g_programsMutex);
+    auto key = std::make_pair(program.jsonPath, program.hash);
+    auto it = g_programs.find(key);
+    if (it != g_programs.end())
+    {
+        return it->second;
+    }
+
+    auto instrumented = std::make_shared<InstrumentedProgram>();
+    if (!P4ProgramInfo::InstrumentTableStats(program.json,
+                                             &instrumented->json,
+                                             &instrumented->counted,
+                                             error))
+    {
+        return nullptr;
+    }
+    NS_LOG_INFO("Instrumented " << program.jsonPath << ": " << instrumented->counted.size()
+                                << " table actions counted");
+    g_programs.emplace(key, instrumented);
+    return instrumented;
+}
+
+P4TableStats*
+P4TableStats::Get()
+{
+    if (!g_stats)
+    {
+        g_stats = new P4TableStats();
+        Simulator::ScheduleDestroy(&P4TableStats::Destroy);
+    }
+    return g_stats;
+}
+
+void
+P4TableStats::Destroy()
+{
+    StringValue fileValue;
+    g_p4TableStatsFile.GetValue(fileValue);
+    std::string path = fileValue.Get();
+    if (!path.empty())
+    {
+        // Each MPI rank reports its own switches, in its own file
+        if (Simulator::GetSystemId() != 0)
+        {
+            size_t dot = path.rfind('.');
+            size_t slash = path.rfind('/');
+            if (dot == std::string::npos || (slash != std::string::npos && dot < slash))
+            {
+                dot = path.size();
+            }
+            path.insert(dot, "-" + std::to_string(Simulator::GetSystemId()));
+        }
+        g_stats->Dump(path);
+    }
+    delete g_stats;
+    g_stats = nullptr;
+}
+
+void
+P4TableStats::Remove(P4SwitchCore* core)
+{
+    if (!g_stats)
+    {
+        return;
+    }
+    auto& cores = g_stats->m_cores;
+    auto it = std::find(cores.begin(), cores.end(), core);
+    if (it == cores.end())
+    {
+        return;
+    }
+    g_stats->m_destroyed.push_back(core->GetTableStats());
+    cores.erase(it);
+}
+
+void
+P4TableStats::Add(P4SwitchCore* core)
+{
+    if (std::find(m_cores.begin(), m_cores.end(), core) == m_cores.end())
+    {
+        m_cores.push_back(core);
+    }
+}
+
+void
+P4TableStats::Write(std::ostream& os)
+{
+    std::vector<SwitchCounters> switches = m_destroyed;
+    for (P4SwitchCore* core : m_cores)
+    {
+        switches.push_back(core->GetTableStats());
+    }
+    std::sort(switches.begin(),
+              switches.end(),
+              [](const SwitchCounters& a, const SwitchCounters& b) {
+                  return a.switchId < b.switchId;
+              });
+
+    os << "switch,table,action,lookups,hits,misses,executions\n";
+    for (const auto& sw : switches)
+    {
+        for (const auto& table : sw.tables)
+        {
+            os << sw.switchId << ',' << table.name << ",," << table.lookups << ',' << table.hits
+               << ',' << table.misses << ",\n";
+            for (const auto& action : table.actions)
+            {
+                os << sw.switchId << ',' << table.name << ',' << action.name << ",,,,"
+                   << action.executions << '\n';
+            }
+        }
+    }
+}
+
+bool
+P4TableStats::Dump(const std::string& path)
+{
+    std::ofstream file(path, std::ios::out | std::ios::trunc);
+    if (!file.is_open())
+    {
+        NS_LOG_ERROR("Failed to open the table statistics file " << path);
+        return false;
+    }
+    Write(file);
+    NS_LOG_INFO("Table statistics of " << m_cores.size() + m_destroyed.size()
+                                       << " switches written to " << path);
+    return true;
+}
+
+} // namespace ns3
@@ -0,0 +1,172 @@
+/*
+ * Copyright (c) 2025 TU Dresden
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Authors: Mingyu Ma <mingyu.ma@tu-dresden.de>
+ */
+
+#ifndef P4_TABLE_STATS_H
+#define P4_TABLE_STATS_H
+
+#include "ns3/p4-json-cache.h"
+#include "ns3/p4-program-info.h"
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace ns3
+{
+
+class P4SwitchCore;
+
+/**
+ * @brief Per-table lookup, hit and miss counters and per-action execution
+ * counters of the P4 switches, reported for all the switches at once.
+ *
+ * The instrumentation is opt-in, per switch (EnableTableStats attribute of
+ * P4SwitchNetDevice). The program of an instrumented switch is rewritten by
+ * P4ProgramInfo::InstrumentTableStats before bmv2 loads it: the counters
+ * then live in bmv2 counter arrays of the switch and are incremented inside
+ * the pipeline, without going through the bmv2 event logger. They are only
+ * read when a report is written.
+ *
+ * The report is one CSV document for all the switches, with the columns
+ * switch,table,action,lookups,hits,misses,executions. Each table has a row
+ * with an empty action (lookups, hits, misses), followed by a row per action
+ * (executions). It is written to the P4TableStatsFile global value when the
+ * simulator is destroyed, or on demand with Write or Dump. In a distributed
+ * simulation, the ranks other than 0 suffix the file name with their system
+ * id (p4-table-stats-1.csv), as the metrics file does.
+ *
+ * The hits are the sum of the hit counters of the table entries: the hits of
+ * deleted entries are lost, and counted as misses. Indirect tables (action
+ * profiles) are not instrumented, neither is a program swapped in at run
+ * time.
+ */
+class P4TableStats
+{
+  public:
+    /**
+     * @brief Executions of one action of a table
+     */
+    struct ActionCounters
+    {
+        std::string name;       //!< Fully qualified action name
+        uint64_t executions{0}; //!< Times the table ran the action
+    };
+
+    /**
+     * @brief Counters of one table
+     */
+    struct TableCounters
+    {
+        std::string name;                    //!< Fully qualified table name
+        uint64_t lookups{0};                 //!< Times the table was applied
+        uint64_t hits{0};                    //!< Lookups matching an entry
+        uint64_t misses{0};                  //!< Lookups running the default action
+        std::vector<ActionCounters> actions; //!< Executions per action
+    };
+
+    /**
+     * @brief Counters of all the tables of a switch
+     */
+    struct SwitchCounters
+    {
+        int switchId{0};                   //!< ID of the switch
+        std::vector<TableCounters> tables; //!< Tables, in program order
+    };
+
+    /**
+     * @brief A program instrumented for the table statistics
+     */
+    struct InstrumentedProgram
+    {
+        std::string json;                                   //!< Instrumented JSON text
+        std::vector<P4ProgramInfo::CountedAction> counted; //!< Counter index to (table, action)
+    };
+
+    /**
+     * @brief Instrument a program, once for all the switches running it
+     * @details Thread-safe, the switches load their programs in parallel.
+     * @param program the program
+     * @param error set to a description of the problem on failure
+     * @return the instrumented program, nullptr on failure
+     */
+    static std::shared_ptr<const InstrumentedProgram> Instrument(
+        const P4JsonCache::Program& program,
+        std::string* error);
+
+    /**
+     * @brief Get the report of the simulation
+     * @details Created on first use, written and destroyed with the simulator.
+     * Must be called on the main thread.
+     * @return the report
+     */
+    static P4TableStats* Get();
+
+    /**
+     * @brief Remove an instrumented switch, keeping its last counters
+     * @param core the switch, being destroyed
+     */
+    static void Remove(P4SwitchCore* core);
+
+    /**
+     * @brief Add an instrumented switch
+     * @param core the switch
+     */
+    void Add(P4SwitchCore* core);
+
+    /**
+     * @brief Write the report of all the switches now
+     * @param os the output stream
+     */
+    void Write(std::ostream& os);
+
+    /**
+     * @brief Write the report of all the switches now to a file
+     * @param path the file path
+     * @return true on success
+     */
+    bool Dump(const std::string& path);
+
+    P4TableStats(const P4TableStats&) = delete;
+    P4TableStats& operator=(const P4TableStats&) = delete;
+
+  private:
+    P4TableStats() = default;
+
+    /**
+     * @brief Write the report to the P4TableStatsFile and destroy it
+     */
+    static void Destroy();
+
+    static P4TableStats* g_stats; //!< Report of the simulation
+
+    static std::mutex g_programsMutex; //!< Protects g_programs
+    static std::map<std::pair<std::string, uint64_t>, std::shared_ptr<const InstrumentedProgram>>
+        g_programs; //!< (path, content hash) to instrumented program
+
+    std::vector<P4SwitchCore*> m_cores;      //!< Instrumented switches alive
+    std::vector<SwitchCounters> m_destroyed; //!< Last counters of the destroyed switches
+};
+
+} // namespace ns3
+
+#endif /* P4_TABLE_STATS_H */
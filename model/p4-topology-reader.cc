@@ -21,7 +21,13 @@
 #include "ns3/log.h"
 #include "ns3/p4-topology-reader.h"
 
+#ifdef NS3_MPI
+#include "ns3/mpi-interface.h"
+#endif
+
+#include <cstdlib>
 #include <fstream>
+#include <limits>
 #include <sstream>
 #include <vector>
 
@@ -234,7 +240,7 @@ P4TopologyReader::Read()
     nodeNum = switchNum + hostNum;
     nodes.resize(nodeNum, nullptr);
 
-    // Read link information
+    // Read link information, the nodes are created once their rank is known
     for (int i = 0; i < linkNum && !fileStream.eof(); ++i)
     {
         if (!getline(fileStream, line))
@@ -255,17 +261,10 @@ P4TopologyReader::Read()
         NS_LOG_INFO("Link " << i << ": from " << fromType << fromIndex << " to " << toType
                             << toIndex << " with DataRate " << dataRate << " and Delay " << delay);
 
-        // Create nodes if they do not exist
-        CreateNodeIfNeeded(nodes, fromIndex, createdNodeNum);
-        CreateNodeIfNeeded(nodes, toIndex, createdNodeNum);
-
         // Add port count
         uint32_t fromPort = m_portCounter[fromIndex]++;
         uint32_t toPort = m_portCounter[toIndex]++;
 
-        // Add the link
-        AddLinkBetweenNodes(nodes, fromIndex, fromType, toIndex, toType, dataRate, delay);
-
         // Save the link information
         LinkInfo link_info;
         link_info.fromIndex = fromIndex;
@@ -287,6 +286,21 @@ P4TopologyReader::Read()
         return false;
     }
 
+    // Create the nodes in the order of the links, on their MPI rank
+    std::vector<uint32_t> ranks = AssignNodeRanks(nodeNum, switchNum);
+    for (const auto& link : m_links)
+    {
+        CreateNodeIfNeeded(nodes, link.fromIndex, createdNodeNum, ranks[link.fromIndex]);
+        CreateNodeIfNeeded(nodes, link.toIndex, createdNodeNum, ranks[link.toIndex]);
+        AddLinkBetweenNodes(nodes,
+                            link.fromIndex,
+                            link.fromType,
+                            link.toIndex,
+                            link.toType,
+                            link.dataRate,
+                            link.delay);
+    }
+
     // Populate m_switches and m_hosts containers
     AddNodesToContainers(nodes, switchNum, hostNum);
 
@@ -332,21 +346,52 @@ P4TopologyReader::AddLinkBetweenNodes(const std::vector<Ptr<Node>>& nodes,
 
 // Helper: Create a node if it doesn't already exist
 void
-P4TopologyReader::CreateNodeIfNeeded(std::vector<Ptr<Node>>& nodes, int index, int& createdNodeNum)
+P4TopologyReader::CreateNodeIfNeeded(std::vector<Ptr<Node>>& nodes,
+                                     int index,
+                                     int& createdNodeNum,
+                                     uint32_t systemId)
 {
     if (nodes[index] == nullptr)
     {
-        nodes[index] = CreateObject<Node>();
-        NS_LOG_INFO("Created Node " << index);
+        nodes[index] = CreateObject<Node>(systemId);
+        NS_LOG_INFO("Created Node " << index << " on rank " << systemId);
         ++createdNodeNum;
     }
 }
 
+// Helper: Place the hosts on the rank of the first switch they are linked to
+std::vector<uint32_t>
+P4TopologyReader::AssignNodeRanks(int nodeNum, int switchNum) const
+{
+    std::vector<uint32_t> ranks(nodeNum, 0);
+    std::vector<bool> assigned(nodeNum, false);
+    for (int i = 0; i < switchNum; ++i)
+    {
+        ranks[i] = m_switchRanks[i];
+        assigned[i] = true;
+    }
+    for (const auto& link : m_links)
+    {
+        if (link.fromType == 's' && !assigned[link.toIndex])
+        {
+            ranks[link.toIndex] = ranks[link.fromIndex];
+            assigned[link.toIndex] = true;
+        }
+        else if (link.toType == 's' && !assigned[link.fromIndex])
+        {
+            ranks[link.fromIndex] = ranks[link.toIndex];
+            assigned[link.fromIndex] = true;
+        }
+    }
+    return ranks;
+}
+
 // Helper: Read switch network function information
 bool
 P4TopologyReader::ReadSwitchNetworkFunctions(std::ifstream& fileStream, int switchNum)
 {
     m_switchNetFunc.resize(switchNum);
+    m_switchRanks.assign(switchNum, 0);
     std::string line;
     std::istringstream lineStream;
 
@@ -369,9 +414,39 @@ P4TopologyReader::ReadSwitchNetworkFunctions(std::ifstream& fileStream, int swit
             NS_LOG_ERROR("Invalid format in switch network function line: " << line);
             return false;
         }
+        if (switchIndex < 0 || switchIndex >= switchNum)
+        {
+            NS_LOG_ERROR("Invalid switch index in switch network function line: " << line);
+            return false;
+        }
+
+        // optional MPI rank of the switch, 0 by default
+        uint32_t rank = 0;
+        std::string rankToken;
+        if (lineStream >> rankToken)
+        {
+            unsigned long value = std::strtoul(rankToken.c_str(), nullptr, 10);
+            if (rankToken.find_first_not_of("0123456789") != std::string::npos ||
+                value > std::numeric_limits<uint32_t>::max())
+            {
+                NS_LOG_ERROR("Invalid rank '" << rankToken << "' of switch " << switchIndex);
+                return false;
+            }
+            rank = static_cast<uint32_t>(value);
+        }
+#ifdef NS3_MPI
+        if (MpiInterface::IsEnabled() && rank >= MpiInterface::GetSize())
+        {
+            NS_LOG_ERROR("Rank " << rank << " of switch " << switchIndex << " is not one of the "
+                                 << MpiInterface::GetSize() << " MPI ranks");
+            return false;
+        }
+#endif
 
         m_switchNetFunc[switchIndex] = networkFunction;
-        NS_LOG_INFO("Switch " << switchIndex << " assigned function " << networkFunction);
+        m_switchRanks[switchIndex] = rank;
+        NS_LOG_INFO("Switch " << switchIndex << " assigned function " << networkFunction
+                              << " on rank " << rank);
     }
     return true;
 }
@@ -417,9 +492,11 @@ P4TopologyReader::PrintHelp() const
      3 h 0 s 1000Mbps 0.1ms
 
   3. Switch network functions (optional):
-     Format: <switch_index> <network_function>
+     Format: <switch_index> <network_function> [<rank>]
      - <switch_index>: Index of the switch.
      - <network_function>: The function assigned to the switch.
+     - <rank>: MPI rank simulating the switch (default 0), for distributed
+       simulations. A host runs on the rank of the first switch it is linked to.
      Example:
      0 SIMPLE_ROUTER
      1 SIMPLE_ROUTER
@@ -465,9 +542,11 @@ P4TopologyReader::PrintHelp() const
     std::cout << "   3 h 0 s 1000Mbps 0.1ms\n\n";
 
     std::cout << "3. Switch network functions (optional):\n";
-    std::cout << "   Format: <switch_index> <network_function>\n";
+    std::cout << "   Format: <switch_index> <network_function> [<rank>]\n";
     std::cout << "   - <switch_index>: Index of the switch.\n";
     std::cout << "   - <network_function>: The function assigned to the switch.\n";
+    std::cout << "   - <rank>: MPI rank simulating the switch (default 0), for distributed\n";
+    std::cout << "     simulations. A host runs on the rank of the first switch it is linked to.\n";
     std::cout << "   Example:\n";
     std::cout << "   0 SIMPLE_ROUTER\n";
     std::cout << "   1 SIMPLE_ROUTER\n\n";
@@ -156,6 +156,11 @@ class P4TopologyReader : public Object
         return m_switchNetFunc;
     }
 
+    std::vector<uint32_t> GetSwitchRanks(void) const
+    {
+        return m_switchRanks;
+    }
+
     /**
      * \brief Main topology reading function.
      * \return True if the reading was successful, false otherwise.
@@ -167,9 +172,25 @@ class P4TopologyReader : public Object
      * \param [in] nodes The vector of nodes.
      * \param [in] index The index of the node to be created.
      * \param [in] createdNodeNum The number of nodes created so far.
+     * \param [in] systemId The MPI rank simulating the node.
      * \return True if the node was created, false otherwise.
      */
-    void CreateNodeIfNeeded(std::vector<Ptr<Node>>& nodes, int index, int& createdNodeNum);
+    void CreateNodeIfNeeded(std::vector<Ptr<Node>>& nodes,
+                            int index,
+                            int& createdNodeNum,
+                            uint32_t systemId = 0);
+
+    /**
+     * \brief Assign every node to an MPI rank
+     *
+     * Switches run on the rank given with their network function, hosts on the
+     * rank of the first switch they are linked to.
+     *
+     * \param [in] nodeNum The number of nodes.
+     * \param [in] switchNum The number of switches.
+     * \return The rank of each node.
+     */
+    std::vector<uint32_t> AssignNodeRanks(int nodeNum, int switchNum) const;
 
     /**
      * \brief Add a link between two nodes
@@ -312,6 +333,7 @@ class P4TopologyReader : public Object
     NodeContainer m_switches;
 
     std::vector<std::string> m_switchNetFunc;
+    std::vector<uint32_t> m_switchRanks; //!< MPI rank of each switch
     // end class TopologyReader
 };
 
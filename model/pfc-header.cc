@@ -0,0 +1,121 @@
+/*
+ * Copyright (c) 2025 TU Dresden
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Authors: Mingyu Ma <mingyu.ma@tu-dresden.de>
+ */
+
+#include "ns3/pfc-header.h"
+
+namespace ns3
+{
+
+NS_OBJECT_ENSURE_REGISTERED(PfcHeader);
+
+TypeId
+PfcHeader::GetTypeId()
+{
+    static TypeId tid = TypeId("ns3::PfcHeader")
+                            .SetParent<Header>()
+                            .SetGroupName("PointToPoint")
+                            .AddConstructor<PfcHeader>();
+    return tid;
+}
+
+TypeId
+PfcHeader::GetInstanceTypeId() const
+{
+    return GetTypeId();
+}
+
+PfcHeader::PfcHeader()
+    : m_opcode(OPCODE),
+      m_classEnable(0)
+{
+    m_quanta.fill(0);
+}
+
+void
+PfcHeader::SetPause(uint8_t priority, uint16_t quanta)
+{
+    NS_ASSERT(priority < NB_PRIORITIES);
+    m_classEnable |= 1 << priority;
+    m_quanta[priority] = quanta;
+}
+
+bool
+PfcHeader::IsEnabled(uint8_t priority) const
+{
+    return priority < NB_PRIORITIES && (m_classEnable & (1 << priority));
+}
+
+uint16_t
+PfcHeader::GetQuanta(uint8_t priority) const
+{
+    return IsEnabled(priority) ? m_quanta[priority] : 0;
+}
+
+bool
+PfcHeader::IsPfc() const
+{
+    return m_opcode == OPCODE;
+}
+
+void
+PfcHeader::Print(std::ostream& os) const
+{
+    os << "PFC";
+    for (uint8_t priority = 0; priority < NB_PRIORITIES; priority++)
+    {
+        if (IsEnabled(priority))
+        {
+            os << " " << +priority << ":" << m_quanta[priority];
+        }
+    }
+}
+
+uint32_t
+PfcHeader::GetSerializedSize() const
+{
+    return SERIALIZED_SIZE;
+}
+
+void
+PfcHeader::Serialize(Buffer::Iterator start) const
+{
+    Buffer::Iterator i = start;
+    i.WriteHtonU16(m_opcode);
+    i.WriteHtonU16(m_classEnable);
+    for (uint16_t quanta : m_quanta)
+    {
+        i.WriteHtonU16(quanta);
+    }
+    i.WriteU8(0, SERIALIZED_SIZE - 4 - 2 * NB_PRIORITIES);
+}
+
+uint32_t
+PfcHeader::Deserialize(Buffer::Iterator start)
+{
+    Buffer::Iterator i = start;
+    m_opcode = i.ReadNtohU16();
+    m_classEnable = i.ReadNtohU16();
+    for (uint16_t& quanta : m_quanta)
+    {
+        quanta = i.ReadNtohU16();
+    }
+    return SERIALIZED_SIZE;
+}
+
+} // namespace ns3
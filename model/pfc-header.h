@@ -0,0 +1,91 @@
+/*
+ * Copyright (c) 2025 TU Dresden
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Authors: Mingyu Ma <mingyu.ma@tu-dresden.de>
+ */
+
+#ifndef PFC_HEADER_H
+#define PFC_HEADER_H
+
+#include "ns3/header.h"
+
+#include <array>
+
+namespace ns3
+{
+
+/**
+ * @brief Payload of an IEEE 802.1Qbb priority flow control (PFC) frame.
+ *
+ * A MAC control frame (EtherType 0x8808, sent to 01:80:C2:00:00:01) with the
+ * PFC opcode, the class-enable vector and one pause time per priority, in
+ * quanta of 512 bit times. A pause time of 0 resumes the priority. The header
+ * is padded to the minimum Ethernet payload of 46 bytes.
+ */
+class PfcHeader : public Header
+{
+  public:
+    static constexpr uint16_t PROTOCOL_NUMBER = 0x8808; //!< EtherType of the MAC control frames
+    static constexpr uint16_t OPCODE = 0x0101;          //!< Opcode of the PFC frames
+    static constexpr uint8_t NB_PRIORITIES = 8;         //!< Number of priorities
+
+    PfcHeader();
+
+    /**
+     * @brief Pause or resume a priority
+     * @param priority the priority
+     * @param quanta pause time in quanta of 512 bit times, 0 to resume
+     */
+    void SetPause(uint8_t priority, uint16_t quanta);
+
+    /**
+     * @brief Check if the frame carries a pause time for a priority
+     * @param priority the priority
+     * @return true if the priority is enabled in the class-enable vector
+     */
+    bool IsEnabled(uint8_t priority) const;
+
+    /**
+     * @brief Get the pause time of a priority
+     * @param priority the priority
+     * @return the pause time in quanta of 512 bit times, 0 to resume
+     */
+    uint16_t GetQuanta(uint8_t priority) const;
+
+    /**
+     * @brief Check if the frame is a PFC frame
+     * @return true if the opcode is the PFC opcode
+     */
+    bool IsPfc() const;
+
+    static TypeId GetTypeId();
+    TypeId GetInstanceTypeId() const override;
+    void Print(std::ostream& os) const override;
+    uint32_t GetSerializedSize() const override;
+    void Serialize(Buffer::Iterator start) const override;
+    uint32_t Deserialize(Buffer::Iterator start) override;
+
+  private:
+    static constexpr uint32_t SERIALIZED_SIZE = 46; //!< Minimum Ethernet payload
+
+    uint16_t m_opcode;                            //!< MAC control opcode
+    uint16_t m_classEnable;                       //!< Priorities with a pause time
+    std::array<uint16_t, NB_PRIORITIES> m_quanta; //!< Pause times
+};
+
+} // namespace ns3
+
+#endif /* PFC_HEADER_H */
@@ -0,0 +1,340 @@
+/*
+ * Copyright (c) 2025 TU Dresden
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Authors: Mingyu Ma <mingyu.ma@tu-dresden.de>
+ */
+
+#include "ns3/p4-aqm.h"
+#include "ns3/test.h"
+
+using namespace ns3;
+
+/**
+ * @brief Test the parsing of the AQM configurations
+ */
+class P4AqmParseTestCase : public TestCase
+{
+  public:
+    P4AqmParseTestCase()
+        : TestCase("P4Aqm configuration parsing")
+    {
+    }
+
+  private:
+    void DoRun() override
+    {
+        P4Aqm::Config config;
+        std::string error;
+
+        NS_TEST_ASSERT_MSG_EQ(P4Aqm::Config::Parse("none", &config, &error), true, "none");
+        NS_TEST_ASSERT_MSG_EQ(config.mode, P4Aqm::NONE, "none");
+        NS_TEST_ASSERT_MSG_EQ(P4Aqm::Config::Parse("", &config, &error), true, "empty");
+        NS_TEST_ASSERT_MSG_EQ(config.mode, P4Aqm::NONE, "empty");
+
+        NS_TEST_ASSERT_MSG_EQ(P4Aqm::Config::Parse("red:min=20,max=60,maxp=0.05,gentle=0",
+                                                   &config,
+                                                   &error),
+                              true,
+                              "red");
+        NS_TEST_ASSERT_MSG_EQ(config.mode, P4Aqm::RED, "red");
+        NS_TEST_ASSERT_MSG_EQ_TOL(config.minThreshold, 20, 1e-9, "red min");
+        NS_TEST_ASSERT_MSG_EQ_TOL(config.maxThreshold, 60, 1e-9, "red max");
+        NS_TEST_ASSERT_MSG_EQ_TOL(config.maxP, 0.05, 1e-9, "red maxp");
+        NS_TEST_ASSERT_MSG_EQ(config.gentle, false, "red gentle");
+        NS_TEST_ASSERT_MSG_EQ(config.ecn, true, "ecn by default");
+
+        NS_TEST_ASSERT_MSG_EQ(P4Aqm::Config::Parse("ecn:k=30000,bytes=1,ecn=0", &config, &error),
+                              true,
+                              "ecn threshold");
+        NS_TEST_ASSERT_MSG_EQ(config.mode, P4Aqm::ECN_THRESHOLD, "ecn threshold");
+        NS_TEST_ASSERT_MSG_EQ_TOL(config.threshold, 30000, 1e-9, "k");
+        NS_TEST_ASSERT_MSG_EQ(config.bytes, true, "bytes");
+        NS_TEST_ASSERT_MSG_EQ(config.ecn, false, "ecn disabled");
+
+        NS_TEST_ASSERT_MSG_EQ(P4Aqm::Config::Parse("pie:target=20000,tupdate=30000,markecn=0.2",
+                                                   &config,
+                                                   &error),
+                              true,
+                              "pie");
+        NS_TEST_ASSERT_MSG_EQ(config.mode, P4Aqm::PIE, "pie");
+        NS_TEST_ASSERT_MSG_EQ(config.target, MilliSeconds(20), "pie target in microseconds");
+        NS_TEST_ASSERT_MSG_EQ(config.tUpdate, MilliSeconds(30), "pie tupdate in microseconds");
+        NS_TEST_ASSERT_MSG_EQ_TOL(config.markEcnThreshold, 0.2, 1e-9, "pie markecn");
+
+        // the keys not given keep their defaults
+        NS_TEST_ASSERT_MSG_EQ(P4Aqm::Config::Parse("red", &config, &error), true, "defaults");
+        NS_TEST_ASSERT_MSG_EQ_TOL(config.minThreshold, P4Aqm::Config().minThreshold, 1e-9, "min");
+
+        for (const char* invalid : {"codel",
+                                    "red:min",
+                                    "red:min=ten",
+                                    "red:min=-1",
+                                    "red:foo=1",
+                                    "red:min=10,max=5",
+                                    "pie:tupdate=0"})
+        {
+            error.clear();
+            NS_TEST_ASSERT_MSG_EQ(P4Aqm::Config::Parse(invalid, &config, &error),
+                                  false,
+                                  "invalid configuration " << invalid);
+            NS_TEST_ASSERT_MSG_EQ(error.empty(), false, "error reported for " << invalid);
+        }
+    }
+};
+
+/**
+ * @brief Test the verdicts of the ECN threshold and RED policies
+ */
+class P4AqmVerdictTestCase : public TestCase
+{
+  public:
+    P4AqmVerdictTestCase()
+        : TestCase("P4Aqm RED and ECN threshold verdicts")
+    {
+    }
+
+  private:
+    void DoRun() override
+    {
+        Time now = Seconds(0);
+        P4Aqm::Config config;
+        std::string error;
+        P4Aqm aqm;
+        NS_TEST_ASSERT_MSG_EQ(aqm.IsEnabled(), false, "no policy by default");
+        NS_TEST_ASSERT_MSG_EQ(aqm.OnEnqueue(1000, 1000000, now), P4Aqm::PASS, "no policy");
+
+        // ECN threshold, in packets then in bytes
+        P4Aqm::Config::Parse("ecn:k=20", &config, &error);
+        aqm.Configure(config);
+        NS_TEST_ASSERT_MSG_EQ(aqm.IsEnabled(), true, "policy set");
+        NS_TEST_ASSERT_MSG_EQ(aqm.OnEnqueue(19, 100000, now), P4Aqm::PASS, "below k");
+        NS_TEST_ASSERT_MSG_EQ(aqm.OnEnqueue(20, 0, now), P4Aqm::MARK, "at k");
+        NS_TEST_ASSERT_MSG_EQ(aqm.OnEnqueue(19, 0, now), P4Aqm::PASS, "instantaneous depth");
+
+        P4Aqm::Config::Parse("ecn:k=3000,bytes=1,ecn=0", &config, &error);
+        aqm.Configure(config);
+        NS_TEST_ASSERT_MSG_EQ(aqm.OnEnqueue(100, 2999, now), P4Aqm::PASS, "below k bytes");
+        NS_TEST_ASSERT_MSG_EQ(aqm.OnEnqueue(1, 3000, now), P4Aqm::DROP, "drop without ecn");
+
+        // RED on the instantaneous depth (weight 1)
+        P4Aqm::Config::Parse("red:min=5,max=15,maxp=0.1,weight=1", &config, &error);
+        aqm.Configure(config);
+        for (int i = 0; i < 100; i++)
+        {
+            NS_TEST_ASSERT_MSG_EQ(aqm.OnEnqueue(4, 0, now), P4Aqm::PASS, "below min");
+        }
+        NS_TEST_ASSERT_MSG_EQ(aqm.OnEnqueue(30, 0, now), P4Aqm::MARK, "gentle, 2 * max");
+        uint32_t marks = 0;
+        const uint32_t arrivals = 10000;
+        for (uint32_t i = 0; i < arrivals; i++)
+        {
+            marks += aqm.OnEnqueue(10, 0, now) == P4Aqm::MARK;
+        }
+        // probability 0.05 at the middle of the thresholds, spread evenly
+        NS_TEST_ASSERT_MSG_GT(marks, arrivals / 40, "marks between the thresholds");
+        NS_TEST_ASSERT_MSG_LT(marks, arrivals / 5, "marks between the thresholds");
+
+        P4Aqm::Config::Parse("red:min=5,max=15,weight=1,gentle=0,ecn=0", &config, &error);
+        aqm.Configure(config);
+        NS_TEST_ASSERT_MSG_EQ(aqm.OnEnqueue(15, 0, now), P4Aqm::DROP, "max without gentle");
+
+        // the average moves slowly with the default weight
+        P4Aqm::Config::Parse("red:min=5,max=15", &config, &error);
+        aqm.Configure(config);
+        NS_TEST_ASSERT_MSG_EQ(aqm.OnEnqueue(100, 0, now), P4Aqm::PASS, "burst absorbed");
+
+        // the counters are kept by the queue
+        aqm.CountMark();
+        aqm.CountDrop();
+        aqm.CountDrop();
+        NS_TEST_ASSERT_MSG_EQ(aqm.GetCounters().marks, 1, "marks counted");
+        NS_TEST_ASSERT_MSG_EQ(aqm.GetCounters().drops, 2, "drops counted");
+    }
+};
+
+/**
+ * @brief Test the PIE verdicts: burst allowance, small queues and the
+ * probability reaching 1
+ */
+class P4AqmPieVerdictTestCase : public TestCase
+{
+  public:
+    P4AqmPieVerdictTestCase()
+        : TestCase("P4Aqm PIE verdicts")
+    {
+    }
+
+  private:
+    /**
+     * @brief Drive the PIE probability to 1 with a large queueing delay
+     * @param aqm the AQM, configured with PIE at time 0
+     * @return the time of the last update
+     */
+    static Time Saturate(P4Aqm& aqm)
+    {
+        // 52 updates of 500 ms above the target reach 1
+        Time now = MilliSeconds(15 * 60);
+        aqm.OnDequeue(MilliSeconds(500));
+        aqm.OnEnqueue(100, 0, now);
+        return now;
+    }
+
+    void DoRun() override
+    {
+        P4Aqm::Config config;
+        std::string error;
+        P4Aqm aqm;
+
+        P4Aqm::Config::Parse("pie:ecn=0", &config, &error);
+        aqm.Configure(config);
+        aqm.OnDequeue(MilliSeconds(500));
+        // the 150 ms burst allowance lasts 10 updates of 15 ms
+        for (int i = 1; i < 10; i++)
+        {
+            NS_TEST_ASSERT_MSG_EQ(aqm.OnEnqueue(100, 0, MilliSeconds(15 * i)),
+                                  P4Aqm::PASS,
+                                  "burst allowance, update " << i);
+        }
+        NS_TEST_ASSERT_MSG_GT(aqm.GetPieProbability(), 0, "probability raised meanwhile");
+        aqm.OnEnqueue(100, 0, MilliSeconds(150));
+        for (int i = 0; i < 100; i++)
+        {
+            NS_TEST_ASSERT_MSG_EQ(aqm.OnEnqueue(1, 0, MilliSeconds(150)),
+                                  P4Aqm::PASS,
+                                  "less than 2 packets queued");
+        }
+
+        Time now = Saturate(aqm);
+        NS_TEST_ASSERT_MSG_EQ(aqm.GetPieProbability(), 1, "probability saturated");
+        NS_TEST_ASSERT_MSG_EQ(aqm.OnEnqueue(100, 0, now), P4Aqm::DROP, "drop without ecn");
+
+        // with ECN, the packets are dropped above markecn and marked below it
+        P4Aqm::Config::Parse("pie", &config, &error);
+        aqm.Configure(config);
+        now = Saturate(aqm);
+        NS_TEST_ASSERT_MSG_EQ(aqm.OnEnqueue(100, 0, now), P4Aqm::DROP, "above markecn");
+        P4Aqm::Config::Parse("pie:markecn=1", &config, &error);
+        aqm.Configure(config);
+        now = Saturate(aqm);
+        NS_TEST_ASSERT_MSG_EQ(aqm.OnEnqueue(100, 0, now), P4Aqm::MARK, "below markecn");
+    }
+};
+
+/**
+ * @brief Test the PIE probability updates: one update per elapsed period,
+ * whether the packets arrive every period or after a long gap
+ */
+class P4AqmPieUpdateTestCase : public TestCase
+{
+  public:
+    P4AqmPieUpdateTestCase()
+        : TestCase("P4Aqm PIE probability updates")
+    {
+    }
+
+  private:
+    void DoRun() override
+    {
+        P4Aqm::Config config;
+        std::string error;
+        P4Aqm::Config::Parse("pie:maxburst=0", &config, &error);
+
+        // one arrival per period, and a single arrival after the same periods
+        P4Aqm stepped;
+        P4Aqm sparse;
+        stepped.Configure(config);
+        sparse.Configure(config);
+        stepped.OnDequeue(MilliSeconds(40));
+        sparse.OnDequeue(MilliSeconds(40));
+
+        // alpha * (40 - 15) ms + beta * 40 ms, scaled down while the
+        // probability is below 1e-6
+        stepped.OnEnqueue(10, 0, MilliSeconds(15));
+        double first = (0.125 * 0.025 + 1.25 * 0.040) / 2048;
+        NS_TEST_ASSERT_MSG_EQ_TOL(stepped.GetPieProbability(), first, 1e-12, "first update");
+        stepped.OnEnqueue(10, 0, MilliSeconds(29));
+        NS_TEST_ASSERT_MSG_EQ_TOL(stepped.GetPieProbability(),
+                                  first,
+                                  1e-12,
+                                  "no update within the period");
+
+        for (int i = 2; i <= 10; i++)
+        {
+            stepped.OnEnqueue(10, 0, MilliSeconds(15 * i));
+        }
+        sparse.OnEnqueue(10, 0, MilliSeconds(150));
+        NS_TEST_ASSERT_MSG_GT(stepped.GetPieProbability(), first, "probability growing");
+        NS_TEST_ASSERT_MSG_EQ_TOL(sparse.GetPieProbability(),
+                                  stepped.GetPieProbability(),
+                                  1e-12,
+                                  "the 10 periods elapsed are updated");
+
+        // saturated with a large delay, then decaying while the queue is
+        // empty: 50 periods later it is below what a single update leaves
+        stepped.OnDequeue(MilliSeconds(500));
+        sparse.OnDequeue(MilliSeconds(500));
+        for (int i = 11; i <= 70; i++)
+        {
+            stepped.OnEnqueue(10, 0, MilliSeconds(15 * i));
+        }
+        sparse.OnEnqueue(10, 0, MilliSeconds(15 * 70));
+        NS_TEST_ASSERT_MSG_EQ(stepped.GetPieProbability(), 1, "saturated every period");
+        NS_TEST_ASSERT_MSG_EQ(sparse.GetPieProbability(), 1, "saturated after the gap");
+
+        for (int i = 71; i <= 120; i++)
+        {
+            stepped.OnEnqueue(0, 0, MilliSeconds(15 * i));
+        }
+        sparse.OnEnqueue(0, 0, MilliSeconds(15 * 120));
+        double oneUpdate = 1 - 0.125 * 0.015 - 1.25 * 0.5;
+        NS_TEST_ASSERT_MSG_LT(stepped.GetPieProbability(), oneUpdate, "decaying every period");
+        NS_TEST_ASSERT_MSG_GT(stepped.GetPieProbability(), 0, "still decaying");
+        NS_TEST_ASSERT_MSG_EQ_TOL(sparse.GetPieProbability(),
+                                  stepped.GetPieProbability(),
+                                  1e-12,
+                                  "the 50 idle periods are updated");
+
+        // the updates stop changing the state once the probability is 0
+        for (int i = 121; i <= 300; i++)
+        {
+            stepped.OnEnqueue(0, 0, MilliSeconds(15 * i));
+        }
+        sparse.OnEnqueue(0, 0, MilliSeconds(15 * 300));
+        NS_TEST_ASSERT_MSG_EQ(stepped.GetPieProbability(), 0, "decayed to 0");
+        NS_TEST_ASSERT_MSG_EQ(sparse.GetPieProbability(), 0, "decayed to 0 after the gap");
+        NS_TEST_ASSERT_MSG_EQ(sparse.OnEnqueue(10, 0, MilliSeconds(15 * 300)),
+                              P4Aqm::PASS,
+                              "low delay and probability");
+    }
+};
+
+/**
+ * @brief P4Aqm test suite
+ */
+class P4AqmTestSuite : public TestSuite
+{
+  public:
+    P4AqmTestSuite()
+        : TestSuite("p4-aqm", UNIT)
+    {
+        AddTestCase(new P4AqmParseTestCase, TestCase::QUICK);
+        AddTestCase(new P4AqmVerdictTestCase, TestCase::QUICK);
+        AddTestCase(new P4AqmPieVerdictTestCase, TestCase::QUICK);
+        AddTestCase(new P4AqmPieUpdateTestCase, TestCase::QUICK);
+    }
+};
+
+static P4AqmTestSuite g_p4AqmTestSuite; //!< Static variable for test initialization
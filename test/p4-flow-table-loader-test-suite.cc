@@ -0,0 +1,295 @@
+/*
+ * Copyright (c) 2025 TU Dresden
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Authors: Mingyu Ma <mingyu.ma@tu-dresden.de>
+ */
+
+#include "ns3/p4-core-pipeline.h"
+#include "ns3/p4-flow-table-loader.h"
+#include "ns3/p4-program-info.h"
+#include "ns3/test.h"
+
+#include <fstream>
+
+using namespace ns3;
+
+/**
+ * @brief Test the encoding of the integers and addresses of the flow table
+ * commands
+ */
+class P4FlowTableValueTestCase : public TestCase
+{
+  public:
+    P4FlowTableValueTestCase()
+        : TestCase("P4FlowTableLoader value encoding")
+    {
+    }
+
+  private:
+    void DoRun() override
+    {
+        std::string bytes;
+        NS_TEST_ASSERT_MSG_EQ(P4FlowTableLoader::ParseInteger("10", 8, &bytes), true, "decimal");
+        NS_TEST_ASSERT_MSG_EQ(bytes, std::string("\x0a", 1), "decimal value");
+        NS_TEST_ASSERT_MSG_EQ(P4FlowTableLoader::ParseInteger("0x0a01", 16, &bytes), true, "hex");
+        NS_TEST_ASSERT_MSG_EQ(bytes, std::string("\x0a\x01", 2), "hex value");
+        NS_TEST_ASSERT_MSG_EQ(P4FlowTableLoader::ParseInteger("0b101", 3, &bytes), true, "binary");
+        NS_TEST_ASSERT_MSG_EQ(bytes, std::string("\x05", 1), "binary value");
+        NS_TEST_ASSERT_MSG_EQ(P4FlowTableLoader::ParseInteger("0o17", 8, &bytes), true, "octal");
+        NS_TEST_ASSERT_MSG_EQ(bytes, std::string("\x0f", 1), "octal value");
+        NS_TEST_ASSERT_MSG_EQ(P4FlowTableLoader::ParseInteger("1_000", 16, &bytes),
+                              true,
+                              "separators");
+        NS_TEST_ASSERT_MSG_EQ(bytes, std::string("\x03\xe8", 2), "value with separators");
+
+        // the value must fit in the field width, not only in its bytes
+        NS_TEST_ASSERT_MSG_EQ(P4FlowTableLoader::ParseInteger("511", 9, &bytes), true, "9 bits");
+        NS_TEST_ASSERT_MSG_EQ(bytes, std::string("\x01\xff", 2), "9-bit value");
+        NS_TEST_ASSERT_MSG_EQ(P4FlowTableLoader::ParseInteger("512", 9, &bytes),
+                              false,
+                              "10 bits in a 9-bit field");
+        NS_TEST_ASSERT_MSG_EQ(P4FlowTableLoader::ParseInteger("256", 8, &bytes),
+                              false,
+                              "9 bits in a byte");
+        NS_TEST_ASSERT_MSG_EQ(P4FlowTableLoader::ParseInteger("0x", 8, &bytes), false, "no digit");
+        NS_TEST_ASSERT_MSG_EQ(P4FlowTableLoader::ParseInteger("12a", 16, &bytes),
+                              false,
+                              "hex digit in a decimal");
+        NS_TEST_ASSERT_MSG_EQ(P4FlowTableLoader::ParseInteger("-1", 16, &bytes), false, "sign");
+
+        std::string error;
+        NS_TEST_ASSERT_MSG_EQ(P4FlowTableLoader::EncodeValue("10.0.1.2", 32, &bytes, &error),
+                              true,
+                              "IPv4 address");
+        NS_TEST_ASSERT_MSG_EQ(bytes, std::string("\x0a\x00\x01\x02", 4), "IPv4 bytes");
+        NS_TEST_ASSERT_MSG_EQ(
+            P4FlowTableLoader::EncodeValue("00:11:22:33:44:55", 48, &bytes, &error),
+            true,
+            "MAC address");
+        NS_TEST_ASSERT_MSG_EQ(bytes, std::string("\x00\x11\x22\x33\x44\x55", 6), "MAC bytes");
+        NS_TEST_ASSERT_MSG_EQ(P4FlowTableLoader::EncodeValue("::1", 128, &bytes, &error),
+                              true,
+                              "IPv6 address");
+        NS_TEST_ASSERT_MSG_EQ(bytes, std::string(15, '\0') + "\x01", "IPv6 bytes");
+        NS_TEST_ASSERT_MSG_EQ(P4FlowTableLoader::EncodeValue("0x0a000102", 32, &bytes, &error),
+                              true,
+                              "integer in an address field");
+        NS_TEST_ASSERT_MSG_EQ(bytes, std::string("\x0a\x00\x01\x02", 4), "integer bytes");
+
+        // addresses are only taken for the fields of their width
+        NS_TEST_ASSERT_MSG_EQ(P4FlowTableLoader::EncodeValue("10.0.1.2", 16, &bytes, &error),
+                              false,
+                              "IPv4 address in a 16-bit field");
+        NS_TEST_ASSERT_MSG_EQ(error, "invalid value '10.0.1.2' for a 16-bit field", "error");
+        NS_TEST_ASSERT_MSG_EQ(P4FlowTableLoader::EncodeValue("10.0.1", 32, &bytes, &error),
+                              false,
+                              "truncated IPv4 address");
+    }
+};
+
+/**
+ * @brief Test the encoding of the match keys, one field of each match kind
+ */
+class P4FlowTableMatchKeyTestCase : public TestCase
+{
+  public:
+    P4FlowTableMatchKeyTestCase()
+        : TestCase("P4FlowTableLoader match key encoding")
+    {
+    }
+
+  private:
+    /**
+     * @brief Build a table keyed by a single field
+     * @param matchType the match kind of the field
+     * @param bitwidth the width of the field
+     * @return the table
+     */
+    static P4ProgramInfo::TableInfo MakeTable(P4ProgramInfo::MatchType matchType,
+                                              unsigned int bitwidth)
+    {
+        P4ProgramInfo::TableInfo table;
+        table.name = "MyIngress.t";
+        table.key.push_back({"hdr.f", matchType, bitwidth});
+        return table;
+    }
+
+    /**
+     * @brief Check that a single match field is rejected
+     * @param matchType the match kind of the field
+     * @param bitwidth the width of the field
+     * @param field the match field
+     * @return true if the field is rejected with an error
+     */
+    static bool Rejects(P4ProgramInfo::MatchType matchType,
+                        unsigned int bitwidth,
+                        const std::string& field)
+    {
+        std::vector<bm::MatchKeyParam> matchKey;
+        std::string error;
+        bool ok = P4FlowTableLoader::ParseMatchKey(MakeTable(matchType, bitwidth),
+                                                   {field},
+                                                   &matchKey,
+                                                   &error);
+        return !ok && !error.empty();
+    }
+
+    void DoRun() override
+    {
+        using MatchType = P4ProgramInfo::MatchType;
+        using Param = bm::MatchKeyParam;
+
+        P4ProgramInfo::TableInfo table;
+        table.name = "MyIngress.t";
+        table.key = {{"hdr.exact", MatchType::EXACT, 16},
+                     {"hdr.lpm", MatchType::LPM, 32},
+                     {"hdr.ternary", MatchType::TERNARY, 8},
+                     {"hdr.range", MatchType::RANGE, 16},
+                     {"hdr.valid", MatchType::VALID, 1},
+                     {"hdr.optional", MatchType::OPTIONAL, 9},
+                     {"hdr.wildcard", MatchType::OPTIONAL, 8}};
+
+        std::vector<Param> matchKey;
+        std::string error;
+        bool ok = P4FlowTableLoader::ParseMatchKey(
+            table,
+            {"0x1234", "10.0.0.0/8", "0x0a&&&0x0f", "10->20", "1", "0x101", "*"},
+            &matchKey,
+            &error);
+        NS_TEST_ASSERT_MSG_EQ(ok, true, "match key encoded: " << error);
+        NS_TEST_ASSERT_MSG_EQ(matchKey.size(), 7, "one parameter per key field");
+
+        NS_TEST_ASSERT_MSG_EQ((matchKey[0].type == Param::Type::EXACT), true, "exact");
+        NS_TEST_ASSERT_MSG_EQ(matchKey[0].key, std::string("\x12\x34", 2), "exact value");
+
+        NS_TEST_ASSERT_MSG_EQ((matchKey[1].type == Param::Type::LPM), true, "lpm");
+        NS_TEST_ASSERT_MSG_EQ(matchKey[1].key, std::string("\x0a\x00\x00\x00", 4), "lpm prefix");
+        NS_TEST_ASSERT_MSG_EQ(matchKey[1].prefix_length, 8, "lpm prefix length");
+
+        NS_TEST_ASSERT_MSG_EQ((matchKey[2].type == Param::Type::TERNARY), true, "ternary");
+        NS_TEST_ASSERT_MSG_EQ(matchKey[2].key, std::string("\x0a", 1), "ternary value");
+        NS_TEST_ASSERT_MSG_EQ(matchKey[2].mask, std::string("\x0f", 1), "ternary mask");
+
+        // the mask of a range match carries the end of the range
+        NS_TEST_ASSERT_MSG_EQ((matchKey[3].type == Param::Type::RANGE), true, "range");
+        NS_TEST_ASSERT_MSG_EQ(matchKey[3].key, std::string("\x00\x0a", 2), "range start");
+        NS_TEST_ASSERT_MSG_EQ(matchKey[3].mask, std::string("\x00\x14", 2), "range end");
+
+        NS_TEST_ASSERT_MSG_EQ((matchKey[4].type == Param::Type::VALID), true, "valid");
+        NS_TEST_ASSERT_MSG_EQ(matchKey[4].key, std::string("\x01", 1), "valid value");
+
+        // optional matches are ternary matches with a full or an empty mask
+        NS_TEST_ASSERT_MSG_EQ((matchKey[5].type == Param::Type::TERNARY), true, "optional");
+        NS_TEST_ASSERT_MSG_EQ(matchKey[5].key, std::string("\x01\x01", 2), "optional value");
+        NS_TEST_ASSERT_MSG_EQ(matchKey[5].mask, std::string("\x01\xff", 2), "optional mask");
+        NS_TEST_ASSERT_MSG_EQ((matchKey[6].type == Param::Type::TERNARY), true, "wildcard");
+        NS_TEST_ASSERT_MSG_EQ(matchKey[6].key, std::string(1, '\0'), "wildcard value");
+        NS_TEST_ASSERT_MSG_EQ(matchKey[6].mask, std::string(1, '\0'), "wildcard mask");
+
+        matchKey.clear();
+        ok = P4FlowTableLoader::ParseMatchKey(table, {"0x1234"}, &matchKey, &error);
+        NS_TEST_ASSERT_MSG_EQ(ok, false, "missing match fields");
+        NS_TEST_ASSERT_MSG_EQ(error,
+                              "table MyIngress.t expects 7 match fields, got 1",
+                              "field count error");
+
+        NS_TEST_ASSERT_MSG_EQ(Rejects(MatchType::EXACT, 8, "0x100"), true, "exact overflow");
+        NS_TEST_ASSERT_MSG_EQ(Rejects(MatchType::LPM, 32, "10.0.0.0"), true, "lpm length");
+        NS_TEST_ASSERT_MSG_EQ(Rejects(MatchType::LPM, 32, "10.0.0.0/33"), true, "lpm too long");
+        NS_TEST_ASSERT_MSG_EQ(Rejects(MatchType::TERNARY, 8, "0x0a"), true, "ternary mask");
+        NS_TEST_ASSERT_MSG_EQ(Rejects(MatchType::RANGE, 16, "10"), true, "range end");
+        NS_TEST_ASSERT_MSG_EQ(Rejects(MatchType::VALID, 1, "2"), true, "valid value");
+        NS_TEST_ASSERT_MSG_EQ(Rejects(MatchType::OPTIONAL, 8, "0x100"), true, "optional value");
+    }
+};
+
+/**
+ * @brief Test that the failed lines of a flow table file are reported with
+ * their line number, and that the other lines are still applied
+ */
+class P4FlowTableFileTestCase : public TestCase
+{
+  public:
+    P4FlowTableFileTestCase()
+        : TestCase("P4FlowTableLoader per-line error reporting")
+    {
+    }
+
+  private:
+    void DoRun() override
+    {
+        std::string jsonPath =
+            std::string(NS_TEST_SOURCEDIR) + "/../examples/p4src/p4_basic/p4_basic.json";
+        P4CorePipeline core(nullptr, false, false);
+        core.InitializeSwitchFromP4Json(jsonPath);
+        P4ProgramInfo programInfo;
+        std::string error;
+        NS_TEST_ASSERT_MSG_EQ(programInfo.LoadFromFile(jsonPath, &error), true, error);
+
+        std::string fileName = CreateTempDirFilename("flowtable.txt");
+        std::ofstream file(fileName);
+        file << "# flow table with errors\n"
+             << "\n"
+             << "table_set_default ipv4_nhop drop\n"
+             << "mt_add_entry ipv4_nhop ipv4_forward 0x0a010101 => 00:00:00:00:00:01 0x0\n"
+             << "table_add ipv4_nhop ipv4_forward 0x0a010101 => 00:00:00:00:00:01 0x0\n"
+             << "table_add ipv4_nhop ipv4_forward 0x0a010102 => 00:00:00:00:00:03\n"
+             << "table_add arp_simple set_arp_nhop 0x0a010101 => 0x200\n";
+        file.close();
+
+        P4FlowTableLoader loader(&core, programInfo);
+        NS_TEST_ASSERT_MSG_EQ(loader.LoadFromFile(fileName), 1, "some lines failed");
+        NS_TEST_ASSERT_MSG_EQ(loader.GetNumCommands(), 2, "the valid lines are applied");
+        NS_TEST_ASSERT_MSG_EQ(loader.GetNumErrors(), 3, "failed lines");
+
+        const std::vector<std::string>& errors = loader.GetErrors();
+        NS_TEST_ASSERT_MSG_EQ(errors.size(), 3, "one error per failed line");
+        // the runtime API names are not commands of the CLI
+        NS_TEST_ASSERT_MSG_EQ(errors[0],
+                              fileName + ":4: unknown command 'mt_add_entry'",
+                              "runtime API name");
+        NS_TEST_ASSERT_MSG_EQ(
+            errors[1],
+            fileName + ":6: table_add: action MyIngress.ipv4_forward expects 2 parameters, got 1",
+            "missing action parameter");
+        NS_TEST_ASSERT_MSG_EQ(
+            errors[2],
+            fileName + ":7: table_add: parameter port: invalid value '0x200' for a 9-bit field",
+            "action parameter too wide");
+
+        NS_TEST_ASSERT_MSG_EQ(loader.LoadFromFile(fileName + ".missing"), 1, "missing file");
+        NS_TEST_ASSERT_MSG_EQ(loader.GetErrors().back(),
+                              fileName + ".missing: flow table file not found",
+                              "missing file error");
+    }
+};
+
+/**
+ * @brief Flow table loader test suite
+ */
+class P4FlowTableTestSuite : public TestSuite
+{
+  public:
+    P4FlowTableTestSuite()
+        : TestSuite("p4-flow-table-loader", UNIT)
+    {
+        AddTestCase(new P4FlowTableValueTestCase, TestCase::QUICK);
+        AddTestCase(new P4FlowTableMatchKeyTestCase, TestCase::QUICK);
+        AddTestCase(new P4FlowTableFileTestCase, TestCase::QUICK);
+    }
+};
+
+static P4FlowTableTestSuite g_p4FlowTableTestSuite; //!< Static variable for test initialization
@@ -0,0 +1,152 @@
+/*
+ * Copyright (c) 2025 TU Dresden
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Authors: Mingyu Ma <mingyu.ma@tu-dresden.de>
+ */
+
+#include "ns3/p4-histogram.h"
+#include "ns3/test.h"
+
+using namespace ns3;
+
+/**
+ * @brief Test the buckets of P4Histogram: exact below SUB_BUCKETS, then a
+ * relative error below 1 / SUB_BUCKETS
+ */
+class P4HistogramBucketTestCase : public TestCase
+{
+  public:
+    P4HistogramBucketTestCase()
+        : TestCase("P4Histogram bucketing")
+    {
+    }
+
+  private:
+    void DoRun() override
+    {
+        for (uint64_t value = 0; value < P4Histogram::SUB_BUCKETS; value++)
+        {
+            NS_TEST_ASSERT_MSG_EQ(P4Histogram::GetBucket(value), value, "small values are exact");
+            NS_TEST_ASSERT_MSG_EQ(P4Histogram::GetBucketMax(value), value, "small buckets");
+        }
+
+        // 32 and 33 share a bucket, 34 starts the next one
+        NS_TEST_ASSERT_MSG_EQ(P4Histogram::GetBucket(32), P4Histogram::GetBucket(33), "32, 33");
+        NS_TEST_ASSERT_MSG_EQ(P4Histogram::GetBucket(34),
+                              P4Histogram::GetBucket(33) + 1,
+                              "34 in the next bucket");
+        NS_TEST_ASSERT_MSG_EQ(P4Histogram::GetBucketMax(P4Histogram::GetBucket(32)), 33, "max");
+
+        size_t last = 0;
+        for (uint64_t value = 1; value < 1000000; value = value * 5 / 4 + 1)
+        {
+            size_t bucket = P4Histogram::GetBucket(value);
+            NS_TEST_ASSERT_MSG_GT_OR_EQ(bucket, last, "buckets grow with the values");
+            last = bucket;
+            uint64_t max = P4Histogram::GetBucketMax(bucket);
+            NS_TEST_ASSERT_MSG_GT_OR_EQ(max, value, "the bucket holds the value");
+            NS_TEST_ASSERT_MSG_LT_OR_EQ(max - value,
+                                        value / P4Histogram::SUB_BUCKETS,
+                                        "relative error below 1 / SUB_BUCKETS");
+            if (bucket > 0)
+            {
+                NS_TEST_ASSERT_MSG_LT(P4Histogram::GetBucketMax(bucket - 1),
+                                      value,
+                                      "the previous bucket ends below the value");
+            }
+        }
+
+        NS_TEST_ASSERT_MSG_EQ(P4Histogram::GetBucket(uint64_t(1) << P4Histogram::MAX_BITS),
+                              P4Histogram::NB_BUCKETS - 1,
+                              "large values in the last bucket");
+        NS_TEST_ASSERT_MSG_EQ(P4Histogram::GetBucket(std::numeric_limits<uint64_t>::max()),
+                              P4Histogram::NB_BUCKETS - 1,
+                              "largest value in the last bucket");
+    }
+};
+
+/**
+ * @brief Test the statistics and the nearest rank percentiles of P4Histogram
+ */
+class P4HistogramPercentileTestCase : public TestCase
+{
+  public:
+    P4HistogramPercentileTestCase()
+        : TestCase("P4Histogram percentiles")
+    {
+    }
+
+  private:
+    void DoRun() override
+    {
+        P4Histogram histogram;
+        NS_TEST_ASSERT_MSG_EQ(histogram.GetPercentile(50), 0, "empty histogram");
+        NS_TEST_ASSERT_MSG_EQ(histogram.GetMin(), 0, "empty histogram");
+
+        for (uint64_t value = 1; value <= 10; value++)
+        {
+            histogram.Record(value);
+        }
+        NS_TEST_ASSERT_MSG_EQ(histogram.GetCount(), 10, "count");
+        NS_TEST_ASSERT_MSG_EQ(histogram.GetMin(), 1, "min");
+        NS_TEST_ASSERT_MSG_EQ(histogram.GetMax(), 10, "max");
+        NS_TEST_ASSERT_MSG_EQ_TOL(histogram.GetMean(), 5.5, 1e-9, "mean");
+
+        // nearest rank: ceil(p / 100 * count), at least 1
+        NS_TEST_ASSERT_MSG_EQ(histogram.GetPercentile(0), 1, "p0");
+        NS_TEST_ASSERT_MSG_EQ(histogram.GetPercentile(10), 1, "p10");
+        NS_TEST_ASSERT_MSG_EQ(histogram.GetPercentile(11), 2, "p11");
+        NS_TEST_ASSERT_MSG_EQ(histogram.GetPercentile(50), 5, "p50");
+        NS_TEST_ASSERT_MSG_EQ(histogram.GetPercentile(90), 9, "p90");
+        NS_TEST_ASSERT_MSG_EQ(histogram.GetPercentile(91), 10, "p91");
+        NS_TEST_ASSERT_MSG_EQ(histogram.GetPercentile(99), 10, "p99");
+        NS_TEST_ASSERT_MSG_EQ(histogram.GetPercentile(100), 10, "p100");
+        NS_TEST_ASSERT_MSG_EQ(histogram.GetPercentile(200), 10, "clamped to p100");
+
+        // a bucket upper bound is capped by the largest value counted
+        P4Histogram large;
+        large.Record(1000);
+        NS_TEST_ASSERT_MSG_EQ(large.GetPercentile(50), 1000, "single value");
+        large.Record(100000);
+        NS_TEST_ASSERT_MSG_EQ(large.GetPercentile(50), 1023, "upper bound of the bucket of 1000");
+        NS_TEST_ASSERT_MSG_EQ(large.GetPercentile(100), 100000, "p100");
+
+        histogram.Merge(large);
+        NS_TEST_ASSERT_MSG_EQ(histogram.GetCount(), 12, "merged count");
+        NS_TEST_ASSERT_MSG_EQ(histogram.GetMax(), 100000, "merged max");
+        NS_TEST_ASSERT_MSG_EQ(histogram.GetPercentile(50), 6, "merged p50");
+
+        histogram.Reset();
+        NS_TEST_ASSERT_MSG_EQ(histogram.GetCount(), 0, "reset");
+        NS_TEST_ASSERT_MSG_EQ(histogram.GetPercentile(99), 0, "reset");
+    }
+};
+
+/**
+ * @brief P4Histogram test suite
+ */
+class P4HistogramTestSuite : public TestSuite
+{
+  public:
+    P4HistogramTestSuite()
+        : TestSuite("p4-histogram", UNIT)
+    {
+        AddTestCase(new P4HistogramBucketTestCase, TestCase::QUICK);
+        AddTestCase(new P4HistogramPercentileTestCase, TestCase::QUICK);
+    }
+};
+
+static P4HistogramTestSuite g_p4HistogramTestSuite; //!< Static variable for test initialization
@@ -0,0 +1,103 @@
+/*
+ * Copyright (c) 2025 TU Dresden
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Authors: Mingyu Ma <mingyu.ma@tu-dresden.de>
+ */
+
+#include "ns3/p4-core-pipeline.h"
+#include "ns3/p4-packet-pool.h"
+#include "ns3/test.h"
+
+#include <cstring>
+
+using namespace ns3;
+
+/**
+ * @brief Test that a recycled packet is reset for its new reception: id,
+ * buffer, ports, registers and metadata
+ */
+class P4PacketPoolReuseTestCase : public TestCase
+{
+  public:
+    P4PacketPoolReuseTestCase()
+        : TestCase("P4PacketPool reuse of a released packet")
+    {
+    }
+
+  private:
+    void DoRun() override
+    {
+        // the packets take their PHV from a switch running a program
+        P4CorePipeline core(nullptr, false, false);
+        core.InitializeSwitchFromP4Json(std::string(NS_TEST_SOURCEDIR) +
+                                        "/../examples/p4src/p4_basic/p4_basic.json");
+        P4PacketPool pool(&core, BM_PACKET_HEADROOM);
+
+        std::unique_ptr<bm::Packet> first = pool.Acquire(1, 10, 100);
+        NS_TEST_ASSERT_MSG_EQ(pool.GetPacketId(first.get()), 10, "id of a new packet");
+        std::memset(first->data(), 0xaa, 100);
+        const char* dataEnd = first->data() + 100;
+        const bm::Packet* address = first.get();
+
+        // state left by the switch: headers popped by the parser, egress port,
+        // registers and metadata
+        first->remove(14);
+        first->set_egress_port(3);
+        first->set_register(0, 1234);
+        first->get_phv()->get_field("standard_metadata.egress_spec").set(5);
+        pool.Release(std::move(first));
+        NS_TEST_ASSERT_MSG_EQ(pool.GetNumCached(), 1, "packet cached");
+
+        std::unique_ptr<bm::Packet> second = pool.Acquire(2, 11, 60);
+        NS_TEST_ASSERT_MSG_EQ(second.get(), address, "packet reused");
+        NS_TEST_ASSERT_MSG_EQ(pool.GetStats().hits, 1, "served from the free list");
+        NS_TEST_ASSERT_MSG_EQ(pool.GetPacketId(second.get()), 11, "id of the new reception");
+        NS_TEST_ASSERT_MSG_EQ(second->get_data_size(), 60, "size of the new frame");
+        NS_TEST_ASSERT_MSG_EQ(second->data() + 60, dataEnd, "buffer rewound");
+        NS_TEST_ASSERT_MSG_EQ(second->get_ingress_port(), 2, "ingress port");
+        NS_TEST_ASSERT_MSG_EQ(second->get_egress_port(), 0, "egress port reset");
+        NS_TEST_ASSERT_MSG_EQ(second->get_register(0), 0, "registers reset");
+        NS_TEST_ASSERT_MSG_EQ(
+            second->get_phv()->get_field("standard_metadata.egress_spec").get_uint(),
+            0,
+            "metadata reset");
+
+        // a clone takes the reception id of its original, and is not cached
+        std::unique_ptr<bm::Packet> clone = second->clone_no_phv_ptr();
+        pool.AddClone(clone.get(), second.get());
+        NS_TEST_ASSERT_MSG_EQ(pool.GetPacketId(clone.get()), 11, "clone of the reception");
+        pool.Release(std::move(clone));
+        NS_TEST_ASSERT_MSG_EQ(pool.GetStats().foreign, 1, "clone destroyed");
+
+        pool.Release(std::move(second));
+        NS_TEST_ASSERT_MSG_EQ(pool.GetStats().recycled, 2, "packet cached again");
+    }
+};
+
+/**
+ * @brief Packet pool test suite
+ */
+class P4PacketPoolTestSuite : public TestSuite
+{
+  public:
+    P4PacketPoolTestSuite()
+        : TestSuite("p4-packet-pool", UNIT)
+    {
+        AddTestCase(new P4PacketPoolReuseTestCase, TestCase::QUICK);
+    }
+};
+
+static P4PacketPoolTestSuite g_p4PacketPoolTestSuite; //!< Static variable for test initialization
@@ -0,0 +1,227 @@
+/*
+ * Copyright (c) 2025 TU Dresden
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Authors: Mingyu Ma <mingyu.ma@tu-dresden.de>
+ */
+
+#include "ns3/nstime.h"
+#include "ns3/p4-pfc.h"
+#include "ns3/p4-queue.h"
+#include "ns3/packet.h"
+#include "ns3/pfc-header.h"
+#include "ns3/simulator.h"
+#include "ns3/test.h"
+
+#include <tuple>
+#include <vector>
+
+using namespace ns3;
+
+/**
+ * @brief Test the XOFF and XON transitions of P4PfcAccounting
+ */
+class P4PfcAccountingTestCase : public TestCase
+{
+  public:
+    P4PfcAccountingTestCase()
+        : TestCase("P4PfcAccounting XOFF and XON transitions")
+    {
+    }
+
+  private:
+    using Transition = std::tuple<uint32_t, uint8_t, bool>; //!< Port, priority, pause
+
+    void DoRun() override
+    {
+        std::vector<Transition> transitions;
+        P4PfcAccounting pfc(3000,
+                            1000,
+                            [&transitions](uint32_t port, uint8_t priority, bool pause) {
+                                transitions.emplace_back(port, priority, pause);
+                            });
+
+        pfc.OnEnqueue(2, 3, 1000);
+        pfc.OnEnqueue(2, 3, 1000);
+        NS_TEST_ASSERT_MSG_EQ(transitions.size(), 0, "below XOFF");
+        NS_TEST_ASSERT_MSG_EQ(pfc.GetBytes(2, 3), 2000, "bytes counted");
+        pfc.OnEnqueue(2, 3, 1000);
+        NS_TEST_ASSERT_MSG_EQ(transitions.size(), 1, "XOFF reached");
+        NS_TEST_ASSERT_MSG_EQ((transitions[0] == Transition(2, 3, true)), true, "pause sent");
+        NS_TEST_ASSERT_MSG_EQ(pfc.IsPaused(2, 3), true, "paused");
+        pfc.OnEnqueue(2, 3, 1000);
+        NS_TEST_ASSERT_MSG_EQ(transitions.size(), 1, "pause sent once");
+
+        // the other ports and priorities are counted apart
+        pfc.OnEnqueue(2, 4, 1000);
+        pfc.OnEnqueue(1, 3, 1000);
+        NS_TEST_ASSERT_MSG_EQ(pfc.IsPaused(2, 4), false, "other priority");
+        NS_TEST_ASSERT_MSG_EQ(pfc.IsPaused(1, 3), false, "other port");
+        NS_TEST_ASSERT_MSG_EQ(transitions.size(), 1, "no other transition");
+
+        // between XON and XOFF the pause holds
+        pfc.OnDequeue(2, 3, 1000);
+        pfc.OnDequeue(2, 3, 1000);
+        NS_TEST_ASSERT_MSG_EQ(pfc.GetBytes(2, 3), 2000, "bytes drained");
+        NS_TEST_ASSERT_MSG_EQ(pfc.IsPaused(2, 3), true, "still paused above XON");
+        pfc.OnDequeue(2, 3, 1000);
+        NS_TEST_ASSERT_MSG_EQ(transitions.size(), 2, "XON reached");
+        NS_TEST_ASSERT_MSG_EQ((transitions[1] == Transition(2, 3, false)), true, "resume sent");
+        NS_TEST_ASSERT_MSG_EQ(pfc.IsPaused(2, 3), false, "resumed");
+
+        // below XON the resume is not repeated, the counter does not underflow
+        pfc.OnDequeue(2, 3, 5000);
+        NS_TEST_ASSERT_MSG_EQ(pfc.GetBytes(2, 3), 0, "counter clamped");
+        NS_TEST_ASSERT_MSG_EQ(transitions.size(), 2, "resume sent once");
+
+        // a single large packet pauses at once
+        pfc.OnEnqueue(7, 0, 4000);
+        NS_TEST_ASSERT_MSG_EQ(transitions.size(), 3, "XOFF with one packet");
+        NS_TEST_ASSERT_MSG_EQ((transitions[2] == Transition(7, 0, true)), true, "new port");
+
+        // out of range priorities and unknown ports are ignored
+        pfc.OnEnqueue(0, P4PfcAccounting::NB_PRIORITIES, 10000);
+        pfc.OnDequeue(100, 0, 1000);
+        NS_TEST_ASSERT_MSG_EQ(transitions.size(), 3, "ignored");
+        NS_TEST_ASSERT_MSG_EQ(pfc.GetBytes(100, 0), 0, "unknown port");
+    }
+};
+
+/**
+ * @brief Test the serialization of PfcHeader
+ */
+class PfcHeaderTestCase : public TestCase
+{
+  public:
+    PfcHeaderTestCase()
+        : TestCase("PfcHeader serialization round trip")
+    {
+    }
+
+  private:
+    void DoRun() override
+    {
+        PfcHeader header;
+        NS_TEST_ASSERT_MSG_EQ(header.IsPfc(), true, "PFC opcode by default");
+        header.SetPause(0, 0xffff);
+        header.SetPause(5, 0);
+        header.SetPause(7, 0x1234);
+
+        Ptr<Packet> packet = Create<Packet>();
+        packet->AddHeader(header);
+        NS_TEST_ASSERT_MSG_EQ(packet->GetSize(), 46, "padded to the minimum Ethernet payload");
+
+        uint8_t raw[46];
+        packet->CopyData(raw, sizeof(raw));
+        NS_TEST_ASSERT_MSG_EQ(raw[0], 0x01, "opcode, network order");
+        NS_TEST_ASSERT_MSG_EQ(raw[1], 0x01, "opcode, network order");
+        NS_TEST_ASSERT_MSG_EQ(raw[2], 0x00, "class-enable vector");
+        NS_TEST_ASSERT_MSG_EQ(raw[3], 0xa1, "class-enable vector of priorities 0, 5 and 7");
+        NS_TEST_ASSERT_MSG_EQ(raw[4], 0xff, "pause time of priority 0");
+        NS_TEST_ASSERT_MSG_EQ(raw[18], 0x12, "pause time of priority 7");
+        NS_TEST_ASSERT_MSG_EQ(raw[19], 0x34, "pause time of priority 7");
+
+        PfcHeader received;
+        packet->RemoveHeader(received);
+        NS_TEST_ASSERT_MSG_EQ(packet->GetSize(), 0, "whole header read");
+        NS_TEST_ASSERT_MSG_EQ(received.IsPfc(), true, "opcode");
+        for (uint8_t priority = 0; priority < PfcHeader::NB_PRIORITIES; priority++)
+        {
+            NS_TEST_ASSERT_MSG_EQ(received.IsEnabled(priority),
+                                  header.IsEnabled(priority),
+                                  "class-enable of priority " << +priority);
+            NS_TEST_ASSERT_MSG_EQ(received.GetQuanta(priority),
+                                  header.GetQuanta(priority),
+                                  "pause time of priority " << +priority);
+        }
+        NS_TEST_ASSERT_MSG_EQ(received.IsEnabled(5), true, "resume carried");
+        NS_TEST_ASSERT_MSG_EQ(received.GetQuanta(5), 0, "resume carried");
+        NS_TEST_ASSERT_MSG_EQ(received.IsEnabled(1), false, "priority not in the frame");
+    }
+};
+
+/**
+ * @brief Test that the paused queues of the egress buffer are never
+ * reported eligible
+ */
+class P4PfcPausedQueueTestCase : public TestCase
+{
+  public:
+    P4PfcPausedQueueTestCase()
+        : TestCase("No eligible packet while the queues are paused")
+    {
+    }
+
+  private:
+    /**
+     * @brief All the logical queues are served by one worker
+     */
+    struct SingleWorker
+    {
+        size_t operator()(size_t /* queueId */) const
+        {
+            return 0;
+        }
+    };
+
+    void DoRun() override
+    {
+        // 2 ports with 2 priority queues, no rate limit
+        NSQueueingLogicPriRL<int, SingleWorker> queue(1, 100, SingleWorker(), 2, 2);
+        queue.set_rate_bps_for_all(0);
+        NS_TEST_ASSERT_MSG_EQ(queue.get_next_tp_all_ports(), Time::Max(), "empty buffer");
+
+        queue.push_front(0, 1, 7, 100);
+        NS_TEST_ASSERT_MSG_EQ((queue.get_next_tp_all_ports() <= Simulator::Now()),
+                              true,
+                              "packet eligible");
+
+        queue.set_paused(0, 1, true);
+        NS_TEST_ASSERT_MSG_EQ(queue.get_next_tp_all_ports(), Time::Max(), "only paused queues");
+
+        queue.push_front(1, 0, 8, 100);
+        NS_TEST_ASSERT_MSG_EQ((queue.get_next_tp_all_ports() <= Simulator::Now()),
+                              true,
+                              "queue of the other port not paused");
+
+        size_t port;
+        int item;
+        queue.pop_back(0, &port, &item);
+        NS_TEST_ASSERT_MSG_EQ(item, 8, "paused queue skipped");
+        NS_TEST_ASSERT_MSG_EQ(queue.get_next_tp_all_ports(), Time::Max(), "only paused queues");
+
+        queue.set_paused(0, 1, false);
+        NS_TEST_ASSERT_MSG_EQ((queue.get_next_tp_all_ports() <= Simulator::Now()),
+                              true,
+                              "packet eligible after the resume");
+    }
+};
+
+/**
+ * @brief PFC test suite
+ */
+class P4PfcTestSuite : public TestSuite
+{
+  public:
+    P4PfcTestSuite()
+        : TestSuite("p4-pfc", UNIT)
+    {
+        AddTestCase(new P4PfcAccountingTestCase, TestCase::QUICK);
+        AddTestCase(new PfcHeaderTestCase, TestCase::QUICK);
+        AddTestCase(new P4PfcPausedQueueTestCase, TestCase::QUICK);
+    }
+};
+
+static P4PfcTestSuite g_p4PfcTestSuite; //!< Static variable for test initialization
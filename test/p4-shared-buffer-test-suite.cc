@@ -0,0 +1,138 @@
+/*
+ * Copyright (c) 2025 TU Dresden
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Authors: Mingyu Ma <mingyu.ma@tu-dresden.de>
+ */
+
+#include "ns3/p4-queue.h"
+#include "ns3/test.h"
+
+using namespace ns3;
+
+/**
+ * @brief Test the admission of the priority queues in the shared egress
+ * buffer, with dynamic thresholds
+ */
+class P4SharedBufferAdmissionTestCase : public TestCase
+{
+  public:
+    P4SharedBufferAdmissionTestCase()
+        : TestCase("Shared buffer admission with dynamic thresholds")
+    {
+    }
+
+  private:
+    /**
+     * @brief All the logical queues are served by one worker
+     */
+    struct SingleWorker
+    {
+        size_t operator()(size_t /* queueId */) const
+        {
+            return 0;
+        }
+    };
+
+    using Queue = NSQueueingLogicPriRL<int, SingleWorker>;
+
+    /**
+     * @brief Push elements of 1000 bytes until one is rejected
+     * @param queue the queue
+     * @param queueId the logical queue
+     * @param priority the priority queue
+     * @return the elements admitted
+     */
+    static int Fill(Queue* queue, size_t queueId, size_t priority)
+    {
+        int admitted = 0;
+        while (admitted < 100 && queue->push_front(queueId, priority, admitted, 1000))
+        {
+            admitted++;
+        }
+        return admitted;
+    }
+
+    void DoRun() override
+    {
+        // 2 ports with 2 priority queues, no rate limit
+        Queue queue(1, 100, SingleWorker(), 2, 2);
+        queue.set_rate_bps_for_all(0);
+
+        // 4 reserves of 1000 bytes, 6000 bytes shared
+        queue.set_shared_buffer(10000, 1000, 1.0);
+        NS_TEST_ASSERT_MSG_EQ(queue.shared_buffer_used(), 0, "empty buffer");
+        NS_TEST_ASSERT_MSG_EQ(queue.shared_buffer_threshold(0, 0), 6000, "whole pool free");
+
+        // alone, a queue takes its reserve and half the pool (alpha = 1)
+        NS_TEST_ASSERT_MSG_EQ(Fill(&queue, 0, 0), 4, "reserve and 3000 shared bytes");
+        NS_TEST_ASSERT_MSG_EQ(queue.shared_buffer_used(), 3000, "shared bytes used");
+
+        // the threshold shrinks as the buffer fills
+        NS_TEST_ASSERT_MSG_EQ(queue.shared_buffer_threshold(1, 0), 3000, "threshold");
+        NS_TEST_ASSERT_MSG_EQ(Fill(&queue, 1, 0), 3, "reserve and 2000 shared bytes");
+        NS_TEST_ASSERT_MSG_EQ(queue.shared_buffer_used(), 5000, "shared bytes used");
+
+        // the reserve is guaranteed, then the last free shared bytes
+        NS_TEST_ASSERT_MSG_EQ(Fill(&queue, 0, 1), 2, "reserve and 1000 shared bytes");
+        NS_TEST_ASSERT_MSG_EQ(queue.shared_buffer_used(), 6000, "pool full");
+        NS_TEST_ASSERT_MSG_EQ(Fill(&queue, 1, 1), 1, "reserve of a full pool");
+        NS_TEST_ASSERT_MSG_EQ(queue.shared_buffer_used(), 6000, "reserves not in the pool");
+
+        // a dequeue beyond the reserve gives its bytes back to the pool
+        size_t queueId;
+        size_t priority;
+        int item = -1;
+        queue.pop_back(0, &queueId, &priority, &item);
+        NS_TEST_ASSERT_MSG_NE(item, -1, "element dequeued");
+        NS_TEST_ASSERT_MSG_EQ(queue.shared_buffer_used(),
+                              queueId == 1 && priority == 1 ? 6000 : 5000,
+                              "shared bytes released");
+
+        // a larger alpha lets a queue take more of the free bytes
+        Queue greedy(1, 100, SingleWorker(), 1, 2);
+        greedy.set_shared_buffer(8000, 1000, 4.0);
+        NS_TEST_ASSERT_MSG_EQ(Fill(&greedy, 0, 0), 6, "reserve and 5000 of 6000 bytes");
+
+        // per queue reserve and alpha
+        Queue custom(1, 100, SingleWorker(), 1, 2);
+        custom.set_shared_buffer(8000, 1000, 1.0);
+        custom.set_shared_buffer_reserve(1, 0, 3000);
+        custom.set_shared_buffer_alpha(0, 0, 0.0);
+        NS_TEST_ASSERT_MSG_EQ(Fill(&custom, 0, 0), 1, "alpha 0: reserve only");
+        NS_TEST_ASSERT_MSG_EQ(Fill(&custom, 1, 0), 5, "reserve of 3000 and 2000 of 4000 bytes");
+
+        // without shared buffer, only the capacities apply
+        Queue priv(1, 10, SingleWorker(), 1, 1);
+        priv.set_shared_buffer(0, 1000, 1.0);
+        NS_TEST_ASSERT_MSG_EQ(Fill(&priv, 0, 0), 10, "capacity in elements");
+        NS_TEST_ASSERT_MSG_EQ(priv.shared_buffer_used(), 0, "no shared buffer");
+    }
+};
+
+/**
+ * @brief Shared egress buffer test suite
+ */
+class P4SharedBufferTestSuite : public TestSuite
+{
+  public:
+    P4SharedBufferTestSuite()
+        : TestSuite("p4-shared-buffer", UNIT)
+    {
+        AddTestCase(new P4SharedBufferAdmissionTestCase, TestCase::QUICK);
+    }
+};
+
+static P4SharedBufferTestSuite g_p4SharedBufferTestSuite; //!< Static test suite instance
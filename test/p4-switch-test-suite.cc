@@ -0,0 +1,371 @@
+/*
+ * Copyright (c) 2025 TU Dresden
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Authors: Mingyu Ma <mingyu.ma@tu-dresden.de>
+ */
+
+#include "ns3/config.h"
+#include "ns3/data-rate.h"
+#include "ns3/ethernet-header.h"
+#include "ns3/ipv4-header.h"
+#include "ns3/mac48-address.h"
+#include "ns3/nstime.h"
+#include "ns3/p4-helper.h"
+#include "ns3/p4-p2p-helper.h"
+#include "ns3/p4-switch-net-device.h"
+#include "ns3/simulator.h"
+#include "ns3/string.h"
+#include "ns3/test.h"
+#include "ns3/uinteger.h"
+
+#include <sstream>
+#include <vector>
+
+using namespace ns3;
+
+/**
+ * @brief Build a P4 switch between two hosts, on port 0 and port 1
+ * @param helper the helper configured with the switch attributes
+ * @param hosts the host nodes, filled
+ * @return the switch device
+ */
+static Ptr<P4SwitchNetDevice>
+BuildSwitchBetweenHosts(P4Helper& helper, NodeContainer* hosts)
+{
+    hosts->Create(2);
+    Ptr<Node> switchNode = CreateObject<Node>();
+
+    // the links are much faster than the switch ports
+    P4PointToPointHelper p4p2p;
+    p4p2p.SetDeviceAttribute("DataRate", DataRateValue(DataRate("100Gbps")));
+    p4p2p.SetChannelAttribute("Delay", TimeValue(MicroSeconds(1)));
+
+    NetDeviceContainer switchPorts;
+    for (uint32_t i = 0; i < hosts->GetN(); i++)
+    {
+        NetDeviceContainer link = p4p2p.Install(hosts->Get(i), switchNode);
+        switchPorts.Add(link.Get(1));
+    }
+
+    helper.SetDeviceAttribute("ChannelType", UintegerValue(1));
+    return DynamicCast<P4SwitchNetDevice>(helper.Install(switchNode, switchPorts).Get(0));
+}
+
+/**
+ * @brief Send a UDP/IPv4 frame from the first device of a host
+ * @param host the sending host
+ * @param destination the IPv4 destination
+ * @param tos the IPv4 TOS byte
+ * @param payloadSize the size of the IPv4 payload
+ */
+static void
+SendIpv4Frame(Ptr<Node> host, Ipv4Address destination, uint8_t tos, uint32_t payloadSize)
+{
+    Ptr<Packet> packet = Create<Packet>(payloadSize);
+    Ipv4Header header;
+    header.SetSource(Ipv4Address("10.1.1.1"));
+    header.SetDestination(destination);
+    header.SetProtocol(17);
+    header.SetPayloadSize(payloadSize);
+    header.SetTtl(64);
+    header.SetTos(tos);
+    header.EnableChecksum();
+    packet->AddHeader(header);
+    host->GetDevice(0)->Send(packet, Mac48Address::GetBroadcast(), 0x0800);
+}
+
+/**
+ * @brief Path of a file of the example P4 programs
+ * @param program the program directory in examples/p4src
+ * @param file the file name
+ * @return the path, from the test directory
+ */
+static std::string
+ExampleP4File(const std::string& program, const std::string& file)
+{
+    return std::string(NS_TEST_SOURCEDIR) + "/../examples/p4src/" + program + "/" + file;
+}
+
+/**
+ * @brief Test that a v1model queue limited in bits per second drains at the
+ * rate of the whole frames, not of the bytes left after parsing
+ */
+class P4SwitchWireRateTestCase : public TestCase
+{
+  public:
+    P4SwitchWireRateTestCase()
+        : TestCase("v1model bit rate limit at the frame length")
+    {
+    }
+
+  private:
+    /**
+     * @brief Record the dequeue time of a packet
+     */
+    void Dequeued(const P4PacketEvent& /* event */)
+    {
+        m_dequeueTimes.push_back(Simulator::Now());
+    }
+
+    void DoRun() override
+    {
+        const uint64_t rateBps = 8000000;
+        const uint32_t payloadSize = 66;
+        const uint32_t frameSize = 14 + 20 + payloadSize; // Ethernet, IPv4, payload
+        const uint32_t nbPackets = 10;
+
+        P4Helper helper;
+        helper.SetDeviceAttribute(
+            "JsonPath",
+            StringValue(ExampleP4File("simple_v1model", "simple_v1model.json")));
+        helper.SetDeviceAttribute(
+            "FlowTablePath",
+            StringValue(ExampleP4File("simple_v1model", "flowtable_0.txt")));
+        helper.SetDeviceAttribute("SwitchRateBps", UintegerValue(rateBps));
+
+        NodeContainer hosts;
+        Ptr<P4SwitchNetDevice> device = BuildSwitchBetweenHosts(helper, &hosts);
+        device->TraceConnectWithoutContext(
+            "Dequeued",
+            MakeCallback(&P4SwitchWireRateTestCase::Dequeued, this));
+
+        // a burst much faster than the switch port
+        for (uint32_t i = 0; i < nbPackets; i++)
+        {
+            Simulator::Schedule(Seconds(1),
+                                &SendIpv4Frame,
+                                hosts.Get(0),
+                                Ipv4Address("10.1.1.2"),
+                                0,
+                                payloadSize);
+        }
+        Simulator::Stop(Seconds(2));
+        Simulator::Run();
+        Simulator::Destroy();
+
+        NS_TEST_ASSERT_MSG_EQ(m_dequeueTimes.size(), nbPackets, "all the packets forwarded");
+        Time gap = Seconds(frameSize * 8.0 / rateBps);
+        for (size_t i = 1; i < m_dequeueTimes.size(); i++)
+        {
+            NS_TEST_ASSERT_MSG_EQ_TOL(m_dequeueTimes[i] - m_dequeueTimes[i - 1],
+                                      gap,
+                                      NanoSeconds(1),
+                                      "packet " << i << " leaves one frame time later");
+        }
+    }
+
+    std::vector<Time> m_dequeueTimes; //!< Dequeue times of the packets
+};
+
+/**
+ * @brief Test that the ECN marks of the egress queues of a PSA switch, which
+ * deparses the packets before queueing them, leave the switch
+ */
+class P4SwitchPsaEcnTestCase : public TestCase
+{
+  public:
+    P4SwitchPsaEcnTestCase()
+        : TestCase("PSA ECN marks in the sent frames")
+    {
+    }
+
+  private:
+    /**
+     * @brief Record the ECN bits and the checksum of a frame received by a host
+     * @param packet the frame
+     * @return true
+     */
+    bool Received(Ptr<NetDevice> /* device */,
+                  Ptr<const Packet> packet,
+                  uint16_t /* protocol */,
+                  const Address& /* from */)
+    {
+        Ptr<Packet> copy = packet->Copy();
+        EthernetHeader ethernet(false);
+        copy->RemoveHeader(ethernet);
+        Ipv4Header ipv4;
+        ipv4.EnableChecksum();
+        copy->RemoveHeader(ipv4);
+        m_ecn.push_back(ipv4.GetEcn());
+        m_checksumOk.push_back(ipv4.IsChecksumOk());
+        return true;
+    }
+
+    void DoRun() override
+    {
+        const uint32_t nbPackets = 10;
+
+        P4Helper helper;
+        helper.SetDeviceAttribute(
+            "JsonPath",
+            StringValue(ExampleP4File("simple_psa", "simple_psa.json")));
+        helper.SetDeviceAttribute("FlowTablePath", StringValue(""));
+        helper.SetDeviceAttribute("P4SwitchArch", UintegerValue(1));
+        helper.SetDeviceAttribute("QueueAqm", StringValue("ecn:k=3"));
+
+        NodeContainer hosts;
+        BuildSwitchBetweenHosts(helper, &hosts);
+        hosts.Get(1)->GetDevice(0)->SetReceiveCallback(
+            MakeCallback(&P4SwitchPsaEcnTestCase::Received, this));
+
+        // ECT(0) packets, the burst fills the queue above the threshold
+        for (uint32_t i = 0; i < nbPackets; i++)
+        {
+            Simulator::Schedule(Seconds(1),
+                                &SendIpv4Frame,
+                                hosts.Get(0),
+                                Ipv4Address("10.1.1.2"),
+                                Ipv4Header::ECN_ECT0,
+                                100);
+        }
+        Simulator::Stop(Seconds(2));
+        Simulator::Run();
+        Simulator::Destroy();
+
+        NS_TEST_ASSERT_MSG_EQ(m_ecn.size(), nbPackets, "all the packets forwarded");
+        NS_TEST_ASSERT_MSG_EQ(m_ecn.front(), Ipv4Header::ECN_ECT0, "empty queue, no mark");
+        NS_TEST_ASSERT_MSG_EQ(m_ecn.back(), Ipv4Header::ECN_CE, "full queue, CE sent");
+        for (size_t i = 0; i < m_checksumOk.size(); i++)
+        {
+            NS_TEST_ASSERT_MSG_EQ(m_checksumOk[i], true, "valid IPv4 checksum, packet " << i);
+        }
+    }
+
+    std::vector<Ipv4Header::EcnType> m_ecn; //!< ECN bits of the received frames
+    std::vector<bool> m_checksumOk;         //!< IPv4 checksum of the received frames
+};
+
+/**
+ * @brief Test that the parallel pipeline engine gives the same packet events
+ * on every run, whatever its number of threads
+ */
+class P4SwitchEngineDeterminismTestCase : public TestCase
+{
+  public:
+    P4SwitchEngineDeterminismTestCase()
+        : TestCase("v1model parallel pipelines are deterministic")
+    {
+    }
+
+  private:
+    /**
+     * @brief Record a packet event of a switch
+     * @param context the switch and the trace source
+     * @param event the packet event
+     */
+    void Record(std::string context, const P4PacketEvent& event)
+    {
+        std::ostringstream oss;
+        oss << Simulator::Now().GetTimeStep() << " " << context << " " << event.packetId << " "
+            << event.port << " " << event.size << " " << event.depth;
+        m_events.push_back(oss.str());
+    }
+
+    /**
+     * @brief Run two switches forwarding bursts in both directions
+     * @param nbThreads the number of pipeline threads
+     * @return the packet events of the switches, in simulation order
+     */
+    std::vector<std::string> RunSwitches(uint32_t nbThreads)
+    {
+        Config::SetGlobal("P4PipelineThreads", UintegerValue(nbThreads));
+        m_events.clear();
+
+        P4Helper helper;
+        helper.SetDeviceAttribute(
+            "JsonPath",
+            StringValue(ExampleP4File("simple_v1model", "simple_v1model.json")));
+        helper.SetDeviceAttribute(
+            "FlowTablePath",
+            StringValue(ExampleP4File("simple_v1model", "flowtable_0.txt")));
+        helper.SetDeviceAttribute("SwitchRateBps", UintegerValue(8000000));
+
+        // the switches get their packets at the same times, their pipelines
+        // are run together by the engine
+        for (uint32_t s = 0; s < 2; s++)
+        {
+            NodeContainer hosts;
+            Ptr<P4SwitchNetDevice> device = BuildSwitchBetweenHosts(helper, &hosts);
+            for (const char* source : {"IngressDone", "Dequeued", "EgressDone", "Dropped"})
+            {
+                std::string context = "switch" + std::to_string(s) + " " + source;
+                device->TraceConnect(
+                    source,
+                    context,
+                    MakeCallback(&P4SwitchEngineDeterminismTestCase::Record, this));
+            }
+            for (uint32_t i = 0; i < 10; i++)
+            {
+                Simulator::Schedule(Seconds(1),
+                                    &SendIpv4Frame,
+                                    hosts.Get(0),
+                                    Ipv4Address("10.1.1.2"),
+                                    0,
+                                    100 + i);
+                Simulator::Schedule(Seconds(1),
+                                    &SendIpv4Frame,
+                                    hosts.Get(1),
+                                    Ipv4Address("10.1.1.1"),
+                                    0,
+                                    200 + i);
+            }
+        }
+        Simulator::Stop(Seconds(2));
+        Simulator::Run();
+        Simulator::Destroy();
+        Config::SetGlobal("P4PipelineThreads", UintegerValue(0));
+        return m_events;
+    }
+
+    void DoRun() override
+    {
+        std::vector<std::string> reference = RunSwitches(4);
+        NS_TEST_ASSERT_MSG_EQ(reference.empty(), false, "packet events recorded");
+
+        for (uint32_t nbThreads : {4, 4, 2, 1})
+        {
+            std::vector<std::string> events = RunSwitches(nbThreads);
+            NS_TEST_ASSERT_MSG_EQ(events.size(),
+                                  reference.size(),
+                                  "number of events with " << nbThreads << " threads");
+            for (size_t i = 0; i < events.size(); i++)
+            {
+                NS_TEST_ASSERT_MSG_EQ(events[i],
+                                      reference[i],
+                                      "event " << i << " with " << nbThreads << " threads");
+            }
+        }
+    }
+
+    std::vector<std::string> m_events; //!< Packet events of the current run
+};
+
+/**
+ * @brief P4 switch test suite
+ */
+class P4SwitchTestSuite : public TestSuite
+{
+  public:
+    P4SwitchTestSuite()
+        : TestSuite("p4-switch", UNIT)
+    {
+        AddTestCase(new P4SwitchWireRateTestCase, TestCase::QUICK);
+        AddTestCase(new P4SwitchPsaEcnTestCase, TestCase::QUICK);
+        AddTestCase(new P4SwitchEngineDeterminismTestCase, TestCase::QUICK);
+    }
+};
+
+static P4SwitchTestSuite g_p4SwitchTestSuite; //!< Static variable for test initialization
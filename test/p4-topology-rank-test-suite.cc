@@ -0,0 +1,132 @@
+/*
+ * Copyright (c) 2025 TU Dresden
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Authors: Mingyu Ma <mingyu.ma@tu-dresden.de>
+ */
+
+#include "ns3/p4-topology-reader-helper.h"
+#include "ns3/simulator.h"
+#include "ns3/test.h"
+
+#include <fstream>
+
+using namespace ns3;
+
+/**
+ * @brief Test the optional [<rank>] column of the switch lines and the rank of
+ * the hosts, taken from the first switch they are linked to
+ */
+class P4TopologyRankTestCase : public TestCase
+{
+  public:
+    P4TopologyRankTestCase()
+        : TestCase("P4TopologyReader switch and host ranks")
+    {
+    }
+
+  private:
+    void DoRun() override
+    {
+        // switches 0 and 1, hosts 2, 3 and 4; host 4 is linked to switch 1 first
+        std::string fileName = CreateTempDirFilename("topo.txt");
+        std::ofstream topo(fileName);
+        topo << "2 3 5\n"
+             << "2 h 0 s 1000Mbps 0.1ms\n"
+             << "0 s 1 s 1000Mbps 0.1ms\n"
+             << "1 s 3 h 1000Mbps 0.1ms\n"
+             << "4 h 1 s 1000Mbps 0.1ms\n"
+             << "4 h 0 s 1000Mbps 0.1ms\n"
+             << "0 BASIC\n"
+             << "1 BASIC 2\n";
+        topo.close();
+
+        P4TopologyReaderHelper helper;
+        helper.SetFileName(fileName);
+        helper.SetFileType("P2P");
+        Ptr<P4TopologyReader> reader = helper.GetTopologyReader();
+        NS_TEST_ASSERT_MSG_NE(reader, nullptr, "the topology is read");
+
+        std::vector<uint32_t> switchRanks = reader->GetSwitchRanks();
+        NS_TEST_ASSERT_MSG_EQ(switchRanks.size(), 2, "one rank per switch");
+        NS_TEST_ASSERT_MSG_EQ(switchRanks[0], 0, "rank 0 by default");
+        NS_TEST_ASSERT_MSG_EQ(switchRanks[1], 2, "rank from the column");
+        NS_TEST_ASSERT_MSG_EQ(reader->GetSwitchNetFunc()[1], "BASIC", "function still read");
+
+        NodeContainer switches = reader->GetSwitchNodeContainer();
+        NS_TEST_ASSERT_MSG_EQ(switches.Get(0)->GetSystemId(), 0, "switch 0 node");
+        NS_TEST_ASSERT_MSG_EQ(switches.Get(1)->GetSystemId(), 2, "switch 1 node");
+
+        NodeContainer hosts = reader->GetHostNodeContainer();
+        NS_TEST_ASSERT_MSG_EQ(hosts.GetN(), 3, "three hosts");
+        NS_TEST_ASSERT_MSG_EQ(hosts.Get(0)->GetSystemId(), 0, "host 2 behind switch 0");
+        NS_TEST_ASSERT_MSG_EQ(hosts.Get(1)->GetSystemId(), 2, "host 3 behind switch 1");
+        NS_TEST_ASSERT_MSG_EQ(hosts.Get(2)->GetSystemId(), 2, "host 4 on its first switch");
+
+        Simulator::Destroy();
+    }
+};
+
+/**
+ * @brief Test that the topology is rejected when a switch line carries a
+ * malformed rank
+ */
+class P4TopologyBadRankTestCase : public TestCase
+{
+  public:
+    P4TopologyBadRankTestCase()
+        : TestCase("P4TopologyReader rejects malformed ranks")
+    {
+    }
+
+  private:
+    void DoRun() override
+    {
+        for (const std::string rank : {"-1", "x", "2abc", "4294967296"})
+        {
+            std::string fileName = CreateTempDirFilename("topo-bad-rank.txt");
+            std::ofstream topo(fileName);
+            topo << "2 1 2\n"
+                 << "2 h 0 s 1000Mbps 0.1ms\n"
+                 << "0 s 1 s 1000Mbps 0.1ms\n"
+                 << "0 BASIC\n"
+                 << "1 BASIC " << rank << "\n";
+            topo.close();
+
+            P4TopologyReaderHelper helper;
+            helper.SetFileName(fileName);
+            helper.SetFileType("P2P");
+            NS_TEST_ASSERT_MSG_EQ(helper.GetTopologyReader(), nullptr, "rank " << rank);
+        }
+
+        Simulator::Destroy();
+    }
+};
+
+/**
+ * @brief Topology reader rank test suite
+ */
+class P4TopologyRankTestSuite : public TestSuite
+{
+  public:
+    P4TopologyRankTestSuite()
+        : TestSuite("p4-topology-rank", UNIT)
+    {
+        AddTestCase(new P4TopologyRankTestCase, TestCase::QUICK);
+        AddTestCase(new P4TopologyBadRankTestCase, TestCase::QUICK);
+    }
+};
+
+static P4TopologyRankTestSuite g_p4TopologyRankTestSuite; //!< Static test suite instance
@@ -0,0 +1,347 @@
+/*
+ * Copyright (c) 2025 TU Dresden
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Authors: Mingyu Ma <mingyu.ma@tu-dresden.de>
+ */
+
+#include "ns3/log.h"
+#include "ns3/p4-aqm.h"
+#include "ns3/simulator.h"
+
+#include <algorithm>
+#include <sstream>
+
+namespace ns3
+{
+
+NS_LOG_COMPONENT_DEFINE("P4Aqm");
+
+namespace
+{
+
+/**
+ * @brief Parse a number of a configuration
+ */
+bool
+ParseNumber(const std::string& text, double* value)
+{
+    try
+    {
+        size_t pos = 0;
+        *value = std::stod(text, &pos);
+        return pos == text.size() && *value >= 0;
+    }
+    catch (const std::exception&)
+    {
+        return false;
+    }
+}
+
+} // namespace
+
+bool
+P4Aqm::Config::Parse(const std::string& text, Config* config, std::string* error)
+{
+    *config = Config();
+    size_t colon = text.find(':');
+    std::string mode = text.substr(0, colon);
+    if (mode == "none" || mode.empty())
+    {
+        config->mode = NONE;
+    }
+    else if (mode == "red")
+    {
+        config->mode = RED;
+    }
+    else if (mode == "ecn")
+    {
+        config->mode = ECN_THRESHOLD;
+    }
+    else if (mode == "pie")
+    {
+        config->mode = PIE;
+    }
+    else
+    {
+        *error = "unknown AQM policy '" + mode + "' (none, red, ecn or pie)";
+        return false;
+    }
+    if (colon == std::string::npos)
+    {
+        return true;
+    }
+
+    std::istringstream params(text.substr(colon + 1));
+    std::string param;
+    while (std::getline(params, param, ','))
+    {
+        size_t equal = param.find('=');
+        double value;
+        if (equal == std::string::npos || !ParseNumber(param.substr(equal + 1), &value))
+        {
+            *error = "invalid AQM parameter '" + param + "'";
+            return false;
+        }
+        std::string key = param.substr(0, equal);
+        if (key == "ecn")
+        {
+            config->ecn = value != 0;
+        }
+        else if (key == "bytes")
+        {
+            config->bytes = value != 0;
+        }
+        else if (key == "min")
+        {
+            config->minThreshold = value;
+        }
+        else if (key == "max")
+        {
+            config->maxThreshold = value;
+        }
+        else if (key == "maxp")
+        {
+            config->maxP = value;
+        }
+        else if (key == "weight")
+        {
+            config->weight = value;
+        }
+        else if (key == "gentle")
+        {
+            config->gentle = value != 0;
+        }
+        else if (key == "k")
+        {
+            config->threshold = value;
+        }
+        else if (key == "target")
+        {
+            config->target = MicroSeconds(value);
+        }
+        else if (key == "tupdate")
+        {
+            config->tUpdate = MicroSeconds(value);
+        }
+        else if (key == "maxburst")
+        {
+            config->maxBurst = MicroSeconds(value);
+        }
+        else if (key == "alpha")
+        {
+            config->alpha = value;
+        }
+        else if (key == "beta")
+        {
+            config->beta = value;
+        }
+        else if (key == "markecn")
+        {
+            config->markEcnThreshold = value;
+        }
+        else
+        {
+            *error = "unknown AQM parameter '" + key + "'";
+            return false;
+        }
+    }
+
+    if (config->mode == RED && config->maxThreshold <= config->minThreshold)
+    {
+        *error = "the RED maximum threshold must be above the minimum threshold";
+        return false;
+    }
+    if (config->mode == PIE && config->tUpdate.IsZero())
+    {
+        *error = "the PIE update period must not be 0";
+        return false;
+    }
+    return true;
+}
+
+void
+P4Aqm::Configure(const Config& config)
+{
+    NS_LOG_FUNCTION(this << config.mode);
+    m_config = config;
+    if ((config.mode == RED || config.mode == PIE) && !m_rng)
+    {
+        m_rng = CreateObject<UniformRandomVariable>();
+    }
+    m_avg = 0;
+    m_count = -1;
+    m_prob = 0;
+    m_qdelay = Seconds(0);
+    m_qdelayOld = Seconds(0);
+    m_burstAllowance = config.maxBurst;
+    m_nextUpdate = Simulator::Now() + config.tUpdate;
+}
+
+P4Aqm::Verdict
+P4Aqm::OnEnqueue(uint64_t packets, uint64_t bytes, Time now)
+{
+    double depth = static_cast<double>(m_config.bytes ? bytes : packets);
+    switch (m_config.mode)
+    {
+    case RED:
+        return Red(depth);
+    case ECN_THRESHOLD:
+        return depth >= m_config.threshold ? Signal() : PASS;
+    case PIE:
+        return Pie(packets, now);
+    default:
+        return PASS;
+    }
+}
+
+P4Aqm::Verdict
+P4Aqm::Red(double depth)
+{
+    m_avg += m_config.weight * (depth - m_avg);
+    if (m_avg < m_config.minThreshold)
+    {
+        m_count = -1;
+        return PASS;
+    }
+
+    double max = m_config.maxThreshold;
+    double pb;
+    if (m_avg < max)
+    {
+        pb = m_config.maxP * (m_avg - m_config.minThreshold) / (max - m_config.minThreshold);
+    }
+    else if (m_config.gentle && m_avg < 2 * max)
+    {
+        pb = m_config.maxP + (1 - m_config.maxP) * (m_avg - max) / max;
+    }
+    else
+    {
+        m_count = 0;
+        return Signal();
+    }
+
+    // Spread the marks evenly: the probability grows with the packets since
+    // the last mark
+    m_count++;
+    double pa = (m_count * pb < 1) ? pb / (1 - m_count * pb) : 1;
+    if (m_rng->GetValue() < pa)
+    {
+        m_count = 0;
+        return Signal();
+    }
+    return PASS;
+}
+
+P4Aqm::Verdict
+P4Aqm::Pie(uint64_t packets, Time now)
+{
+    // An empty queue has no queueing delay, whatever the last packet served saw
+    if (packets == 0)
+    {
+        m_qdelay = Seconds(0);
+    }
+    if (now >= m_nextUpdate)
+    {
+        // One update per period elapsed since the last one, with the last
+        // queue delay seen. Once an update changes nothing, the next ones
+        // would not either
+        int64_t periods =
+            1 + (now - m_nextUpdate).GetTimeStep() / m_config.tUpdate.GetTimeStep();
+        for (int64_t i = 0; i < periods; i++)
+        {
+            double prob = m_prob;
+            Time burstAllowance = m_burstAllowance;
+            Time qdelayOld = m_qdelayOld;
+            UpdatePie();
+            if (m_prob == prob && m_burstAllowance == burstAllowance && m_qdelayOld == qdelayOld)
+            {
+                break;
+            }
+        }
+        m_nextUpdate += m_config.tUpdate * periods;
+    }
+
+    if (m_burstAllowance.IsStrictlyPositive())
+    {
+        return PASS;
+    }
+    if (m_qdelayOld < m_config.target / 2 && m_prob < 0.2)
+    {
+        return PASS;
+    }
+    if (packets < 2)
+    {
+        return PASS;
+    }
+    if (m_rng->GetValue() >= m_prob)
+    {
+        return PASS;
+    }
+    return (m_config.ecn && m_prob <= m_config.markEcnThreshold) ? MARK : DROP;
+}
+
+void
+P4Aqm::UpdatePie()
+{
+    double p = m_config.alpha * (m_qdelay - m_config.target).GetSeconds() +
+               m_config.beta * (m_qdelay - m_qdelayOld).GetSeconds();
+
+    // Auto-tuning: small probabilities move in small steps
+    if (m_prob < 0.000001)
+    {
+        p /= 2048;
+    }
+    else if (m_prob < 0.00001)
+    {
+        p /= 512;
+    }
+    else if (m_prob < 0.0001)
+    {
+        p /= 128;
+    }
+    else if (m_prob < 0.001)
+    {
+        p /= 32;
+    }
+    else if (m_prob < 0.01)
+    {
+        p /= 8;
+    }
+    else if (m_prob < 0.1)
+    {
+        p /= 2;
+    }
+    if (m_prob >= 0.1 && p > 0.02)
+    {
+        p = 0.02;
+    }
+    m_prob += p;
+
+    if (m_qdelay.IsZero() && m_qdelayOld.IsZero())
+    {
+        m_prob *= 0.98;
+    }
+    m_prob = std::min(std::max(m_prob, 0.0), 1.0);
+
+    m_burstAllowance = std::max(m_burstAllowance - m_config.tUpdate, Seconds(0));
+    if (m_prob == 0 && m_qdelay < m_config.target / 2 && m_qdelayOld < m_config.target / 2)
+    {
+        m_burstAllowance = m_config.maxBurst;
+    }
+    m_qdelayOld = m_qdelay;
+}
+
+} // namespace ns3
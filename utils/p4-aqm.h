@@ -0,0 +1,253 @@
+/*
+ * Copyright (c) 2025 TU Dresden
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Authors: Mingyu Ma <mingyu.ma@tu-dresden.de>
+ */
+
+#ifndef P4_AQM_H
+#define P4_AQM_H
+
+#include "ns3/nstime.h"
+#include "ns3/ptr.h"
+#include "ns3/random-variable-stream.h"
+
+#include <cstdint>
+#include <string>
+
+namespace ns3
+{
+
+/**
+ * @brief Active queue management of one egress priority queue.
+ *
+ * The queue asks the AQM about every arriving packet, in O(1) and without
+ * scheduling any event; the AQM answers pass, mark (set ECN CE) or drop. The
+ * policies are:
+ * - RED: the average depth (EWMA) is compared to a minimum and a maximum
+ *   threshold, the marking probability grows linearly between them up to
+ *   maxP (then to 1 at twice the maximum threshold in gentle mode);
+ * - ECN_THRESHOLD: the packets arriving when the instantaneous depth is at
+ *   least the threshold are marked, as in DCTCP;
+ * - PIE (RFC 8033): the drop probability is updated every tUpdate from the
+ *   queueing delay, measured as the sojourn time of the last packet served.
+ *   The first arrival after a period elapsed runs one update per period
+ *   elapsed since the last update.
+ *
+ * The depths are in packets, or in bytes with Config::bytes. With
+ * Config::ecn, the packets are marked instead of dropped; the queue drops the
+ * packets that are not ECN capable (and, for PIE, all the packets once the
+ * probability exceeds markEcnThreshold).
+ */
+class P4Aqm
+{
+  public:
+    /**
+     * @brief AQM policy
+     */
+    enum Mode
+    {
+        NONE = 0,      //!< No AQM, only the capacities drop packets
+        RED,           //!< Random early detection
+        ECN_THRESHOLD, //!< Mark above an instantaneous depth (DCTCP)
+        PIE            //!< Proportional integral controller enhanced
+    };
+
+    /**
+     * @brief Decision about an arriving packet
+     */
+    enum Verdict
+    {
+        PASS = 0, //!< Enqueue the packet
+        MARK,     //!< Enqueue the packet with ECN CE, or drop it if not ECN capable
+        DROP      //!< Drop the packet
+    };
+
+    /**
+     * @brief Parameters of the AQM
+     */
+    struct Config
+    {
+        Mode mode{NONE};   //!< Policy
+        bool ecn{true};    //!< Mark ECN capable packets instead of dropping them
+        bool bytes{false}; //!< Depths and thresholds in bytes instead of packets
+
+        // RED
+        double minThreshold{5};  //!< Average depth the marking starts at
+        double maxThreshold{15}; //!< Average depth the probability reaches maxP at
+        double maxP{0.1};        //!< Marking probability at maxThreshold
+        double weight{0.002};    //!< Weight of the new depth in the average
+        bool gentle{true};       //!< Probability up to 1 at 2 * maxThreshold, not a cliff
+
+        // ECN_THRESHOLD
+        double threshold{20}; //!< Instantaneous depth the marking starts at (K)
+
+        // PIE
+        Time target{MilliSeconds(15)};    //!< Target queueing delay
+        Time tUpdate{MilliSeconds(15)};   //!< Period of the probability updates
+        Time maxBurst{MilliSeconds(150)}; //!< Burst allowance after an idle queue
+        double alpha{0.125};              //!< Gain of the delay error (1/s)
+        double beta{1.25};                //!< Gain of the delay trend (1/s)
+        double markEcnThreshold{0.1};     //!< Probability above which PIE drops even with ECN
+
+        /**
+         * @brief Parse a configuration
+         * @details The format is "<mode>[:<key>=<value>[,<key>=<value>...]]",
+         * the mode being none, red, ecn or pie. The keys are ecn and bytes
+         * (0 or 1), min, max, maxp, weight and gentle (RED), k (ECN
+         * threshold), target, tupdate and maxburst (PIE, in microseconds),
+         * alpha, beta and markecn (PIE), e.g. "red:min=20,max=60,maxp=0.05".
+         * @param text the configuration text
+         * @param config set to the configuration, defaults for the keys not given
+         * @param error set to a description of the problem on failure
+         * @return true on success
+         */
+        static bool Parse(const std::string& text, Config* config, std::string* error);
+    };
+
+    /**
+     * @brief Packets marked and dropped by the AQM
+     */
+    struct Counters
+    {
+        uint64_t marks{0}; //!< Packets marked ECN CE
+        uint64_t drops{0}; //!< Packets dropped, including unmarkable ones
+    };
+
+    /**
+     * @brief Set the policy and its parameters, resetting the state
+     * @param config the configuration
+     */
+    void Configure(const Config& config);
+
+    /**
+     * @brief Get the configuration
+     * @return the configuration
+     */
+    const Config& GetConfig() const
+    {
+        return m_config;
+    }
+
+    /**
+     * @brief Check if a policy is set
+     * @return true if the AQM may mark or drop packets
+     */
+    bool IsEnabled() const
+    {
+        return m_config.mode != NONE;
+    }
+
+    /**
+     * @brief Decide about an arriving packet
+     * @param packets packets in the queue, before the arriving one
+     * @param bytes bytes in the queue, before the arriving one
+     * @param now the current time
+     * @return the verdict, MARK only if ECN marking is enabled
+     */
+    Verdict OnEnqueue(uint64_t packets, uint64_t bytes, Time now);
+
+    /**
+     * @brief Report the sojourn time of a packet served, used by PIE
+     * @param sojourn time the packet spent in the queue
+     */
+    void OnDequeue(Time sojourn)
+    {
+        m_qdelay = sojourn;
+    }
+
+    /**
+     * @brief Count a packet marked ECN CE
+     */
+    void CountMark()
+    {
+        m_counters.marks++;
+    }
+
+    /**
+     * @brief Count a packet dropped
+     */
+    void CountDrop()
+    {
+        m_counters.drops++;
+    }
+
+    /**
+     * @brief Get the mark and drop counters
+     * @return the counters
+     */
+    const Counters& GetCounters() const
+    {
+        return m_counters;
+    }
+
+    /**
+     * @brief Get the PIE drop probability
+     * @return the probability, 0 for the other policies
+     */
+    double GetPieProbability() const
+    {
+        return m_prob;
+    }
+
+  private:
+    /**
+     * @brief RED decision
+     * @param depth the depth, in the unit of the thresholds
+     * @return the verdict
+     */
+    Verdict Red(double depth);
+
+    /**
+     * @brief PIE decision
+     * @param packets packets in the queue
+     * @param now the current time
+     * @return the verdict
+     */
+    Verdict Pie(uint64_t packets, Time now);
+
+    /**
+     * @brief Update the PIE drop probability (RFC 8033, section 4.2)
+     */
+    void UpdatePie();
+
+    /**
+     * @brief Mark if enabled, else drop
+     * @return the verdict
+     */
+    Verdict Signal() const
+    {
+        return m_config.ecn ? MARK : DROP;
+    }
+
+    Config m_config;                  //!< Configuration
+    Counters m_counters;              //!< Marks and drops
+    Ptr<UniformRandomVariable> m_rng; //!< Random draws of RED and PIE
+
+    // RED state
+    double m_avg{0};     //!< Average depth
+    int64_t m_count{-1}; //!< Packets since the last mark, -1 below minThreshold
+
+    // PIE state
+    double m_prob{0};      //!< Drop probability
+    Time m_qdelay;         //!< Last queueing delay measured
+    Time m_qdelayOld;      //!< Queueing delay at the previous update
+    Time m_burstAllowance; //!< Time left without drops
+    Time m_nextUpdate;     //!< Time of the next probability update
+};
+
+} // namespace ns3
+
+#endif /* P4_AQM_H */
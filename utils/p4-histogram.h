@@ -0,0 +1,208 @@
+/*
+ * Copyright (c) 2025 TU Dresden
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Authors: Mingyu Ma <mingyu.ma@tu-dresden.de>
+ */
+
+#ifndef P4_HISTOGRAM_H
+#define P4_HISTOGRAM_H
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+
+namespace ns3
+{
+
+/**
+ * @brief Histogram of non-negative integer values with logarithmic buckets.
+ *
+ * The buckets follow the HDR histogram layout: the values below SUB_BUCKETS
+ * have a bucket each, then every power of two range is split into SUB_BUCKETS
+ * linear buckets. A value is thus counted with a relative error below
+ * 1 / SUB_BUCKETS (6.25 %), whatever its magnitude. Values from 2^MAX_BITS
+ * up are counted in the last bucket.
+ *
+ * The buckets are a fixed array: Record() is a few instructions and never
+ * allocates, so the histogram can be updated for every packet.
+ */
+class P4Histogram
+{
+  public:
+    static constexpr unsigned SUB_BUCKET_BITS = 4; //!< log2 of the buckets per power of two
+    static constexpr unsigned MAX_BITS = 48;       //!< Values are resolved below 2^MAX_BITS
+    static constexpr uint64_t SUB_BUCKETS = uint64_t(1) << SUB_BUCKET_BITS; //!< Buckets per range
+    static constexpr size_t NB_BUCKETS =
+        SUB_BUCKETS * (MAX_BITS - SUB_BUCKET_BITS + 1); //!< Number of buckets
+
+    /**
+     * @brief Count a value
+     * @param value the value
+     */
+    void Record(uint64_t value)
+    {
+        m_counts[GetBucket(value)]++;
+        m_count++;
+        m_sum += value;
+        m_min = std::min(m_min, value);
+        m_max = std::max(m_max, value);
+    }
+
+    /**
+     * @brief Get the number of values counted
+     * @return the number of values
+     */
+    uint64_t GetCount() const
+    {
+        return m_count;
+    }
+
+    /**
+     * @brief Get the smallest value counted
+     * @return the smallest value, 0 if the histogram is empty
+     */
+    uint64_t GetMin() const
+    {
+        return m_count ? m_min : 0;
+    }
+
+    /**
+     * @brief Get the largest value counted
+     * @return the largest value, 0 if the histogram is empty
+     */
+    uint64_t GetMax() const
+    {
+        return m_max;
+    }
+
+    /**
+     * @brief Get the mean of the values counted
+     * @return the exact mean, 0 if the histogram is empty
+     */
+    double GetMean() const
+    {
+        return m_count ? static_cast<double>(m_sum) / static_cast<double>(m_count) : 0.0;
+    }
+
+    /**
+     * @brief Get a percentile of the values counted
+     * @details Walks the buckets, O(NB_BUCKETS). The result is the upper
+     * bound of the bucket holding the percentile, capped by the largest value
+     * counted: it is at most 1 / SUB_BUCKETS above the exact percentile.
+     * @param percentile the percentile, in [0, 100]
+     * @return the value at the percentile, 0 if the histogram is empty
+     */
+    uint64_t GetPercentile(double percentile) const
+    {
+        if (m_count == 0)
+        {
+            return 0;
+        }
+        percentile = std::min(std::max(percentile, 0.0), 100.0);
+        // nearest rank: the smallest value with at least percentile % of the
+        // values at or below it
+        uint64_t rank =
+            static_cast<uint64_t>(std::ceil(percentile / 100.0 * static_cast<double>(m_count)));
+        rank = std::min(std::max<uint64_t>(rank, 1), m_count);
+        uint64_t seen = 0;
+        for (size_t bucket = 0; bucket < NB_BUCKETS; bucket++)
+        {
+            seen += m_counts[bucket];
+            if (seen >= rank)
+            {
+                return std::max(std::min(GetBucketMax(bucket), m_max), GetMin());
+            }
+        }
+        return m_max;
+    }
+
+    /**
+     * @brief Add the values counted by another histogram
+     * @param other the other histogram
+     */
+    void Merge(const P4Histogram& other)
+    {
+        for (size_t bucket = 0; bucket < NB_BUCKETS; bucket++)
+        {
+            m_counts[bucket] += other.m_counts[bucket];
+        }
+        m_count += other.m_count;
+        m_sum += other.m_sum;
+        m_min = std::min(m_min, other.m_min);
+        m_max = std::max(m_max, other.m_max);
+    }
+
+    /**
+     * @brief Forget all the values counted
+     */
+    void Reset()
+    {
+        *this = P4Histogram();
+    }
+
+    /**
+     * @brief Get the bucket of a value
+     * @param value the value
+     * @return the index of its bucket
+     */
+    static size_t GetBucket(uint64_t value)
+    {
+        if (value < SUB_BUCKETS)
+        {
+            return value;
+        }
+        unsigned msb = 63 - __builtin_clzll(value);
+        if (msb >= MAX_BITS)
+        {
+            return NB_BUCKETS - 1;
+        }
+        unsigned shift = msb - SUB_BUCKET_BITS;
+        return SUB_BUCKETS * (shift + 1) + ((value >> shift) & (SUB_BUCKETS - 1));
+    }
+
+    /**
+     * @brief Get the largest value of a bucket
+     * @param bucket the index of the bucket
+     * @return the largest value counted in the bucket
+     */
+    static uint64_t GetBucketMax(size_t bucket)
+    {
+        if (bucket < SUB_BUCKETS)
+        {
+            return bucket;
+        }
+        if (bucket == NB_BUCKETS - 1)
+        {
+            return std::numeric_limits<uint64_t>::max();
+        }
+        unsigned shift = bucket / SUB_BUCKETS - 1;
+        uint64_t sub = SUB_BUCKETS + bucket % SUB_BUCKETS;
+        return ((sub + 1) << shift) - 1;
+    }
+
+  private:
+    std::array<uint64_t, NB_BUCKETS> m_counts{};          //!< Values counted per bucket
+    uint64_t m_count{0};                                  //!< Values counted
+    uint64_t m_sum{0};                                    //!< Sum of the values counted
+    uint64_t m_min{std::numeric_limits<uint64_t>::max()}; //!< Smallest value counted
+    uint64_t m_max{0};                                    //!< Largest value counted
+};
+
+} // namespace ns3
+
+#endif /* P4_HISTOGRAM_H */
@@ -0,0 +1,124 @@
+/*
+ * Copyright (c) 2025 TU Dresden
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Authors: Mingyu Ma <mingyu.ma@tu-dresden.de>
+ */
+
+#include "ns3/log.h"
+#include "ns3/p4-json-cache.h"
+
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+
+NS_LOG_COMPONENT_DEFINE("P4JsonCache");
+
+namespace ns3
+{
+
+std::mutex P4JsonCache::g_mutex;
+std::unordered_map<std::string, P4JsonCache::FileState> P4JsonCache::g_files;
+std::map<std::pair<std::string, uint64_t>, std::shared_ptr<const P4JsonCache::Program>>
+    P4JsonCache::g_programs;
+
+uint64_t
+P4JsonCache::Hash(const std::string& content)
+{
+    uint64_t hash = 14695981039346656037ULL;
+    for (unsigned char c : content)
+    {
+        hash ^= c;
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+std::shared_ptr<const P4JsonCache::Program>
+P4JsonCache::Get(const std::string& jsonPath, std::string* error)
+{
+    std::error_code ec;
+    uintmax_t size = std::filesystem::file_size(jsonPath, ec);
+    if (ec)
+    {
+        *error = "cannot access " + jsonPath + ": " + ec.message();
+        return nullptr;
+    }
+    int64_t mtime = std::filesystem::last_write_time(jsonPath, ec).time_since_epoch().count();
+
+    std::lock_guard<std::mutex> lock(g_mutex);
+
+    auto fileIt = g_files.find(jsonPath);
+    if (fileIt != g_files.end() && fileIt->second.mtime == mtime && fileIt->second.size == size)
+    {
+        NS_LOG_DEBUG("Reusing cached P4 program " << jsonPath);
+        return fileIt->second.program;
+    }
+
+    std::ifstream infile(jsonPath, std::ios::binary);
+    if (!infile.good())
+    {
+        *error = "cannot open " + jsonPath;
+        return nullptr;
+    }
+    std::ostringstream content;
+    content << infile.rdbuf();
+    std::string json = content.str();
+    uint64_t hash = Hash(json);
+
+    // The file may have been touched without being modified
+    std::shared_ptr<const Program>& program = g_programs[std::make_pair(jsonPath, hash)];
+    if (!program)
+    {
+        NS_LOG_INFO("Caching P4 program " << jsonPath << " (" << json.size() << " bytes)");
+        auto newProgram = std::make_shared<Program>();
+        newProgram->jsonPath = jsonPath;
+        newProgram->hash = hash;
+        std::string infoError;
+        newProgram->programInfoValid = newProgram->programInfo.LoadFromString(json, &infoError);
+        if (!newProgram->programInfoValid)
+        {
+            NS_LOG_WARN("Cannot read the program description of " << jsonPath << ": "
+                                                                   << infoError);
+        }
+        newProgram->json = std::move(json);
+        program = newProgram;
+    }
+
+    if (fileIt != g_files.end() && fileIt->second.program->hash != hash)
+    {
+        // Older versions stay alive as long as a switch still uses them
+        g_programs.erase(std::make_pair(jsonPath, fileIt->second.program->hash));
+    }
+    g_files[jsonPath] = FileState{mtime, size, program};
+    return program;
+}
+
+void
+P4JsonCache::Clear()
+{
+    std::lock_guard<std::mutex> lock(g_mutex);
+    g_files.clear();
+    g_programs.clear();
+}
+
+size_t
+P4JsonCache::GetNumPrograms()
+{
+    std::lock_guard<std::mutex> lock(g_mutex);
+    return g_programs.size();
+}
+
+} // namespace ns3
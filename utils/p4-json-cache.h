@@ -0,0 +1,110 @@
+/*
+ * Copyright (c) 2025 TU Dresden
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Authors: Mingyu Ma <mingyu.ma@tu-dresden.de>
+ */
+
+#ifndef P4_JSON_CACHE_H
+#define P4_JSON_CACHE_H
+
+#include "ns3/p4-program-info.h"
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+namespace ns3
+{
+
+/**
+ * @brief Process-wide cache of compiled P4 programs (bmv2 JSON files).
+ *
+ * Large topologies usually run the same program on hundreds of switches. The
+ * cache reads every JSON file once, keyed by its path and the hash of its
+ * content, and keeps the JSON text together with the parsed P4ProgramInfo.
+ * All the switches running the program share the same entry: the bmv2 objects
+ * of each switch are built from the cached text, and the flow table loader
+ * uses the cached program description.
+ *
+ * A file is read again only when its size or modification time changes. The
+ * cache is thread-safe.
+ */
+class P4JsonCache
+{
+  public:
+    /**
+     * @brief A cached compiled P4 program
+     */
+    struct Program
+    {
+        std::string jsonPath;      //!< Path of the JSON file
+        std::string json;          //!< Content of the JSON file
+        uint64_t hash;             //!< Hash of the content
+        P4ProgramInfo programInfo; //!< Control plane view of the program
+        bool programInfoValid;     //!< False if the program info could not be parsed
+    };
+
+    /**
+     * @brief Get a compiled P4 program, reading it on the first request
+     * @param jsonPath the path to the JSON file
+     * @param error set to a description of the problem on failure
+     * @return the cached program, or nullptr if the file cannot be read
+     */
+    static std::shared_ptr<const Program> Get(const std::string& jsonPath, std::string* error);
+
+    /**
+     * @brief Remove all the cached programs
+     *
+     * Programs still used by a switch stay alive until the switch releases them.
+     */
+    static void Clear();
+
+    /**
+     * @brief Get the number of cached programs
+     * @return the number of programs
+     */
+    static size_t GetNumPrograms();
+
+    /**
+     * @brief Hash the content of a JSON file (64-bit FNV-1a)
+     * @param content the content
+     * @return the hash
+     */
+    static uint64_t Hash(const std::string& content);
+
+  private:
+    /**
+     * @brief Last known state of a JSON file
+     */
+    struct FileState
+    {
+        int64_t mtime;                           //!< Modification time
+        uintmax_t size;                          //!< Size in bytes
+        std::shared_ptr<const Program> program;  //!< Program read from the file
+    };
+
+    static std::mutex g_mutex; //!< Protects the maps below
+    static std::unordered_map<std::string, FileState> g_files; //!< Path to file state
+    static std::map<std::pair<std::string, uint64_t>, std::shared_ptr<const Program>>
+        g_programs; //!< (path, content hash) to program
+};
+
+} // namespace ns3
+
+#endif /* P4_JSON_CACHE_H */
@@ -0,0 +1,260 @@
+/*
+ * Copyright (c) 2025 TU Dresden
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Authors: Mingyu Ma <mingyu.ma@tu-dresden.de>
+ */
+
+#include "ns3/log.h"
+#include "ns3/p4-packet-pool.h"
+
+#include <bm/bm_sim/phv.h>
+
+NS_LOG_COMPONENT_DEFINE("P4PacketPool");
+
+namespace ns3
+{
+
+// Packet registers used by the switch cores (see RegisterAccess)
+static constexpr size_t NB_USED_PACKET_REGISTERS = 3;
+
+const std::array<size_t, P4PacketPool::NUM_SIZE_CLASSES> P4PacketPool::g_classSizes = {
+    128,
+    256,
+    512,
+    1024,
+    2048,
+    4096,
+    9216};
+
+P4PacketPool::P4PacketPool(bm::Switch* sw, size_t headroom, size_t maxPackets)
+    : m_switch(sw),
+      m_headroom(headroom),
+      m_maxPackets(0),
+      m_numCached(0)
+{
+    SetMaxPackets(maxPackets);
+}
+
+P4PacketPool::~P4PacketPool()
+{
+    NS_LOG_DEBUG("Packet pool: " << m_stats.hits << " hits, " << m_stats.misses << " misses, "
+                                 << m_stats.oversize << " oversize, " << m_stats.foreign
+                                 << " foreign releases");
+}
+
+size_t
+P4PacketPool::GetSizeClass(size_t len)
+{
+    for (size_t i = 0; i < NUM_SIZE_CLASSES; i++)
+    {
+        if (len <= g_classSizes[i])
+        {
+            return i;
+        }
+    }
+    return NUM_SIZE_CLASSES;
+}
+
+void
+P4PacketPool::ResetPacket(bm::Packet* packet, const Slot& slot, int ingressPort, size_t len)
+{
+    // Rewind the buffer: the data ends at the end of the buffer, the rest is headroom
+    bm::Packet::buffer_state_t state;
+    state.head = slot.bufferEnd - len;
+    state.data_size = len;
+    packet->restore_buffer_state(state);
+
+    packet->set_ingress_port(ingressPort);
+    packet->set_egress_port(0);
+    packet->set_ingress_length(len);
+    packet->reset_exit();
+    for (size_t i = 0; i < NB_USED_PACKET_REGISTERS; i++)
+    {
+        packet->set_register(i, 0);
+    }
+
+    bm::PHV* phv = packet->get_phv();
+    phv->reset();
+    phv->reset_header_stacks();
+    phv->reset_metadata();
+}
+
+std::unique_ptr<bm::Packet>
+P4PacketPool::Acquire(int ingressPort, uint64_t packetId, size_t len)
+{
+    size_t sizeClass = GetSizeClass(len);
+    if (sizeClass == NUM_SIZE_CLASSES || m_maxPackets == 0)
+    {
+        // Not pooled: plain allocation, released normally
+        m_stats.oversize += (sizeClass == NUM_SIZE_CLASSES);
+        m_stats.misses += (sizeClass != NUM_SIZE_CLASSES);
+        bm::PacketBuffer buffer(len + m_headroom);
+        buffer.push(len);
+        return m_switch->new_packet_ptr(ingressPort, packetId, len, std::move(buffer));
+    }
+
+    std::vector<std::unique_ptr<bm::Packet>>& freeList = m_freeLists[sizeClass];
+    if (!freeList.empty())
+    {
+        std::unique_ptr<bm::Packet> packet = std::move(freeList.back());
+        freeList.pop_back();
+        m_numCached--;
+        m_stats.hits++;
+        Slot& slot = m_slots.at(packet.get());
+        slot.receptionId = packetId;
+        ResetPacket(packet.get(), slot, ingressPort, len);
+        return packet;
+    }
+
+    // Allocate a buffer of the full class size, so the packet can serve any
+    // frame of its class once recycled
+    m_stats.misses++;
+    size_t capacity = g_classSizes[sizeClass] + m_headroom;
+    bm::PacketBuffer buffer(capacity);
+    char* data = buffer.push(len);
+    std::unique_ptr<bm::Packet> packet =
+        m_switch->new_packet_ptr(ingressPort, packetId, len, std::move(buffer));
+
+    // A packet destroyed by bmv2 may have left a slot at the same address
+    m_slots[packet.get()] = Slot{data + len, capacity, packetId, packetId, sizeClass};
+    return packet;
+}
+
+void
+P4PacketPool::Release(std::unique_ptr<bm::Packet>&& packet)
+{
+    if (!packet)
+    {
+        return;
+    }
+
+    auto it = m_slots.find(packet.get());
+    if (it == m_slots.end())
+    {
+        m_clones.erase(packet.get());
+        m_stats.foreign++;
+        packet.reset();
+        return;
+    }
+
+    // Make sure the slot describes this packet, and not a packet destroyed
+    // without being released whose address has been reused. Truncated packets
+    // are not recycled either, their data does not end at the end of the buffer.
+    const Slot& slot = it->second;
+    const char* data = packet->data();
+    if (packet->get_packet_id() != slot.packetId || packet->get_copy_id() != 0 ||
+        data + packet->get_data_size() != slot.bufferEnd ||
+        data < slot.bufferEnd - slot.capacity)
+    {
+        m_slots.erase(it);
+        m_stats.foreign++;
+        packet.reset();
+        return;
+    }
+
+    if (m_numCached >= m_maxPackets)
+    {
+        m_slots.erase(it);
+        m_stats.freed++;
+        packet.reset();
+        return;
+    }
+
+    m_freeLists[slot.sizeClass].push_back(std::move(packet));
+    m_numCached++;
+    m_stats.recycled++;
+}
+
+uint64_t
+P4PacketPool::GetPacketId(const bm::Packet* packet) const
+{
+    // the bmv2 ids tell the packets from the destroyed ones at the same address
+    auto slot = m_slots.find(packet);
+    if (slot != m_slots.end() && slot->second.packetId == packet->get_packet_id())
+    {
+        return slot->second.receptionId;
+    }
+    auto clone = m_clones.find(packet);
+    if (clone != m_clones.end() && clone->second.bmPacketId == packet->get_packet_id())
+    {
+        return clone->second.receptionId;
+    }
+    return packet->get_packet_id();
+}
+
+void
+P4PacketPool::AddClone(const bm::Packet* clone, const bm::Packet* original)
+{
+    m_clones[clone] = CloneId{clone->get_packet_id(), GetPacketId(original)};
+}
+
+void
+P4PacketPool::Clear()
+{
+    for (auto& freeList : m_freeLists)
+    {
+        for (auto& packet : freeList)
+        {
+            m_slots.erase(packet.get());
+        }
+        freeList.clear();
+    }
+    m_numCached = 0;
+}
+
+void
+P4PacketPool::SetMaxPackets(size_t maxPackets)
+{
+    if (maxPackets < m_numCached)
+    {
+        Clear();
+    }
+    m_maxPackets = maxPackets;
+
+    // No reallocation of the free lists once the pool is warm
+    for (auto& freeList : m_freeLists)
+    {
+        freeList.reserve(maxPackets);
+    }
+    m_slots.reserve(maxPackets);
+}
+
+size_t
+P4PacketPool::GetMaxPackets() const
+{
+    return m_maxPackets;
+}
+
+size_t
+P4PacketPool::GetNumCached() const
+{
+    return m_numCached;
+}
+
+const P4PacketPool::Stats&
+P4PacketPool::GetStats() const
+{
+    return m_stats;
+}
+
+double
+P4PacketPool::GetHitRate() const
+{
+    uint64_t requests = m_stats.hits + m_stats.misses + m_stats.oversize;
+    return requests == 0 ? 0.0 : static_cast<double>(m_stats.hits) / requests;
+}
+
+} // namespace ns3
@@ -0,0 +1,215 @@
+/*
+ * Copyright (c) 2025 TU Dresden
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Authors: Mingyu Ma <mingyu.ma@tu-dresden.de>
+ */
+
+#ifndef P4_PACKET_POOL_H
+#define P4_PACKET_POOL_H
+
+#include <array>
+#include <bm/bm_sim/packet.h>
+#include <bm/bm_sim/switch.h>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+namespace ns3
+{
+
+/**
+ * @brief Per-switch free list of bm packets.
+ *
+ * A bm::Packet owns its PacketBuffer and its PHV. Instead of destroying the
+ * packets leaving the switch (or dropped by it), the pool keeps them and hands
+ * them out again for the next received frames: the buffer is rewound, the PHV
+ * and the packet metadata are reset, and no heap allocation takes place.
+ *
+ * A recycled packet keeps the id bmv2 created it with, which cannot be
+ * changed: the id of the current reception, given to Acquire(), is returned by
+ * GetPacketId(). The clones of a packet are given its reception id with
+ * AddClone().
+ *
+ * Packets are sorted in size classes by the data size their buffer can hold
+ * (128 bytes to 9216 bytes, plus the headroom). A frame is served from the
+ * smallest class it fits in. Only the packets created by the pool are recycled;
+ * the clones created by bmv2 (mirroring, multicast, resubmit, recirculation)
+ * are released normally.
+ *
+ * The pool is not thread-safe, it is used by the switch owning it only.
+ */
+class P4PacketPool
+{
+  public:
+    /**
+     * @brief Usage counters of the pool
+     */
+    struct Stats
+    {
+        uint64_t hits{0};     //!< Packets served from the free list
+        uint64_t misses{0};   //!< Packets allocated because the free list was empty
+        uint64_t oversize{0}; //!< Packets allocated because no size class fits
+        uint64_t recycled{0}; //!< Packets returned to the free list
+        uint64_t freed{0};    //!< Pool packets destroyed because the pool was full
+        uint64_t foreign{0};  //!< Released packets not created by the pool (clones)
+    };
+
+    static constexpr size_t DEFAULT_MAX_PACKETS = 1024; //!< Default number of cached packets
+
+    /**
+     * @brief Construct a new packet pool
+     * @param sw the switch creating the packets
+     * @param headroom free bytes kept in front of the packet data
+     * @param maxPackets maximum number of cached packets, 0 disables the pool
+     */
+    P4PacketPool(bm::Switch* sw, size_t headroom, size_t maxPackets = DEFAULT_MAX_PACKETS);
+
+    ~P4PacketPool();
+
+    /**
+     * @brief Get a packet with a data buffer of the given size
+     *
+     * The returned packet holds \p len bytes of uninitialized data, to be
+     * filled through bm::Packet::data().
+     *
+     * @param ingressPort the ingress port of the packet
+     * @param packetId the packet id, see GetPacketId()
+     * @param len the data size in bytes
+     * @return std::unique_ptr<bm::Packet> the packet
+     */
+    std::unique_ptr<bm::Packet> Acquire(int ingressPort, uint64_t packetId, size_t len);
+
+    /**
+     * @brief Give a packet back to the pool
+     *
+     * The packet is cached if it was created by the pool and the pool is not
+     * full, otherwise it is destroyed.
+     *
+     * @param packet the packet, not used by the switch anymore
+     */
+    void Release(std::unique_ptr<bm::Packet>&& packet);
+
+    /**
+     * @brief Get the id of the reception a packet belongs to
+     * @details The id given to Acquire() for the packets of the pool, the id
+     * of the original for the clones given to AddClone(), the bmv2 id
+     * otherwise.
+     * @param packet the packet
+     * @return the packet id
+     */
+    uint64_t GetPacketId(const bm::Packet* packet) const;
+
+    /**
+     * @brief Give a clone the reception id of its original
+     * @details The clone is forgotten when it is released.
+     * @param clone the clone
+     * @param original the packet it was cloned from
+     */
+    void AddClone(const bm::Packet* clone, const bm::Packet* original);
+
+    /**
+     * @brief Destroy all the cached packets
+     *
+     * Must be called when the P4 program is swapped, as the cached PHVs have
+     * the layout of the former program.
+     */
+    void Clear();
+
+    /**
+     * @brief Set the maximum number of cached packets
+     * @param maxPackets the maximum number of packets, 0 disables the pool
+     */
+    void SetMaxPackets(size_t maxPackets);
+
+    /**
+     * @brief Get the maximum number of cached packets
+     * @return the maximum number of packets
+     */
+    size_t GetMaxPackets() const;
+
+    /**
+     * @brief Get the number of packets currently cached
+     * @return the number of packets
+     */
+    size_t GetNumCached() const;
+
+    /**
+     * @brief Get the usage counters of the pool
+     * @return the counters
+     */
+    const Stats& GetStats() const;
+
+    /**
+     * @brief Get the fraction of the packets served from the free list
+     * @return the hit rate in [0, 1], 0 if no packet was requested
+     */
+    double GetHitRate() const;
+
+  private:
+    static constexpr size_t NUM_SIZE_CLASSES = 7; //!< Number of size classes
+    static const std::array<size_t, NUM_SIZE_CLASSES> g_classSizes; //!< Data size of each class
+
+    /**
+     * @brief Bookkeeping of a packet created by the pool
+     */
+    struct Slot
+    {
+        char* bufferEnd;      //!< End of the packet buffer, the data is stored in front of it
+        size_t capacity;      //!< Size of the packet buffer
+        uint64_t packetId;    //!< Id the packet was created with
+        uint64_t receptionId; //!< Id of the current use of the packet
+        size_t sizeClass;     //!< Size class of the packet
+    };
+
+    /**
+     * @brief Ids of a clone
+     */
+    struct CloneId
+    {
+        uint64_t bmPacketId;  //!< Id bmv2 gave the clone
+        uint64_t receptionId; //!< Reception id of the original
+    };
+
+    /**
+     * @brief Find the smallest size class holding the given data size
+     * @param len the data size in bytes
+     * @return the size class, or NUM_SIZE_CLASSES if none fits
+     */
+    static size_t GetSizeClass(size_t len);
+
+    /**
+     * @brief Reset the state a packet kept from its previous use
+     * @param packet the packet
+     * @param slot the bookkeeping of the packet
+     * @param ingressPort the new ingress port
+     * @param len the new data size
+     */
+    static void ResetPacket(bm::Packet* packet, const Slot& slot, int ingressPort, size_t len);
+
+    bm::Switch* m_switch;  //!< Switch creating the packets
+    size_t m_headroom;     //!< Free bytes in front of the packet data
+    size_t m_maxPackets;   //!< Maximum number of cached packets
+    size_t m_numCached;    //!< Number of cached packets
+    Stats m_stats;         //!< Usage counters
+    std::array<std::vector<std::unique_ptr<bm::Packet>>, NUM_SIZE_CLASSES>
+        m_freeLists; //!< Cached packets, per size class
+    std::unordered_map<const bm::Packet*, Slot> m_slots;     //!< Packets created by the pool
+    std::unordered_map<const bm::Packet*, CloneId> m_clones; //!< Clones given to AddClone
+};
+
+} // namespace ns3
+
+#endif /* P4_PACKET_POOL_H */
@@ -0,0 +1,152 @@
+/*
+ * Copyright (c) 2025 TU Dresden
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Authors: Mingyu Ma <mingyu.ma@tu-dresden.de>
+ */
+
+#ifndef P4_PFC_H
+#define P4_PFC_H
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+namespace ns3
+{
+
+/**
+ * @brief Ingress accounting of a switch driving priority flow control (PFC).
+ *
+ * Counts the bytes each ingress port has in the egress buffer of the switch,
+ * per priority, from their enqueue to their dequeue. When the bytes of an
+ * ingress port and priority reach the XOFF threshold, the upstream device on
+ * that port must pause the priority; once they drain to the XON threshold, it
+ * can resume. Each transition is reported once to the pause handler.
+ *
+ * The counters grow with the ports seen, updating them is O(1).
+ */
+class P4PfcAccounting
+{
+  public:
+    static constexpr uint8_t NB_PRIORITIES = 8; //!< Priorities of PFC
+
+    //! Pauses (true) or resumes (false) a priority of the upstream device of a port
+    using PauseHandler = std::function<void(uint32_t port, uint8_t priority, bool pause)>;
+
+    /**
+     * @brief Construct the accounting
+     * @param xoffBytes bytes of a port and priority pausing the upstream device
+     * @param xonBytes bytes of a port and priority resuming it, below xoffBytes
+     * @param handler receives the pause and resume transitions
+     */
+    P4PfcAccounting(uint64_t xoffBytes, uint64_t xonBytes, PauseHandler handler)
+        : m_xoffBytes(xoffBytes),
+          m_xonBytes(xonBytes),
+          m_handler(std::move(handler))
+    {
+    }
+
+    /**
+     * @brief Count a packet entering the egress buffer
+     * @param port the ingress port of the packet
+     * @param priority the priority of the packet
+     * @param bytes the size of the packet
+     */
+    void OnEnqueue(uint32_t port, uint8_t priority, uint64_t bytes)
+    {
+        if (priority >= NB_PRIORITIES)
+        {
+            return;
+        }
+        if (port >= m_counters.size() / NB_PRIORITIES)
+        {
+            m_counters.resize((port + 1) * NB_PRIORITIES);
+        }
+        Counter& counter = m_counters[port * NB_PRIORITIES + priority];
+        counter.bytes += bytes;
+        if (!counter.paused && counter.bytes >= m_xoffBytes)
+        {
+            counter.paused = true;
+            m_handler(port, priority, true);
+        }
+    }
+
+    /**
+     * @brief Count a packet leaving the egress buffer
+     * @param port the ingress port of the packet
+     * @param priority the priority of the packet
+     * @param bytes the size of the packet, as counted by OnEnqueue()
+     */
+    void OnDequeue(uint32_t port, uint8_t priority, uint64_t bytes)
+    {
+        size_t idx = static_cast<size_t>(port) * NB_PRIORITIES + priority;
+        if (priority >= NB_PRIORITIES || idx >= m_counters.size())
+        {
+            return;
+        }
+        Counter& counter = m_counters[idx];
+        counter.bytes -= std::min(bytes, counter.bytes);
+        if (counter.paused && counter.bytes <= m_xonBytes)
+        {
+            counter.paused = false;
+            m_handler(port, priority, false);
+        }
+    }
+
+    /**
+     * @brief Get the bytes of an ingress port and priority in the egress buffer
+     * @param port the ingress port
+     * @param priority the priority
+     * @return the bytes
+     */
+    uint64_t GetBytes(uint32_t port, uint8_t priority) const
+    {
+        size_t idx = static_cast<size_t>(port) * NB_PRIORITIES + priority;
+        return priority < NB_PRIORITIES && idx < m_counters.size() ? m_counters[idx].bytes : 0;
+    }
+
+    /**
+     * @brief Check if the upstream device of a port is paused for a priority
+     * @param port the ingress port
+     * @param priority the priority
+     * @return true between the XOFF and the XON transitions
+     */
+    bool IsPaused(uint32_t port, uint8_t priority) const
+    {
+        size_t idx = static_cast<size_t>(port) * NB_PRIORITIES + priority;
+        return priority < NB_PRIORITIES && idx < m_counters.size() && m_counters[idx].paused;
+    }
+
+  private:
+    /**
+     * @brief Bytes and pause state of an ingress port and priority
+     */
+    struct Counter
+    {
+        uint64_t bytes{0};  //!< Bytes in the egress buffer
+        bool paused{false}; //!< XOFF sent, XON not sent yet
+    };
+
+    uint64_t m_xoffBytes;            //!< Pause threshold
+    uint64_t m_xonBytes;             //!< Resume threshold
+    PauseHandler m_handler;          //!< Receives the transitions
+    std::vector<Counter> m_counters; //!< Indexed by port * NB_PRIORITIES + priority
+};
+
+} // namespace ns3
+
+#endif /* P4_PFC_H */
@@ -0,0 +1,1068 @@
+/*
+ * Copyright (c) 2025 TU Dresden
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Authors: Mingyu Ma <mingyu.ma@tu-dresden.de>
+ */
+
+#include "ns3/p4-program-info.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <sstream>
+
+namespace ns3
+{
+
+namespace
+{
+
+/**
+ * @brief Minimal JSON document model, only what is needed to read a bmv2 JSON
+ */
+struct JsonValue
+{
+    enum Kind
+    {
+        NUL,
+        BOOLEAN,
+        NUMBER,
+        STRING,
+        ARRAY,
+        OBJECT
+    };
+
+    Kind kind{NUL};
+    bool boolean{false};
+    double number{0};
+    std::string str;
+    std::vector<JsonValue> array;
+    std::vector<std::pair<std::string, JsonValue>> object;
+
+    const JsonValue* Get(const std::string& key) const
+    {
+        if (kind != OBJECT)
+        {
+            return nullptr;
+        }
+        for (const auto& member : object)
+        {
+            if (member.first == key)
+            {
+                return &member.second;
+            }
+        }
+        return nullptr;
+    }
+
+    std::string GetString(const std::string& key) const
+    {
+        const JsonValue* v = Get(key);
+        return (v && v->kind == STRING) ? v->str : std::string();
+    }
+
+    double GetNumber(const std::string& key) const
+    {
+        const JsonValue* v = Get(key);
+        return (v && v->kind == NUMBER) ? v->number : 0;
+    }
+
+    bool GetBool(const std::string& key) const
+    {
+        const JsonValue* v = Get(key);
+        return v && v->kind == BOOLEAN && v->boolean;
+    }
+
+    const std::vector<JsonValue>& GetArray(const std::string& key) const
+    {
+        static const std::vector<JsonValue> empty;
+        const JsonValue* v = Get(key);
+        return (v && v->kind == ARRAY) ? v->array : empty;
+    }
+
+    JsonValue* GetMutable(const std::string& key)
+    {
+        return const_cast<JsonValue*>(Get(key));
+    }
+
+    void Set(const std::string& key, JsonValue value)
+    {
+        JsonValue* v = GetMutable(key);
+        if (v)
+        {
+            *v = std::move(value);
+        }
+        else
+        {
+            object.emplace_back(key, std::move(value));
+        }
+    }
+
+    static JsonValue MakeNumber(double value)
+    {
+        JsonValue v;
+        v.kind = NUMBER;
+        v.number = value;
+        return v;
+    }
+
+    static JsonValue MakeString(const std::string& value)
+    {
+        JsonValue v;
+        v.kind = STRING;
+        v.str = value;
+        return v;
+    }
+
+    static JsonValue MakeBool(bool value)
+    {
+        JsonValue v;
+        v.kind = BOOLEAN;
+        v.boolean = value;
+        return v;
+    }
+
+    static JsonValue MakeObject(std::vector<std::pair<std::string, JsonValue>> members)
+    {
+        JsonValue v;
+        v.kind = OBJECT;
+        v.object = std::move(members);
+        return v;
+    }
+
+    /**
+     * @brief Serialize the value, without spaces
+     */
+    void Write(std::string* out) const
+    {
+        switch (kind)
+        {
+        case NUL:
+            out->append("null");
+            break;
+        case BOOLEAN:
+            out->append(boolean ? "true" : "false");
+            break;
+        case NUMBER: {
+            char buf[32];
+            // bmv2 JSON numbers are integers (IDs, widths, sizes)
+            if (number == static_cast<double>(static_cast<long long>(number)))
+            {
+                snprintf(buf, sizeof(buf), "%lld", static_cast<long long>(number));
+            }
+            else
+            {
+                snprintf(buf, sizeof(buf), "%.17g", number);
+            }
+            out->append(buf);
+            break;
+        }
+        case STRING:
+            WriteString(str, out);
+            break;
+        case ARRAY:
+            out->push_back('[');
+            for (size_t i = 0; i < array.size(); i++)
+            {
+                if (i)
+                {
+                    out->push_back(',');
+                }
+                array[i].Write(out);
+            }
+            out->push_back(']');
+            break;
+        case OBJECT:
+            out->push_back('{');
+            for (size_t i = 0; i < object.size(); i++)
+            {
+                if (i)
+                {
+                    out->push_back(',');
+                }
+                WriteString(object[i].first, out);
+                out->push_back(':');
+                object[i].second.Write(out);
+            }
+            out->push_back('}');
+            break;
+        }
+    }
+
+    static void WriteString(const std::string& value, std::string* out)
+    {
+        out->push_back('"');
+        for (char c : value)
+        {
+            switch (c)
+            {
+            case '"':
+                out->append("\\\"");
+                break;
+            case '\\':
+                out->append("\\\\");
+                break;
+            case '\n':
+                out->append("\\n");
+                break;
+            case '\t':
+                out->append("\\t");
+                break;
+            case '\r':
+                out->append("\\r");
+                break;
+            default:
+                if (static_cast<unsigned char>(c) < 0x20)
+                {
+                    char buf[8];
+                    snprintf(buf, sizeof(buf), "\\u%04x", c);
+                    out->append(buf);
+                }
+                else
+                {
+                    out->push_back(c);
+                }
+            }
+        }
+        out->push_back('"');
+    }
+};
+
+/**
+ * @brief Recursive descent JSON parser
+ */
+class JsonParser
+{
+  public:
+    explicit JsonParser(const std::string& text)
+        : m_text(text),
+          m_pos(0)
+    {
+    }
+
+    bool Parse(JsonValue* root, std::string* error)
+    {
+        if (!ParseValue(root, 0))
+        {
+            *error = m_error + " (offset " + std::to_string(m_pos) + ")";
+            return false;
+        }
+        SkipSpaces();
+        if (m_pos != m_text.size())
+        {
+            *error = "trailing characters after JSON document (offset " + std::to_string(m_pos) +
+                     ")";
+            return false;
+        }
+        return true;
+    }
+
+  private:
+    static constexpr int MAX_DEPTH = 256;
+
+    void SkipSpaces()
+    {
+        while (m_pos < m_text.size() && (m_text[m_pos] == ' ' || m_text[m_pos] == '\t' ||
+                                         m_text[m_pos] == '\n' || m_text[m_pos] == '\r'))
+        {
+            m_pos++;
+        }
+    }
+
+    bool Fail(const std::string& msg)
+    {
+        m_error = msg;
+        return false;
+    }
+
+    bool Expect(const char* literal)
+    {
+        size_t len = std::char_traits<char>::length(literal);
+        if (m_text.compare(m_pos, len, literal) != 0)
+        {
+            return Fail(std::string("expected '") + literal + "'");
+        }
+        m_pos += len;
+        return true;
+    }
+
+    bool ParseValue(JsonValue* v, int depth)
+    {
+        if (depth > MAX_DEPTH)
+        {
+            return Fail("JSON document nested too deeply");
+        }
+        SkipSpaces();
+        if (m_pos >= m_text.size())
+        {
+            return Fail("unexpected end of JSON document");
+        }
+
+        char c = m_text[m_pos];
+        switch (c)
+        {
+        case '{':
+            return ParseObject(v, depth);
+        case '[':
+            return ParseArray(v, depth);
+        case '"':
+            v->kind = JsonValue::STRING;
+            return ParseString(&v->str);
+        case 't':
+            v->kind = JsonValue::BOOLEAN;
+            v->boolean = true;
+            return Expect("true");
+        case 'f':
+            v->kind = JsonValue::BOOLEAN;
+            v->boolean = false;
+            return Expect("false");
+        case 'n':
+            v->kind = JsonValue::NUL;
+            return Expect("null");
+        default:
+            return ParseNumber(v);
+        }
+    }
+
+    bool ParseObject(JsonValue* v, int depth)
+    {
+        v->kind = JsonValue::OBJECT;
+        m_pos++; // '{'
+        SkipSpaces();
+        if (m_pos < m_text.size() && m_text[m_pos] == '}')
+        {
+            m_pos++;
+            return true;
+        }
+        while (true)
+        {
+            SkipSpaces();
+            if (m_pos >= m_text.size() || m_text[m_pos] != '"')
+            {
+                return Fail("expected object key");
+            }
+            std::string key;
+            if (!ParseString(&key))
+            {
+                return false;
+            }
+            SkipSpaces();
+            if (m_pos >= m_text.size() || m_text[m_pos] != ':')
+            {
+                return Fail("expected ':' after object key");
+            }
+            m_pos++;
+            v->object.emplace_back(std::move(key), JsonValue());
+            if (!ParseValue(&v->object.back().second, depth + 1))
+            {
+                return false;
+            }
+            SkipSpaces();
+            if (m_pos < m_text.size() && m_text[m_pos] == ',')
+            {
+                m_pos++;
+                continue;
+            }
+            if (m_pos < m_text.size() && m_text[m_pos] == '}')
+            {
+                m_pos++;
+                return true;
+            }
+            return Fail("expected ',' or '}' in object");
+        }
+    }
+
+    bool ParseArray(JsonValue* v, int depth)
+    {
+        v->kind = JsonValue::ARRAY;
+        m_pos++; // '['
+        SkipSpaces();
+        if (m_pos < m_text.size() && m_text[m_pos] == ']')
+        {
+            m_pos++;
+            return true;
+        }
+        while (true)
+        {
+            v->array.emplace_back();
+            if (!ParseValue(&v->array.back(), depth + 1))
+            {
+                return false;
+            }
+            SkipSpaces();
+            if (m_pos < m_text.size() && m_text[m_pos] == ',')
+            {
+                m_pos++;
+                continue;
+            }
+            if (m_pos < m_text.size() && m_text[m_pos] == ']')
+            {
+                m_pos++;
+                return true;
+            }
+            return Fail("expected ',' or ']' in array");
+        }
+    }
+
+    bool ParseString(std::string* out)
+    {
+        m_pos++; // opening quote
+        while (m_pos < m_text.size())
+        {
+            char c = m_text[m_pos++];
+            if (c == '"')
+            {
+                return true;
+            }
+            if (c != '\\')
+            {
+                out->push_back(c);
+                continue;
+            }
+            if (m_pos >= m_text.size())
+            {
+                break;
+            }
+            char e = m_text[m_pos++];
+            switch (e)
+            {
+            case '"':
+            case '\\':
+            case '/':
+                out->push_back(e);
+                break;
+            case 'b':
+                out->push_back('\b');
+                break;
+            case 'f':
+                out->push_back('\f');
+                break;
+            case 'n':
+                out->push_back('\n');
+                break;
+            case 'r':
+                out->push_back('\r');
+                break;
+            case 't':
+                out->push_back('\t');
+                break;
+            case 'u': {
+                if (m_pos + 4 > m_text.size())
+                {
+                    return Fail("truncated unicode escape");
+                }
+                unsigned int cp = std::stoul(m_text.substr(m_pos, 4), nullptr, 16);
+                m_pos += 4;
+                // Names in bmv2 JSON files are plain ASCII, encode the rest as UTF-8
+                if (cp < 0x80)
+                {
+                    out->push_back(static_cast<char>(cp));
+                }
+                else if (cp < 0x800)
+                {
+                    out->push_back(static_cast<char>(0xc0 | (cp >> 6)));
+                    out->push_back(static_cast<char>(0x80 | (cp & 0x3f)));
+                }
+                else
+                {
+                    out->push_back(static_cast<char>(0xe0 | (cp >> 12)));
+                    out->push_back(static_cast<char>(0x80 | ((cp >> 6) & 0x3f)));
+                    out->push_back(static_cast<char>(0x80 | (cp & 0x3f)));
+                }
+                break;
+            }
+            default:
+                return Fail("invalid escape sequence in string");
+            }
+        }
+        return Fail("unterminated string");
+    }
+
+    bool ParseNumber(JsonValue* v)
+    {
+        size_t start = m_pos;
+        while (m_pos < m_text.size())
+        {
+            char c = m_text[m_pos];
+            if ((c >= '0' && c <= '9') || c == '-' || c == '+' || c == '.' || c == 'e' ||
+                c == 'E')
+            {
+                m_pos++;
+                continue;
+            }
+            break;
+        }
+        if (start == m_pos)
+        {
+            return Fail("unexpected character in JSON document");
+        }
+        v->kind = JsonValue::NUMBER;
+        try
+        {
+            v->number = std::stod(m_text.substr(start, m_pos - start));
+        }
+        catch (const std::exception&)
+        {
+            return Fail("invalid number");
+        }
+        return true;
+    }
+
+    const std::string& m_text;
+    size_t m_pos;
+    std::string m_error;
+};
+
+/**
+ * @brief Convert a bmv2 JSON match type string
+ */
+bool
+ToMatchType(const std::string& str, P4ProgramInfo::MatchType* type)
+{
+    if (str == "exact")
+    {
+        *type = P4ProgramInfo::MatchType::EXACT;
+    }
+    else if (str == "lpm")
+    {
+        *type = P4ProgramInfo::MatchType::LPM;
+    }
+    else if (str == "ternary")
+    {
+        *type = P4ProgramInfo::MatchType::TERNARY;
+    }
+    else if (str == "range")
+    {
+        *type = P4ProgramInfo::MatchType::RANGE;
+    }
+    else if (str == "valid")
+    {
+        *type = P4ProgramInfo::MatchType::VALID;
+    }
+    else if (str == "optional")
+    {
+        *type = P4ProgramInfo::MatchType::OPTIONAL;
+    }
+    else
+    {
+        return false;
+    }
+    return true;
+}
+
+} // namespace
+
+bool
+P4ProgramInfo::TableInfo::NeedsPriority() const
+{
+    for (const auto& field : key)
+    {
+        if (field.matchType == MatchType::TERNARY || field.matchType == MatchType::RANGE ||
+            field.matchType == MatchType::OPTIONAL)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+void
+P4ProgramInfo::NameIndex::Add(const std::string& fullName)
+{
+    // The full name always resolves to itself, even if it is also the suffix of
+    // another name.
+    m_aliases[fullName] = fullName;
+    m_ambiguous.erase(fullName);
+
+    size_t pos = fullName.find('.');
+    while (pos != std::string::npos)
+    {
+        std::string suffix = fullName.substr(pos + 1);
+        auto it = m_aliases.find(suffix);
+        if (it == m_aliases.end())
+        {
+            if (m_ambiguous.find(suffix) == m_ambiguous.end())
+            {
+                m_aliases[suffix] = fullName;
+            }
+        }
+        else if (it->second != fullName && it->first != it->second)
+        {
+            m_aliases.erase(it);
+            m_ambiguous[suffix] = true;
+        }
+        pos = fullName.find('.', pos + 1);
+    }
+}
+
+std::string
+P4ProgramInfo::NameIndex::Resolve(const std::string& name) const
+{
+    auto it = m_aliases.find(name);
+    return (it == m_aliases.end()) ? std::string() : it->second;
+}
+
+void
+P4ProgramInfo::NameIndex::Clear()
+{
+    m_aliases.clear();
+    m_ambiguous.clear();
+}
+
+template <typename T>
+const T*
+P4ProgramInfo::Lookup(const std::map<std::string, T>& objects,
+                      const NameIndex& index,
+                      const std::string& name)
+{
+    auto it = objects.find(index.Resolve(name));
+    return (it == objects.end()) ? nullptr : &it->second;
+}
+
+bool
+P4ProgramInfo::LoadFromFile(const std::string& jsonPath, std::string* error)
+{
+    std::ifstream fs(jsonPath, std::ios::in | std::ios::binary);
+    if (!fs)
+    {
+        *error = "cannot open JSON file " + jsonPath;
+        return false;
+    }
+    std::ostringstream content;
+    content << fs.rdbuf();
+    return LoadFromString(content.str(), error);
+}
+
+bool
+P4ProgramInfo::LoadFromString(const std::string& json, std::string* error)
+{
+    JsonValue root;
+    JsonParser parser(json);
+    if (!parser.Parse(&root, error))
+    {
+        return false;
+    }
+    if (root.kind != JsonValue::OBJECT)
+    {
+        *error = "top-level JSON value is not an object";
+        return false;
+    }
+
+    m_tables.clear();
+    m_actions.clear();
+    m_actionProfiles.clear();
+    m_registers.clear();
+    m_counters.clear();
+    m_meters.clear();
+    m_tableNames.Clear();
+    m_actionNames.Clear();
+    m_actionProfileNames.Clear();
+    m_registerNames.Clear();
+    m_counterNames.Clear();
+    m_meterNames.Clear();
+
+    // Field widths, indexed by header instance name and field name
+    std::unordered_map<std::string, std::unordered_map<std::string, unsigned int>> headerTypes;
+    for (const auto& ht : root.GetArray("header_types"))
+    {
+        auto& fields = headerTypes[ht.GetString("name")];
+        for (const auto& f : ht.GetArray("fields"))
+        {
+            // [name, bitwidth, signed], bitwidth is "*" for varbit fields
+            if (f.kind == JsonValue::ARRAY && f.array.size() >= 2 &&
+                f.array[0].kind == JsonValue::STRING && f.array[1].kind == JsonValue::NUMBER)
+            {
+                fields[f.array[0].str] = static_cast<unsigned int>(f.array[1].number);
+            }
+        }
+    }
+    std::unordered_map<std::string, std::string> headers;
+    for (const auto& h : root.GetArray("headers"))
+    {
+        headers[h.GetString("name")] = h.GetString("header_type");
+    }
+
+    auto fieldWidth = [&](const std::string& header, const std::string& field) -> int {
+        auto h = headers.find(header);
+        if (h == headers.end())
+        {
+            return -1;
+        }
+        auto ht = headerTypes.find(h->second);
+        if (ht == headerTypes.end())
+        {
+            return -1;
+        }
+        auto f = ht->second.find(field);
+        return (f == ht->second.end()) ? -1 : static_cast<int>(f->second);
+    };
+
+    for (const auto& a : root.GetArray("actions"))
+    {
+        std::string name = a.GetString("name");
+        if (m_actions.count(name))
+        {
+            continue; // same action instantiated in several controls
+        }
+        ActionInfo action;
+        action.name = name;
+        for (const auto& p : a.GetArray("runtime_data"))
+        {
+            action.paramNames.push_back(p.GetString("name"));
+            action.paramWidths.push_back(static_cast<unsigned int>(p.GetNumber("bitwidth")));
+        }
+        m_actions.emplace(name, std::move(action));
+        m_actionNames.Add(name);
+    }
+
+    for (const auto& pipeline : root.GetArray("pipelines"))
+    {
+        for (const auto& ap : pipeline.GetArray("action_profiles"))
+        {
+            ActionProfileInfo profile;
+            profile.name = ap.GetString("name");
+            profile.withSelection = ap.Get("selector") != nullptr;
+            m_actionProfileNames.Add(profile.name);
+            m_actionProfiles.emplace(profile.name, std::move(profile));
+        }
+
+        for (const auto& t : pipeline.GetArray("tables"))
+        {
+            TableInfo table;
+            table.name = t.GetString("name");
+            table.type = t.GetString("type");
+            table.actionProfile = t.GetString("action_profile");
+            table.pipeline = pipeline.GetString("name");
+            for (const auto& k : t.GetArray("key"))
+            {
+                KeyField field;
+                field.name = k.GetString("name");
+                if (!ToMatchType(k.GetString("match_type"), &field.matchType))
+                {
+                    *error = "unsupported match type '" + k.GetString("match_type") +
+                             "' in table " + table.name;
+                    return false;
+                }
+                const JsonValue* target = k.Get("target");
+                if (field.matchType == MatchType::VALID)
+                {
+                    field.bitwidth = 1;
+                }
+                else if (target && target->kind == JsonValue::ARRAY && target->array.size() == 2)
+                {
+                    int width = fieldWidth(target->array[0].str, target->array[1].str);
+                    if (width < 0)
+                    {
+                        *error = "unknown key field " + target->array[0].str + "." +
+                                 target->array[1].str + " in table " + table.name;
+                        return false;
+                    }
+                    field.bitwidth = static_cast<unsigned int>(width);
+                }
+                else
+                {
+                    *error = "unsupported key target in table " + table.name;
+                    return false;
+                }
+                if (field.name.empty())
+                {
+                    field.name = target && target->kind == JsonValue::ARRAY
+                                     ? target->array[0].str + "." + target->array[1].str
+                                     : std::string();
+                }
+                table.key.push_back(std::move(field));
+            }
+            for (const auto& a : t.GetArray("actions"))
+            {
+                if (a.kind == JsonValue::STRING)
+                {
+                    table.actions.push_back(a.str);
+                }
+            }
+            m_tableNames.Add(table.name);
+            m_tables.emplace(table.name, std::move(table));
+        }
+    }
+
+    for (const auto& r : root.GetArray("register_arrays"))
+    {
+        ExternInfo reg{r.GetString("name"),
+                       false,
+                       std::string(),
+                       static_cast<unsigned int>(r.GetNumber("bitwidth")),
+                       static_cast<size_t>(r.GetNumber("size"))};
+        m_registerNames.Add(reg.name);
+        m_registers.emplace(reg.name, std::move(reg));
+    }
+
+    for (const auto& c : root.GetArray("counter_arrays"))
+    {
+        ExternInfo counter{c.GetString("name"),
+                           c.GetBool("is_direct"),
+                           c.GetString("binding"),
+                           0,
+                           static_cast<size_t>(c.GetNumber("size"))};
+        m_counterNames.Add(counter.name);
+        m_counters.emplace(counter.name, std::move(counter));
+    }
+
+    for (const auto& m : root.GetArray("meter_arrays"))
+    {
+        ExternInfo meter{m.GetString("name"),
+                         m.GetBool("is_direct"),
+                         m.GetString("binding"),
+                         0,
+                         static_cast<size_t>(m.GetNumber("size"))};
+        m_meterNames.Add(meter.name);
+        m_meters.emplace(meter.name, std::move(meter));
+    }
+
+    return true;
+}
+
+const P4ProgramInfo::TableInfo*
+P4ProgramInfo::FindTable(const std::string& name) const
+{
+    return Lookup(m_tables, m_tableNames, name);
+}
+
+const P4ProgramInfo::ActionInfo*
+P4ProgramInfo::FindAction(const std::string& name) const
+{
+    return Lookup(m_actions, m_actionNames, name);
+}
+
+const P4ProgramInfo::ActionInfo*
+P4ProgramInfo::FindTableAction(const TableInfo& table, const std::string& name) const
+{
+    for (const auto& actionName : table.actions)
+    {
+        bool suffixMatch = actionName.size() > name.size() &&
+                           actionName.compare(actionName.size() - name.size(),
+                                              name.size(),
+                                              name) == 0 &&
+                           actionName[actionName.size() - name.size() - 1] == '.';
+        if (actionName == name || suffixMatch)
+        {
+            auto it = m_actions.find(actionName);
+            if (it != m_actions.end())
+            {
+                return &it->second;
+            }
+        }
+    }
+    return FindAction(name);
+}
+
+const P4ProgramInfo::ActionProfileInfo*
+P4ProgramInfo::FindActionProfile(const std::string& name) const
+{
+    return Lookup(m_actionProfiles, m_actionProfileNames, name);
+}
+
+const P4ProgramInfo::ExternInfo*
+P4ProgramInfo::FindRegister(const std::string& name) const
+{
+    return Lookup(m_registers, m_registerNames, name);
+}
+
+const P4ProgramInfo::ExternInfo*
+P4ProgramInfo::FindCounter(const std::string& name) const
+{
+    return Lookup(m_counters, m_counterNames, name);
+}
+
+const P4ProgramInfo::ExternInfo*
+P4ProgramInfo::FindMeter(const std::string& name) const
+{
+    return Lookup(m_meters, m_meterNames, name);
+}
+
+const std::map<std::string, P4ProgramInfo::TableInfo>&
+P4ProgramInfo::GetTables() const
+{
+    return m_tables;
+}
+
+const std::map<std::string, P4ProgramInfo::ExternInfo>&
+P4ProgramInfo::GetRegisters() const
+{
+    return m_registers;
+}
+
+const std::map<std::string, P4ProgramInfo::ExternInfo>&
+P4ProgramInfo::GetCounters() const
+{
+    return m_counters;
+}
+
+const std::map<std::string, P4ProgramInfo::ExternInfo>&
+P4ProgramInfo::GetMeters() const
+{
+    return m_meters;
+}
+
+const std::map<std::string, P4ProgramInfo::ActionProfileInfo>&
+P4ProgramInfo::GetActionProfiles() const
+{
+    return m_actionProfiles;
+}
+
+bool
+P4ProgramInfo::InstrumentTableStats(const std::string& json,
+                                    std::string* out,
+                                    std::vector<CountedAction>* counted,
+                                    std::string* error)
+{
+    JsonValue root;
+    JsonParser parser(json);
+    if (!parser.Parse(&root, error))
+    {
+        return false;
+    }
+    JsonValue* actions = root.GetMutable("actions");
+    JsonValue* pipelines = root.GetMutable("pipelines");
+    if (root.kind != JsonValue::OBJECT || !actions || actions->kind != JsonValue::ARRAY ||
+        !pipelines || pipelines->kind != JsonValue::ARRAY)
+    {
+        *error = "not a bmv2 JSON program";
+        return false;
+    }
+
+    std::unordered_map<int, size_t> actionIndex; // action ID to index in "actions"
+    int nextActionId = 0;
+    for (size_t i = 0; i < actions->array.size(); i++)
+    {
+        int id = static_cast<int>(actions->array[i].GetNumber("id"));
+        actionIndex[id] = i;
+        nextActionId = std::max(nextActionId, id + 1);
+    }
+
+    counted->clear();
+    for (auto& pipeline : pipelines->array)
+    {
+        JsonValue* tables = pipeline.GetMutable("tables");
+        if (!tables || tables->kind != JsonValue::ARRAY)
+        {
+            continue;
+        }
+        for (auto& table : tables->array)
+        {
+            // the actions of indirect tables are also bound to their action
+            // profile, they are left alone
+            JsonValue* actionIds = table.GetMutable("action_ids");
+            if (table.GetString("type") != "simple" || !actionIds ||
+                actionIds->kind != JsonValue::ARRAY)
+            {
+                continue;
+            }
+
+            // Each action of the table is replaced by a copy counting its
+            // executions in the slot of the (table, action) pair. The copy
+            // keeps the action name: the control plane resolves action names
+            // per table.
+            std::unordered_map<int, int> cloneOf;
+            for (auto& actionId : actionIds->array)
+            {
+                int id = static_cast<int>(actionId.number);
+                auto it = actionIndex.find(id);
+                if (it == actionIndex.end())
+                {
+                    *error = "table " + table.GetString("name") + " uses unknown action " +
+                             std::to_string(id);
+                    return false;
+                }
+                JsonValue clone = actions->array[it->second];
+                clone.Set("id", JsonValue::MakeNumber(nextActionId));
+
+                JsonValue countOp = JsonValue::MakeObject(
+                    {{"op", JsonValue::MakeString("count")}, {"parameters", JsonValue()}});
+                JsonValue* params = countOp.GetMutable("parameters");
+                params->kind = JsonValue::ARRAY;
+                params->array.push_back(
+                    JsonValue::MakeObject({{"type", JsonValue::MakeString("counter_array")},
+                                           {"value", JsonValue::MakeString(TABLE_STATS_COUNTER)}}));
+                char slot[24];
+                snprintf(slot, sizeof(slot), "0x%zx", counted->size());
+                params->array.push_back(
+                    JsonValue::MakeObject({{"type", JsonValue::MakeString("hexstr")},
+                                           {"value", JsonValue::MakeString(slot)}}));
+                JsonValue* primitives = clone.GetMutable("primitives");
+                if (!primitives || primitives->kind != JsonValue::ARRAY)
+                {
+                    clone.Set("primitives", JsonValue());
+                    primitives = clone.GetMutable("primitives");
+                    primitives->kind = JsonValue::ARRAY;
+                }
+                primitives->array.insert(primitives->array.begin(), std::move(countOp));
+
+                counted->push_back(CountedAction{table.GetString("name"), clone.GetString("name")});
+                cloneOf[id] = nextActionId;
+                actionId.number = nextActionId++;
+                actions->array.push_back(std::move(clone));
+            }
+
+            // the default entry and the const entries refer to the copies
+            auto remap = [&cloneOf](JsonValue* entry) {
+                JsonValue* id = entry ? entry->GetMutable("action_id") : nullptr;
+                if (id && id->kind == JsonValue::NUMBER &&
+                    cloneOf.count(static_cast<int>(id->number)))
+                {
+                    id->number = cloneOf[static_cast<int>(id->number)];
+                }
+            };
+            remap(table.GetMutable("default_entry"));
+            JsonValue* entries = table.GetMutable("entries");
+            if (entries && entries->kind == JsonValue::ARRAY)
+            {
+                for (auto& entry : entries->array)
+                {
+                    remap(entry.GetMutable("action_entry"));
+                }
+            }
+
+            // bmv2 counts the hits of the entries of tables with counters
+            table.Set("with_counters", JsonValue::MakeBool(true));
+        }
+    }
+
+    JsonValue* counters = root.GetMutable("counter_arrays");
+    if (!counters)
+    {
+        root.Set("counter_arrays", JsonValue());
+        counters = root.GetMutable("counter_arrays");
+        counters->kind = JsonValue::ARRAY;
+    }
+    int nextCounterId = 0;
+    for (const auto& counter : counters->array)
+    {
+        nextCounterId = std::max(nextCounterId, static_cast<int>(counter.GetNumber("id")) + 1);
+    }
+    size_t size = std::max<size_t>(counted->size(), 1);
+    counters->array.push_back(
+        JsonValue::MakeObject({{"name", JsonValue::MakeString(TABLE_STATS_COUNTER)},
+                               {"id", JsonValue::MakeNumber(nextCounterId)},
+                               {"is_direct", JsonValue::MakeBool(false)},
+                               {"size", JsonValue::MakeNumber(size)}}));
+
+    out->clear();
+    out->reserve(json.size() + json.size() / 4);
+    root.Write(out);
+    return true;
+}
+
+} // namespace ns3
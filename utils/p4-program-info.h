@@ -0,0 +1,308 @@
+/*
+ * Copyright (c) 2025 TU Dresden
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Authors: Mingyu Ma <mingyu.ma@tu-dresden.de>
+ */
+
+#ifndef P4_PROGRAM_INFO_H
+#define P4_PROGRAM_INFO_H
+
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace ns3
+{
+
+/**
+ * @brief Control plane view of a compiled bmv2 JSON program.
+ *
+ * The runtime CLI of bmv2 (runtime_CLI.py) reads the compiled JSON to learn
+ * the match types and bit widths of table keys and action parameters before it
+ * can encode a command line into runtime API calls. P4ProgramInfo extracts the
+ * same information in C++, so that flow table files can be applied to a switch
+ * without going through the Python CLI and the thrift server.
+ *
+ * Object names can be looked up either by their fully qualified name (e.g.
+ * "MyIngress.ipv4_lpm") or by any unambiguous dot-separated suffix (e.g.
+ * "ipv4_lpm"), following the behavior of the runtime CLI.
+ */
+class P4ProgramInfo
+{
+  public:
+    /**
+     * @brief Match kinds supported by the bmv2 match tables
+     */
+    enum class MatchType
+    {
+        EXACT,
+        LPM,
+        TERNARY,
+        RANGE,
+        VALID,
+        OPTIONAL
+    };
+
+    /**
+     * @brief One field of a table key
+     */
+    struct KeyField
+    {
+        std::string name;      //!< Name of the key field, e.g. "hdr.ipv4.dstAddr"
+        MatchType matchType;   //!< Match kind of this key field
+        unsigned int bitwidth; //!< Width of the key field in bits
+    };
+
+    /**
+     * @brief Match-action table description
+     */
+    struct TableInfo
+    {
+        std::string name;                 //!< Fully qualified table name
+        std::string type;                 //!< "simple", "indirect" or "indirect_ws"
+        std::string actionProfile;        //!< Action profile name for indirect tables
+        std::string pipeline;             //!< Control (bmv2 pipeline) applying the table
+        std::vector<KeyField> key;        //!< Key fields, in match key order
+        std::vector<std::string> actions; //!< Fully qualified action names
+
+        /**
+         * @brief Check whether entries of this table need a priority
+         * @return true if the key contains a ternary, range or optional field
+         */
+        bool NeedsPriority() const;
+    };
+
+    /**
+     * @brief Action description
+     */
+    struct ActionInfo
+    {
+        std::string name;                      //!< Fully qualified action name
+        std::vector<std::string> paramNames;   //!< Runtime parameter names
+        std::vector<unsigned int> paramWidths; //!< Runtime parameter widths in bits
+    };
+
+    /**
+     * @brief Stateful object (register, counter or meter array) description
+     */
+    struct ExternInfo
+    {
+        std::string name;      //!< Fully qualified name
+        bool isDirect;         //!< Direct counters and meters are bound to a table
+        std::string binding;   //!< Name of the bound table for direct objects
+        unsigned int bitwidth; //!< Cell width in bits (registers only)
+        size_t size;           //!< Number of cells
+    };
+
+    /**
+     * @brief Action profile description
+     */
+    struct ActionProfileInfo
+    {
+        std::string name;   //!< Fully qualified action profile name
+        bool withSelection; //!< True for action selectors
+    };
+
+    /**
+     * @brief A (table, action) pair counted by the table statistics
+     */
+    struct CountedAction
+    {
+        std::string table;  //!< Fully qualified table name
+        std::string action; //!< Fully qualified action name
+    };
+
+    //! Name of the counter array added by InstrumentTableStats
+    static constexpr const char* TABLE_STATS_COUNTER = "__p4sim_table_stats";
+
+    P4ProgramInfo() = default;
+
+    /**
+     * @brief Instrument a bmv2 JSON program to count its table lookups
+     *
+     * Every action of every simple (direct) table is replaced by a copy of
+     * the action that first counts its execution in the counter array
+     * TABLE_STATS_COUNTER, at the index of the (table, action) pair; one
+     * execution is one lookup of the table. The tables get per-entry
+     * counters, so that bmv2 counts their hits. The counting runs inside
+     * bmv2 with the "count" primitive, which the v1model switches provide.
+     *
+     * @param json the JSON text of the program
+     * @param out set to the JSON text of the instrumented program
+     * @param counted set to the counted (table, action) pairs, by counter index
+     * @param error set to a description of the problem on failure
+     * @return true on success
+     */
+    static bool InstrumentTableStats(const std::string& json,
+                                     std::string* out,
+                                     std::vector<CountedAction>* counted,
+                                     std::string* error);
+
+    /**
+     * @brief Build the program information from the content of a bmv2 JSON file
+     * @param json the JSON text
+     * @param error set to a description of the problem on failure
+     * @return true on success
+     */
+    bool LoadFromString(const std::string& json, std::string* error);
+
+    /**
+     * @brief Build the program information from a bmv2 JSON file
+     * @param jsonPath the path to the JSON file
+     * @param error set to a description of the problem on failure
+     * @return true on success
+     */
+    bool LoadFromFile(const std::string& jsonPath, std::string* error);
+
+    /**
+     * @brief Find a table by its full name or by an unambiguous suffix
+     * @param name the table name
+     * @return the table, or nullptr if not found
+     */
+    const TableInfo* FindTable(const std::string& name) const;
+
+    /**
+     * @brief Find an action by its full name or by an unambiguous suffix
+     * @param name the action name
+     * @return the action, or nullptr if not found
+     */
+    const ActionInfo* FindAction(const std::string& name) const;
+
+    /**
+     * @brief Find an action that can be used in the given table
+     *
+     * Several compiled actions can share the same short name (e.g. "drop"
+     * declared in different controls). The action is first looked up in the
+     * table's own action list before falling back to the global lookup.
+     *
+     * @param table the table
+     * @param name the action name
+     * @return the action, or nullptr if not found
+     */
+    const ActionInfo* FindTableAction(const TableInfo& table, const std::string& name) const;
+
+    /**
+     * @brief Find an action profile by its full name or by an unambiguous suffix
+     * @param name the action profile name
+     * @return the action profile, or nullptr if not found
+     */
+    const ActionProfileInfo* FindActionProfile(const std::string& name) const;
+
+    /**
+     * @brief Find a register array by its full name or by an unambiguous suffix
+     * @param name the register name
+     * @return the register, or nullptr if not found
+     */
+    const ExternInfo* FindRegister(const std::string& name) const;
+
+    /**
+     * @brief Find a counter array by its full name or by an unambiguous suffix
+     * @param name the counter name
+     * @return the counter, or nullptr if not found
+     */
+    const ExternInfo* FindCounter(const std::string& name) const;
+
+    /**
+     * @brief Find a meter array by its full name or by an unambiguous suffix
+     * @param name the meter name
+     * @return the meter, or nullptr if not found
+     */
+    const ExternInfo* FindMeter(const std::string& name) const;
+
+    /**
+     * @brief Get all the tables of the program
+     * @return the tables, keyed by their fully qualified name
+     */
+    const std::map<std::string, TableInfo>& GetTables() const;
+
+    /**
+     * @brief Get all the register arrays of the program
+     * @return the registers, keyed by their fully qualified name
+     */
+    const std::map<std::string, ExternInfo>& GetRegisters() const;
+
+    /**
+     * @brief Get all the counter arrays of the program
+     * @return the counters, keyed by their fully qualified name
+     */
+    const std::map<std::string, ExternInfo>& GetCounters() const;
+
+    /**
+     * @brief Get all the meter arrays of the program
+     * @return the meters, keyed by their fully qualified name
+     */
+    const std::map<std::string, ExternInfo>& GetMeters() const;
+
+    /**
+     * @brief Get all the action profiles of the program
+     * @return the action profiles, keyed by their fully qualified name
+     */
+    const std::map<std::string, ActionProfileInfo>& GetActionProfiles() const;
+
+  private:
+    /**
+     * @brief Name index with suffix aliases, same as in the runtime CLI
+     */
+    class NameIndex
+    {
+      public:
+        /**
+         * @brief Register a fully qualified name and all its suffixes
+         * @param fullName the fully qualified name
+         */
+        void Add(const std::string& fullName);
+
+        /**
+         * @brief Resolve a full name or an unambiguous suffix
+         * @param name the name to resolve
+         * @return the fully qualified name, or an empty string
+         */
+        std::string Resolve(const std::string& name) const;
+
+        /**
+         * @brief Remove all the names
+         */
+        void Clear();
+
+      private:
+        std::unordered_map<std::string, std::string> m_aliases; //!< Suffix to full name
+        std::unordered_map<std::string, bool> m_ambiguous;      //!< Suffixes used twice
+    };
+
+    template <typename T>
+    static const T* Lookup(const std::map<std::string, T>& objects,
+                           const NameIndex& index,
+                           const std::string& name);
+
+    std::map<std::string, TableInfo> m_tables;                 //!< Tables
+    std::map<std::string, ActionInfo> m_actions;               //!< Actions
+    std::map<std::string, ActionProfileInfo> m_actionProfiles; //!< Action profiles
+    std::map<std::string, ExternInfo> m_registers;             //!< Register arrays
+    std::map<std::string, ExternInfo> m_counters;              //!< Counter arrays
+    std::map<std::string, ExternInfo> m_meters;                //!< Meter arrays
+
+    NameIndex m_tableNames;         //!< Table aliases
+    NameIndex m_actionNames;        //!< Action aliases
+    NameIndex m_actionProfileNames; //!< Action profile aliases
+    NameIndex m_registerNames;      //!< Register aliases
+    NameIndex m_counterNames;       //!< Counter aliases
+    NameIndex m_meterNames;         //!< Meter aliases
+};
+
+} // namespace ns3
+
+#endif /* P4_PROGRAM_INFO_H */
@@ -18,25 +18,105 @@
 #ifndef P4_QUEUE_H
 #define P4_QUEUE_H
 
+#include "ns3/p4-aqm.h"
+#include "ns3/p4-histogram.h"
 #include "ns3/simulator.h"
 
+#include <algorithm>
 #include <bm/bm_sim/packet.h>
 #include <condition_variable>
+#include <functional>
 #include <map>
 #include <mutex>
 #include <queue>
+#include <stdexcept>
+#include <vector>
 
 namespace ns3
 {
 
+/**
+ * @brief Locking policy of the queues for the single-threaded ns-3 event loop.
+ *
+ * The lock, mutex and condition variable types do nothing, so the enqueue and
+ * dequeue paths carry no synchronization at all. Waiting on a condition is
+ * never needed: a queue that cannot accept or deliver a packet returns
+ * immediately (see CAN_BLOCK).
+ */
+struct QueueNoLockPolicy
+{
+    static constexpr bool CAN_BLOCK = false; //!< Producers never wait for free space
+
+    /**
+     * @brief Mutex doing nothing
+     */
+    struct Mutex
+    {
+    };
+
+    /**
+     * @brief Lock doing nothing
+     */
+    class Lock
+    {
+      public:
+        explicit Lock(Mutex&)
+        {
+        }
+
+        void unlock()
+        {
+        }
+    };
+
+    /**
+     * @brief Condition variable doing nothing
+     */
+    struct CondVar
+    {
+        void notify_one()
+        {
+        }
+
+        void wait(Lock&)
+        {
+        }
+
+        template <typename Predicate>
+        void wait(Lock&, Predicate)
+        {
+        }
+    };
+};
+
+/**
+ * @brief Thread-safe locking policy of the queues, as in bmv2.
+ *
+ * For a multi-threaded engine where producers and consumers run concurrently:
+ * every access takes the queue mutex, and a producer pushing a blocking packet
+ * into a full queue waits until a consumer frees some space.
+ */
+struct QueueMutexPolicy
+{
+    static constexpr bool CAN_BLOCK = true; //!< Producers may wait for free space
+
+    using Mutex = std::mutex;                //!< Mutex type
+    using Lock = std::unique_lock<Mutex>;    //!< Lock type
+    using CondVar = std::condition_variable; //!< Condition variable type
+};
+
 // Arbitrates which packets are processed by the ingress thread. Resubmit and
 // recirculate packets go to a high priority queue, while normal packets go to a
 // low priority queue. We assume that starvation is not going to be a problem.
 // Resubmit packets are dropped if the queue is full in order to make sure the
 // ingress thread cannot deadlock. We do the same for recirculate packets even
 // though the same argument does not apply for them. Enqueueing normal packets
-// is blocking (back pressure is applied to the interface).
-class InputBuffer
+// is blocking (back pressure is applied to the interface) with the thread-safe
+// QueueMutexPolicy. With QueueNoLockPolicy nothing can drain the queue while the
+// caller waits, so a full queue rejects normal packets as well (push_front()
+// returns 0 and leaves the packet to the caller).
+template <typename LockPolicy = QueueNoLockPolicy>
+class BasicInputBuffer
 {
   public:
     enum class PacketType
@@ -47,7 +127,7 @@ class InputBuffer
         SENTINEL // signal for the ingress thread to terminate
     };
 
-    InputBuffer(size_t capacity_hi, size_t capacity_lo)
+    BasicInputBuffer(size_t capacity_hi, size_t capacity_lo)
         : capacity_hi(capacity_hi),
           capacity_lo(capacity_lo)
     {
@@ -98,21 +178,29 @@ class InputBuffer
         return capacity_hi + capacity_lo;
     }
 
+    //! Number of packets waiting in both queues
+    size_t size() const
+    {
+        Lock lock(mutex);
+        return queue_hi.size() + queue_lo.size();
+    }
+
   private:
-    using Mutex = std::mutex;
-    using Lock = std::unique_lock<Mutex>;
+    using Mutex = typename LockPolicy::Mutex;
+    using Lock = typename LockPolicy::Lock;
+    using CondVar = typename LockPolicy::CondVar;
     using QueueImpl = std::deque<std::unique_ptr<bm::Packet>>;
 
     int push_front(QueueImpl* queue,
                    size_t capacity,
-                   std::condition_variable* cvar,
+                   CondVar* cvar,
                    std::unique_ptr<bm::Packet>&& item,
                    bool blocking)
     {
         Lock lock(mutex);
         while (queue->size() == capacity)
         {
-            if (!blocking)
+            if (!blocking || !LockPolicy::CAN_BLOCK)
                 return 0;
             cvar->wait(lock);
         }
@@ -122,16 +210,89 @@ class InputBuffer
         return 1;
     }
 
-    mutable std::mutex mutex;
-    mutable std::condition_variable cvar_can_push_hi;
-    mutable std::condition_variable cvar_can_push_lo;
-    mutable std::condition_variable cvar_can_pop;
+    mutable Mutex mutex;
+    mutable CondVar cvar_can_push_hi;
+    mutable CondVar cvar_can_push_lo;
+    mutable CondVar cvar_can_pop;
     size_t capacity_hi;
     size_t capacity_lo;
     QueueImpl queue_hi;
     QueueImpl queue_lo;
 };
 
+//! Input buffer of the switches driven by the ns-3 event loop
+using InputBuffer = BasicInputBuffer<>;
+
+/**
+ * @brief Fixed-capacity FIFO in front of a pipeline, counting its drops.
+ *
+ * The ring never grows: an item arriving while the ring is full is refused
+ * (push_back() returns false and leaves the item to the caller) and counted as
+ * a drop. Driven by the single-threaded ns-3 event loop, it takes no lock.
+ */
+template <typename T>
+class BoundedRing
+{
+  public:
+    explicit BoundedRing(size_t capacity)
+        : slots(capacity),
+          head(0),
+          count(0),
+          drops(0)
+    {
+    }
+
+    bool push_back(T&& item)
+    {
+        if (count == slots.size())
+        {
+            drops++;
+            return false;
+        }
+        slots[(head + count) % slots.size()] = std::move(item);
+        count++;
+        return true;
+    }
+
+    bool pop_front(T* pItem)
+    {
+        if (count == 0)
+            return false;
+        *pItem = std::move(slots[head]);
+        slots[head] = T();
+        head = (head + 1) % slots.size();
+        count--;
+        return true;
+    }
+
+    bool empty() const
+    {
+        return count == 0;
+    }
+
+    size_t size() const
+    {
+        return count;
+    }
+
+    size_t capacity() const
+    {
+        return slots.size();
+    }
+
+    //! Number of items refused because the ring was full
+    uint64_t get_drops() const
+    {
+        return drops;
+    }
+
+  private:
+    std::vector<T> slots;
+    size_t head;
+    size_t count;
+    uint64_t drops;
+};
+
 /**
  * @brief This code is taken from
  * https://github.com/p4lang/behavioral-model/blob/main/include/bm/bm_sim/queueing.h#L489
@@ -153,18 +314,72 @@ class InputBuffer
  * Look at the documentation for QueueingLogic for more information about the
  * template parameters (they are the same).
  *
+ * The queue is driven by the single-threaded ns-3 event loop, so by default it
+ * takes no lock (QueueNoLockPolicy). QueueMutexPolicy restores the bmv2
+ * locking for a multi-threaded engine.
+ *
+ * Unlike bmv2, the state is stored as dense arrays indexed by
+ * `queue_id * nb_priorities + priority`, sized at construction from the number
+ * of logical queues (the egress ports of the switch): the counters, capacities
+ * and rates of all the priority queues are contiguous, and each priority queue
+ * keeps its elements in a contiguous ring. The send times of the elements of
+ * one priority queue never decrease, so a FIFO ring serves them in the same
+ * order as the bmv2 heap. A logical queue id beyond the initial number of
+ * queues grows the arrays, as bmv2 creates its queues on first use.
+ *
+ * On top of the priority queue rates, each logical queue (egress port) can have
+ * a line rate (set_port_rate()): the port transmits at most one element every
+ * 1 / rate, whatever the priority, and the ports are served independently of
+ * each other.
+ *
+ * The rates can be given in bits per second instead (set_rate_bps(),
+ * set_port_rate_bps()): the gap after an element is then the time to transmit
+ * its size, as passed to push_front(). A queue or port has one rate, the last
+ * one set, in packets or in bits per second. Besides its capacity in elements,
+ * each priority queue can have a capacity in bytes (set_byte_capacity()); an
+ * element is rejected if either is exceeded.
+ *
+ * Instead of private buffers, the priority queues can share one pool of bytes
+ * (set_shared_buffer()). Each priority queue is guaranteed a reserve of bytes;
+ * beyond it, it takes bytes from the shared pool as long as its share stays
+ * below alpha times the free bytes of the pool (dynamic threshold, as in
+ * Choudhury and Hahne): a queue can take most of an idle buffer, and the
+ * threshold shrinks as the other queues fill it. The pool occupancy is kept
+ * up to date at enqueue and dequeue, the admission check costs O(1). The
+ * capacities of the priority queues still apply on top of the pool.
+ *
+ * Each priority queue can run an AQM policy (set_aqm(), see P4Aqm) on the
+ * arriving elements, after the capacity checks. The elements the AQM marks
+ * are handed to the ECN marker (set_ecn_marker()); those it cannot mark are
+ * dropped.
+ *
+ * A priority queue can be paused (set_paused()), e.g. by a PFC pause frame from
+ * the downstream device: it keeps its elements and accepts new ones, but is
+ * not served until it is resumed.
+ *
+ * Each priority keeps a bitmap of its non-empty queues: the dequeue and the
+ * next send time only visit the queues holding elements, not every port.
+ *
+ * Optionally (enable_histograms()), each priority queue keeps a P4Histogram of
+ * its occupancy seen by the arriving elements and one of the sojourn time of
+ * the served elements, from their enqueue to their dequeue, in nanoseconds.
+ *
  * @tparam T
  * @tparam FMap
+ * @tparam LockPolicy QueueNoLockPolicy or QueueMutexPolicy
  */
-template <typename T, typename FMap>
+template <typename T, typename FMap, typename LockPolicy = QueueNoLockPolicy>
 class NSQueueingLogicPriRL
 {
-    using MutexType = std::mutex;
-    using LockType = std::unique_lock<MutexType>;
+    using MutexType = typename LockPolicy::Mutex;
+    using LockType = typename LockPolicy::Lock;
 
   public:
+    //! Sets ECN CE in an element, returns false if it is not ECN capable
+    using EcnMarker = std::function<bool(T& item)>;
+
     /**
-     * @brief Construct a new NSQueueingLogicPriRL object\
+     * @brief Construct a new NSQueueingLogicPriRL object
      *
      * See QueueingLogic::QueueingLogicRL() for an introduction. The difference
      * here is that each logical queue can receive several priority queues (as
@@ -177,51 +392,44 @@ class NSQueueingLogicPriRL
      * @param capacity
      * @param map_to_worker
      * @param nb_priorities
+     * @param nb_queues number of logical queues allocated upfront, usually the
+     * number of egress ports
      */
     NSQueueingLogicPriRL(size_t nb_workers,
                          size_t capacity,
                          FMap map_to_worker,
-                         size_t nb_priorities = 2)
+                         size_t nb_priorities = 2,
+                         size_t nb_queues = 0)
         : nb_workers(nb_workers),
           capacity(capacity),
-          workers_info(nb_workers),
           map_to_worker(std::move(map_to_worker)),
-          nb_priorities(nb_priorities)
+          nb_priorities(nb_priorities),
+          workers_size(nb_workers, 0),
+          workers_counter(nb_workers, 0),
+          workers_not_empty(nb_workers)
     {
+        grow(nb_queues);
     }
 
     /**
      * @brief Place the packet in the front of corresponding priority queue.
      * If priority queue \p priority of logical queue \p queue_id is full, the
      * function will return `0` immediately. Otherwise, \p item will be copied to
-     * the queue and the function will return `1`. If \p queue_id or \p priority
-     * are incorrect, an exception of type std::out_of_range will be thrown (same
-     * if the FMap object provided to the constructor does not behave correctly).
+     * the queue and the function will return `1`. If \p priority is incorrect,
+     * an exception of type std::out_of_range will be thrown.
      *
      * @param queue_id each egress port will have a queue_id
      * @param priority the priroity of the packet in one queue
      * @param item the packet or things to be placed in the queue
      * @return int
      */
-    int push_front(size_t queue_id, size_t priority, const T& item)
+    int push_front(size_t queue_id,
+                   size_t priority,
+                   const T& item,
+                   size_t bytes = 0,
+                   P4Aqm::Verdict* verdict = nullptr)
     {
-        size_t worker_id = map_to_worker(queue_id);
-        LockType lock(mutex);
-        auto& q_info = get_queue(queue_id);
-        auto& w_info = workers_info.at(worker_id);
-        auto& q_info_pri = q_info.at(priority);
-        if (q_info_pri.size >= q_info_pri.capacity)
-            return 0;
-        q_info_pri.last_sent = get_next_tp(q_info_pri);
-        w_info.queues[priority].emplace(item,
-                                        queue_id,
-                                        q_info_pri.last_sent,
-                                        w_info.wrapping_counter++);
-        q_info_pri.size++;
-        q_info.size++;
-        w_info.size++;
-        w_info.q_not_empty.notify_one();
-        return 1;
+        return push_front(queue_id, priority, T(item), bytes, verdict);
     }
 
     int push_front(size_t queue_id, const T& item)
@@ -230,25 +438,63 @@ class NSQueueingLogicPriRL
     }
 
     //! Same as push_front(size_t queue_id, size_t priority, const T &item), but
-    //! \p item is moved instead of copied.
-    int push_front(size_t queue_id, size_t priority, T&& item)
+    //! \p item is moved instead of copied. \p bytes is the size of the
+    //! element, used by the byte capacities and the bit rates. \p verdict, if
+    //! given, is set to the decision of the AQM: P4Aqm::DROP if it rejected the
+    //! element, P4Aqm::MARK if it marked it.
+    int push_front(size_t queue_id,
+                   size_t priority,
+                   T&& item,
+                   size_t bytes = 0,
+                   P4Aqm::Verdict* verdict = nullptr)
     {
         size_t worker_id = map_to_worker(queue_id);
         LockType lock(mutex);
-        auto& q_info = get_queue(queue_id);
-        auto& w_info = workers_info.at(worker_id);
-        auto& q_info_pri = q_info.at(priority);
-        if (q_info_pri.size >= q_info_pri.capacity)
+        size_t idx = get_index(queue_id, priority);
+        if (verdict)
+            *verdict = P4Aqm::PASS;
+        if (histograms_enabled)
+            depth_hist[idx].Record(pri_size[idx]);
+        if (pri_size[idx] >= pri_capacity[idx])
+            return 0;
+        if (pri_byte_capacity[idx] != 0 && pri_bytes[idx] + bytes > pri_byte_capacity[idx])
             return 0;
-        q_info_pri.last_sent = get_next_tp(q_info_pri);
-        w_info.queues[priority].emplace(std::move(item),
-                                        queue_id,
-                                        q_info_pri.last_sent,
-                                        w_info.wrapping_counter++);
-        q_info_pri.size++;
-        q_info.size++;
-        w_info.size++;
-        w_info.q_not_empty.notify_one();
+        size_t shared = shared_bytes(idx, pri_bytes[idx] + bytes) - shared_bytes(idx);
+        if (shared_total != 0 && shared != 0 && !shared_admit(idx, shared))
+            return 0;
+        if (aqm_enabled && pri_aqm[idx].IsEnabled())
+        {
+            P4Aqm& aqm = pri_aqm[idx];
+            P4Aqm::Verdict v = aqm.OnEnqueue(pri_size[idx], pri_bytes[idx], Simulator::Now());
+            // an element which is not ECN capable is dropped instead
+            if (v == P4Aqm::MARK && !(ecn_marker && ecn_marker(item)))
+                v = P4Aqm::DROP;
+            if (verdict)
+                *verdict = v;
+            if (v == P4Aqm::DROP)
+            {
+                aqm.CountDrop();
+                return 0;
+            }
+            if (v == P4Aqm::MARK)
+                aqm.CountMark();
+        }
+        pri_last_sent[idx] = get_next_tp(idx);
+        pri_last_bytes[idx] = bytes;
+        rings[idx].push_back(QE(std::move(item),
+                                queue_id,
+                                bytes,
+                                Simulator::Now(),
+                                pri_last_sent[idx],
+                                workers_counter[worker_id]++));
+        if (pri_size[idx]++ == 0)
+            active[priority][queue_id / 64] |= uint64_t(1) << (queue_id % 64);
+        pri_bytes[idx] += bytes;
+        shared_used += shared;
+        queue_size[queue_id]++;
+        queue_bytes[queue_id] += bytes;
+        workers_size[worker_id]++;
+        workers_not_empty[worker_id].notify_one();
         return 1;
     }
 
@@ -258,10 +504,7 @@ class NSQueueingLogicPriRL
     }
 
     /**
-     * @brief The exit end of the priority queue is prioritized. (itself bmv2 code
-     * through the lock mechanism, but ns-3 does not have a built-in locking
-     * mechanism ns3 in the replacement for the polling mechanism, so there will
-     * be some loss in performance)
+     * @brief The exit end of the priority queue is prioritized.
      *
      * [from bmv2]
      * Retrieves an element for the worker thread indentified by \p worker_id and
@@ -271,10 +514,11 @@ class NSQueueingLogicPriRL
      * Elements are retrieved according to the priority queue they are in
      * (highest priorities, i.e. lowest priority values, are served first). Once
      * a given priority queue reaches its maximum rate, the next queue is served.
-     * If no elements are available (either the queues are empty or they have
-     * exceeded their rate already), the function will block.
+     * In ns-3 the function does not block: if no element is available (either
+     * the queues are empty or they have exceeded their rate already), \p pItem
+     * is left untouched.
      *
-     * @ todo remove the lock mechanism, also the loops in the function
+     * With the default QueueNoLockPolicy no lock is taken.
      *
      * @param worker_id
      * @param queue_id
@@ -284,93 +528,97 @@ class NSQueueingLogicPriRL
     void pop_back(size_t worker_id, size_t* queue_id, size_t* priority, T* pItem)
     {
         LockType lock(mutex);
-        auto& w_info = workers_info.at(worker_id);
-        MyQ* queue = nullptr;
-        size_t pri;
-        while (true)
-        {
-            if (w_info.size == 0)
-            {
-                // waiting for add queue item
-                // w_info.q_not_empty.wait (lock);
-                return;
-            }
-            else
-            {
-                Time now = Simulator::Now();
-                Time next = now + Seconds(5);
+        pop_eligible(worker_id, queue_id, priority, pItem);
+    }
 
-                // auto now_real = std::chrono::steady_clock::now ();
-                // auto next_real = now_real + std::chrono::nanoseconds (next.GetNanoSeconds ());
-                // auto now = clock::now ();
-                // auto next = clock::time_point::max ();
+    /**
+     * @brief An element retrieved by pop_back_batch()
+     */
+    struct PoppedItem
+    {
+        size_t queue_id; //!< Logical queue which contained the element
+        size_t priority; //!< Priority queue which contained the element
+        T item;          //!< The element
+    };
 
-                // This will iterate from nb_priorities-1 to 0
-                for (pri = nb_priorities; pri-- > 0;)
-                {
-                    auto& q = w_info.queues[pri];
-                    if (q.size() == 0)
-                        continue;
-                    if (q.top().send <= now)
-                    {
-                        queue = &q;
-                        break;
-                    }
-                    next = std::min(next, q.top().send);
-                    // next_real = now_real + std::chrono::nanoseconds (next.GetNanoSeconds ());
-                }
-                if (queue)
-                    break;
-                return;
-                // if (w_info.q_not_empty.wait_until (lock, next_real) == std::cv_status::timeout)
-                //   {
-                //     // Time Out in 5s
-                //     *pItem = nullptr;
-                //     return;
-                //   }
-            }
+    /**
+     * @brief Retrieve all the elements eligible at Simulator::Now() for the
+     * worker \p worker_id, up to \p max_items.
+     *
+     * The elements are appended to \p items in the order successive calls to
+     * pop_back() would return them (priority, then send time), with a single
+     * lock acquisition.
+     *
+     * @param worker_id
+     * @param max_items maximum number of elements to retrieve
+     * @param items the retrieved elements are appended to this vector
+     * @return size_t the number of retrieved elements
+     */
+    size_t pop_back_batch(size_t worker_id, size_t max_items, std::vector<PoppedItem>* items)
+    {
+        LockType lock(mutex);
+        size_t count = 0;
+        while (count < max_items)
+        {
+            size_t queue_id;
+            size_t priority;
+            T item{};
+            if (!pop_eligible(worker_id, &queue_id, &priority, &item))
+                break;
+            items->push_back(PoppedItem{queue_id, priority, std::move(item)});
+            count++;
         }
-        *queue_id = queue->top().queue_id;
-        *priority = pri;
-        // TODO(antonin): improve / document this
-        // http://stackoverflow.com/questions/20149471/move-out-element-of-std-priority-queue-in-c11
-        *pItem = std::move(const_cast<QE&>(queue->top()).e);
-        queue->pop();
-        auto& q_info = get_queue_or_throw(*queue_id);
-        auto& q_info_pri = q_info.at(*priority);
-        q_info_pri.size--;
-        q_info.size--;
-        w_info.size--;
+        return count;
     }
 
     Time get_this_pkt_delay(const size_t queue_id, const size_t priority)
     {
-        auto& q_info = get_queue(queue_id);
-        auto& q_info_pri = q_info.at(priority);
-        // Time now = Simulator::Now ();
-        return q_info_pri.pkt_delay_time;
+        return pri_delay[get_index(queue_id, priority)];
     }
 
-    Time get_next_tp_all_ports()
+    /**
+     * @brief Get the time the next packet becomes eligible for pop_back(),
+     * over all the logical queues and priorities.
+     *
+     * The egress side of the switch schedules its next dequeue event at
+     * this time instead of polling the queues.
+     *
+     * A packet is eligible once its priority queue rate and the line rate of
+     * its port allow it, and its priority queue is not paused.
+     *
+     * @return Time the send time of the first eligible packet (at most
+     * Simulator::Now() if a packet can be sent already), or Time::Max() if
+     * the queues are empty or all the non-empty queues are paused
+     */
+    Time get_next_tp_all_ports() const
     {
+        LockType lock(mutex);
         Time now = Simulator::Now();
-        Time next = now + Seconds(5);
+        Time next = Time::Max();
 
         // This will iterate from nb_priorities-1 to 0
-        for (auto it = workers_info.begin(); it != workers_info.end(); it++)
+        for (size_t pri = nb_priorities; pri-- > 0;)
         {
-            auto& w_info = it->second;
-            for (size_t pri = nb_priorities; pri-- > 0;)
-            {
-                auto& q = w_info.queues[pri];
-                if (q.size() == 0)
-                    continue;
-                if (q.top().send <= now)
+            bool found = false;
+            Time first;
+            for_each_active(pri, [&](size_t q) {
+                size_t idx = q * nb_priorities + pri;
+                if (nb_paused != 0 && pri_paused[idx])
+                    return;
+                Time send = std::max(rings[idx].front().send, port_next_free[q]);
+                if (!found || send < first)
                 {
-                    return q.top().send;
+                    first = send;
+                    found = true;
                 }
-                next = std::min(next, q.top().send);
+            });
+            if (!found)
+                continue;
+            if (first <= now)
+            {
+                return first;
             }
+            next = std::min(next, first);
         }
         return next;
     }
@@ -391,6 +639,22 @@ class NSQueueingLogicPriRL
         return pop_back(worker_id, queue_id, &priority, pItem);
     }
 
+    /**
+     * @brief Check if all the logical queues are empty
+     *
+     * @return true if no packet is queued
+     */
+    bool empty() const
+    {
+        LockType lock(mutex);
+        for (size_t size : workers_size)
+        {
+            if (size > 0)
+                return false;
+        }
+        return true;
+    }
+
     /**
      * @brief  QueueingLogic::size
      * @copydoc QueueingLogic::size
@@ -402,11 +666,9 @@ class NSQueueingLogicPriRL
     size_t size(size_t queue_id) const
     {
         LockType lock(mutex);
-        auto it = queues_info.find(queue_id);
-        if (it == queues_info.end())
+        if (queue_id >= queue_size.size())
             return 0;
-        auto& q_info = it->second;
-        return q_info.size;
+        return queue_size[queue_id];
     }
 
     /**
@@ -421,12 +683,55 @@ class NSQueueingLogicPriRL
     size_t size(size_t queue_id, size_t priority) const
     {
         LockType lock(mutex);
-        auto it = queues_info.find(queue_id);
-        if (it == queues_info.end())
+        if (queue_id >= queue_size.size())
             return 0;
-        auto& q_info = it->second;
-        auto& q_info_pri = q_info.at(priority);
-        return q_info_pri.size;
+        if (priority >= nb_priorities)
+            throw std::out_of_range("priority out of range");
+        return pri_size[queue_id * nb_priorities + priority];
+    }
+
+    /**
+     * @brief Get the bytes queued in all the priority queues of logical
+     * queue \p queue_id.
+     *
+     * @param queue_id the id of logical queue in each egress port
+     * @return size_t
+     */
+    size_t bytes(size_t queue_id) const
+    {
+        LockType lock(mutex);
+        if (queue_id >= queue_size.size())
+            return 0;
+        return queue_bytes[queue_id];
+    }
+
+    /**
+     * @brief Get the bytes queued in priority queue \p priority of logical
+     * queue \p queue_id.
+     *
+     * @param queue_id the id of logical queue in each egress port
+     * @param priority the priority queue
+     * @return size_t
+     */
+    size_t bytes(size_t queue_id, size_t priority) const
+    {
+        LockType lock(mutex);
+        if (queue_id >= queue_size.size())
+            return 0;
+        if (priority >= nb_priorities)
+            throw std::out_of_range("priority out of range");
+        return pri_bytes[queue_id * nb_priorities + priority];
+    }
+
+    /**
+     * @brief Get the number of logical queues currently allocated
+     *
+     * @return size_t
+     */
+    size_t nb_queues() const
+    {
+        LockType lock(mutex);
+        return queue_size.size();
     }
 
     /**
@@ -439,7 +744,8 @@ class NSQueueingLogicPriRL
     void set_capacity(size_t queue_id, size_t c)
     {
         LockType lock(mutex);
-        for_each_q(queue_id, SetCapacityFn(c));
+        size_t first = get_index(queue_id, 0);
+        std::fill_n(pri_capacity.begin() + first, nb_priorities, c);
     }
 
     /**
@@ -453,7 +759,7 @@ class NSQueueingLogicPriRL
     void set_capacity(size_t queue_id, size_t priority, size_t c)
     {
         LockType lock(mutex);
-        for_one_q(queue_id, priority, SetCapacityFn(c));
+        pri_capacity[get_index(queue_id, priority)] = c;
     }
 
     /**
@@ -465,16 +771,130 @@ class NSQueueingLogicPriRL
     void set_capacity_for_all(size_t c)
     {
         LockType lock(mutex);
-        for (auto& p : queues_info)
-            for_each_q(p.first, SetCapacityFn(c));
+        std::fill(pri_capacity.begin(), pri_capacity.end(), c);
         capacity = c;
     }
 
-    //! Set the maximum rate of all the priority queues for logical queue \p
-    //! queue_id to \p pps. \p pps is expressed in "number of elements per
-    //! second". Until this function is called, there will be no rate limit for
-    //! the queue. The same behavior (no rate limit) can be achieved by calling
-    //! this method with a rate of 0.
+    /**
+     * @brief Set the capacity in bytes of all the priority queues for logical
+     * queue \p queue_id to \p c bytes, 0 for no byte limit (the default).
+     *
+     * @param queue_id the id of logical queue in each egress port
+     * @param c bytes in one priority queue
+     */
+    void set_byte_capacity(size_t queue_id, size_t c)
+    {
+        LockType lock(mutex);
+        size_t first = get_index(queue_id, 0);
+        std::fill_n(pri_byte_capacity.begin() + first, nb_priorities, c);
+    }
+
+    /**
+     * @brief Set the capacity in bytes of priority queue \p priority for
+     * logical queue \p queue_id to \p c bytes, 0 for no byte limit.
+     *
+     * @param queue_id the id of logical queue in each egress port
+     * @param priority the \p priority number of one logical queue
+     * @param c bytes in the priority queue
+     */
+    void set_byte_capacity(size_t queue_id, size_t priority, size_t c)
+    {
+        LockType lock(mutex);
+        pri_byte_capacity[get_index(queue_id, priority)] = c;
+    }
+
+    /**
+     * @brief Set the capacity in bytes of all the priority queues of all
+     * logical queues to \p c bytes, 0 for no byte limit.
+     *
+     * @param c bytes in one priority queue
+     */
+    void set_byte_capacity_for_all(size_t c)
+    {
+        LockType lock(mutex);
+        std::fill(pri_byte_capacity.begin(), pri_byte_capacity.end(), c);
+        byte_capacity = c;
+    }
+
+    /**
+     * @brief Make all the priority queues share a buffer of \p total_bytes
+     * bytes, with dynamic thresholds. Each priority queue, current or
+     * allocated later, is guaranteed \p reserve_bytes bytes and may take from
+     * the rest of the buffer up to \p alpha times its free bytes. A
+     * \p total_bytes of 0 (the default) disables the shared buffer.
+     *
+     * @param total_bytes size of the buffer, reserves included
+     * @param reserve_bytes bytes guaranteed to each priority queue
+     * @param alpha dynamic threshold factor, usually a power of two
+     */
+    void set_shared_buffer(size_t total_bytes, size_t reserve_bytes, double alpha)
+    {
+        LockType lock(mutex);
+        shared_total = total_bytes;
+        shared_reserve = reserve_bytes;
+        shared_alpha = alpha;
+        std::fill(pri_reserve.begin(), pri_reserve.end(), reserve_bytes);
+        std::fill(pri_alpha.begin(), pri_alpha.end(), alpha);
+        update_shared_used();
+    }
+
+    /**
+     * @brief Set the bytes of the shared buffer guaranteed to priority queue
+     * \p priority of logical queue \p queue_id.
+     *
+     * @param queue_id the id of logical queue in each egress port
+     * @param priority the \p priority number of one logical queue
+     * @param reserve_bytes bytes guaranteed to the priority queue
+     */
+    void set_shared_buffer_reserve(size_t queue_id, size_t priority, size_t reserve_bytes)
+    {
+        LockType lock(mutex);
+        pri_reserve[get_index(queue_id, priority)] = reserve_bytes;
+        update_shared_used();
+    }
+
+    /**
+     * @brief Set the dynamic threshold factor of priority queue \p priority
+     * of logical queue \p queue_id in the shared buffer.
+     *
+     * @param queue_id the id of logical queue in each egress port
+     * @param priority the \p priority number of one logical queue
+     * @param alpha dynamic threshold factor
+     */
+    void set_shared_buffer_alpha(size_t queue_id, size_t priority, double alpha)
+    {
+        LockType lock(mutex);
+        pri_alpha[get_index(queue_id, priority)] = alpha;
+    }
+
+    /**
+     * @brief Get the bytes of the shared buffer used beyond the reserves of
+     * the priority queues.
+     *
+     * @return size_t 0 if the shared buffer is disabled
+     */
+    size_t shared_buffer_used() const
+    {
+        LockType lock(mutex);
+        return shared_total != 0 ? shared_used : 0;
+    }
+
+    /**
+     * @brief Get the bytes priority queue \p priority of logical queue
+     * \p queue_id may currently hold beyond its reserve in the shared buffer.
+     *
+     * @param queue_id the id of logical queue in each egress port
+     * @param priority the priority queue
+     * @return size_t 0 if the shared buffer is disabled
+     */
+    size_t shared_buffer_threshold(size_t queue_id, size_t priority) const
+    {
+        LockType lock(mutex);
+        if (shared_total == 0 || queue_id >= queue_size.size() || priority >= nb_priorities)
+            return 0;
+        return static_cast<size_t>(pri_alpha[queue_id * nb_priorities + priority] *
+                                   (shared_pool() - shared_used));
+    }
 
     /**
      * @brief Set the rate of processing packets
@@ -490,7 +910,9 @@ class NSQueueingLogicPriRL
     void set_rate(size_t queue_id, uint64_t pps)
     {
         LockType lock(mutex);
-        for_each_q(queue_id, SetRateFn(pps));
+        size_t first = get_index(queue_id, 0);
+        for (size_t idx = first; idx < first + nb_priorities; idx++)
+            set_rate_at(idx, pps);
     }
 
     /**
@@ -504,7 +926,7 @@ class NSQueueingLogicPriRL
     void set_rate(size_t queue_id, size_t priority, uint64_t pps)
     {
         LockType lock(mutex);
-        for_one_q(queue_id, priority, SetRateFn(pps));
+        set_rate_at(get_index(queue_id, priority), pps);
     }
 
     /**
@@ -516,11 +938,281 @@ class NSQueueingLogicPriRL
     void set_rate_for_all(uint64_t pps)
     {
         LockType lock(mutex);
-        for (auto& p : queues_info)
-            for_each_q(p.first, SetRateFn(pps));
+        for (size_t idx = 0; idx < pri_rate_pps.size(); idx++)
+            set_rate_at(idx, pps);
         queue_rate_pps = pps;
     }
 
+    /**
+     * @brief Set the rate of all the priority queues for logical queue \p
+     * queue_id to \p bps bits per second, replacing their packet rate. The
+     * gap after an element is the time to transmit its size. A rate of 0
+     * means no rate limit.
+     *
+     * @param queue_id the id of logical queue in each egress port
+     * @param bps bits per second
+     */
+    void set_rate_bps(size_t queue_id, uint64_t bps)
+    {
+        LockType lock(mutex);
+        size_t first = get_index(queue_id, 0);
+        for (size_t idx = first; idx < first + nb_priorities; idx++)
+            set_rate_bps_at(idx, bps);
+    }
+
+    /**
+     * @brief Same as set_rate_bps(size_t queue_id, uint64_t bps) but only
+     * applies to the given priority queue.
+     *
+     * @param queue_id the id of logical queue in each egress port
+     * @param priority the prirority of the packet in one logical queue
+     * @param bps bits per second
+     */
+    void set_rate_bps(size_t queue_id, size_t priority, uint64_t bps)
+    {
+        LockType lock(mutex);
+        set_rate_bps_at(get_index(queue_id, priority), bps);
+    }
+
+    /**
+     * @brief Set the rate of all the priority queues of all logical queues to
+     * \p bps bits per second, replacing their packet rate.
+     *
+     * @param bps bits per second, 0 for no rate limit
+     */
+    void set_rate_bps_for_all(uint64_t bps)
+    {
+        LockType lock(mutex);
+        for (size_t idx = 0; idx < pri_rate_bps.size(); idx++)
+            set_rate_bps_at(idx, bps);
+        queue_rate_bps = bps;
+    }
+
+    /**
+     * @brief Set the line rate of the egress port of logical queue \p queue_id
+     * to \p pps elements per second, shared by all its priority queues. A rate
+     * of 0 (the default) means no line rate limit.
+     *
+     * @param queue_id the id of logical queue in each egress port
+     * @param pps packets per second
+     */
+    void set_port_rate(size_t queue_id, uint64_t pps)
+    {
+        LockType lock(mutex);
+        size_t q = get_index(queue_id, 0) / nb_priorities;
+        port_delay[q] = port_rate_to_time(pps);
+        port_rate_bps[q] = 0;
+    }
+
+    /**
+     * @brief Set the line rate of the egress ports of all logical queues to
+     * \p pps elements per second.
+     *
+     * @param pps packets per second, 0 for no line rate limit
+     */
+    void set_port_rate_for_all(uint64_t pps)
+    {
+        LockType lock(mutex);
+        std::fill(port_delay.begin(), port_delay.end(), port_rate_to_time(pps));
+        std::fill(port_rate_bps.begin(), port_rate_bps.end(), 0);
+        port_rate_pps = pps;
+        port_rate_bits = 0;
+    }
+
+    /**
+     * @brief Set the line rate of the egress port of logical queue \p queue_id
+     * to \p bps bits per second, replacing its packet rate: after an element,
+     * the port is busy for the time to transmit its size.
+     *
+     * @param queue_id the id of logical queue in each egress port
+     * @param bps bits per second, 0 for no line rate limit
+     */
+    void set_port_rate_bps(size_t queue_id, uint64_t bps)
+    {
+        LockType lock(mutex);
+        size_t q = get_index(queue_id, 0) / nb_priorities;
+        port_delay[q] = Seconds(0);
+        port_rate_bps[q] = bps;
+    }
+
+    /**
+     * @brief Set the line rate of the egress ports of all logical queues to
+     * \p bps bits per second.
+     *
+     * @param bps bits per second, 0 for no line rate limit
+     */
+    void set_port_rate_bps_for_all(uint64_t bps)
+    {
+        LockType lock(mutex);
+        std::fill(port_delay.begin(), port_delay.end(), Seconds(0));
+        std::fill(port_rate_bps.begin(), port_rate_bps.end(), bps);
+        port_rate_pps = 0;
+        port_rate_bits = bps;
+    }
+
+    /**
+     * @brief Pause or resume priority queue \p priority of logical queue
+     * \p queue_id. A paused priority queue keeps accepting elements but is
+     * not served.
+     *
+     * @param queue_id the id of logical queue in each egress port
+     * @param priority the \p priority number of one logical queue
+     * @param paused true to pause the priority queue, false to resume it
+     */
+    void set_paused(size_t queue_id, size_t priority, bool paused)
+    {
+        LockType lock(mutex);
+        size_t idx = get_index(queue_id, priority);
+        if (static_cast<bool>(pri_paused[idx]) == paused)
+            return;
+        pri_paused[idx] = paused;
+        if (paused)
+            nb_paused++;
+        else
+            nb_paused--;
+    }
+
+    /**
+     * @brief Check if priority queue \p priority of logical queue \p queue_id
+     * is paused.
+     *
+     * @param queue_id the id of logical queue in each egress port
+     * @param priority the priority queue
+     * @return true if the priority queue is paused
+     */
+    bool is_paused(size_t queue_id, size_t priority) const
+    {
+        LockType lock(mutex);
+        if (queue_id >= queue_size.size() || priority >= nb_priorities)
+            return false;
+        return pri_paused[queue_id * nb_priorities + priority];
+    }
+
+    /**
+     * @brief Set the function marking the elements ECN CE for the AQM.
+     * Without marker, the AQM drops the elements it would mark.
+     *
+     * @param marker the marker
+     */
+    void set_ecn_marker(EcnMarker marker)
+    {
+        LockType lock(mutex);
+        ecn_marker = std::move(marker);
+    }
+
+    /**
+     * @brief Set the AQM of priority queue \p priority of logical queue \p
+     * queue_id, resetting its state and counters.
+     *
+     * @param queue_id the id of logical queue in each egress port
+     * @param priority the priority queue
+     * @param config the AQM configuration, mode P4Aqm::NONE to disable it
+     */
+    void set_aqm(size_t queue_id, size_t priority, const P4Aqm::Config& config)
+    {
+        LockType lock(mutex);
+        pri_aqm[get_index(queue_id, priority)].Configure(config);
+        update_aqm_enabled();
+    }
+
+    /**
+     * @brief Set the AQM of all the priority queues of logical queue \p
+     * queue_id.
+     *
+     * @param queue_id the id of logical queue in each egress port
+     * @param config the AQM configuration
+     */
+    void set_aqm(size_t queue_id, const P4Aqm::Config& config)
+    {
+        LockType lock(mutex);
+        size_t first = get_index(queue_id, 0);
+        for (size_t idx = first; idx < first + nb_priorities; idx++)
+            pri_aqm[idx].Configure(config);
+        update_aqm_enabled();
+    }
+
+    /**
+     * @brief Set the AQM of all the priority queues of all logical queues,
+     * including the ones allocated later.
+     *
+     * @param config the AQM configuration
+     */
+    void set_aqm_for_all(const P4Aqm::Config& config)
+    {
+        LockType lock(mutex);
+        for (auto& aqm : pri_aqm)
+            aqm.Configure(config);
+        aqm_config = config;
+        update_aqm_enabled();
+    }
+
+    /**
+     * @brief Get the packets marked and dropped by the AQM of priority queue
+     * \p priority of logical queue \p queue_id.
+     *
+     * @param queue_id the id of logical queue in each egress port
+     * @param priority the priority queue
+     * @return the counters, 0 for a queue which does not exist
+     */
+    P4Aqm::Counters aqm_counters(size_t queue_id, size_t priority) const
+    {
+        LockType lock(mutex);
+        if (queue_id >= queue_size.size() || priority >= nb_priorities)
+            return P4Aqm::Counters();
+        return pri_aqm[queue_id * nb_priorities + priority].GetCounters();
+    }
+
+    /**
+     * @brief Enable or disable the occupancy and sojourn time histograms of
+     * all the priority queues. Enabling them allocates the histograms, the
+     * enqueue and dequeue paths then only update them, without allocating.
+     * Disabling them discards their counts.
+     *
+     * @param enable true to keep the histograms
+     */
+    void enable_histograms(bool enable)
+    {
+        LockType lock(mutex);
+        histograms_enabled = enable;
+        depth_hist.assign(enable ? pri_size.size() : 0, P4Histogram());
+        sojourn_hist.assign(enable ? pri_size.size() : 0, P4Histogram());
+    }
+
+    /**
+     * @brief Get the histogram of the occupancy of priority queue \p priority
+     * of logical queue \p queue_id, seen by the elements pushed into it
+     * (including the ones rejected because the queue was full).
+     *
+     * @param queue_id the id of logical queue in each egress port
+     * @param priority the priority queue
+     * @return the histogram (elements), nullptr if the histograms are disabled
+     * or the queue does not exist
+     */
+    const P4Histogram* depth_histogram(size_t queue_id, size_t priority) const
+    {
+        LockType lock(mutex);
+        if (!histograms_enabled || queue_id >= queue_size.size() || priority >= nb_priorities)
+            return nullptr;
+        return &depth_hist[queue_id * nb_priorities + priority];
+    }
+
+    /**
+     * @brief Get the histogram of the time the elements served from priority
+     * queue \p priority of logical queue \p queue_id spent in it.
+     *
+     * @param queue_id the id of logical queue in each egress port
+     * @param priority the priority queue
+     * @return the histogram (nanoseconds), nullptr if the histograms are
+     * disabled or the queue does not exist
+     */
+    const P4Histogram* sojourn_histogram(size_t queue_id, size_t priority) const
+    {
+        LockType lock(mutex);
+        if (!histograms_enabled || queue_id >= queue_size.size() || priority >= nb_priorities)
+            return nullptr;
+        return &sojourn_hist[queue_id * nb_priorities + priority];
+    }
+
     //! Deleted copy constructor
     NSQueueingLogicPriRL(const NSQueueingLogicPriRL&) = delete;
     //! Deleted copy assignment operator
@@ -546,24 +1238,47 @@ class NSQueueingLogicPriRL
                           : Seconds(static_cast<double>(1. / static_cast<double>(pps)));
     }
 
+    /**
+     * @brief Time between two packets of a port transmitting at \p pps,
+     * 0 if the port has no line rate limit.
+     */
+    static Time port_rate_to_time(uint64_t pps)
+    {
+        return (pps == 0) ? Seconds(0) : Seconds(1. / static_cast<double>(pps));
+    }
+
+    /**
+     * @brief Time to transmit \p bytes at \p bps bits per second.
+     */
+    static Time bytes_to_time(size_t bytes, uint64_t bps)
+    {
+        return Seconds(static_cast<double>(bytes) * 8. / static_cast<double>(bps));
+    }
+
     /**
      * @brief The control label of the packet, the queue it is in,
      * the timestamp, etc.
      */
     struct QE
     {
-        QE(T e, size_t queue_id, const Time& send, size_t id)
+        QE() = default;
+
+        QE(T e, size_t queue_id, size_t bytes, const Time& enq, const Time& send, size_t id)
             : e(std::move(e)),
               queue_id(queue_id),
+              bytes(bytes),
+              enq(enq),
               send(send),
               id(id)
         {
         }
 
-        T e;
-        size_t queue_id;
+        T e{};
+        size_t queue_id{0};
+        size_t bytes{0};
+        Time enq;
         Time send;
-        size_t id;
+        size_t id{0};
     };
 
     /**
@@ -578,142 +1293,323 @@ class NSQueueingLogicPriRL
         }
     };
 
-    using MyQ = std::priority_queue<QE, std::deque<QE>, QEComp>;
-
     /**
-     * @brief information for each prioriry queue.
-     *
+     * @brief FIFO of the elements of one priority queue, stored in a
+     * contiguous ring which doubles its storage when full.
      */
-    struct QueueInfoPri
+    class QERing
     {
-        QueueInfoPri(size_t capacity, uint64_t queue_rate_pps)
-            : capacity(capacity),
-              queue_rate_pps(queue_rate_pps),
-              pkt_delay_time(rate_to_time(queue_rate_pps)),
-              last_sent(Simulator::Now())
+      public:
+        bool empty() const
         {
+            return count == 0;
         }
 
-        size_t size{0};
-        size_t capacity;
-        uint64_t queue_rate_pps;
-        Time pkt_delay_time;
-        Time last_sent;
+        QE& front()
+        {
+            return slots[head];
+        }
+
+        const QE& front() const
+        {
+            return slots[head];
+        }
+
+        void push_back(QE&& qe)
+        {
+            if (count == slots.size())
+                grow();
+            slots[(head + count) % slots.size()] = std::move(qe);
+            count++;
+        }
+
+        void pop_front()
+        {
+            slots[head] = QE();
+            head = (head + 1) % slots.size();
+            count--;
+        }
+
+      private:
+        void grow()
+        {
+            std::vector<QE> larger(std::max<size_t>(2 * slots.size(), 16));
+            for (size_t i = 0; i < count; i++)
+                larger[i] = std::move(slots[(head + i) % slots.size()]);
+            slots = std::move(larger);
+            head = 0;
+        }
+
+        std::vector<QE> slots;
+        size_t head{0};
+        size_t count{0};
     };
 
     /**
-     * @brief information for each logical queue (containing multiple
-     * priority queues).
+     * @brief pop_back() without locking
+     * @return true if an element was retrieved
      */
-    struct QueueInfo : public std::vector<QueueInfoPri>
+    bool pop_eligible(size_t worker_id, size_t* queue_id, size_t* priority, T* pItem)
     {
-        QueueInfo(size_t capacity, uint64_t queue_rate_pps, size_t nb_priorities)
-            : std::vector<QueueInfoPri>(nb_priorities, QueueInfoPri(capacity, queue_rate_pps))
+        if (workers_size.at(worker_id) == 0)
+            return false;
+
+        Time now = Simulator::Now();
+        // This will iterate from nb_priorities-1 to 0
+        for (size_t pri = nb_priorities; pri-- > 0;)
         {
+            // Among the queues of the worker, the head with the earliest send
+            // time (then the oldest one) is served, as from the bmv2 heap
+            const QE* best = nullptr;
+            size_t best_idx = 0;
+            for_each_active(pri, [&](size_t q) {
+                size_t idx = q * nb_priorities + pri;
+                if (port_next_free[q] > now || (nb_paused != 0 && pri_paused[idx]) ||
+                    map_to_worker(q) != worker_id)
+                    return;
+                const QE& head = rings[idx].front();
+                if (head.send <= now && (!best || QEComp()(*best, head)))
+                {
+                    best = &head;
+                    best_idx = idx;
+                }
+            });
+            if (best)
+            {
+                *queue_id = best->queue_id;
+                *priority = pri;
+                if (histograms_enabled)
+                    sojourn_hist[best_idx].Record((now - best->enq).GetNanoSeconds());
+                if (aqm_enabled)
+                    pri_aqm[best_idx].OnDequeue(now - best->enq);
+                size_t bytes = best->bytes;
+                *pItem = std::move(rings[best_idx].front().e);
+                rings[best_idx].pop_front();
+                if (--pri_size[best_idx] == 0)
+                    active[pri][*queue_id / 64] &= ~(uint64_t(1) << (*queue_id % 64));
+                shared_used -= shared_bytes(best_idx);
+                pri_bytes[best_idx] -= bytes;
+                shared_used += shared_bytes(best_idx);
+                queue_size[*queue_id]--;
+                queue_bytes[*queue_id] -= bytes;
+                Time port_gap = port_rate_bps[*queue_id]
+                                    ? bytes_to_time(bytes, port_rate_bps[*queue_id])
+                                    : port_delay[*queue_id];
+                port_next_free[*queue_id] = now + port_gap;
+                workers_size[worker_id]--;
+                return true;
+            }
         }
-
-        size_t size{0};
-    };
+        return false;
+    }
 
     /**
-     * @brief threads information from bmv2 src.
-     *
+     * @brief Call \p f with the id of each logical queue whose priority queue
+     * \p pri holds elements, in increasing order.
      */
-    struct WorkerInfo
+    template <typename F>
+    void for_each_active(size_t pri, F f) const
     {
-        mutable std::condition_variable q_not_empty{};
-        size_t size{0};
-        std::array<MyQ, 32> queues;
-        size_t wrapping_counter{0};
-    };
+        const std::vector<uint64_t>& words = active[pri];
+        for (size_t w = 0; w < words.size(); w++)
+        {
+            for (uint64_t bits = words[w]; bits != 0; bits &= bits - 1)
+                f(w * 64 + __builtin_ctzll(bits));
+        }
+    }
 
-    QueueInfo& get_queue(size_t queue_id)
+    /**
+     * @brief Get the index of a priority queue in the dense arrays, growing
+     * them if \p queue_id is a new logical queue.
+     */
+    size_t get_index(size_t queue_id, size_t priority)
     {
-        auto it = queues_info.find(queue_id);
-        if (it != queues_info.end())
-            return it->second;
-        auto p = queues_info.emplace(queue_id, QueueInfo(capacity, queue_rate_pps, nb_priorities));
-        return p.first->second;
+        if (priority >= nb_priorities)
+            throw std::out_of_range("priority out of range");
+        if (queue_id >= queue_size.size())
+            grow(queue_id + 1);
+        return queue_id * nb_priorities + priority;
     }
 
-    const QueueInfo& get_queue_or_throw(size_t queue_id) const
+    /**
+     * @brief Allocate the state of the logical queues up to \p nb_queues,
+     * with the default capacity and rate.
+     */
+    void grow(size_t nb_queues)
     {
-        return queues_info.at(queue_id);
+        if (nb_queues <= queue_size.size())
+            return;
+        size_t nb_pri_queues = nb_queues * nb_priorities;
+        queue_size.resize(nb_queues, 0);
+        queue_bytes.resize(nb_queues, 0);
+        port_delay.resize(nb_queues, port_rate_to_time(port_rate_pps));
+        port_rate_bps.resize(nb_queues, port_rate_bits);
+        port_next_free.resize(nb_queues, Time());
+        pri_size.resize(nb_pri_queues, 0);
+        pri_bytes.resize(nb_pri_queues, 0);
+        pri_capacity.resize(nb_pri_queues, capacity);
+        pri_byte_capacity.resize(nb_pri_queues, byte_capacity);
+        pri_rate_pps.resize(nb_pri_queues, queue_rate_pps);
+        pri_rate_bps.resize(nb_pri_queues, queue_rate_bps);
+        pri_delay.resize(nb_pri_queues, rate_to_time(queue_rate_pps));
+        pri_last_sent.resize(nb_pri_queues, Simulator::Now());
+        pri_last_bytes.resize(nb_pri_queues, 0);
+        reserved_total += (nb_pri_queues - pri_reserve.size()) * shared_reserve;
+        pri_reserve.resize(nb_pri_queues, shared_reserve);
+        pri_alpha.resize(nb_pri_queues, shared_alpha);
+        pri_paused.resize(nb_pri_queues, false);
+        size_t first_new = pri_aqm.size();
+        pri_aqm.resize(nb_pri_queues);
+        if (aqm_config.mode != P4Aqm::NONE)
+        {
+            for (size_t idx = first_new; idx < nb_pri_queues; idx++)
+                pri_aqm[idx].Configure(aqm_config);
+        }
+        rings.resize(nb_pri_queues);
+        active.resize(nb_priorities);
+        for (auto& words : active)
+            words.resize((nb_queues + 63) / 64, 0);
+        if (histograms_enabled)
+        {
+            depth_hist.resize(nb_pri_queues);
+            sojourn_hist.resize(nb_pri_queues);
+        }
     }
 
-    QueueInfo& get_queue_or_throw(size_t queue_id)
+    /**
+     * @brief Bytes of priority queue \p idx beyond its reserve when it holds
+     * \p queued bytes
+     */
+    size_t shared_bytes(size_t idx, size_t queued) const
     {
-        return queues_info.at(queue_id);
+        return queued > pri_reserve[idx] ? queued - pri_reserve[idx] : 0;
     }
 
-    Time get_next_tp(const QueueInfoPri& q_info_pri)
+    size_t shared_bytes(size_t idx) const
     {
-        // Calculate when the next step should be sent
-        return (Simulator::Now() > q_info_pri.last_sent + q_info_pri.pkt_delay_time)
-                   ? Simulator::Now()
-                   : q_info_pri.last_sent + q_info_pri.pkt_delay_time;
+        return shared_bytes(idx, pri_bytes[idx]);
     }
 
-    template <typename Function>
-    Function for_each_q(size_t queue_id, Function fn)
+    /**
+     * @brief Size of the shared buffer without the reserves
+     */
+    size_t shared_pool() const
     {
-        auto& q_info = get_queue(queue_id);
-        for (auto& q_info_pri : q_info)
-            fn(q_info_pri);
-        return fn;
+        return shared_total > reserved_total ? shared_total - reserved_total : 0;
     }
 
-    template <typename Function>
-    Function for_one_q(size_t queue_id, size_t priority, Function fn)
+    /**
+     * @brief Dynamic threshold check of priority queue \p idx taking
+     * \p shared more bytes from the shared pool
+     */
+    bool shared_admit(size_t idx, size_t shared) const
     {
-        auto& q_info = get_queue(queue_id);
-        auto& q_info_pri = q_info.at(priority);
-        fn(q_info_pri);
-        return fn;
+        size_t pool = shared_pool();
+        if (shared_used + shared > pool)
+            return false;
+        double threshold = pri_alpha[idx] * static_cast<double>(pool - shared_used);
+        return static_cast<double>(shared_bytes(idx) + shared) <= threshold;
     }
 
-    struct SetCapacityFn
+    /**
+     * @brief Recompute the reserves and the shared pool occupancy after a
+     * reserve change
+     */
+    void update_shared_used()
     {
-        explicit SetCapacityFn(size_t c)
-            : c(c)
+        reserved_total = 0;
+        shared_used = 0;
+        for (size_t idx = 0; idx < pri_reserve.size(); idx++)
         {
+            reserved_total += pri_reserve[idx];
+            shared_used += shared_bytes(idx);
         }
+    }
 
-        void operator()(QueueInfoPri& info) const
-        { // NOLINT(runtime/references)
-            info.capacity = c;
-        }
-
-        size_t c;
-    };
+    void update_aqm_enabled()
+    {
+        aqm_enabled = std::any_of(pri_aqm.begin(), pri_aqm.end(), [](const P4Aqm& aqm) {
+            return aqm.IsEnabled();
+        });
+    }
 
-    struct SetRateFn
+    void set_rate_at(size_t idx, uint64_t pps)
     {
-        explicit SetRateFn(uint64_t pps)
-            : pps(pps)
-        {
-            pkt_delay_time = rate_to_time(pps);
-        }
+        pri_rate_pps[idx] = pps;
+        pri_rate_bps[idx] = 0;
+        pri_delay[idx] = rate_to_time(pps);
+    }
 
-        void operator()(QueueInfoPri& info) const
-        { // NOLINT(runtime/references)
-            info.queue_rate_pps = pps;
-            info.pkt_delay_time = pkt_delay_time;
-        }
+    void set_rate_bps_at(size_t idx, uint64_t bps)
+    {
+        pri_rate_pps[idx] = 0;
+        pri_rate_bps[idx] = bps;
+        pri_delay[idx] = Seconds(0);
+    }
 
-        uint64_t pps;
-        Time pkt_delay_time;
-    };
+    Time get_next_tp(size_t idx) const
+    {
+        // Calculate when the next step should be sent: the gap after the last
+        // element is fixed with a packet rate, its transmission time with a
+        // bit rate
+        Time gap = pri_rate_bps[idx] ? bytes_to_time(pri_last_bytes[idx], pri_rate_bps[idx])
+                                     : pri_delay[idx];
+        Time next = pri_last_sent[idx] + gap;
+        return (Simulator::Now() > next) ? Simulator::Now() : next;
+    }
 
     mutable MutexType mutex;
     size_t nb_workers;
     size_t capacity;            // default capacity
+    size_t byte_capacity{0};    // default capacity in bytes, 0: no limit
     uint64_t queue_rate_pps{0}; // default rate
-    std::unordered_map<size_t, QueueInfo> queues_info{};
-    std::vector<WorkerInfo> workers_info{};
-    std::vector<MyQ> queues{};
+    uint64_t queue_rate_bps{0}; // default rate in bits per second, 0: packet rate
+    uint64_t port_rate_pps{0};  // default line rate of the ports
+    uint64_t port_rate_bits{0}; // default line rate of the ports in bits per second
+    size_t shared_total{0};     // size of the shared buffer, 0: private buffers
+    size_t shared_reserve{0};   // default reserve in the shared buffer
+    double shared_alpha{1};     // default dynamic threshold factor
+    size_t reserved_total{0};   // sum of the reserves
+    size_t shared_used{0};      // bytes of the shared buffer used beyond the reserves
     FMap map_to_worker;
     size_t nb_priorities;
+
+    // Per logical queue, indexed by queue_id
+    std::vector<size_t> queue_size;
+    std::vector<size_t> queue_bytes;
+    std::vector<Time> port_delay;        // time between two packets of the port
+    std::vector<uint64_t> port_rate_bps; // line rate in bits per second, 0: port_delay
+    std::vector<Time> port_next_free;    // time the port can transmit again
+
+    // Per priority queue, indexed by queue_id * nb_priorities + priority
+    std::vector<size_t> pri_size;
+    std::vector<size_t> pri_bytes;
+    std::vector<size_t> pri_capacity;
+    std::vector<size_t> pri_byte_capacity; // 0: no limit
+    std::vector<uint64_t> pri_rate_pps;
+    std::vector<uint64_t> pri_rate_bps; // 0: packet rate (pri_delay)
+    std::vector<Time> pri_delay;
+    std::vector<Time> pri_last_sent;
+    std::vector<size_t> pri_last_bytes; // size of the last element pushed
+    std::vector<size_t> pri_reserve;    // bytes guaranteed in the shared buffer
+    std::vector<double> pri_alpha;      // dynamic threshold factor in the shared buffer
+    std::vector<uint8_t> pri_paused;    // paused by set_paused()
+    size_t nb_paused{0};                // priority queues paused
+    std::vector<QERing> rings;
+    std::vector<P4Aqm> pri_aqm;
+    // Per priority, bitmap of the logical queues whose priority queue is not empty
+    std::vector<std::vector<uint64_t>> active;
+    bool aqm_enabled{false};  // any priority queue has an AQM
+    P4Aqm::Config aqm_config; // AQM of the priority queues allocated later
+    EcnMarker ecn_marker;
+    bool histograms_enabled{false};
+    std::vector<P4Histogram> depth_hist;   // occupancy seen at enqueue
+    std::vector<P4Histogram> sojourn_hist; // enqueue to dequeue, in ns
+
+    // Per worker, indexed by worker_id
+    std::vector<size_t> workers_size;
+    std::vector<size_t> workers_counter;
+    std::vector<typename LockPolicy::CondVar> workers_not_empty;
 };
 
 } // namespace ns3
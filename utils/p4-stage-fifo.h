@@ -0,0 +1,158 @@
+/*
+ * Copyright (c) 2025 TU Dresden
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Authors: Mingyu Ma <mingyu.ma@tu-dresden.de>
+ */
+
+#ifndef P4_STAGE_FIFO_H
+#define P4_STAGE_FIFO_H
+
+#include "ns3/simulator.h"
+
+#include <deque>
+#include <functional>
+
+namespace ns3
+{
+
+/**
+ * @brief Packets in flight through a pipeline stage with a fixed latency.
+ *
+ * Every item pushed into the stage leaves it, in order, after the latency of
+ * the stage. As the latency is the same for all the items, they leave in the
+ * order they entered: the stage keeps them in a FIFO and only schedules one
+ * event, for the item at its head, instead of one event per item.
+ *
+ * With a latency of zero, the items are handed to the next stage immediately
+ * and no event is ever scheduled.
+ *
+ * @tparam T the item type, may be move-only
+ */
+template <typename T>
+class P4StageFifo
+{
+  public:
+    using Handler = std::function<void(T&&)>; //!< Receives the items leaving the stage
+
+    P4StageFifo()
+        : m_latency(Seconds(0))
+    {
+    }
+
+    ~P4StageFifo()
+    {
+        Simulator::Cancel(m_event);
+    }
+
+    /**
+     * @brief Set the function receiving the items leaving the stage
+     * @param handler the handler
+     */
+    void SetHandler(Handler handler)
+    {
+        m_handler = std::move(handler);
+    }
+
+    /**
+     * @brief Set the latency of the stage
+     * @details Items already in the stage keep their exit time. The stage
+     * never reorders its items: after a latency decrease, new items wait for
+     * the items in flight to leave.
+     * @param latency the latency
+     */
+    void SetLatency(Time latency)
+    {
+        m_latency = latency;
+    }
+
+    /**
+     * @brief Get the latency of the stage
+     * @return the latency
+     */
+    Time GetLatency() const
+    {
+        return m_latency;
+    }
+
+    /**
+     * @brief Get the number of items in the stage
+     * @return the number of items
+     */
+    size_t GetSize() const
+    {
+        return m_items.size();
+    }
+
+    /**
+     * @brief Push an item into the stage
+     * @param item the item, handed to the handler after the stage latency
+     */
+    void Push(T&& item)
+    {
+        if (m_latency.IsZero() && m_items.empty())
+        {
+            m_handler(std::move(item));
+            return;
+        }
+        m_items.push_back(Entry{Simulator::Now() + m_latency, std::move(item)});
+        if (m_event.IsExpired())
+        {
+            m_event = Simulator::Schedule(m_items.front().exit - Simulator::Now(),
+                                          &P4StageFifo::Drain,
+                                          this);
+        }
+    }
+
+    P4StageFifo(const P4StageFifo&) = delete;
+    P4StageFifo& operator=(const P4StageFifo&) = delete;
+
+  private:
+    /**
+     * @brief An item and the time it leaves the stage
+     */
+    struct Entry
+    {
+        Time exit; //!< Exit time
+        T item;    //!< The item
+    };
+
+    /**
+     * @brief Hand the items whose exit time has come to the handler
+     */
+    void Drain()
+    {
+        Time now = Simulator::Now();
+        while (!m_items.empty() && m_items.front().exit <= now)
+        {
+            T item = std::move(m_items.front().item);
+            m_items.pop_front();
+            m_handler(std::move(item));
+        }
+        if (!m_items.empty() && m_event.IsExpired())
+        {
+            m_event = Simulator::Schedule(m_items.front().exit - now, &P4StageFifo::Drain, this);
+        }
+    }
+
+    Time m_latency;            //!< Latency of the stage
+    Handler m_handler;         //!< Receives the items leaving the stage
+    std::deque<Entry> m_items; //!< Items in the stage, by exit time
+    EventId m_event;           //!< Exit event of the head item
+};
+
+} // namespace ns3
+
+#endif /* P4_STAGE_FIFO_H */
@@ -0,0 +1,60 @@
+/*
+ * Copyright (c) 2025 TU Dresden
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Authors: Mingyu Ma <mingyu.ma@tu-dresden.de>
+ */
+
+#ifndef PRIMITIVES_PNA_H
+#define PRIMITIVES_PNA_H
+
+#include "ns3/p4-nic-pna.h"
+
+#include <bm/bm_sim/actions.h>
+#include <bm/bm_sim/packet.h>
+
+// Forwarding externs of the PNA main control. The compiler emits the calls to
+// extern functions as primitives of the same name; the decision is kept in the
+// egress port of the packet and read by P4PnaNic::main_processing_pipeline.
+
+/**
+ * @brief send_to_port(dest_port): forward the packet to a port at the end of
+ * the main control, overriding an earlier drop_packet()
+ */
+class send_to_port : public bm::ActionPrimitive<const bm::Data&>
+{
+    void operator()(const bm::Data& dest_port)
+    {
+        get_packet().set_egress_port(dest_port.get<uint32_t>());
+    }
+};
+
+REGISTER_PRIMITIVE(send_to_port);
+
+/**
+ * @brief drop_packet(): drop the packet at the end of the main control,
+ * overriding an earlier send_to_port()
+ */
+class drop_packet : public bm::ActionPrimitive<>
+{
+    void operator()()
+    {
+        get_packet().set_egress_port(ns3::P4PnaNic::DROP_PORT);
+    }
+};
+
+REGISTER_PRIMITIVE(drop_packet);
+
+#endif // PRIMITIVES_PNA_H
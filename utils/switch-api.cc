@@ -114,6 +114,25 @@ SwitchApi::InitApiMap()
     g_apiMap["swap_configs"] = SWAP_CONFIGS;
     g_apiMap["get_config"] = GET_CONFIG;
     g_apiMap["get_config_md5"] = GET_CONFIG_MD5;
+
+    // Mirroring Operations
+    g_apiMap["mirroring_add"] = MIRRORING_ADD;
+    g_apiMap["mirroring_add_mc"] = MIRRORING_ADD_MC;
+    g_apiMap["mirroring_delete"] = MIRRORING_DELETE;
+
+    // Multicast Operations
+    g_apiMap["mc_mgrp_create"] = MC_MGRP_CREATE;
+    g_apiMap["mc_mgrp_destroy"] = MC_MGRP_DESTROY;
+    g_apiMap["mc_node_create"] = MC_NODE_CREATE;
+    g_apiMap["mc_node_update"] = MC_NODE_UPDATE;
+    g_apiMap["mc_node_associate"] = MC_NODE_ASSOCIATE;
+    g_apiMap["mc_node_dissociate"] = MC_NODE_DISSOCIATE;
+    g_apiMap["mc_node_destroy"] = MC_NODE_DESTROY;
+    g_apiMap["mc_set_lag_membership"] = MC_SET_LAG_MEMBERSHIP;
+
+    // Queue Operations
+    g_apiMap["set_queue_depth"] = SET_QUEUE_DEPTH;
+    g_apiMap["set_queue_rate"] = SET_QUEUE_RATE;
 }
 
 } // namespace ns3
@@ -46,7 +46,10 @@ class SwitchApi
         METER_OPERATIONS,           // APIs for configuring/querying meters
         REGISTER_OPERATIONS,        // APIs for managing registers
         PARSE_VALUE_SET_OPERATIONS, // APIs for parse value sets
-        RUNTIME_STATE_MANAGEMENT    // APIs for managing runtime state
+        RUNTIME_STATE_MANAGEMENT,   // APIs for managing runtime state
+        MIRRORING_OPERATIONS,       // APIs for mirroring (clone) sessions
+        MULTICAST_OPERATIONS,       // APIs for the packet replication engine
+        QUEUE_OPERATIONS            // APIs for the egress queue buffer
     };
 
     // Enums for specific APIs
@@ -136,7 +139,26 @@ class SwitchApi
         LOAD_NEW_CONFIG,
         SWAP_CONFIGS,
         GET_CONFIG,
-        GET_CONFIG_MD5
+        GET_CONFIG_MD5,
+
+        // Mirroring Operations
+        MIRRORING_ADD = MIRRORING_OPERATIONS * 100,
+        MIRRORING_ADD_MC,
+        MIRRORING_DELETE,
+
+        // Multicast Operations
+        MC_MGRP_CREATE = MULTICAST_OPERATIONS * 100,
+        MC_MGRP_DESTROY,
+        MC_NODE_CREATE,
+        MC_NODE_UPDATE,
+        MC_NODE_ASSOCIATE,
+        MC_NODE_DISSOCIATE,
+        MC_NODE_DESTROY,
+        MC_SET_LAG_MEMBERSHIP,
+
+        // Queue Operations
+        SET_QUEUE_DEPTH = QUEUE_OPERATIONS * 100,
+        SET_QUEUE_RATE
     };
 
     // Static map to bind API names to their types